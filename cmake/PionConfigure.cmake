@@ -27,3 +27,9 @@ endif()
 
 # check for required functions
 check_function_exists(malloc_trim PION_HAVE_MALLOC_TRIM)
+
+# check for io_uring support (used through its system calls)
+CHECK_INCLUDE_FILE("linux/io_uring.h" PION_HAVE_LINUX_IO_URING_H)
+if(PION_HAVE_LINUX_IO_URING_H)
+    check_symbol_exists(__NR_io_uring_setup "sys/syscall.h" PION_HAVE_IO_URING)
+endif()
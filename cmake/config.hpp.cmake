@@ -24,6 +24,9 @@
 /* Define to 1 if C library supports malloc_trim() */
 #cmakedefine PION_HAVE_MALLOC_TRIM ${PION_HAVE_MALLOC_TRIM}
 
+/* Define to 1 if the kernel headers support io_uring */
+#cmakedefine PION_HAVE_IO_URING ${PION_HAVE_IO_URING}
+
 // -----------------------------------------------------------------------
 // hash_map support
 //
@@ -0,0 +1,332 @@
+// ---------------------------------------------------------------------
+// pion:  a Boost C++ framework for building lightweight HTTP interfaces
+// ---------------------------------------------------------------------
+// Copyright (C) 2007-2014 Splunk Inc.  (https://github.com/splunk/pion)
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See http://www.boost.org/LICENSE_1_0.txt
+//
+
+#ifndef __PION_FLAT_MULTIMAP_HEADER__
+#define __PION_FLAT_MULTIMAP_HEADER__
+
+#include <string>
+#include <vector>
+#include <utility>
+#include <iterator>
+#include <cstddef>
+#include <boost/cstdint.hpp>
+#include <pion/config.hpp>
+
+
+namespace pion {    // begin namespace pion
+
+
+///
+/// flat_multimap: case-insensitive dictionary of strings that keeps its
+/// entries in a vector, in the order they were added.  Entries with the same
+/// key are linked together, so that equal_range() visits only those.
+///
+/// HTTP messages hold only a handful of headers, cookies and query
+/// parameters, so a search of a vector is faster than hashing the key.  The
+/// standard HTTP header names are found through an index without searching
+/// at all, and larger dictionaries (such as big HTML forms) keep a hash
+/// index of their other keys.
+///
+/// Keys are compared by folding ASCII letters only.  The key of an entry
+/// must not be modified through an iterator.
+///
+class PION_API flat_multimap {
+public:
+
+    /// standard HTTP header names, which are found without searching
+    enum known_key_t {
+        KEY_HOST = 0,
+        KEY_DATE,
+        KEY_ETAG,
+        KEY_RANGE,
+        KEY_ACCEPT,
+        KEY_COOKIE,
+        KEY_ORIGIN,
+        KEY_PRAGMA,
+        KEY_SERVER,
+        KEY_EXPIRES,
+        KEY_REFERER,
+        KEY_UPGRADE,
+        KEY_LOCATION,
+        KEY_CLIENT_IP,
+        KEY_CONNECTION,
+        KEY_SET_COOKIE,
+        KEY_USER_AGENT,
+        KEY_CONTENT_TYPE,
+        KEY_AUTHORIZATION,
+        KEY_CACHE_CONTROL,
+        KEY_IF_NONE_MATCH,
+        KEY_LAST_MODIFIED,
+        KEY_CONTENT_LENGTH,
+        KEY_ACCEPT_ENCODING,
+        KEY_ACCEPT_LANGUAGE,
+        KEY_X_FORWARDED_FOR,
+        KEY_CONTENT_ENCODING,
+        KEY_CONTENT_LOCATION,
+        KEY_IF_MODIFIED_SINCE,
+        KEY_TRANSFER_ENCODING,
+        KEY_CONTENT_DISPOSITION,
+        NUM_KNOWN_KEYS,
+        KEY_UNKNOWN = NUM_KNOWN_KEYS
+    };
+
+    typedef std::string                             key_type;
+    typedef std::string                             mapped_type;
+    typedef std::pair<std::string, std::string>     value_type;
+    typedef std::size_t                             size_type;
+    typedef std::ptrdiff_t                          difference_type;
+    typedef value_type&                             reference;
+    typedef const value_type&                       const_reference;
+
+
+protected:
+
+    /// an entry in the dictionary
+    struct entry_t {
+        entry_t(const value_type& v)
+            : value(v), next(NPOS), last(NPOS), key_id(KEY_UNKNOWN) {}
+
+        /// the key and value
+        value_type          value;
+
+        /// position of the next entry with the same key (NPOS if none)
+        boost::uint32_t     next;
+
+        /// position of the last entry with the same key, if this is the
+        /// first one (NPOS for the others)
+        boost::uint32_t     last;
+
+        /// known_key_t for the key
+        boost::uint32_t     key_id;
+    };
+
+    /// data type for the entries
+    typedef std::vector<entry_t>    entries_t;
+
+    /// position used to mean "none"
+    static const boost::uint32_t    NPOS = 0xFFFFFFFFU;
+
+
+public:
+
+    ///
+    /// basic_iterator: walks through the entries in order, or, for
+    /// iterators returned by equal_range(), through the values of one key
+    ///
+    template <typename MapType, typename ValueType>
+    class basic_iterator {
+    public:
+        typedef std::forward_iterator_tag       iterator_category;
+        typedef flat_multimap::value_type       value_type;
+        typedef std::ptrdiff_t                  difference_type;
+        typedef ValueType *                     pointer;
+        typedef ValueType &                     reference;
+
+        basic_iterator(void) : m_map_ptr(NULL), m_pos(0), m_same_key(false) {}
+
+        basic_iterator(MapType *map_ptr, std::size_t pos, bool same_key)
+            : m_map_ptr(map_ptr), m_pos(pos), m_same_key(same_key) {}
+
+        /// converts an iterator to a const_iterator
+        template <typename OtherMapType, typename OtherValueType>
+        basic_iterator(const basic_iterator<OtherMapType, OtherValueType>& i)
+            : m_map_ptr(i.m_map_ptr), m_pos(i.m_pos), m_same_key(i.m_same_key) {}
+
+        inline reference operator*(void) const { return m_map_ptr->m_entries[m_pos].value; }
+        inline pointer operator->(void) const { return &(m_map_ptr->m_entries[m_pos].value); }
+
+        inline basic_iterator& operator++(void) {
+            if (m_same_key) {
+                const boost::uint32_t next = m_map_ptr->m_entries[m_pos].next;
+                m_pos = (next == NPOS ? m_map_ptr->m_entries.size() : next);
+            } else {
+                ++m_pos;
+            }
+            return *this;
+        }
+
+        inline basic_iterator operator++(int) {
+            basic_iterator i(*this);
+            ++(*this);
+            return i;
+        }
+
+        template <typename OtherMapType, typename OtherValueType>
+        inline bool operator==(const basic_iterator<OtherMapType, OtherValueType>& i) const {
+            return m_pos == i.m_pos;
+        }
+
+        template <typename OtherMapType, typename OtherValueType>
+        inline bool operator!=(const basic_iterator<OtherMapType, OtherValueType>& i) const {
+            return m_pos != i.m_pos;
+        }
+
+        /// returns the position of the entry in the dictionary
+        inline std::size_t get_position(void) const { return m_pos; }
+
+    private:
+        template <typename OtherMapType, typename OtherValueType> friend class basic_iterator;
+
+        /// the dictionary being walked through
+        MapType *           m_map_ptr;
+
+        /// position of the current entry
+        std::size_t         m_pos;
+
+        /// true if only the entries with the same key are visited
+        bool                m_same_key;
+    };
+
+    typedef basic_iterator<flat_multimap, value_type>               iterator;
+    typedef basic_iterator<const flat_multimap, const value_type>   const_iterator;
+
+
+    /// constructs an empty dictionary
+    flat_multimap(void) : m_index_size(0) { clear_known_keys(); }
+
+    /// returns the number of entries
+    inline size_type size(void) const { return m_entries.size(); }
+
+    /// returns true if there are no entries
+    inline bool empty(void) const { return m_entries.empty(); }
+
+    /// removes all of the entries
+    inline void clear(void) {
+        m_entries.clear();
+        m_index.clear();
+        m_index_size = 0;
+        clear_known_keys();
+    }
+
+    /// reserves space for a number of entries
+    inline void reserve(size_type n) { m_entries.reserve(n); }
+
+    inline iterator begin(void) { return iterator(this, 0, false); }
+    inline iterator end(void) { return iterator(this, m_entries.size(), false); }
+    inline const_iterator begin(void) const { return const_iterator(this, 0, false); }
+    inline const_iterator end(void) const { return const_iterator(this, m_entries.size(), false); }
+
+    /// returns the first entry for a key, or end() if there are none
+    inline iterator find(const key_type& key) {
+        return iterator(this, find_position(key), false);
+    }
+
+    /// returns the first entry for a key, or end() if there are none
+    inline const_iterator find(const key_type& key) const {
+        return const_iterator(this, find_position(key), false);
+    }
+
+    /// returns the first entry for a standard HTTP header, or end() if there are none
+    inline const_iterator find(known_key_t key_id) const {
+        return const_iterator(this, known_key_position(key_id), false);
+    }
+
+    /// returns the range of entries for a key
+    inline std::pair<iterator, iterator> equal_range(const key_type& key) {
+        return std::make_pair(iterator(this, find_position(key), true), end());
+    }
+
+    /// returns the range of entries for a key
+    inline std::pair<const_iterator, const_iterator> equal_range(const key_type& key) const {
+        return std::make_pair(const_iterator(this, find_position(key), true), end());
+    }
+
+    /// returns the number of entries for a key
+    size_type count(const key_type& key) const;
+
+    /// adds an entry after all of the others
+    iterator insert(const value_type& value);
+
+    /// removes an entry and returns the entry that followed it
+    iterator erase(const_iterator pos);
+
+    /// removes the entries in a range (as returned by equal_range() or begin())
+    void erase(const_iterator first, const_iterator last);
+
+    /// removes all of the entries for a key and returns the number removed
+    size_type erase(const key_type& key);
+
+    /// returns the known_key_t for a standard HTTP header name, or KEY_UNKNOWN
+    static known_key_t get_known_key(const char *ptr, std::size_t length);
+
+    /// returns true if two keys are equal, ignoring the case of ASCII letters
+    static inline bool keys_equal(const char *a, const char *b, std::size_t length) {
+        for (std::size_t n = 0; n < length; ++n) {
+            if (a[n] != b[n] && fold_case(a[n]) != fold_case(b[n]))
+                return false;
+        }
+        return true;
+    }
+
+
+protected:
+
+    /// returns a letter in lower case; other characters are left unchanged
+    static inline char fold_case(char c) {
+        return (c >= 'A' && c <= 'Z') ? static_cast<char>(c + ('a' - 'A')) : c;
+    }
+
+    /// returns the position of the first entry for a standard HTTP header
+    inline std::size_t known_key_position(known_key_t key_id) const {
+        const boost::uint32_t pos = (key_id < NUM_KNOWN_KEYS ? m_known_keys[key_id] : NPOS);
+        return (pos == NPOS ? m_entries.size() : pos);
+    }
+
+    /// returns the position of the first entry for a key, or size() if none
+    std::size_t find_position(const key_type& key) const;
+
+    /// returns the position of the first entry for a key, or NPOS if there
+    /// are none (only entries that have been linked are searched)
+    boost::uint32_t find_first(boost::uint32_t key_id, const char *key_ptr,
+                               std::size_t key_length) const;
+
+    /// links an entry to the others with the same key
+    void link_entry(boost::uint32_t pos);
+
+    /// links all of the entries again after some have been removed
+    void relink_entries(void);
+
+    /// adds the first entry for an unknown key to the hash index
+    void add_to_index(boost::uint32_t pos);
+
+    /// builds the hash index of unknown keys, making room for more
+    void build_index(void);
+
+    /// returns a hash of a key, ignoring the case of ASCII letters
+    static std::size_t hash_key(const char *ptr, std::size_t length);
+
+    /// marks all of the standard HTTP headers as missing
+    inline void clear_known_keys(void) {
+        for (std::size_t n = 0; n < NUM_KNOWN_KEYS; ++n)
+            m_known_keys[n] = NPOS;
+    }
+
+
+    /// number of entries above which unknown keys are found using a hash index
+    static const std::size_t        LINEAR_SEARCH_MAX;
+
+
+    /// the entries, in order
+    entries_t                       m_entries;
+
+    /// position of the first entry for each of the standard HTTP headers
+    boost::uint32_t                 m_known_keys[NUM_KNOWN_KEYS];
+
+    /// open-addressed hash index of the first entries for unknown keys
+    /// (empty unless the dictionary has more than LINEAR_SEARCH_MAX entries)
+    std::vector<boost::uint32_t>    m_index;
+
+    /// number of keys in the hash index
+    std::size_t                     m_index_size;
+};
+
+
+}   // end namespace pion
+
+#endif
@@ -15,6 +15,7 @@
 #include <boost/algorithm/string.hpp>
 #include <boost/functional/hash.hpp>
 #include <pion/config.hpp>
+#include <pion/flat_multimap.hpp>
 
 #if defined(PION_HAVE_UNORDERED_MAP)
     #include <unordered_map>
@@ -131,13 +132,13 @@ namespace pion {    // begin namespace pion
         }
     };
 
-    /// data type for case-insensitive dictionary of strings
-    typedef PION_HASH_MULTIMAP<std::string, std::string, ihash_windows >    ihash_multimap;
-#else
-    /// data type for case-insensitive dictionary of strings
-    typedef PION_HASH_MULTIMAP<std::string, std::string, ihash, iequal_to >    ihash_multimap;
 #endif
 
+    /// data type for case-insensitive dictionary of strings (used for HTTP
+    /// headers, cookies and query parameters, which are usually few enough
+    /// that a flat container is faster than hashing their keys)
+    typedef flat_multimap   ihash_multimap;
+
 
 }   // end namespace pion
 
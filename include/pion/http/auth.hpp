@@ -14,6 +14,8 @@
 #include <map>
 #include <boost/noncopyable.hpp>
 #include <boost/shared_ptr.hpp>
+#include <boost/function/function1.hpp>
+#include <boost/function/function2.hpp>
 #include <pion/config.hpp>
 #include <pion/error.hpp>
 #include <pion/logger.hpp>
@@ -36,6 +38,11 @@ class PION_API auth :
 {
 public:
     
+    /// function called to continue handling a request once it has been
+    /// authenticated asynchronously
+    typedef boost::function2<void, const http::request_ptr&, const tcp::connection_ptr&>   resume_handler_t;
+
+
     /// default constructor
     auth(user_manager_ptr userManager) 
         : m_logger(PION_GET_LOGGER("pion.http.auth")),
@@ -51,6 +58,9 @@ public:
      * the request and return "true". 
      * If request not authenticated, appropriate response is sent over tcp_conn
      * and return "false";
+     * If the credentials must be checked and a resume handler is set, they
+     * are checked on the scheduler's blocking pool and "false" is returned;
+     * the resume handler is called later if the request is valid.
      *
      * @param http_request_ptr the new HTTP request to handle
      * @param tcp_conn the TCP connection that has the new request
@@ -59,6 +69,15 @@ public:
      */
     virtual bool handle_request(const http::request_ptr& http_request_ptr, const tcp::connection_ptr& tcp_conn) = 0;
     
+    /**
+     * sets the function used to continue handling requests that are
+     * authenticated asynchronously (servers set this so that password
+     * hashes are not computed on the threads that handle I/O events)
+     *
+     * @param handler function called with each request that is authenticated
+     */
+    inline void set_resume_handler(resume_handler_t handler) { m_resume_handler = handler; }
+    
     /**
      * sets a configuration option
      *
@@ -145,6 +164,20 @@ protected:
     bool find_resource(const resource_set_type& resource_set,
                       const std::string& resource) const;
 
+    /**
+     * locates a user object by username and password on the scheduler's
+     * blocking pool, since matching the password means computing its hash
+     *
+     * @param username name of the user
+     * @param password password credentials
+     * @param tcp_conn the TCP connection that has the request (the handler
+     *                 is called using its IO service)
+     * @param handler called with the user object found (null if none matched)
+     */
+    void async_get_user(const std::string& username, const std::string& password,
+                        const tcp::connection_ptr& tcp_conn,
+                        boost::function1<void, user_ptr> handler);
+
     /// sets the logger to be used
     inline void set_logger(logger log_ptr) { m_logger = log_ptr; }
     
@@ -163,6 +196,10 @@ protected:
 
     /// mutex used to protect access to the resources
     mutable boost::mutex    m_resource_mutex;
+
+    /// function called to continue handling requests that are authenticated
+    /// asynchronously (if empty, credentials are checked synchronously)
+    resume_handler_t        m_resume_handler;
 };
 
 /// data type for a auth pointer
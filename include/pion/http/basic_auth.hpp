@@ -69,6 +69,18 @@ protected:
      */
     void handle_unauthorized(const http::request_ptr& http_request_ptr, const tcp::connection_ptr& tcp_conn);
     
+    /**
+     * finishes authenticating a request once its user has been looked up
+     * on the blocking pool
+     *
+     * @param http_request_ptr the new HTTP request to handle
+     * @param tcp_conn the TCP connection that has the new request
+     * @param credentials base64 user credentials from the request
+     * @param user the user object found (null if none matched)
+     */
+    void handle_user(const http::request_ptr& http_request_ptr, const tcp::connection_ptr& tcp_conn,
+                     const std::string& credentials, user_ptr user);
+    
     /**
      * extracts base64 user credentials from authorization string
      *
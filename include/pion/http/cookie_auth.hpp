@@ -103,6 +103,29 @@ protected:
      */
     bool process_login(const http::request_ptr& http_request_ptr, const tcp::connection_ptr& tcp_conn);
 
+    /**
+     * finishes a login request once its user has been looked up
+     *
+     * @param http_request_ptr the new HTTP request to handle
+     * @param tcp_conn the TCP connection that has the new request
+     * @param redirect_url URL to redirect to once logged in (if not empty)
+     * @param user the user object found (null if none matched)
+     */
+    void handle_login(const http::request_ptr& http_request_ptr, const tcp::connection_ptr& tcp_conn,
+        const std::string& redirect_url, user_ptr user);
+
+    /**
+     * sends the response to a login or logout request
+     *
+     * @param http_request_ptr the new HTTP request to handle
+     * @param tcp_conn the TCP connection that has the new request
+     * @param redirect_url URL to redirect to (if empty, an OK response is sent)
+     * @param new_cookie session cookie for a new login
+     * @param delete_cookie if true, the session cookie is removed from the browser
+     */
+    void send_login_response(const http::request_ptr& http_request_ptr, const tcp::connection_ptr& tcp_conn,
+        const std::string& redirect_url, const std::string& new_cookie, bool delete_cookie);
+
     /**
      * used to send responses when access to resource is not authorized
      *
@@ -97,7 +97,8 @@ public:
         : m_is_valid(false), m_is_chunked(false), m_chunks_supported(false),
         m_do_not_send_content_length(false),
         m_version_major(1), m_version_minor(1), m_content_length(0), m_content_buf(),
-        m_status(STATUS_NONE), m_has_missing_packets(false), m_has_data_after_missing(false)
+        m_status(STATUS_NONE), m_has_missing_packets(false), m_has_data_after_missing(false),
+        m_has_deferred_cookies(false), m_deferred_set_cookies(false)
     {}
 
     /// copy constructor
@@ -115,10 +116,14 @@ public:
         m_content_buf(http_msg.m_content_buf),
         m_chunk_cache(http_msg.m_chunk_cache),
         m_headers(http_msg.m_headers),
+        m_header_buffer(http_msg.m_header_buffer),
+        m_header_views(http_msg.m_header_views),
         m_cookie_params(http_msg.m_cookie_params),
         m_status(http_msg.m_status),
         m_has_missing_packets(http_msg.m_has_missing_packets),
-        m_has_data_after_missing(http_msg.m_has_data_after_missing)
+        m_has_data_after_missing(http_msg.m_has_data_after_missing),
+        m_has_deferred_cookies(http_msg.m_has_deferred_cookies),
+        m_deferred_set_cookies(http_msg.m_deferred_set_cookies)
     {}
 
     /// assignment operator
@@ -135,10 +140,14 @@ public:
         m_content_buf = http_msg.m_content_buf;
         m_chunk_cache = http_msg.m_chunk_cache;
         m_headers = http_msg.m_headers;
+        m_header_buffer = http_msg.m_header_buffer;
+        m_header_views = http_msg.m_header_views;
         m_cookie_params = http_msg.m_cookie_params;
         m_status = http_msg.m_status;
         m_has_missing_packets = http_msg.m_has_missing_packets;
         m_has_data_after_missing = http_msg.m_has_data_after_missing;
+        m_has_deferred_cookies = http_msg.m_has_deferred_cookies;
+        m_deferred_set_cookies = http_msg.m_deferred_set_cookies;
         return *this;
     }
 
@@ -156,10 +165,13 @@ public:
         m_content_buf.clear();
         m_chunk_cache.clear();
         m_headers.clear();
+        m_header_buffer.clear();
+        m_header_views.clear();
         m_cookie_params.clear();
         m_status = STATUS_NONE;
         m_has_missing_packets = false;
         m_has_data_after_missing = false;
+        m_has_deferred_cookies = m_deferred_set_cookies = false;
     }
 
     /// should return true if the content length can be implied without headers
@@ -214,53 +226,108 @@ public:
 
     /// returns a value for the header if any are defined; otherwise, an empty string
     inline const std::string& get_header(const std::string& key) const {
+        sync_header_views();
         return get_value(m_headers, key);
     }
 
     /// returns a reference to the HTTP headers
     inline ihash_multimap& get_headers(void) {
+        sync_header_views();
         return m_headers;
     }
 
     /// returns true if at least one value for the header is defined
     inline bool has_header(const std::string& key) const {
-        return(m_headers.find(key) != m_headers.end());
+        const char *value_ptr;
+        std::size_t value_length;
+        return find_header_view(key, value_ptr, value_length);
     }
 
+    /**
+     * finds a value for a header without copying it out of the message.
+     * Values that have been copied into strings are counted before those
+     * still held in the header buffer.
+     *
+     * @param key name of the header to find
+     * @param value_ptr set to point to the value, if one is found
+     * @param value_length set to the length of the value, if one is found
+     * @param n which of the header's values to find (0 for the first)
+     *
+     * @return true if the header has at least n + 1 values
+     */
+    bool find_header_view(const std::string& key, const char *& value_ptr,
+                          std::size_t& value_length, std::size_t n = 0) const;
+
+    /**
+     * adds a value for the HTTP header named key by copying both into the
+     * message's header buffer.  Headers added this way are copied into
+     * strings only when the headers are first used through get_headers() or
+     * any of the other functions that return or modify them.
+     *
+     * @param name_ptr points to the name of the header
+     * @param name_length length of the name
+     * @param value_ptr points to the value of the header
+     * @param value_length length of the value
+     */
+    void add_header_view(const char *name_ptr, std::size_t name_length,
+                         const char *value_ptr, std::size_t value_length);
+
+    /// returns true if some headers are still held only in the header buffer
+    inline bool has_header_views(void) const { return ! m_header_views.empty(); }
+
     /// returns a value for the cookie if any are defined; otherwise, an empty string
     /// since cookie names are insensitive, key should use lowercase alpha chars
     inline const std::string& get_cookie(const std::string& key) const {
+        parse_deferred_cookies();
         return get_value(m_cookie_params, key);
     }
     
     /// returns the cookie parameters
     inline ihash_multimap& get_cookies(void) {
+        parse_deferred_cookies();
         return m_cookie_params;
     }
 
     /// returns true if at least one value for the cookie is defined
     /// since cookie names are insensitive, key should use lowercase alpha chars
     inline bool has_cookie(const std::string& key) const {
+        parse_deferred_cookies();
         return(m_cookie_params.find(key) != m_cookie_params.end());
     }
     
     /// adds a value for the cookie
     /// since cookie names are insensitive, key should use lowercase alpha chars
     inline void add_cookie(const std::string& key, const std::string& value) {
+        parse_deferred_cookies();
         m_cookie_params.insert(std::make_pair(key, value));
     }
 
     /// changes the value of a cookie
     /// since cookie names are insensitive, key should use lowercase alpha chars
     inline void change_cookie(const std::string& key, const std::string& value) {
+        parse_deferred_cookies();
         change_value(m_cookie_params, key, value);
     }
 
     /// removes all values for a cookie
     /// since cookie names are insensitive, key should use lowercase alpha chars
     inline void delete_cookie(const std::string& key) {
+        parse_deferred_cookies();
         delete_value(m_cookie_params, key);
     }
+
+    /**
+     * defers parsing the message's Cookie or Set-Cookie headers into its
+     * cookie parameters until the cookies are first used.  The headers are
+     * parsed as they are at that time.
+     *
+     * @param set_cookie_headers if true, the Set-Cookie headers are parsed;
+     *                           otherwise, the Cookie headers are parsed
+     */
+    inline void defer_cookie_headers(bool set_cookie_headers) {
+        m_has_deferred_cookies = true;
+        m_deferred_set_cookies = set_cookie_headers;
+    }
     
     /// returns a string containing the first line for the HTTP message
     inline const std::string& get_first_line(void) const {
@@ -315,11 +382,12 @@ public:
 
     /// sets the length of the payload content using the Content-Length header
     inline void update_content_length_using_header(void) {
-        ihash_multimap::const_iterator i = m_headers.find(HEADER_CONTENT_LENGTH);
-        if (i == m_headers.end()) {
+        const char *value_ptr;
+        std::size_t value_length;
+        if (! find_header_view(HEADER_CONTENT_LENGTH, value_ptr, value_length)) {
             m_content_length = 0;
         } else {
-            std::string trimmed_length(i->second);
+            std::string trimmed_length(value_ptr, value_length);
             boost::algorithm::trim(trimmed_length);
             m_content_length = boost::lexical_cast<size_t>(trimmed_length);
         }
@@ -328,10 +396,11 @@ public:
     /// sets the transfer coding using the Transfer-Encoding header
     inline void update_transfer_encoding_using_header(void) {
         m_is_chunked = false;
-        ihash_multimap::const_iterator i = m_headers.find(HEADER_TRANSFER_ENCODING);
-        if (i != m_headers.end()) {
+        const char *value_ptr;
+        std::size_t value_length;
+        if (find_header_view(HEADER_TRANSFER_ENCODING, value_ptr, value_length)) {
             // From RFC 2616, sec 3.6: All transfer-coding values are case-insensitive.
-            m_is_chunked = boost::regex_match(i->second, REGEX_ICASE_CHUNKED);
+            m_is_chunked = boost::regex_match(value_ptr, value_ptr + value_length, REGEX_ICASE_CHUNKED);
             // ignoring other possible values for now
         }
     }
@@ -354,32 +423,41 @@ public:
     inline void clear_content(void) {
         set_content_length(0);
         create_content_buffer();
+        sync_header_views();
         delete_value(m_headers, HEADER_CONTENT_TYPE);
     }
 
     /// sets the content type for the message payload
     inline void set_content_type(const std::string& type) {
+        sync_header_views();
         change_value(m_headers, HEADER_CONTENT_TYPE, type);
     }
 
     /// adds a value for the HTTP header named key
     inline void add_header(const std::string& key, const std::string& value) {
+        sync_header_views();
         m_headers.insert(std::make_pair(key, value));
     }
 
     /// changes the value for the HTTP header named key
     inline void change_header(const std::string& key, const std::string& value) {
+        sync_header_views();
         change_value(m_headers, key, value);
     }
 
     /// removes all values for the HTTP header named key
     inline void delete_header(const std::string& key) {
+        sync_header_views();
         delete_value(m_headers, key);
     }
 
     /// returns true if the HTTP connection may be kept alive
     inline bool check_keep_alive(void) const {
-        return (get_header(HEADER_CONNECTION) != "close"
+        const char *value_ptr;
+        std::size_t value_length;
+        const bool is_close = (find_header_view(HEADER_CONNECTION, value_ptr, value_length)
+                               && value_length == 5 && memcmp(value_ptr, "close", 5) == 0);
+        return (! is_close
                 && (get_version_major() > 1
                     || (get_version_major() >= 1 && get_version_minor() >= 1)) );
     }
@@ -586,6 +664,7 @@ protected:
      * @param write_buffers the buffers to append HTTP headers into
      */
     inline void append_headers(write_buffers_t& write_buffers) {
+        sync_header_views();
         // add HTTP headers
         for (ihash_multimap::const_iterator i = m_headers.begin(); i != m_headers.end(); ++i) {
             write_buffers.push_back(boost::asio::buffer(i->first));
@@ -640,13 +719,8 @@ protected:
             // set the first value found for the key to the new one
             result_pair.first->second = value;
             // remove any remaining values
-            typename DictionaryType::iterator i;
             ++(result_pair.first);
-            while (result_pair.first != result_pair.second) {
-                i = result_pair.first;
-                ++(result_pair.first);
-                dict.erase(i);
-            }
+            dict.erase(result_pair.first, result_pair.second);
         }
     }
 
@@ -676,6 +750,40 @@ protected:
     /// updates the string containing the first line for the HTTP message
     virtual void update_first_line(void) const = 0;
 
+    /// parses the cookie headers into m_cookie_params, if that was deferred
+    inline void parse_deferred_cookies(void) const {
+        if (m_has_deferred_cookies)
+            parse_cookie_headers();
+    }
+
+    /// copies the headers held in the header buffer into m_headers, unless
+    /// that has already been done
+    inline void sync_header_views(void) const {
+        if (! m_header_views.empty())
+            copy_header_views();
+    }
+
+    /**
+     * copies a string into the message's header buffer
+     *
+     * @param ptr points to the string to copy
+     * @param length length of the string
+     *
+     * @return std::size_t offset of the copy within the header buffer
+     */
+    inline std::size_t copy_to_header_buffer(const char *ptr, std::size_t length) {
+        if (m_header_buffer.empty())
+            m_header_buffer.reserve(HEADER_BUFFER_INITIAL_SIZE);
+        const std::size_t offset = m_header_buffer.size();
+        m_header_buffer.append(ptr, length);
+        return offset;
+    }
+
+    /// returns a pointer to a string that is stored in the header buffer
+    inline const char *get_header_buffer_ptr(std::size_t offset) const {
+        return m_header_buffer.data() + offset;
+    }
+
     /// first line sent in an HTTP message
     /// (i.e. "GET / HTTP/1.1" for request, or "HTTP/1.1 200 OK" for response)
     mutable std::string             m_first_line;
@@ -683,6 +791,31 @@ protected:
 
 private:
 
+    /// location of a header whose name and value are held in the header buffer
+    struct header_view_t {
+        std::size_t     name_offset;
+        std::size_t     name_length;
+        std::size_t     value_offset;
+        std::size_t     value_length;
+    };
+
+    /// data type for the headers held in the header buffer
+    typedef std::vector<header_view_t>  header_views_t;
+
+
+    /// copies the headers held in the header buffer into m_headers
+    void copy_header_views(void) const;
+
+    /// parses the deferred Cookie or Set-Cookie headers into m_cookie_params
+    void parse_cookie_headers(void) const;
+
+
+    /// initial capacity of the header buffer (in bytes)
+    static const std::size_t        HEADER_BUFFER_INITIAL_SIZE = 1024;
+
+    /// initial capacity for the headers held in the header buffer
+    static const std::size_t        HEADER_VIEWS_INITIAL_SIZE = 16;
+
     /// Regex used to check for the "chunked" transfer encoding header
     static const boost::regex       REGEX_ICASE_CHUNKED;
 
@@ -716,11 +849,18 @@ private:
     /// buffers for holding chunked data
     chunk_cache_t                   m_chunk_cache;
 
-    /// HTTP message headers
-    ihash_multimap                  m_headers;
+    /// HTTP message headers (copied from the header buffer when first used)
+    mutable ihash_multimap          m_headers;
+
+    /// holds the names and values of headers added by add_header_view(),
+    /// along with any other strings that are copied into it
+    std::string                     m_header_buffer;
+
+    /// headers held in the header buffer that are not yet in m_headers
+    mutable header_views_t          m_header_views;
 
     /// HTTP cookie parameters parsed from the headers
-    ihash_multimap                  m_cookie_params;
+    mutable ihash_multimap          m_cookie_params;
 
     /// message data integrity status
     data_status_t                   m_status;
@@ -730,6 +870,12 @@ private:
 
     /// indicates missing packets in the middle of the data stream
     bool                            m_has_data_after_missing;
+
+    /// true if the cookie headers have not yet been parsed into m_cookie_params
+    mutable bool                    m_has_deferred_cookies;
+
+    /// true if the deferred cookie headers are Set-Cookie headers
+    bool                            m_deferred_set_cookies;
 };
 
 
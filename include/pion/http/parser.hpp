@@ -135,7 +135,8 @@ public:
         m_bytes_content_remaining(0), m_bytes_content_read(0),
         m_bytes_last_read(0), m_bytes_total_read(0),
         m_max_content_length(max_content_length),
-        m_parse_headers_only(false), m_save_raw_headers(false)
+        m_parse_headers_only(false), m_save_raw_headers(false),
+        m_parse_header_views(false), m_lazy_params(true)
     {}
 
     /// default destructor
@@ -169,6 +170,38 @@ public:
     boost::tribool parse_missing_data(http::message& http_msg, std::size_t len,
         boost::system::error_code& ec);
 
+    /**
+     * returns the number of payload content bytes that may be read directly
+     * into the message's content buffer, at get_content() plus
+     * get_content_bytes_read(), instead of being read into a separate buffer
+     * and parsed.  This is only possible once the read buffer has been
+     * consumed, while the rest of a message with a known content length
+     * fits in its content buffer and no payload handler is used.
+     *
+     * @param http_msg the HTTP message object being parsed
+     * @return std::size_t number of content bytes remaining, or 0 if they
+     *                     must be parsed
+     */
+    inline std::size_t get_direct_content_length(const http::message& http_msg) const {
+        if (m_message_parse_state != PARSE_CONTENT || m_payload_handler || ! eof()
+            || m_bytes_content_read + m_bytes_content_remaining > http_msg.get_content_buffer_size())
+            return 0;
+        return m_bytes_content_remaining;
+    }
+
+    /**
+     * consumes payload content that was read directly into the message's
+     * content buffer (see get_direct_content_length())
+     *
+     * @param http_msg the HTTP message object being parsed
+     * @param bytes_read number of content bytes that were read
+     *
+     * @return boost::tribool result of parsing:
+     *                        true = finished parsing HTTP message,
+     *                        indeterminate = not yet finished parsing HTTP message
+     */
+    boost::tribool consume_direct_content(http::message& http_msg, std::size_t bytes_read);
+
     /**
      * finishes parsing an HTTP response message
      *
@@ -272,6 +305,12 @@ public:
 
     /// returns true if parsing headers only
     inline bool get_parse_headers_only(void) { return m_parse_headers_only; }
+
+    /// returns true if headers are left in the message's header buffer
+    inline bool get_parse_header_views(void) const { return m_parse_header_views; }
+
+    /// returns true if query pairs, cookies and form content are parsed when first used
+    inline bool get_lazy_params(void) const { return m_lazy_params; }
     
     /// returns true if the parser is being used to parse an HTTP request
     inline bool is_parsing_request(void) const { return m_is_request; }
@@ -291,6 +330,21 @@ public:
     /// sets parameter for saving raw HTTP header content
     inline void set_save_raw_headers(bool b) { m_save_raw_headers = b; }
 
+    /**
+     * sets parameter for leaving the headers in the message's header buffer.
+     * If true, the request line and headers are copied into a single buffer
+     * owned by the message, and strings are only created for them when they
+     * are first used (see http::message::add_header_view()).
+     */
+    inline void set_parse_header_views(bool b) { m_parse_header_views = b; }
+
+    /**
+     * sets parameter for parsing the query string, cookie headers and form
+     * content of messages when their parameters are first used (the default).
+     * If false, they are parsed when the message is finished.
+     */
+    inline void set_lazy_params(bool b) { m_lazy_params = b; }
+
     /// sets the logger to be used
     inline void set_logger(logger log_ptr) { m_logger = log_ptr; }
 
@@ -543,6 +597,68 @@ protected:
     /// creates the unique parser error_category_t
     static void create_error_category(void);
 
+    /**
+     * finds the end of a run of text characters, checking 16 or 32 characters
+     * at a time using SIMD instructions where they are available
+     *
+     * @param ptr start of the characters to check
+     * @param end end of the characters to check
+     * @param allow_tab if true, tabs are treated as text
+     * @param delim1 another character that ends the run
+     * @param delim2 another character that ends the run
+     *
+     * @return pointer to the first control character (other than an allowed
+     *         tab) or delimiter, or end if there are none
+     */
+    static const char *find_text_end(const char *ptr, const char *end, bool allow_tab,
+                                     char delim1 = '\0', char delim2 = '\0');
+
+    /// returns a pointer to the first character in [ptr, end) that may not
+    /// be part of a token (such as a header name), or end if there are none
+    static const char *find_token_end(const char *ptr, const char *end);
+
+    /**
+     * appends the characters from the read pointer up to span_end to a string
+     * (and to the raw headers, if they are being saved), leaving the read
+     * pointer on the last of them
+     *
+     * @param str the string to append to
+     * @param span_end end of the characters to append
+     */
+    inline void append_span(std::string& str, const char *span_end) {
+        str.append(m_read_ptr, span_end);
+        if (m_save_raw_headers)
+            m_raw_headers.append(m_read_ptr + 1, span_end);
+        m_read_ptr = span_end - 1;
+    }
+
+    /// adds the header that has just been parsed to the HTTP message
+    inline void add_parsed_header(http::message& http_msg) {
+        if (m_parse_header_views) {
+            http_msg.add_header_view(m_header_name.data(), m_header_name.size(),
+                                     m_header_value.data(), m_header_value.size());
+        } else {
+            http_msg.add_header(m_header_name, m_header_value);
+        }
+    }
+
+    /**
+     * appends payload content to a message's chunk cache, dropping whatever
+     * would make it longer than the maximum content length
+     *
+     * @param chunks the chunk cache to append to
+     * @param ptr points to the content to append
+     * @param len number of bytes of content to append
+     */
+    inline void append_to_chunk_cache(http::message::chunk_cache_t& chunks,
+                                      const char *ptr, std::size_t len) const
+    {
+        if (chunks.size() < m_max_content_length) {
+            const std::size_t room = m_max_content_length - chunks.size();
+            chunks.insert(chunks.end(), ptr, ptr + (len > room ? room : len));
+        }
+    }
+
 
     // misc functions used by the parsing functions
     inline static bool is_char(int c);
@@ -550,6 +666,7 @@ protected:
     inline static bool is_special(int c);
     inline static bool is_digit(int c);
     inline static bool is_hex_digit(int c);
+    inline static std::size_t get_hex_digit_value(int c);
     inline static bool is_cookie_attribute(const std::string& name, bool set_cookie_header);
 
 
@@ -669,9 +786,6 @@ private:
     /// Used for parsing the value of HTTP headers
     std::string                         m_header_value;
 
-    /// Used for parsing the chunk size
-    std::string                         m_chunk_size_str;
-
     /// number of bytes in the chunk currently being parsed
     std::size_t                         m_size_of_current_chunk;
 
@@ -699,6 +813,12 @@ private:
     /// if true, the raw contents of HTTP headers are stored into m_raw_headers
     bool                                m_save_raw_headers;
 
+    /// if true, headers are left in the message's header buffer
+    bool                                m_parse_header_views;
+
+    /// if true, query pairs, cookies and form content are parsed when first used
+    bool                                m_lazy_params;
+
     /// points to a single and unique instance of the parser error_category_t
     static error_category_t *           m_error_category_ptr;
         
@@ -742,6 +862,12 @@ inline bool parser::is_hex_digit(int c)
     return((c >= '0' && c <= '9') || (c >= 'a' && c <= 'f') || (c >= 'A' && c <= 'F'));
 }
 
+inline std::size_t parser::get_hex_digit_value(int c)
+{
+    // c must be a hex digit; letters are folded to lower case
+    return (c <= '9' ? c - '0' : (c | 0x20) - 'a' + 10);
+}
+
 inline bool parser::is_cookie_attribute(const std::string& name, bool set_cookie_header)
 {
     return (name.empty() || name[0] == '$' || (set_cookie_header &&
@@ -11,11 +11,11 @@
 #define __PION_HTTP_READER_HEADER__
 
 #include <boost/asio.hpp>
+#include <boost/logic/tribool.hpp>
 #include <pion/config.hpp>
 #include <pion/http/parser.hpp>
 #include <pion/http/message.hpp>
 #include <pion/tcp/connection.hpp>
-#include <pion/tcp/timer.hpp>
 
 
 namespace pion {    // begin namespace pion
@@ -42,6 +42,23 @@ public:
     /// sets the maximum number of seconds for read operations
     inline void set_timeout(boost::uint32_t seconds) { m_read_timeout = seconds; }
 
+    /// sets the maximum number of seconds that a kept-alive connection may
+    /// wait for the next message to begin (0 disables the timeout)
+    inline void set_idle_timeout(boost::uint32_t seconds) { m_idle_timeout = seconds; }
+
+    /// if true, a kept-alive connection's read buffer is returned to the pool
+    /// while waiting for its next message to begin (disabled by default, and
+    /// ignored for SSL connections)
+    inline void set_release_idle_buffer(bool b) { m_release_idle_buffer = b; }
+
+
+    /// default maximum number of seconds for read operations
+    static const boost::uint32_t            DEFAULT_READ_TIMEOUT;
+
+    /// default maximum number of seconds to wait for the next message on a
+    /// kept-alive connection
+    static const boost::uint32_t            DEFAULT_IDLE_TIMEOUT;
+
     
 protected:
 
@@ -54,7 +71,8 @@ protected:
      */
     reader(const bool is_request, const tcp::connection_ptr& tcp_conn)
         : http::parser(is_request), m_tcp_conn(tcp_conn),
-        m_read_timeout(DEFAULT_READ_TIMEOUT)
+        m_read_timeout(DEFAULT_READ_TIMEOUT), m_idle_timeout(DEFAULT_IDLE_TIMEOUT),
+        m_release_idle_buffer(false)
         {}  
     
     /**
@@ -68,10 +86,41 @@ protected:
 
     /// Consumes bytes that have been read using an HTTP parser
     void consume_bytes(void);
+
+    /**
+     * Consumes payload content that has been read directly into the HTTP
+     * message's content buffer
+     * 
+     * @param read_error error status from the last read operation
+     * @param bytes_read number of bytes consumed by the last read operation
+     */
+    void consume_content_bytes(const boost::system::error_code& read_error,
+                               std::size_t bytes_read);
     
+    /**
+     * Called after data is available to be read from the TCP connection
+     *
+     * @param wait_error error status from the wait operation
+     */
+    void data_ready(const boost::system::error_code& wait_error);
+
     /// Reads more bytes from the TCP connection
     virtual void read_bytes(void) = 0;
 
+    /// Waits until bytes are available to be read from the TCP connection,
+    /// then calls data_ready() (the default reads them right away instead)
+    virtual void wait_for_bytes(void) { read_bytes(); }
+
+    /**
+     * Reads payload content directly into the HTTP message's content buffer,
+     * then calls consume_content_bytes() (the default reads it into the
+     * connection's read buffer and parses it instead)
+     *
+     * @param ptr pointer to the next byte of the content buffer to read into
+     * @param len number of content bytes remaining
+     */
+    virtual void read_content(char * /* ptr */, std::size_t /* len */) { read_bytes(); }
+
     /// Called after we have finished reading/parsing the HTTP message
     virtual void finished_reading(const boost::system::error_code& ec) = 0;
 
@@ -81,8 +130,28 @@ protected:
 
 private:
 
-    /// reads more bytes for parsing, with timeout support
-    void read_bytes_with_timeout(void);
+    /**
+     * reads more bytes for parsing, with timeout support
+     *
+     * @param seconds maximum number of seconds for the read (0 for no limit)
+     */
+    void read_bytes_with_timeout(const boost::uint32_t seconds);
+
+    /**
+     * sets or cancels the connection's deadline
+     *
+     * @param seconds maximum number of seconds for the operation (0 for no limit)
+     */
+    void set_deadline(const boost::uint32_t seconds);
+
+    /**
+     * Handles the result of parsing or consuming bytes of the HTTP message
+     *
+     * @param result false if the message is invalid, true if it is finished,
+     *               or indeterminate if more bytes must be read
+     * @param ec error status from parsing the message
+     */
+    void handle_parse_result(boost::tribool result, const boost::system::error_code& ec);
 
     /**
      * Handles errors that occur during read operations
@@ -92,18 +161,17 @@ private:
     void handle_read_error(const boost::system::error_code& read_error);
 
 
-    /// default maximum number of seconds for read operations
-    static const boost::uint32_t            DEFAULT_READ_TIMEOUT;
-
-
     /// The HTTP connection that has a new HTTP message to parse
     tcp::connection_ptr                        m_tcp_conn;
     
-    /// pointer to a tcp::timer object if read timeouts are enabled
-    tcp::timer_ptr                             m_timer_ptr;
-
     /// maximum number of seconds for read operations
     boost::uint32_t                         m_read_timeout;
+
+    /// maximum number of seconds to wait for the next message on a kept-alive connection
+    boost::uint32_t                         m_idle_timeout;
+
+    /// true if the read buffer is returned to the pool while waiting for the next message
+    bool                                    m_release_idle_buffer;
 };
 
 
@@ -12,7 +12,9 @@
 
 #include <boost/shared_ptr.hpp>
 #include <pion/config.hpp>
+#include <pion/logger.hpp>
 #include <pion/http/message.hpp>
+#include <pion/http/parser.hpp>
 #include <pion/user.hpp>
 
 
@@ -34,14 +36,31 @@ public:
      * @param resource the HTTP resource to request
      */
     request(const std::string& resource)
-        : m_method(REQUEST_METHOD_GET), m_resource(resource) {}
+        : m_method(REQUEST_METHOD_GET), m_resource(resource),
+        m_method_offset(0), m_method_length(0), m_resource_offset(0), m_resource_length(0),
+        m_query_string_offset(0), m_query_string_length(0), m_has_request_line_views(false),
+        m_has_deferred_query_string(false), m_deferred_form_content(FORM_CONTENT_NONE)
+    {}
     
     /// constructs a new request object (default constructor)
-    request(void) : m_method(REQUEST_METHOD_GET) {}
+    request(void)
+        : m_method(REQUEST_METHOD_GET),
+        m_method_offset(0), m_method_length(0), m_resource_offset(0), m_resource_length(0),
+        m_query_string_offset(0), m_query_string_length(0), m_has_request_line_views(false),
+        m_has_deferred_query_string(false), m_deferred_form_content(FORM_CONTENT_NONE)
+    {}
     
     /// virtual destructor
     virtual ~request() {}
 
+    /// types of form content that may be parsed into the query parameters
+    enum form_content_t
+    {
+        FORM_CONTENT_NONE,          // no form content
+        FORM_CONTENT_URLENCODED,    // application/x-www-form-urlencoded
+        FORM_CONTENT_MULTIPART      // multipart/form-data
+    };
+
     /// clears all request data
     virtual void clear(void) {
         http::message::clear();
@@ -51,81 +70,111 @@ public:
         m_query_string.erase();
         m_query_params.clear();
         m_user_record.reset();
+        m_has_request_line_views = false;
+        m_has_deferred_query_string = false;
+        m_deferred_form_content = FORM_CONTENT_NONE;
     }
 
     /// the content length of the message can never be implied for requests
     virtual bool is_content_length_implied(void) const { return false; }
 
     /// returns the request method (i.e. GET, POST, PUT)
-    inline const std::string& get_method(void) const { return m_method; }
+    inline const std::string& get_method(void) const {
+        sync_request_line_views();
+        return m_method;
+    }
     
     /// returns the resource uri-stem to be delivered (possibly the result of a redirect)
-    inline const std::string& get_resource(void) const { return m_resource; }
+    inline const std::string& get_resource(void) const {
+        sync_request_line_views();
+        return m_resource;
+    }
 
     /// returns the resource uri-stem originally requested
-    inline const std::string& get_original_resource(void) const { return m_original_resource; }
+    inline const std::string& get_original_resource(void) const {
+        sync_request_line_views();
+        return m_original_resource;
+    }
 
     /// returns the uri-query or query string requested
-    inline const std::string& get_query_string(void) const { return m_query_string; }
+    inline const std::string& get_query_string(void) const {
+        sync_request_line_views();
+        return m_query_string;
+    }
     
     /// returns a value for the query key if any are defined; otherwise, an empty string
     inline const std::string& get_query(const std::string& key) const {
+        parse_deferred_queries();
         return get_value(m_query_params, key);
     }
 
     /// returns the query parameters
     inline ihash_multimap& get_queries(void) {
+        parse_deferred_queries();
         return m_query_params;
     }
     
     /// returns true if at least one value for the query key is defined
     inline bool has_query(const std::string& key) const {
+        parse_deferred_queries();
         return(m_query_params.find(key) != m_query_params.end());
     }
         
     /// sets the HTTP request method (i.e. GET, POST, PUT)
     inline void set_method(const std::string& str) { 
+        sync_request_line_views();
         m_method = str;
         clear_first_line();
     }
     
     /// sets the resource or uri-stem originally requested
     inline void set_resource(const std::string& str) {
+        sync_request_line_views();
         m_resource = m_original_resource = str;
         clear_first_line();
     }
 
     /// changes the resource or uri-stem to be delivered (called as the result of a redirect)
-    inline void change_resource(const std::string& str) { m_resource = str; }
+    inline void change_resource(const std::string& str) {
+        sync_request_line_views();
+        m_resource = str;
+    }
 
     /// sets the uri-query or query string requested
     inline void set_query_string(const std::string& str) {
+        parse_deferred_queries();
+        sync_request_line_views();
         m_query_string = str;
         clear_first_line();
     }
     
     /// adds a value for the query key
     inline void add_query(const std::string& key, const std::string& value) {
+        parse_deferred_queries();
         m_query_params.insert(std::make_pair(key, value));
     }
     
     /// changes the value of a query key
     inline void change_query(const std::string& key, const std::string& value) {
+        parse_deferred_queries();
         change_value(m_query_params, key, value);
     }
     
     /// removes all values for a query key
     inline void delete_query(const std::string& key) {
+        parse_deferred_queries();
         delete_value(m_query_params, key);
     }
     
     /// use the query parameters to build a query string for the request
     inline void use_query_params_for_query_string(void) {
+        parse_deferred_queries();
         set_query_string(make_query_string(m_query_params));
     }
 
     /// use the query parameters to build POST content for the request
     inline void use_query_params_for_post_content(void) {
+        parse_deferred_queries();
         std::string post_content(make_query_string(m_query_params));
         set_content_length(post_content.size());
         char *ptr = create_content_buffer();  // null-terminates buffer
@@ -137,6 +186,7 @@ public:
 
     /// add content (for POST) from string
     inline void set_content(const std::string &value) {
+        parse_deferred_queries();
         set_content_length(value.size());
         char *ptr = create_content_buffer();
         if (! value.empty())
@@ -148,11 +198,48 @@ public:
     inline void set_content(const char* value, size_t size) {
         if ( NULL == value || 0 == size )
             return;
+        parse_deferred_queries();
         set_content_length(size);
         char *ptr = create_content_buffer();
         memcpy(ptr, value, size);
     }
     
+    /**
+     * sets the request method, resource and query string by copying them
+     * into the message's header buffer.  They are copied into strings only
+     * when they are first used.
+     *
+     * @param method the HTTP request method (i.e. GET, POST, PUT)
+     * @param resource the resource or uri-stem requested
+     * @param query_string the uri-query or query string requested
+     */
+    inline void set_request_line_views(const std::string& method, const std::string& resource,
+                                       const std::string& query_string)
+    {
+        m_method_offset = copy_to_header_buffer(method.data(), method.size());
+        m_method_length = method.size();
+        m_resource_offset = copy_to_header_buffer(resource.data(), resource.size());
+        m_resource_length = resource.size();
+        m_query_string_offset = copy_to_header_buffer(query_string.data(), query_string.size());
+        m_query_string_length = query_string.size();
+        m_has_request_line_views = true;
+        clear_first_line();
+    }
+
+    /// defers parsing the query string into the query parameters until they
+    /// are first used
+    inline void defer_query_string(void) { m_has_deferred_query_string = true; }
+
+    /**
+     * defers parsing the request's content into the query parameters until
+     * they are first used.  The content is parsed as it is at that time.
+     *
+     * @param form_content the type of form held in the content
+     */
+    inline void defer_form_content(form_content_t form_content) {
+        m_deferred_form_content = form_content;
+    }
+
     /// sets the user record for HTTP request after authentication
     inline void set_user(user_ptr user) { m_user_record = user; }
     
@@ -164,6 +251,7 @@ protected:
 
     /// updates the string containing the first line for the HTTP message
     virtual void update_first_line(void) const {
+        sync_request_line_views();
         // start out with the request method
         m_first_line = m_method;
         m_first_line += ' ';
@@ -190,26 +278,96 @@ protected:
         }
     }
 
+
+    /// copies the request line held in the header buffer into strings,
+    /// unless that has already been done
+    inline void sync_request_line_views(void) const {
+        if (m_has_request_line_views) {
+            m_method.assign(get_header_buffer_ptr(m_method_offset), m_method_length);
+            m_resource.assign(get_header_buffer_ptr(m_resource_offset), m_resource_length);
+            m_original_resource = m_resource;
+            m_query_string.assign(get_header_buffer_ptr(m_query_string_offset), m_query_string_length);
+            m_has_request_line_views = false;
+        }
+    }
+
+    /// parses the query string and form content into the query parameters,
+    /// if that was deferred
+    inline void parse_deferred_queries(void) const {
+        if (m_has_deferred_query_string) {
+            m_has_deferred_query_string = false;
+            const std::string& query_string(get_query_string());
+            if (! http::parser::parse_url_encoded(m_query_params, query_string.c_str(), query_string.size())) {
+                PION_LOG_WARN(PION_GET_LOGGER("pion.http.parser"), "Request query string parsing failed (URI)");
+            }
+        }
+        if (m_deferred_form_content == FORM_CONTENT_URLENCODED) {
+            m_deferred_form_content = FORM_CONTENT_NONE;
+            if (! http::parser::parse_url_encoded(m_query_params, get_content(), get_content_length())) {
+                PION_LOG_WARN(PION_GET_LOGGER("pion.http.parser"), "Request form data parsing failed (POST urlencoded)");
+            }
+        } else if (m_deferred_form_content == FORM_CONTENT_MULTIPART) {
+            m_deferred_form_content = FORM_CONTENT_NONE;
+            std::string content_type_header;
+            const char *content_type_ptr;
+            std::size_t content_type_length;
+            if (find_header_view(HEADER_CONTENT_TYPE, content_type_ptr, content_type_length))
+                content_type_header.assign(content_type_ptr, content_type_length);
+            if (! http::parser::parse_multipart_form_data(m_query_params, content_type_header,
+                                                          get_content(), get_content_length()))
+            {
+                PION_LOG_WARN(PION_GET_LOGGER("pion.http.parser"), "Request form data parsing failed (POST multipart)");
+            }
+        }
+    }
+
     
 private:
 
     /// request method (GET, POST, PUT, etc.)
-    std::string                     m_method;
+    mutable std::string             m_method;
 
     /// name of the resource or uri-stem to be delivered
-    std::string                     m_resource;
+    mutable std::string             m_resource;
 
     /// name of the resource or uri-stem originally requested
-    std::string                     m_original_resource;
+    mutable std::string             m_original_resource;
 
     /// query string portion of the URI
-    std::string                     m_query_string;
+    mutable std::string             m_query_string;
     
     /// HTTP query parameters parsed from the request line and post content
-    ihash_multimap                  m_query_params;
+    mutable ihash_multimap          m_query_params;
 
     /// pointer to user record if this request had been authenticated 
     user_ptr                        m_user_record;
+
+    /// offset of the request method in the header buffer
+    std::size_t                     m_method_offset;
+
+    /// length of the request method in the header buffer
+    std::size_t                     m_method_length;
+
+    /// offset of the resource in the header buffer
+    std::size_t                     m_resource_offset;
+
+    /// length of the resource in the header buffer
+    std::size_t                     m_resource_length;
+
+    /// offset of the query string in the header buffer
+    std::size_t                     m_query_string_offset;
+
+    /// length of the query string in the header buffer
+    std::size_t                     m_query_string_length;
+
+    /// true if the request line is held only in the header buffer
+    mutable bool                    m_has_request_line_views;
+
+    /// true if the query string has not yet been parsed into m_query_params
+    mutable bool                    m_has_deferred_query_string;
+
+    /// type of the form content that has not yet been parsed into m_query_params
+    mutable form_content_t          m_deferred_form_content;
 };
 
 
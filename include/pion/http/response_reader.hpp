@@ -88,6 +88,22 @@ protected:
                                                         boost::asio::placeholders::bytes_transferred));
     }
 
+    /// Waits until bytes are available to be read from the TCP connection
+    virtual void wait_for_bytes(void) {
+        get_connection()->async_wait_for_data(boost::bind(&response_reader::data_ready,
+                                                            shared_from_this(),
+                                                            boost::asio::placeholders::error));
+    }
+
+    /// Reads payload content directly into the HTTP message's content buffer
+    virtual void read_content(char *ptr, std::size_t len) {
+        get_connection()->async_read_some(boost::asio::buffer(ptr, len),
+                                          boost::bind(&response_reader::consume_content_bytes,
+                                                      shared_from_this(),
+                                                      boost::asio::placeholders::error,
+                                                      boost::asio::placeholders::bytes_transferred));
+    }
+
     /// Called after we have finished parsing the HTTP message headers
     virtual void finished_parsing_headers(const boost::system::error_code& ec) {
         // call the finished headers handler with the HTTP message
@@ -13,6 +13,7 @@
 #include <map>
 #include <string>
 #include <boost/asio.hpp>
+#include <boost/bind.hpp>
 #include <boost/function.hpp>
 #include <boost/function/function2.hpp>
 #include <boost/function/function3.hpp>
@@ -24,6 +25,7 @@
 #include <pion/http/request.hpp>
 #include <pion/http/auth.hpp>
 #include <pion/http/parser.hpp>
+#include <pion/http/reader.hpp>
 
 
 namespace pion {    // begin namespace pion
@@ -60,7 +62,11 @@ public:
         m_bad_request_handler(server::handle_bad_request),
         m_not_found_handler(server::handle_not_found_request),
         m_server_error_handler(server::handle_server_error),
-        m_max_content_length(http::parser::DEFAULT_CONTENT_MAX)
+        m_max_content_length(http::parser::DEFAULT_CONTENT_MAX),
+        m_read_timeout(http::reader::DEFAULT_READ_TIMEOUT),
+        m_keep_alive_timeout(http::reader::DEFAULT_IDLE_TIMEOUT),
+        m_release_idle_buffers(false), m_parse_header_views(false),
+        m_lazy_params(true)
     { 
         set_logger(PION_GET_LOGGER("pion.http.server"));
     }
@@ -75,7 +81,11 @@ public:
         m_bad_request_handler(server::handle_bad_request),
         m_not_found_handler(server::handle_not_found_request),
         m_server_error_handler(server::handle_server_error),
-        m_max_content_length(http::parser::DEFAULT_CONTENT_MAX)
+        m_max_content_length(http::parser::DEFAULT_CONTENT_MAX),
+        m_read_timeout(http::reader::DEFAULT_READ_TIMEOUT),
+        m_keep_alive_timeout(http::reader::DEFAULT_IDLE_TIMEOUT),
+        m_release_idle_buffers(false), m_parse_header_views(false),
+        m_lazy_params(true)
     { 
         set_logger(PION_GET_LOGGER("pion.http.server"));
     }
@@ -91,7 +101,11 @@ public:
         m_bad_request_handler(server::handle_bad_request),
         m_not_found_handler(server::handle_not_found_request),
         m_server_error_handler(server::handle_server_error),
-        m_max_content_length(http::parser::DEFAULT_CONTENT_MAX)
+        m_max_content_length(http::parser::DEFAULT_CONTENT_MAX),
+        m_read_timeout(http::reader::DEFAULT_READ_TIMEOUT),
+        m_keep_alive_timeout(http::reader::DEFAULT_IDLE_TIMEOUT),
+        m_release_idle_buffers(false), m_parse_header_views(false),
+        m_lazy_params(true)
     { 
         set_logger(PION_GET_LOGGER("pion.http.server"));
     }
@@ -107,7 +121,11 @@ public:
         m_bad_request_handler(server::handle_bad_request),
         m_not_found_handler(server::handle_not_found_request),
         m_server_error_handler(server::handle_server_error),
-        m_max_content_length(http::parser::DEFAULT_CONTENT_MAX)
+        m_max_content_length(http::parser::DEFAULT_CONTENT_MAX),
+        m_read_timeout(http::reader::DEFAULT_READ_TIMEOUT),
+        m_keep_alive_timeout(http::reader::DEFAULT_IDLE_TIMEOUT),
+        m_release_idle_buffers(false), m_parse_header_views(false),
+        m_lazy_params(true)
     { 
         set_logger(PION_GET_LOGGER("pion.http.server"));
     }
@@ -217,12 +235,36 @@ public:
 
     /**
      * sets the handler object for authentication verification processing
+     * (requests that it authenticates asynchronously are resumed by the server)
      */ 
-    inline void set_authentication(http::auth_ptr auth) { m_auth_ptr = auth; }
+    inline void set_authentication(http::auth_ptr auth) {
+        m_auth_ptr = auth;
+        if (m_auth_ptr)
+            m_auth_ptr->set_resume_handler(boost::bind(&server::handle_authorized_request, this, _1, _2));
+    }
 
     /// sets the maximum length for HTTP request payload content
     inline void set_max_content_length(std::size_t n) { m_max_content_length = n; }
 
+    /// sets the maximum number of seconds for reading parts of a request (0 disables the timeout)
+    inline void set_read_timeout(boost::uint32_t seconds) { m_read_timeout = seconds; }
+
+    /// sets the maximum number of seconds that a kept-alive connection may stay
+    /// idle while waiting for its next request (0 disables the timeout)
+    inline void set_keep_alive_timeout(boost::uint32_t seconds) { m_keep_alive_timeout = seconds; }
+
+    /// if true, kept-alive connections return their read buffers to the pool
+    /// while they wait for their next request (disabled by default)
+    inline void set_release_idle_buffers(bool b) { m_release_idle_buffers = b; }
+
+    /// if true, request headers are left in each request's header buffer
+    /// until they are first used (see http::parser::set_parse_header_views())
+    inline void set_parse_header_views(bool b) { m_parse_header_views = b; }
+
+    /// if true, query pairs, cookies and form content are parsed when each
+    /// request first uses them (see http::parser::set_lazy_params())
+    inline void set_lazy_params(bool b) { m_lazy_params = b; }
+
 protected:
 
     /**
@@ -242,6 +284,16 @@ protected:
     virtual void handle_request(const http::request_ptr& http_request_ptr,
                                 const tcp::connection_ptr& tcp_conn, const boost::system::error_code& ec);
 
+    /**
+     * handles an HTTP request that has been authenticated (or that does not
+     * need to be) by passing it to its request handler
+     *
+     * @param http_request_ptr the HTTP request to handle
+     * @param tcp_conn TCP connection containing the request
+     */
+    void handle_authorized_request(const http::request_ptr& http_request_ptr,
+                                   const tcp::connection_ptr& tcp_conn);
+
     /**
      * searches for the appropriate request handler to use for a given resource
      *
@@ -287,6 +339,21 @@ private:
 
     /// maximum length for HTTP request payload content
     std::size_t                 m_max_content_length;
+
+    /// maximum number of seconds for reading parts of a request
+    boost::uint32_t             m_read_timeout;
+
+    /// maximum number of seconds that a kept-alive connection may wait for its next request
+    boost::uint32_t             m_keep_alive_timeout;
+
+    /// true if kept-alive connections return their read buffers while waiting for a request
+    bool                        m_release_idle_buffers;
+
+    /// true if request headers are left in each request's header buffer
+    bool                        m_parse_header_views;
+
+    /// true if query pairs, cookies and form content are parsed when first used
+    bool                        m_lazy_params;
 };
 
 
@@ -58,6 +58,7 @@ struct PION_API types
     static const std::string    CONTENT_TYPE_HTML;
     static const std::string    CONTENT_TYPE_TEXT;
     static const std::string    CONTENT_TYPE_XML;
+    static const std::string    CONTENT_TYPE_JSON;
     static const std::string    CONTENT_TYPE_URLENCODED;
     static const std::string    CONTENT_TYPE_MULTIPART_FORM_DATA;
     
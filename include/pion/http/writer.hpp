@@ -53,7 +53,7 @@ protected:
         : m_logger(PION_GET_LOGGER("pion.http.writer")),
         m_tcp_conn(tcp_conn), m_content_length(0), m_stream_is_empty(true), 
         m_client_supports_chunks(true), m_sending_chunks(false),
-        m_sent_headers(false), m_finished(handler)
+        m_sent_headers(false), m_write_timeout(0), m_finished(handler)
     {}
     
     /**
@@ -78,6 +78,7 @@ protected:
     
     /// called after we have finished sending the HTTP message
     inline void finished_writing(const boost::system::error_code& ec) {
+        if (m_write_timeout > 0) m_tcp_conn->cancel_deadline();
         if (m_finished) m_finished(ec);
     }
     
@@ -248,6 +249,11 @@ public:
     /// returns true if we are sending a chunked message to the client
     inline bool sending_chunked_message() const { return m_sending_chunks; }
     
+    /// sets the maximum number of seconds for each send operation (0 disables
+    /// the timeout).  The deadline remains set until the writer finishes, the
+    /// connection is finished or another deadline replaces it
+    inline void set_timeout(boost::uint32_t seconds) { m_write_timeout = seconds; }
+    
     /// sets the logger to be used
     inline void set_logger(logger log_ptr) { m_logger = log_ptr; }
     
@@ -274,6 +280,8 @@ private:
             http::message::write_buffers_t write_buffers;
             prepare_write_buffers(write_buffers, send_final_chunk);
             // send data in the write buffers
+            if (m_write_timeout > 0)
+                m_tcp_conn->set_deadline(m_write_timeout);
             m_tcp_conn->async_write(write_buffers, send_handler);
         } else {
             finished_writing(boost::asio::error::connection_reset);
@@ -357,6 +365,9 @@ private:
     /// true if the HTTP message headers have already been sent
     bool                                    m_sent_headers;
 
+    /// maximum number of seconds for each send operation (0 if disabled)
+    boost::uint32_t                         m_write_timeout;
+
     /// function called after the HTTP message has been sent
     finished_handler_t                      m_finished;
 };
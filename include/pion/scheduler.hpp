@@ -10,24 +10,196 @@
 #ifndef __PION_SCHEDULER_HEADER__
 #define __PION_SCHEDULER_HEADER__
 
+#include <deque>
+#include <string>
 #include <vector>
 #include <boost/asio.hpp>
 #include <boost/assert.hpp>
 #include <boost/bind.hpp>
 #include <boost/function/function0.hpp>
 #include <boost/cstdint.hpp>
+#include <boost/detail/atomic_count.hpp>
 #include <boost/shared_ptr.hpp>
 #include <boost/noncopyable.hpp>
+#include <boost/scoped_ptr.hpp>
 #include <boost/thread/thread.hpp>
 #include <boost/thread/mutex.hpp>
+#include <boost/thread/once.hpp>
+#include <boost/thread/tss.hpp>
 #include <boost/thread/xtime.hpp>
 #include <boost/thread/condition.hpp>
 #include <pion/config.hpp>
 #include <pion/logger.hpp>
 
+#if defined(__linux__)
+    #include <pthread.h>
+#endif
+
 
 namespace pion {    // begin namespace pion
 
+///
+/// blocking_pool: a bounded pool of threads used to run work that blocks,
+/// such as disk reads or hostname lookups, so that it does not hold up the
+/// threads that handle async I/O events.  Threads are started as needed,
+/// up to a limit, and the pool is shared by all schedulers.
+///
+class PION_API blocking_pool :
+    private boost::noncopyable
+{
+public:
+
+    /// constructs a new blocking_pool
+    blocking_pool(void);
+
+    /// virtual destructor
+    virtual ~blocking_pool() { shutdown(); }
+
+    /**
+     * runs blocking work on one of the pool's threads, and then posts a
+     * continuation to an IO service.  If the pool's queue is full, the
+     * blocking work is run on the calling thread instead.  Exceptions
+     * thrown by the blocking work are logged, and the continuation is
+     * still run, so the work should catch any errors that the continuation
+     * needs to know about.
+     *
+     * @param blocking_func blocking work to be executed
+     * @param resume_service IO service used to run the continuation
+     * @param continuation function called once the blocking work has finished
+     */
+    void offload(boost::function0<void> blocking_func,
+                 boost::asio::io_service& resume_service,
+                 boost::function0<void> continuation);
+
+    /// runs any work that is still queued and stops all of the pool's threads
+    /// (the pool starts new threads if more work is offloaded afterwards)
+    void shutdown(void);
+
+    /// sets the maximum number of threads in the pool
+    inline void set_num_threads(const boost::uint32_t n) {
+        boost::mutex::scoped_lock pool_lock(m_mutex);
+        m_num_threads = n;
+    }
+
+    /// returns the maximum number of threads in the pool
+    inline boost::uint32_t get_num_threads(void) const { return m_num_threads; }
+
+    /// sets the maximum number of work items that may wait for a thread
+    inline void set_max_queued_work(const boost::uint32_t n) {
+        boost::mutex::scoped_lock pool_lock(m_mutex);
+        m_max_queued_work = n;
+    }
+
+    /// returns the maximum number of work items that may wait for a thread
+    inline boost::uint32_t get_max_queued_work(void) const { return m_max_queued_work; }
+
+    /// returns the number of work items that are waiting for a thread
+    std::size_t get_queued_work(void) const;
+
+    /// returns the number of threads that are waiting for work
+    boost::uint32_t get_num_idle_threads(void) const;
+
+    /// returns the number of work items that were run on the pool's threads
+    boost::uint64_t get_num_offloaded(void) const;
+
+    /// returns the number of work items that were run on the calling thread
+    /// because the queue was full
+    boost::uint64_t get_num_run_inline(void) const;
+
+    /// sets the logger to be used
+    inline void set_logger(logger log_ptr) { m_logger = log_ptr; }
+
+    /// returns the logger currently in use
+    inline logger get_logger(void) { return m_logger; }
+
+    /// returns the blocking_pool singleton, which is shared by all schedulers
+    static inline blocking_pool& get_instance(void) {
+        boost::call_once(blocking_pool::create_instance, m_instance_flag);
+        return *m_instance_ptr;
+    }
+
+
+protected:
+
+    /// blocking work waiting for a thread, along with its continuation
+    struct blocking_work {
+        /// blocking work to be executed
+        boost::function0<void>          m_blocking_func;
+
+        /// IO service used to run the continuation
+        boost::asio::io_service *       m_resume_service;
+
+        /// function called once the blocking work has finished
+        boost::function0<void>          m_continuation;
+    };
+
+    /// runs blocking work and posts its continuation
+    void run_blocking_work(blocking_work& work);
+
+    /// thread function used to run queued blocking work
+    void process_blocking_work(void);
+
+
+    /// default maximum number of threads in the pool
+    static const boost::uint32_t    DEFAULT_NUM_THREADS;
+
+    /// default maximum number of work items that may wait for a thread
+    static const boost::uint32_t    DEFAULT_MAX_QUEUED_WORK;
+
+
+    /// primary logging interface used by this class
+    logger                                  m_logger;
+
+    /// blocking work waiting for a thread, oldest first
+    std::deque<blocking_work>               m_work;
+
+    /// threads used to run the blocking work
+    std::vector<boost::shared_ptr<boost::thread> >  m_threads;
+
+    /// maximum number of threads in the pool
+    boost::uint32_t                         m_num_threads;
+
+    /// maximum number of work items that may wait for a thread
+    boost::uint32_t                         m_max_queued_work;
+
+    /// number of threads that are waiting for work
+    boost::uint32_t                         m_num_idle;
+
+    /// number of idle threads that have been woken for queued work but have
+    /// not yet stopped waiting
+    boost::uint32_t                         m_num_wakeups;
+
+    /// number of work items that were run on the pool's threads
+    boost::uint64_t                         m_num_offloaded;
+
+    /// number of work items that were run on the calling thread
+    boost::uint64_t                         m_num_run_inline;
+
+    /// true if the threads should exit once the queue is empty
+    bool                                    m_is_stopping;
+
+    /// mutex used to protect the pool
+    mutable boost::mutex                    m_mutex;
+
+    /// condition triggered when work is queued or the pool is stopping
+    boost::condition                        m_work_available;
+
+
+private:
+
+    /// creates the blocking_pool singleton
+    static void create_instance(void);
+
+
+    /// points to the blocking_pool singleton (never deleted, since blocking
+    /// work may still be running while the program exits)
+    static blocking_pool *                  m_instance_ptr;
+
+    /// used to make sure that the singleton is created only once
+    static boost::once_flag                 m_instance_flag;
+};
+
+
 ///
 /// scheduler: combines Boost.ASIO with a managed thread pool for scheduling
 /// 
@@ -36,14 +208,198 @@ class PION_API scheduler :
 {
 public:
 
+    /// data type for a counter of the connections that use an I/O service
+    typedef boost::detail::atomic_count     load_counter_type;
+
+    /// data type for a function called when the number of I/O services changes
+    typedef boost::function0<void>          resize_handler_type;
+
+    /// priority classes for work scheduled using post()
+    enum priority_type {
+        PRIORITY_HIGH = 0,      ///< latency-sensitive work, run before all other queued work
+        PRIORITY_NORMAL,        ///< ordinary work
+        PRIORITY_LOW,           ///< bulk work, run once higher priority work has drained
+        NUM_PRIORITIES
+    };
+
+    /// number of times that queued work may be passed over for higher
+    /// priority work before it is run anyway
+    enum { MAX_PRIORITY_BYPASS = 8 };
+
+
+    ///
+    /// histogram: counts of durations, in buckets of microseconds whose
+    /// upper limits are powers of two
+    ///
+    struct PION_API histogram {
+        /// number of buckets; the last one counts all durations of 2^22
+        /// microseconds (about 4 seconds) or more
+        enum { NUM_BUCKETS = 24 };
+
+        /// constructs an empty histogram
+        histogram(void) { reset(); }
+
+        /// removes all of the durations counted
+        void reset(void);
+
+        /// counts a duration
+        void add(boost::uint64_t usec);
+
+        /// adds the counts of another histogram to this one
+        void merge(const histogram& other);
+
+        /// returns the upper limit of the bucket that holds a percentile of
+        /// the durations counted, in microseconds (0 if there are none)
+        boost::uint64_t get_percentile(unsigned int percent) const;
+
+        /// returns the upper limit of bucket n in microseconds (the last
+        /// bucket is unlimited, so its lower limit is returned instead)
+        static inline boost::uint64_t get_bucket_limit(unsigned int n) {
+            return (n + 1 < NUM_BUCKETS ? (static_cast<boost::uint64_t>(1) << n)
+                    : (static_cast<boost::uint64_t>(1) << (NUM_BUCKETS - 2)));
+        }
+
+        /// number of durations in each bucket; bucket n counts durations
+        /// that are less than 2^n microseconds, but not less than 2^(n-1)
+        boost::uint64_t     m_counts[NUM_BUCKETS];
+
+        /// total number of durations counted
+        boost::uint64_t     m_num_samples;
+
+        /// sum of all of the durations counted, in microseconds
+        boost::uint64_t     m_total_usec;
+
+        /// longest duration counted, in microseconds
+        boost::uint64_t     m_max_usec;
+    };
+
+    ///
+    /// thread_usage: how busy one of the scheduler's threads has been
+    ///
+    struct thread_usage {
+        /// constructs a new thread_usage object
+        thread_usage(void)
+            : m_thread_num(0), m_is_running(false), m_num_work(0),
+            m_elapsed_usec(0), m_work_usec(0), m_cpu_usec(0), m_num_stalls(0),
+            m_spin_usec(0), m_num_spin_hits(0), m_num_spin_misses(0)
+        {}
+
+        /// number of the thread, in the order that threads were first used
+        boost::uint32_t     m_thread_num;
+
+        /// true if the thread is still processing work for the scheduler
+        bool                m_is_running;
+
+        /// number of work items scheduled using post() that the thread has run
+        boost::uint64_t     m_num_work;
+
+        /// time since the thread started (or until it stopped), in microseconds
+        boost::uint64_t     m_elapsed_usec;
+
+        /// time spent running work scheduled using post(), in microseconds
+        boost::uint64_t     m_work_usec;
+
+        /// CPU time used by the thread, in microseconds (0 if unknown), which
+        /// also covers the I/O event handlers that post() does not see
+        boost::uint64_t     m_cpu_usec;
+
+        /// number of handlers that the thread ran for longer than the
+        /// stall threshold
+        boost::uint64_t     m_num_stalls;
+
+        /// time spent busy polling for events without finding any, in
+        /// microseconds (the CPU burned by busy polling)
+        boost::uint64_t     m_spin_usec;
+
+        /// number of times that busy polling found an event before its
+        /// budget ran out (each one saved a blocking wait and its wakeup)
+        boost::uint64_t     m_num_spin_hits;
+
+        /// number of times that busy polling ran out of budget, and the
+        /// thread blocked waiting for events
+        boost::uint64_t     m_num_spin_misses;
+    };
+
+    ///
+    /// stats: a snapshot of the measurements taken by a scheduler
+    ///
+    struct stats {
+        /// constructs an empty stats object
+        stats(void)
+            : m_num_threads(0), m_is_running(false), m_num_stalls(0), m_busy_poll_usec(0)
+        {}
+
+        /// time from post() until work started running
+        histogram                   m_queue_delay;
+
+        /// time taken to run work scheduled using post()
+        histogram                   m_run_time;
+
+        /// usage of each thread that has run work for the scheduler
+        std::vector<thread_usage>   m_threads;
+
+        /// number of threads that the scheduler is configured to use
+        boost::uint32_t             m_num_threads;
+
+        /// true if the scheduler is running
+        bool                        m_is_running;
+
+        /// number of handlers that ran for longer than the stall threshold
+        boost::uint64_t             m_num_stalls;
+
+        /// busy polling budget of the scheduler's threads, in microseconds
+        /// (0 if busy polling is disabled)
+        boost::uint32_t             m_busy_poll_usec;
+    };
+
+
+    ///
+    /// handler_scope: marks the calling thread as running a handler while it
+    /// exists, so that the stall watchdog can report handlers that block
+    /// the thread for too long
+    ///
+    class PION_API handler_scope :
+        private boost::noncopyable
+    {
+    public:
+        /**
+         * marks the calling thread as running a handler.  This does nothing
+         * if the thread does not process work for the scheduler, or if it
+         * is already running a handler (the outer handler covers both).
+         *
+         * @param sched the scheduler that the calling thread processes work for
+         * @param resource describes what the handler is working on; it must
+         *                 remain valid until the handler_scope is destroyed
+         */
+        handler_scope(scheduler& sched, const std::string& resource);
+
+        /// marks the calling thread as no longer running the handler
+        ~handler_scope();
+
+    private:
+        /// the scheduler that the calling thread processes work for
+        scheduler &     m_scheduler;
+
+        /// true if the calling thread was marked by this object
+        bool            m_is_marked;
+    };
+
+
     /// constructs a new scheduler
     scheduler(void)
         : m_logger(PION_GET_LOGGER("pion.scheduler")),
-        m_num_threads(DEFAULT_NUM_THREADS), m_active_users(0), m_is_running(false)
-    {}
+        m_num_threads(DEFAULT_NUM_THREADS), m_active_users(0), m_is_running(false),
+        m_instrumentation(false), m_num_stalls(0), m_stall_threshold(0),
+        m_busy_poll_usec(0), m_thread_stats(&scheduler::release_thread_stats)
+    {
+        add_scheduler(this);
+    }
     
     /// virtual destructor
-    virtual ~scheduler() {}
+    virtual ~scheduler() {
+        stop_watchdog();
+        remove_scheduler(this);
+    }
 
     /// Starts the thread scheduler (this is called automatically when necessary)
     virtual void startup(void) {}
@@ -65,8 +421,9 @@ public:
     /// returns true if the scheduler is running
     inline bool is_running(void) const { return m_is_running; }
     
-    /// sets the number of threads to be used (these are shared by all servers)
-    inline void set_num_threads(const boost::uint32_t n) { m_num_threads = n; }
+    /// sets the number of threads to be used (these are shared by all servers);
+    /// schedulers that support it resize their thread pool if already running
+    virtual void set_num_threads(const boost::uint32_t n) { m_num_threads = n; }
     
     /// returns the number of threads currently in use
     inline boost::uint32_t get_num_threads(void) const { return m_num_threads; }
@@ -80,13 +437,163 @@ public:
     /// returns an async I/O service used to schedule work
     virtual boost::asio::io_service& get_io_service(void) = 0;
     
+    /**
+     * returns a specific async I/O service used to schedule work; schedulers
+     * that use only one service always return the same object
+     *
+     * @param n integer number representing the service object
+     */
+    virtual boost::asio::io_service& get_io_service(boost::uint32_t /* n */) {
+        return get_io_service();
+    }
+    
+    /// returns the number of distinct async I/O services used to schedule work
+    virtual boost::uint32_t get_num_services(void) const { return 1; }
+    
+    /**
+     * returns the counter of active connections for an I/O service.  Servers
+     * keep it up to date so that the scheduler can balance new connections
+     * across its services.
+     *
+     * @param service the I/O service used by the connections
+     * @return load_counter_type* the counter (null if the scheduler does not use one)
+     */
+    virtual load_counter_type *get_load_counter(boost::asio::io_service& /* service */) {
+        return NULL;
+    }
+    
+    /**
+     * returns the number of active connections that use an I/O service
+     *
+     * @param n integer number representing the service object
+     * @return long number of connections (0 if the scheduler does not count them)
+     */
+    virtual long get_service_load(boost::uint32_t /* n */) const { return 0; }
+    
+    /**
+     * registers a function that is called by one of the scheduler's threads
+     * after the number of I/O services used to schedule work has changed
+     * (this replaces any function already registered by the same owner)
+     *
+     * @param owner identifies the function for remove_resize_handler()
+     * @param handler the function to call
+     */
+    void add_resize_handler(const void *owner, const resize_handler_type& handler);
+    
+    /**
+     * unregisters the function registered by an owner.  Once this returns,
+     * the function is not running and will not be called again.
+     *
+     * @param owner the object that registered the function
+     */
+    void remove_resize_handler(const void *owner);
+    
     /**
      * schedules work to be performed by one of the pooled threads
      *
      * @param work_func work function to be executed
      */
     virtual void post(boost::function0<void> work_func) {
-        get_io_service().post(work_func);
+        get_io_service().post(instrument_work(work_func));
+    }
+    
+    /**
+     * schedules work to be performed by one of the pooled threads, using a
+     * priority class.  Each IO service has a queue (lane) of work for each
+     * priority class, and each thread runs the work waiting in its high
+     * lane before the work in its lower lanes.  Work that is passed over
+     * MAX_PRIORITY_BYPASS times is run before higher priority work, so that
+     * it is never starved.
+     *
+     * @param work_func work function to be executed
+     * @param priority the priority class of the work
+     */
+    void post(boost::function0<void> work_func, priority_type priority);
+    
+    /// returns the number of work items waiting in the lanes for a priority class
+    std::size_t get_lane_depth(priority_type priority) const;
+    
+    /// returns the largest number of work items that have been waiting at
+    /// once in any IO service's lane for a priority class
+    std::size_t get_lane_peak_depth(priority_type priority) const;
+    
+    /// enables or disables the measurement of work scheduled using post()
+    /// (this is disabled by default, since it adds to the cost of each post)
+    inline void set_instrumentation(bool b) { m_instrumentation = b; }
+
+    /// returns true if work scheduled using post() is measured
+    inline bool get_instrumentation(void) const { return m_instrumentation; }
+
+    /// returns a snapshot of the scheduler's measurements
+    stats get_stats(void) const;
+
+    /// discards the scheduler's measurements, and forgets threads that have stopped
+    void reset_stats(void);
+
+    /**
+     * sets how long a handler may run before the stall watchdog reports it.
+     * The watchdog thread logs the thread, the handler's resource and (if
+     * supported) a backtrace of the thread, once for each stalled handler.
+     * Only work scheduled using post() and handlers marked with a
+     * handler_scope are watched.
+     *
+     * @param msec the threshold in milliseconds (0 stops the watchdog, and
+     *             is the default)
+     */
+    void set_stall_threshold(boost::uint32_t msec);
+
+    /// returns the stall threshold in milliseconds (0 if the watchdog is stopped)
+    inline boost::uint32_t get_stall_threshold(void) const { return m_stall_threshold; }
+
+    /// returns the number of handlers that ran for longer than the stall threshold
+    boost::uint64_t get_num_stalls(void) const;
+
+    /**
+     * enables busy polling, a low latency mode in which each thread polls
+     * its IO service for events for up to a budget of time before it blocks
+     * waiting for them.  Events that arrive while a thread is polling are
+     * handled without the latency of waking up a blocked thread, at the
+     * cost of burning CPU time.  This works best when each thread has its
+     * own IO service (one_to_one_scheduler), and should be set before the
+     * scheduler starts.
+     *
+     * @param usec the polling budget in microseconds (0 disables busy
+     *             polling, and is the default)
+     */
+    inline void set_busy_poll(boost::uint32_t usec) { m_busy_poll_usec = usec; }
+
+    /// returns the busy polling budget in microseconds (0 if disabled)
+    inline boost::uint32_t get_busy_poll(void) const { return m_busy_poll_usec; }
+
+    /**
+     * returns snapshots of the measurements of all of the schedulers in
+     * the process
+     *
+     * @param stats_list the snapshots are appended to this list
+     */
+    static void get_all_stats(std::vector<stats>& stats_list);
+
+    /// returns the pool of threads used to run blocking work (this is
+    /// shared by all schedulers)
+    static inline blocking_pool& get_blocking_pool(void) {
+        return blocking_pool::get_instance();
+    }
+    
+    /**
+     * runs blocking work on the blocking pool, so that it does not hold up
+     * the threads that handle async I/O events, and then resumes on an IO
+     * service
+     *
+     * @param blocking_func blocking work to be executed
+     * @param resume_service IO service used to run the continuation
+     *                       (normally the one that the caller is running on)
+     * @param continuation function called once the blocking work has finished
+     */
+    static inline void offload(boost::function0<void> blocking_func,
+                               boost::asio::io_service& resume_service,
+                               boost::function0<void> continuation)
+    {
+        get_blocking_pool().offload(blocking_func, resume_service, continuation);
     }
     
     /**
@@ -133,6 +640,141 @@ public:
 
 protected:
 
+    /// thrown by work to make the thread that runs it stop processing work;
+    /// process_service_work() returns when it is caught
+    struct thread_retired {};
+
+
+    ///
+    /// thread_stats: measurements taken by one of the scheduler's threads
+    ///
+    struct thread_stats :
+        private boost::noncopyable
+    {
+        /// constructs a new thread_stats object for the calling thread
+        explicit thread_stats(boost::uint32_t thread_num);
+
+        /// returns the CPU time used by the thread so far, in microseconds
+        /// (0 if unknown); may be called from any thread while it is running
+        boost::uint64_t get_cpu_usec(void) const;
+
+        /// time from post() until work started running
+        histogram                   m_queue_delay;
+
+        /// time taken to run work scheduled using post()
+        histogram                   m_run_time;
+
+        /// usage of the thread (updated while it runs)
+        thread_usage                m_usage;
+
+        /// time at which the thread started, in microseconds
+        boost::uint64_t             m_start_usec;
+
+        /// time at which the running handler started, in microseconds (0
+        /// if the thread is not running a handler)
+        boost::uint64_t             m_handler_start_usec;
+
+        /// describes what the running handler is working on (null if the
+        /// thread is not running a handler)
+        const std::string *         m_handler_resource;
+
+        /// true if the running handler has been reported as stalled
+        bool                        m_stall_reported;
+
+#if defined(__linux__)
+        /// the thread's native handle, used to sample its backtrace
+        pthread_t                   m_native_thread;
+
+        /// clock that measures the thread's CPU time
+        clockid_t                   m_cpu_clock;
+
+        /// true if m_cpu_clock is valid
+        bool                        m_has_cpu_clock;
+#endif
+
+        /// mutex used to protect the measurements (this is only contended
+        /// while a snapshot is taken)
+        mutable boost::mutex        m_mutex;
+    };
+
+    /// typedef for the measurements of each thread that has run work
+    typedef std::vector<boost::shared_ptr<thread_stats> >   stats_pool_type;
+
+    /// returns the measurements of the calling thread, creating them if necessary
+    thread_stats& get_thread_stats(void);
+
+    /// records that the calling thread has stopped processing work
+    void stop_thread_stats(void);
+
+    /**
+     * measures the CPU time used by the scheduler's threads so far (0 if
+     * unknown), and the time that they have spent busy polling
+     *
+     * @param cpu_usec will be set to the CPU time used, in microseconds
+     * @param spin_usec will be set to the time spent polling, in microseconds
+     */
+    void get_cpu_usage(boost::uint64_t& cpu_usec, boost::uint64_t& spin_usec) const;
+
+    /// calls the functions registered using add_resize_handler()
+    void notify_resize(void);
+
+    /**
+     * wraps work so that it is measured when it runs (if instrumentation is
+     * enabled)
+     *
+     * @param work_func the work to be measured
+     * @return boost::function0<void> the work to be scheduled
+     */
+    boost::function0<void> instrument_work(const boost::function0<void>& work_func);
+
+    /**
+     * runs work that was scheduled using post(), and measures it
+     *
+     * @param work_func the work to run
+     * @param posted_usec the time at which the work was posted, in microseconds
+     */
+    void run_instrumented_work(const boost::function0<void>& work_func, boost::uint64_t posted_usec);
+
+    /// returns the time of a monotonic clock in microseconds
+    static boost::uint64_t get_time_usec(void);
+
+    /**
+     * processes work passed to an asio service, busy polling for events
+     * before blocking to wait for them.  This returns when the service has
+     * stopped or busy polling is disabled.
+     *
+     * @param service the IO service to process work for
+     */
+    void run_busy_poll(boost::asio::io_service& service);
+
+    /// stops the stall watchdog thread, if it is running
+    void stop_watchdog(void);
+
+    /// function run by the stall watchdog thread
+    void process_watchdog(void);
+
+    /**
+     * reports threads that have been running the same handler for longer
+     * than the stall threshold
+     *
+     * @param threshold_usec the stall threshold in microseconds
+     */
+    void check_for_stalls(boost::uint64_t threshold_usec);
+
+    /**
+     * returns a backtrace of a stalled thread, one frame per line (empty if
+     * this is not supported).  The thread's stats mutex must be locked, so
+     * that the thread cannot exit while it is sampled.
+     *
+     * @param ts the measurements of the stalled thread
+     */
+    static std::string sample_backtrace(const thread_stats& ts);
+
+    /// called when a thread's pointer to its measurements is released; the
+    /// measurements are owned by the stats pool instead
+    static void release_thread_stats(thread_stats *) {}
+
+
     /**
      * calculates a wakeup time in boost::system_time format
      *
@@ -155,6 +797,64 @@ protected:
 
     /// finishes all threads used to perform work
     virtual void finish_threads(void) {}
+
+    /// releases the lanes used for prioritized work (work still queued in
+    /// them is kept alive by the IO services that it was posted to)
+    void finish_lanes(void) {
+        boost::mutex::scoped_lock pool_lock(m_lanes_mutex);
+        m_lanes_pool.clear();
+    }
+    
+    
+    ///
+    /// work_lanes: queues of prioritized work for one of the IO services
+    ///
+    struct work_lanes :
+        private boost::noncopyable
+    {
+        /// constructs a new work_lanes object
+        explicit work_lanes(boost::asio::io_service& service)
+            : m_service(service)
+        {
+            for (int p = 0; p < NUM_PRIORITIES; ++p) {
+                m_num_bypassed[p] = 0;
+                m_peak_depth[p] = 0;
+            }
+        }
+
+        /// IO service that runs the work
+        boost::asio::io_service &               m_service;
+
+        /// work items waiting to be run for each priority class, oldest first
+        std::deque<boost::function0<void> >     m_work[NUM_PRIORITIES];
+
+        /// number of times that each lane's oldest work has been passed over
+        unsigned int                            m_num_bypassed[NUM_PRIORITIES];
+
+        /// largest number of work items that have waited in each lane
+        std::size_t                             m_peak_depth[NUM_PRIORITIES];
+
+        /// mutex used to protect the lanes
+        mutable boost::mutex                    m_mutex;
+    };
+
+    /// typedef for the lanes used by each IO service
+    typedef std::vector<boost::shared_ptr<work_lanes> >     lanes_pool_type;
+    
+    /**
+     * returns the lanes used for an IO service, creating them if necessary
+     *
+     * @param service the IO service that will run the work
+     */
+    boost::shared_ptr<work_lanes> get_work_lanes(boost::asio::io_service& service);
+    
+    /**
+     * runs the next work item waiting in an IO service's lanes.  This is
+     * posted to the IO service once for each work item queued.
+     *
+     * @param lanes_ptr the lanes of the IO service
+     */
+    void run_priority_work(boost::shared_ptr<work_lanes> lanes_ptr);
     
     
     /// default number of worker threads in the thread pool
@@ -169,6 +869,9 @@ protected:
     /// number of seconds a timer should wait for to keep the IO services running
     static const boost::uint32_t    KEEP_RUNNING_TIMER_SECONDS;
 
+    /// resource reported for stalled work that was scheduled using post()
+    static const std::string        POSTED_WORK_RESOURCE;
+
 
     /// mutex to make class thread-safe
     boost::mutex                    m_mutex;
@@ -190,6 +893,83 @@ protected:
 
     /// true if the thread scheduler is running
     bool                            m_is_running;
+
+    /// lanes of prioritized work, one for each IO service that has been used
+    lanes_pool_type                 m_lanes_pool;
+
+    /// mutex used to protect the pool of lanes
+    mutable boost::mutex            m_lanes_mutex;
+
+    /// true if work scheduled using post() is measured
+    bool                            m_instrumentation;
+
+    /// measurements of each thread that has run work for the scheduler
+    stats_pool_type                 m_stats_pool;
+
+    /// mutex used to protect the stats pool
+    mutable boost::mutex            m_stats_mutex;
+
+    /// number of handlers that ran for longer than the stall threshold
+    boost::uint64_t                 m_num_stalls;
+
+    /// how long a handler may run before it is reported, in milliseconds
+    boost::uint32_t                 m_stall_threshold;
+
+    /// thread that watches for stalled handlers
+    boost::scoped_ptr<boost::thread>    m_watchdog_thread;
+
+    /// mutex used to protect the watchdog thread
+    boost::mutex                    m_watchdog_mutex;
+
+    /// condition used to wake up the watchdog thread when it should stop
+    boost::condition                m_watchdog_wakeup;
+
+    /// busy polling budget of each thread in microseconds (0 if disabled)
+    boost::uint32_t                 m_busy_poll_usec;
+
+    /// measurements of the calling thread (owned by the stats pool)
+    boost::thread_specific_ptr<thread_stats>    m_thread_stats;
+
+    /// functions called after the number of I/O services has changed, along
+    /// with the objects that registered them
+    std::vector<std::pair<const void *, resize_handler_type> >  m_resize_handlers;
+
+    /// mutex used to protect the resize handlers (held while they are called)
+    boost::mutex                    m_resize_handler_mutex;
+
+
+private:
+
+    /// data type for the registry of all schedulers in the process
+    struct registry_type {
+        /// all of the schedulers that currently exist
+        std::vector<scheduler *>    m_schedulers;
+
+        /// mutex used to protect the registry
+        boost::mutex                m_mutex;
+    };
+
+    /// returns a singleton instance of registry_type
+    static inline registry_type& get_registry(void) {
+        boost::call_once(scheduler::create_registry, m_registry_flag);
+        return *m_registry_ptr;
+    }
+
+    /// creates the registry singleton
+    static void create_registry(void);
+
+    /// adds a scheduler to the registry
+    static void add_scheduler(scheduler *sched_ptr);
+
+    /// removes a scheduler from the registry
+    static void remove_scheduler(scheduler *sched_ptr);
+
+
+    /// used to ensure thread safety of the registry singleton
+    static boost::once_flag         m_registry_flag;
+
+    /// pointer to the registry singleton
+    static registry_type *          m_registry_ptr;
 };
 
     
@@ -201,15 +981,176 @@ class PION_API multi_thread_scheduler :
 {
 public:
     
+    /// data type for a list of CPU numbers
+    typedef std::vector<boost::uint32_t>    cpu_list_type;
+
+
     /// constructs a new multi_thread_scheduler
-    multi_thread_scheduler(void) {}
+    multi_thread_scheduler(void)
+        : m_min_threads(1), m_max_threads(DEFAULT_MAX_THREADS), m_autoscaling(false),
+        m_max_queue_latency(DEFAULT_MAX_QUEUE_LATENCY), m_queue_latency(0), m_peak_latency(0),
+        m_utilization(0), m_num_idle_intervals(0), m_last_cpu_usec(0), m_last_spin_usec(0),
+        m_num_probes_pending(0)
+    {}
     
     /// virtual destructor
     virtual ~multi_thread_scheduler() {}
 
+    /**
+     * sets the number of threads to be used.  If the scheduler is already
+     * running, threads are started or retired to match, within the thread
+     * limits (if the scheduler supports it).
+     *
+     * @param n the number of threads
+     */
+    virtual void set_num_threads(const boost::uint32_t n);
+
+    /**
+     * sets the smallest and largest number of threads that the pool may be
+     * resized to while it is running.  Throws error::bad_arg if min_threads
+     * is zero or greater than max_threads.
+     *
+     * @param min_threads the smallest number of threads
+     * @param max_threads the largest number of threads
+     */
+    void set_thread_limits(boost::uint32_t min_threads, boost::uint32_t max_threads);
+
+    /// returns the smallest number of threads that the pool may be resized to
+    inline boost::uint32_t get_min_threads(void) const { return m_min_threads; }
+
+    /// returns the largest number of threads that the pool may be resized to
+    inline boost::uint32_t get_max_threads(void) const { return m_max_threads; }
+
+    /**
+     * enables or disables autoscaling of the thread pool, within the thread
+     * limits.  While it is enabled, the scheduler measures how long work
+     * waits in its IO services' queues and how busy the process is.  A
+     * thread is added when work waits for too long or the threads are
+     * nearly always busy, and one is retired once they have been mostly
+     * idle for several intervals in a row.  This must be set before the
+     * scheduler is started.
+     *
+     * @param b true to enable autoscaling
+     */
+    inline void set_autoscaling(bool b) { m_autoscaling = b; }
+
+    /// returns true if autoscaling of the thread pool is enabled
+    inline bool get_autoscaling(void) const { return m_autoscaling; }
+
+    /// sets the longest time (in microseconds) that work may wait in a queue
+    /// before autoscaling adds another thread
+    inline void set_max_queue_latency(boost::uint32_t usec) { m_max_queue_latency = usec; }
+
+    /// returns the longest time (in microseconds) that work may wait in a queue
+    /// before autoscaling adds another thread
+    inline boost::uint32_t get_max_queue_latency(void) const { return m_max_queue_latency; }
+
+    /// returns the longest time (in microseconds) that work waited in a queue
+    /// during the last autoscaling interval
+    boost::uint32_t get_queue_latency(void) const;
+
+    /// returns the percentage of time that the threads were busy during the
+    /// last autoscaling interval (based on the CPU time used by its threads,
+    /// less the time they spent busy polling)
+    inline boost::uint32_t get_utilization(void) const { return m_utilization; }
+
+    /**
+     * sets the CPUs that the worker threads are pinned to.  Thread n runs
+     * only on CPU cpus[n % cpus.size()], so memory that it allocates for
+     * its connections and buffers is placed on the CPU's NUMA node.  This
+     * must be called before the scheduler is started.
+     *
+     * @param cpus CPU numbers to use (if empty, threads are not pinned)
+     */
+    inline void set_cpu_affinity(const cpu_list_type& cpus) { m_cpu_affinity = cpus; }
+
+    /// returns the CPUs that the worker threads are pinned to (empty if they are not)
+    inline const cpu_list_type& get_cpu_affinity(void) const { return m_cpu_affinity; }
+
+    /**
+     * parses a list of CPUs, such as "0-3,8,10-11".  A list may also name
+     * a NUMA node, such as "node1", for all of the CPUs on that node.
+     * Throws error::bad_arg if the list is invalid or names a CPU that
+     * threads cannot be pinned to.
+     *
+     * @param str the list of CPUs
+     * @return cpu_list_type the CPU numbers, in the order listed
+     */
+    static cpu_list_type parse_cpu_list(const std::string& str);
+
+    /**
+     * returns the CPUs that belong to a NUMA node (this is only supported
+     * on Linux)
+     *
+     * @param node the number of the NUMA node
+     * @return cpu_list_type the node's CPU numbers (empty if unknown)
+     */
+    static cpu_list_type get_node_cpus(boost::uint32_t node);
+
+    /**
+     * pins the calling thread to one CPU
+     *
+     * @param cpu the CPU number
+     * @return true if the thread was pinned
+     */
+    static bool set_thread_affinity(boost::uint32_t cpu);
+
+    /**
+     * thread function that pins the thread to its CPU (if any) before
+     * processing work for an IO service
+     *
+     * @param n the thread's number
+     * @param service the IO service used by the thread
+     */
+    void process_pinned_work(boost::uint32_t n, boost::asio::io_service& service) {
+        bind_thread(n);
+        process_service_work(service);
+    }
+
     
 protected:
     
+    /// pins the calling thread to the CPU configured for worker thread n;
+    /// does nothing if no CPUs are configured
+    void bind_thread(boost::uint32_t n);
+    
+    /**
+     * starts a new worker thread and adds it to the pool; assumes that a
+     * scheduler lock has already been acquired
+     *
+     * @param n the thread's number
+     * @param service the IO service used by the thread
+     */
+    void start_thread(boost::uint32_t n, boost::asio::io_service& service);
+
+    /// removes threads that have been retired from the pool; assumes that
+    /// a scheduler lock has already been acquired
+    void prune_threads(void);
+
+    /**
+     * starts or retires threads while the scheduler is running so that n
+     * threads are used; assumes that a scheduler lock has already been
+     * acquired.  The default keeps the current number of threads.
+     *
+     * @param n the number of threads, within the thread limits
+     */
+    virtual void resize_threads(boost::uint32_t n);
+
+    /// starts measuring the scheduler for autoscaling, if it is enabled;
+    /// assumes that a scheduler lock has already been acquired
+    void start_autoscaling(void);
+
+    /// thread function that runs the autoscaling checks, so that they are
+    /// not held up by the work queued in the IO services
+    void process_autoscaling(void);
+
+    /// resizes the thread pool using the measurements taken since it last
+    /// ran, and starts measuring again
+    void autoscale(void);
+
+    /// records how long a probe posted for autoscaling waited in a queue
+    void record_queue_latency(const boost::system_time& posted_time);
+
     /// stops all threads used to perform work
     virtual void stop_threads(void) {
         if (! m_thread_pool.empty()) {
@@ -225,7 +1166,11 @@ protected:
                 if (**i != current_thread) (*i)->join();
             }
         }
+        stop_autoscaling();
     }
+
+    /// stops the thread used to run autoscaling checks
+    void stop_autoscaling(void);
     
     /// finishes all threads used to perform work
     virtual void finish_threads(void) { m_thread_pool.clear(); }
@@ -235,8 +1180,88 @@ protected:
     typedef std::vector<boost::shared_ptr<boost::thread> >  ThreadPool;
     
     
+    /// default largest number of threads that the pool may be resized to
+    static const boost::uint32_t    DEFAULT_MAX_THREADS;
+
+    /// default longest time (in microseconds) that work may wait in a queue
+    /// before autoscaling adds another thread
+    static const boost::uint32_t    DEFAULT_MAX_QUEUE_LATENCY;
+
+    /// number of milliseconds between autoscaling checks
+    static const boost::uint32_t    AUTOSCALE_INTERVAL_MSEC;
+
+    /// utilization (percent) at or above which autoscaling adds a thread
+    static const boost::uint32_t    HIGH_UTILIZATION;
+
+    /// utilization (percent) at or below which the threads are considered idle
+    static const boost::uint32_t    LOW_UTILIZATION;
+
+    /// number of idle intervals in a row after which autoscaling retires a thread
+    static const boost::uint32_t    AUTOSCALE_IDLE_INTERVALS;
+
+    /// CPU numbers that threads may be pinned to are below this limit
+    static const boost::uint32_t    MAX_CPUS;
+
+
     /// pool of threads used to perform work
     ThreadPool              m_thread_pool;
+
+    /// CPUs that the worker threads are pinned to (empty if they are not)
+    cpu_list_type           m_cpu_affinity;
+
+    /// smallest number of threads that the pool may be resized to
+    boost::uint32_t         m_min_threads;
+
+    /// largest number of threads that the pool may be resized to
+    boost::uint32_t         m_max_threads;
+
+    /// true if the thread pool is resized automatically
+    bool                    m_autoscaling;
+
+    /// longest time (in microseconds) that work may wait before a thread is added
+    boost::uint32_t         m_max_queue_latency;
+
+    /// longest time (in microseconds) that work waited during the last interval
+    boost::uint32_t         m_queue_latency;
+
+    /// longest time (in microseconds) that work has waited in this interval
+    boost::uint32_t         m_peak_latency;
+
+    /// percentage of time that the threads were busy during the last interval
+    boost::uint32_t         m_utilization;
+
+    /// number of intervals in a row that the threads have been idle
+    boost::uint32_t         m_num_idle_intervals;
+
+    /// time at which the current autoscaling interval started
+    boost::system_time      m_last_check_time;
+
+    /// CPU time used by the threads when the current interval started
+    boost::uint64_t         m_last_cpu_usec;
+
+    /// time spent busy polling by the threads when the current interval started
+    boost::uint64_t         m_last_spin_usec;
+
+    /// time at which the latest latency probes were posted
+    boost::system_time      m_probe_time;
+
+    /// number of latency probes that have not run yet
+    boost::uint32_t         m_num_probes_pending;
+
+    /// thread used to run autoscaling checks
+    boost::scoped_ptr<boost::thread>    m_autoscale_thread;
+
+    /// condition used to wake up the autoscaling thread when stopping
+    boost::condition        m_autoscale_wakeup;
+
+    /// mutex used to protect the latency measurements
+    mutable boost::mutex    m_latency_mutex;
+
+    /// mutex used to protect the retirement of threads and changes to the
+    /// pools of IO services; it is never held while waiting for the
+    /// scheduler's own mutex, so threads may take it while the scheduler is
+    /// shutting down
+    mutable boost::mutex    m_resize_mutex;
 };
     
     
@@ -250,7 +1275,7 @@ public:
     
     /// constructs a new single_service_scheduler
     single_service_scheduler(void)
-        : m_service(), m_timer(m_service)
+        : m_service(), m_timer(m_service), m_num_retiring(0)
     {}
     
     /// virtual destructor
@@ -259,6 +1284,9 @@ public:
     /// returns an async I/O service used to schedule work
     virtual boost::asio::io_service& get_io_service(void) { return m_service; }
     
+    /// returns an async I/O service used to schedule work (there is only one)
+    virtual boost::asio::io_service& get_io_service(boost::uint32_t /* n */) { return m_service; }
+    
     /// Starts the thread scheduler (this is called automatically when necessary)
     virtual void startup(void);
         
@@ -271,12 +1299,23 @@ protected:
     /// finishes all services used to schedule work
     virtual void finish_services(void) { m_service.reset(); }
 
+    /// starts or retires threads while the scheduler is running so that n
+    /// threads are used; assumes that a scheduler lock has already been acquired
+    virtual void resize_threads(boost::uint32_t n);
+
+    /// work that retires the thread that runs it, unless the threads
+    /// waiting to be retired have since been kept by resize_threads()
+    void retire_thread(void);
+
     
     /// service used to manage async I/O events
     boost::asio::io_service         m_service;
     
     /// timer used to periodically check for shutdown
     boost::asio::deadline_timer     m_timer;
+
+    /// number of threads that are still to be retired (protected by m_resize_mutex)
+    boost::uint32_t                 m_num_retiring;
 };
     
 
@@ -288,25 +1327,43 @@ class PION_API one_to_one_scheduler :
 {
 public:
     
+    /// policies used to choose the IO service for new work and connections
+    enum service_policy_type {
+        POLICY_ROUND_ROBIN,     ///< each service is used in turn
+        POLICY_LEAST_LOADED     ///< the service with the fewest active connections is used
+    };
+
+
     /// constructs a new one_to_one_scheduler
     one_to_one_scheduler(void)
-        : m_service_pool(), m_next_service(0)
+        : m_service_pool(), m_next_service(0), m_service_policy(POLICY_ROUND_ROBIN),
+        m_services_ready(0)
     {}
     
     /// virtual destructor
     virtual ~one_to_one_scheduler() { shutdown(); }
+
+    /**
+     * sets the number of threads to be used, and creates an IO service for
+     * each of them.  If the scheduler is already running, threads are
+     * started or retired to match, within the thread limits.
+     *
+     * @param n the number of threads
+     */
+    virtual void set_num_threads(const boost::uint32_t n) {
+        multi_thread_scheduler::set_num_threads(n);
+        boost::mutex::scoped_lock scheduler_lock(m_mutex);
+        create_services();
+    }
     
-    /// returns an async I/O service used to schedule work
+    /// returns an async I/O service used to schedule work (this does not
+    /// lock once the services have been created)
     virtual boost::asio::io_service& get_io_service(void) {
-        boost::mutex::scoped_lock scheduler_lock(m_mutex);
-        while (m_service_pool.size() < m_num_threads) {
-            boost::shared_ptr<service_pair_type>  service_ptr(new service_pair_type());
-            m_service_pool.push_back(service_ptr);
+        if (m_services_ready == 0) {
+            boost::mutex::scoped_lock scheduler_lock(m_mutex);
+            create_services();
         }
-        if (++m_next_service >= m_num_threads)
-            m_next_service = 0;
-        BOOST_ASSERT(m_next_service < m_num_threads);
-        return m_service_pool[m_next_service]->first;
+        return m_service_pool[select_service()]->first;
     }
     
     /**
@@ -317,16 +1374,46 @@ public:
      */
     virtual boost::asio::io_service& get_io_service(boost::uint32_t n) {
         BOOST_ASSERT(n < m_num_threads);
-        BOOST_ASSERT(n < m_service_pool.size());
+        if (m_services_ready == 0) {
+            boost::mutex::scoped_lock scheduler_lock(m_mutex);
+            create_services();
+        }
         return m_service_pool[n]->first;
     }
 
+    /// returns the number of distinct async I/O services used to schedule work
+    virtual boost::uint32_t get_num_services(void) const { return m_num_threads; }
+
+    /// returns the counter of active connections for an I/O service
+    virtual load_counter_type *get_load_counter(boost::asio::io_service& service);
+
+    /// returns the number of active connections that use an I/O service
+    virtual long get_service_load(boost::uint32_t n) const {
+        BOOST_ASSERT(n < m_service_pool.size());
+        return m_service_pool[n]->m_load;
+    }
+
+    /// returns the policy used to choose the IO service for new work and connections
+    inline service_policy_type get_service_policy(void) const { return m_service_policy; }
+
+    /// sets the policy used to choose the IO service for new work and connections
+    inline void set_service_policy(service_policy_type p) { m_service_policy = p; }
+
     /// Starts the thread scheduler (this is called automatically when necessary)
     virtual void startup(void);
     
     
 protected:
     
+    /// makes sure that there is an IO service for each thread, and marks
+    /// the services as ready; assumes that a scheduler lock has already
+    /// been acquired
+    void create_services(void);
+    
+    /// returns the number of the IO service to use for new work, using the
+    /// service policy (this does not lock)
+    boost::uint32_t select_service(void);
+    
     /// stops all services used to schedule work
     virtual void stop_services(void) {
         for (service_pool_type::iterator i = m_service_pool.begin(); i != m_service_pool.end(); ++i) {
@@ -335,14 +1422,47 @@ protected:
     }
         
     /// finishes all services used to schedule work
-    virtual void finish_services(void) { m_service_pool.clear(); }
+    virtual void finish_services(void) {
+        boost::mutex::scoped_lock resize_lock(m_resize_mutex);
+        if (m_services_ready != 0)
+            --m_services_ready;
+        m_service_pool.clear();
+    }
     
+    /**
+     * starts or retires threads while the scheduler is running so that n
+     * threads are used; assumes that a scheduler lock has already been
+     * acquired.  Services that are retired stop receiving new work, and
+     * their threads keep running until the connections using them have
+     * finished, so that connections never move between services.  The
+     * first service is never retired, and its thread calls the resize
+     * handlers once the number of services has changed.
+     *
+     * @param n the number of threads, within the thread limits
+     */
+    virtual void resize_threads(boost::uint32_t n);
 
-    /// typedef for a pair object where first is an IO service and second is a deadline timer
+    /**
+     * retires the thread of a service that is no longer used for new work,
+     * once the service has been idle for a full check interval; until then
+     * the check is repeated
+     *
+     * @param n the number of the service
+     * @param was_idle true if the service was idle when last checked
+     * @param ec error from the drain timer (if any)
+     */
+    void retire_service(boost::uint32_t n, bool was_idle, const boost::system::error_code& ec);
+
+
+    /// typedef for a pair object where first is an IO service and second is a
+    /// deadline timer (along with the number of active connections for the service)
     struct service_pair_type {
-        service_pair_type(void) : first(), second(first) {}
+        service_pair_type(void) : first(), second(first), m_drain_timer(first), m_load(0), m_has_thread(false) {}
         boost::asio::io_service         first;
         boost::asio::deadline_timer     second;
+        boost::asio::deadline_timer     m_drain_timer;
+        load_counter_type               m_load;
+        bool                            m_has_thread;
     };
     
     /// typedef for a pool of IO services
@@ -352,8 +1472,189 @@ protected:
     /// pool of IO services used to schedule work
     service_pool_type   m_service_pool;
 
-    /// the next service to use for scheduling work
-    boost::uint32_t     m_next_service;
+    /// used to choose the next service for scheduling work (incremented atomically)
+    load_counter_type   m_next_service;
+
+    /// policy used to choose the IO service for new work and connections
+    service_policy_type m_service_policy;
+
+    /// non-zero once there is an IO service for each thread, so that the
+    /// services may be used without locking (only changed while both the
+    /// scheduler's mutex and m_resize_mutex are held)
+    load_counter_type   m_services_ready;
+
+    /// number of milliseconds between checks for the connections of a retired service
+    static const boost::uint32_t    DRAIN_CHECK_MSEC;
+};
+
+
+///
+/// work_stealing_scheduler: uses a single IO service for each thread, like
+/// one_to_one_scheduler, so that socket I/O stays on the thread that owns
+/// the connection.  Work scheduled using post() is kept in a run queue for
+/// each thread instead, and threads that run out of queued work steal it
+/// from the others, so that a slow handler does not hold up the work
+/// queued behind it.
+///
+class PION_API work_stealing_scheduler :
+    public one_to_one_scheduler
+{
+public:
+
+    /// maximum number of queued work items that a thread runs before it
+    /// returns to its IO service to handle other events
+    enum { MAX_WORK_BATCH_SIZE = 16 };
+
+
+    /// constructs a new work_stealing_scheduler
+    work_stealing_scheduler(void)
+        : m_queue_pool(), m_next_queue(0), m_current_queue(&work_stealing_scheduler::release_current_queue)
+    {}
+
+    /// virtual destructor
+    virtual ~work_stealing_scheduler() { shutdown(); }
+
+    /// Starts the thread scheduler (this is called automatically when necessary)
+    virtual void startup(void);
+
+    // prioritized work is run from the IO services' lanes, not the run queues
+    using one_to_one_scheduler::post;
+
+    /**
+     * schedules work to be performed by one of the pooled threads.  Work
+     * posted by one of the scheduler's own threads is queued for that
+     * thread, and other work is spread across the threads' queues.  If the
+     * queue's owner is running a handler, or has not yet started on work
+     * queued earlier, an idle thread is woken to steal the work.
+     *
+     * @param work_func work function to be executed
+     */
+    virtual void post(boost::function0<void> work_func);
+
+    /// returns the number of work items that are waiting in the run queues
+    std::size_t get_queued_work(void) const;
+
+    /// returns the number of work items that were run by a thread other
+    /// than the one that they were queued for
+    boost::uint64_t get_stolen_work(void) const;
+
+
+protected:
+
+    /// finishes all services used to schedule work
+    virtual void finish_services(void) {
+        {
+            boost::mutex::scoped_lock resize_lock(m_resize_mutex);
+            m_queue_pool.clear();
+        }
+        one_to_one_scheduler::finish_services();
+    }
+
+    /// keeps the current number of threads, since each has its own run
+    /// queue that the others steal from
+    virtual void resize_threads(boost::uint32_t n) {
+        multi_thread_scheduler::resize_threads(n);
+    }
+
+
+    ///
+    /// work_queue: run queue of work items for one of the threads
+    ///
+    struct work_queue :
+        private boost::noncopyable
+    {
+        /// constructs a new work_queue
+        work_queue(boost::asio::io_service& service, boost::uint32_t n)
+            : m_service(service), m_index(n), m_num_stolen(0), m_is_busy(false)
+        {}
+
+        /// IO service of the thread that owns the queue
+        boost::asio::io_service &               m_service;
+
+        /// position of the queue in the pool
+        const boost::uint32_t                   m_index;
+
+        /// work items waiting to be run, oldest first (other threads also
+        /// steal from the front, so that work runs in the order posted)
+        std::deque<boost::function0<void> >     m_work;
+
+        /// number of work items in this queue that were run by other threads
+        boost::uint64_t                         m_num_stolen;
+
+        /// true while the owner is running or looking for work items, so
+        /// that anything queued behind it is left for another thread (work
+        /// queued while the owner runs any other handler is caught by post())
+        bool                                    m_is_busy;
+
+        /// mutex used to protect the queue
+        mutable boost::mutex                    m_mutex;
+    };
+
+    /// typedef for a pool of run queues
+    typedef std::vector<boost::shared_ptr<work_queue> >     queue_pool_type;
+
+
+    /**
+     * thread function used to process work for a thread's IO service
+     *
+     * @param n the thread's number (the same as its IO service and run queue)
+     */
+    void process_queue_work(boost::uint32_t n);
+
+    /**
+     * runs work items that are waiting in a thread's run queue, and steals
+     * work from the other queues once it is empty.  This is posted to a
+     * thread's IO service whenever work is queued for it.
+     *
+     * @param n the thread's number
+     */
+    void run_queued_work(boost::uint32_t n);
+
+    /**
+     * takes the next work item from a thread's own queue, or else from
+     * another thread's queue
+     *
+     * @param n the thread's number
+     * @param work_func the work item taken (if any)
+     * @return true if a work item was found
+     */
+    bool take_work(boost::uint32_t n, boost::function0<void>& work_func);
+
+    /**
+     * marks a thread's run queue as having no work item in progress
+     *
+     * @param n the thread's number
+     */
+    void set_idle(boost::uint32_t n);
+
+    /**
+     * wakes a thread that is not running any work item so that it steals
+     * work from a queue whose owner is busy
+     *
+     * @param n number of the queue that work was added to
+     */
+    void wake_thief(boost::uint32_t n);
+
+    /// returns the number of run queues (they are only added while
+    /// m_resize_mutex is held, and never move since their room is reserved)
+    std::size_t get_num_queues(void);
+
+    /// makes sure that there is a run queue for each IO service; assumes
+    /// that a scheduler lock has already been acquired
+    void create_queues(void);
+
+    /// cleanup function for m_current_queue (the queues are owned by m_queue_pool)
+    static void release_current_queue(work_queue *) {}
+
+
+    /// run queues, one for each thread (changes are protected by m_resize_mutex)
+    queue_pool_type                             m_queue_pool;
+
+    /// the next queue to use for work posted from outside the thread pool
+    boost::uint32_t                             m_next_queue;
+
+    /// run queue of the current thread (null if it is not one of the scheduler's threads)
+    boost::thread_specific_ptr<work_queue>      m_current_queue;
 };
     
     
@@ -0,0 +1,72 @@
+// ---------------------------------------------------------------------
+// pion:  a Boost C++ framework for building lightweight HTTP interfaces
+// ---------------------------------------------------------------------
+// Copyright (C) 2007-2014 Splunk Inc.  (https://github.com/splunk/pion)
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See http://www.boost.org/LICENSE_1_0.txt
+//
+
+#ifndef __PION_TCP_BUFFER_POOL_HEADER__
+#define __PION_TCP_BUFFER_POOL_HEADER__
+
+#include <cstddef>
+#include <pion/config.hpp>
+
+
+namespace pion {    // begin namespace pion
+namespace tcp {     // begin namespace tcp
+
+
+///
+/// buffer_pool: pool of blocks that connections borrow for reading.  Block
+/// sizes are powers of two between MIN_BLOCK_SIZE and MAX_BLOCK_SIZE.  Each
+/// thread keeps its own lists of free blocks, so acquiring and releasing a
+/// block does not require any locking.  A block may be released by a
+/// different thread than the one that acquired it.
+///
+class PION_API buffer_pool
+{
+public:
+
+    /// default size of a block in bytes
+    enum { BLOCK_SIZE = 8192 };
+
+    /// smallest and largest sizes of a block in bytes
+    enum { MIN_BLOCK_SIZE = 1024, MAX_BLOCK_SIZE = 1048576 };
+
+    /// maximum number of bytes in free blocks that each thread keeps for
+    /// reuse, for each block size (at least one block is always kept)
+    enum { MAX_FREE_BYTES = 524288 };
+
+
+    /// returns the size of the block used for a buffer of n bytes
+    static std::size_t get_block_size(std::size_t n);
+
+    /// returns a block of block_size bytes (which must be a valid block size)
+    static char *acquire(std::size_t block_size = BLOCK_SIZE);
+
+    /// returns a block to the calling thread's free list (or frees it)
+    static void release(char *block_ptr, std::size_t block_size = BLOCK_SIZE);
+
+    /// returns the number of blocks that have been acquired but not released
+    static long get_blocks_in_use(void);
+
+    /// returns the number of bytes in blocks that have been acquired but not released
+    static long get_bytes_in_use(void);
+
+    /// returns the number of free blocks kept by the calling thread
+    static std::size_t get_free_blocks(void);
+
+
+private:
+
+    /// this class is not meant to be instantiated
+    buffer_pool(void);
+};
+
+
+}   // end namespace tcp
+}   // end namespace pion
+
+#endif
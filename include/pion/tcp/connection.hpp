@@ -19,15 +19,23 @@
 #endif
 
 #include <boost/noncopyable.hpp>
+#include <boost/scoped_ptr.hpp>
 #include <boost/shared_ptr.hpp>
 #include <boost/lexical_cast.hpp>
 #include <boost/enable_shared_from_this.hpp>
 #include <boost/asio.hpp>
 #include <boost/array.hpp>
+#include <boost/bind.hpp>
 #include <boost/function.hpp>
 #include <boost/function/function1.hpp>
 #include <pion/config.hpp>
+#include <pion/scheduler.hpp>
+#include <pion/uring_engine.hpp>
+#include <pion/tcp/buffer_pool.hpp>
+#include <pion/tcp/timer_wheel.hpp>
+#include <cstring>
 #include <string>
+#include <vector>
 
 
 namespace pion {    // begin namespace pion
@@ -48,35 +56,183 @@ public:
         LIFECYCLE_CLOSE, LIFECYCLE_KEEPALIVE, LIFECYCLE_PIPELINED
     };
     
-    /// size of the read buffer
-    enum { READ_BUFFER_SIZE = 8192 };
+    /// default size of the read buffer
+    enum { READ_BUFFER_SIZE = buffer_pool::BLOCK_SIZE };
     
     /// data type for a function that handles TCP connection objects
     typedef boost::function1<void, boost::shared_ptr<connection> >   connection_handler;
     
-    /// data type for an I/O read buffer
-    typedef boost::array<char, READ_BUFFER_SIZE>    read_buffer_type;
+    ///
+    /// read_buffer_type: I/O read buffer that is borrowed from the buffer_pool
+    /// the first time that it is used, and may be returned while the
+    /// connection is idle.  Its size may be adapted to the amount of data
+    /// that each read returns: it grows while reads keep filling it, and
+    /// shrinks back when they stop.
+    ///
+    class read_buffer_type :
+        private boost::noncopyable
+    {
+    public:
+
+        /// number of consecutive reads that fill the buffer before it grows
+        enum { GROW_AFTER_FULL_READS = 2 };
+
+        /// number of consecutive reads that fill less than a quarter of the
+        /// buffer before it shrinks
+        enum { SHRINK_AFTER_SHORT_READS = 4 };
+
+
+        /// default constructor (does not allocate the buffer)
+        read_buffer_type(void)
+            : m_block_ptr(NULL), m_block_size(READ_BUFFER_SIZE),
+            m_min_size(READ_BUFFER_SIZE), m_max_size(READ_BUFFER_SIZE),
+            m_next_size(READ_BUFFER_SIZE), m_full_reads(0), m_short_reads(0)
+        {}
+
+        /// returns the buffer to the pool
+        ~read_buffer_type() { release(); }
+
+        /// returns a pointer to the buffer (borrowing it if necessary)
+        inline char *data(void) {
+            if (m_block_ptr == NULL) {
+                m_block_size = m_next_size;
+                m_block_ptr = buffer_pool::acquire(m_block_size);
+            }
+            return m_block_ptr;
+        }
+
+        /// returns a pointer to the buffer (borrowing it if necessary)
+        inline char *c_array(void) { return data(); }
+
+        /// returns the size of the buffer in bytes
+        inline std::size_t size(void) const {
+            return (m_block_ptr == NULL ? m_next_size : m_block_size);
+        }
+
+        /// returns true if the buffer is currently borrowed from the pool
+        inline bool is_allocated(void) const { return m_block_ptr != NULL; }
+
+        /// returns the buffer to the pool
+        inline void release(void) {
+            if (m_block_ptr != NULL) {
+                buffer_pool::release(m_block_ptr, m_block_size);
+                m_block_ptr = NULL;
+            }
+        }
+
+        /**
+         * sets the size of the buffer (sizes are rounded up to a buffer_pool
+         * block size).  The new size is used the next time that the buffer
+         * is prepared for a read.
+         *
+         * @param n initial size of the buffer in bytes
+         * @param max_n largest size that the buffer may grow to (growth is
+         *              disabled if this is not larger than n)
+         */
+        inline void set_size(std::size_t n, std::size_t max_n) {
+            m_min_size = buffer_pool::get_block_size(n);
+            m_max_size = buffer_pool::get_block_size(max_n);
+            if (m_max_size < m_min_size)
+                m_max_size = m_min_size;
+            reset_size();
+        }
+
+        /// returns the initial size of the buffer in bytes
+        inline std::size_t get_min_size(void) const { return m_min_size; }
+
+        /// returns the largest size that the buffer may grow to
+        inline std::size_t get_max_size(void) const { return m_max_size; }
+
+        /// shrinks the buffer back to its initial size (when next prepared)
+        inline void reset_size(void) {
+            m_next_size = m_min_size;
+            m_full_reads = m_short_reads = 0;
+        }
+
+        /**
+         * updates the size of the buffer using the result of a read into it
+         * (does nothing if growth is disabled)
+         *
+         * @param bytes_read number of bytes that the read returned
+         */
+        inline void update_size(std::size_t bytes_read) {
+            if (m_max_size == m_min_size)
+                return;
+            const std::size_t current_size = size();
+            if (bytes_read >= current_size) {
+                m_short_reads = 0;
+                if (++m_full_reads >= GROW_AFTER_FULL_READS && m_next_size < m_max_size) {
+                    m_next_size <<= 1;
+                    m_full_reads = 0;
+                }
+            } else if (bytes_read < current_size / 4) {
+                m_full_reads = 0;
+                if (++m_short_reads >= SHRINK_AFTER_SHORT_READS && m_next_size > m_min_size) {
+                    m_next_size >>= 1;
+                    m_short_reads = 0;
+                }
+            } else {
+                m_full_reads = m_short_reads = 0;
+            }
+        }
+
+        /// returns the buffer to use for the next read, resizing it first if
+        /// necessary (this discards any data that is in the buffer)
+        inline boost::asio::mutable_buffers_1 prepare(void) {
+            if (m_block_ptr != NULL && m_block_size != m_next_size)
+                release();
+            char *ptr = data();
+            return boost::asio::mutable_buffers_1(ptr, m_block_size);
+        }
+
+    private:
+
+        /// block borrowed from the buffer_pool (NULL if none)
+        char *          m_block_ptr;
+
+        /// size of the block that is (or was last) borrowed
+        std::size_t     m_block_size;
+
+        /// initial size of the buffer
+        std::size_t     m_min_size;
+
+        /// largest size that the buffer may grow to
+        std::size_t     m_max_size;
+
+        /// size of the buffer for the next read
+        std::size_t     m_next_size;
+
+        /// number of consecutive reads that filled the buffer
+        unsigned int    m_full_reads;
+
+        /// number of consecutive reads that filled less than a quarter of the buffer
+        unsigned int    m_short_reads;
+    };
     
-    /// data type for a socket connection
-    typedef boost::asio::ip::tcp::socket            socket_type;
+    /// data type for a socket connection (a TCP socket, or a Unix domain
+    /// stream socket if the connection was accepted from a local endpoint).
+    /// This used to be boost::asio::ip::tcp::socket: its endpoints are
+    /// generic, so use get_local_endpoint() and get_remote_endpoint() to
+    /// get TCP endpoints.
+    typedef boost::asio::generic::stream_protocol::socket   socket_type;
 
 #ifdef PION_HAVE_SSL
-    /// data type for an SSL socket connection
-    typedef boost::asio::ssl::stream<boost::asio::ip::tcp::socket>  ssl_socket_type;
+    /// data type for an SSL socket connection (layered over the connection's TCP socket)
+    typedef boost::asio::ssl::stream<socket_type&>                  ssl_socket_type;
 
     /// data type for SSL configuration context
     typedef boost::asio::ssl::context                               ssl_context_type;
 #else
     class ssl_socket_type {
     public:
-        ssl_socket_type(boost::asio::io_service& io_service) : m_socket(io_service) {}
+        ssl_socket_type(socket_type& s) : m_socket(s) {}
         inline socket_type& next_layer(void) { return m_socket; }
         inline const socket_type& next_layer(void) const { return m_socket; }
         inline socket_type::lowest_layer_type& lowest_layer(void) { return m_socket.lowest_layer(); }
         inline const socket_type::lowest_layer_type& lowest_layer(void) const { return m_socket.lowest_layer(); }
         inline void shutdown(void) {}
     private:
-        socket_type  m_socket;
+        socket_type &   m_socket;
     };
     typedef int     ssl_context_type;
 #endif
@@ -107,19 +263,18 @@ public:
      * @param ssl_flag if true then the connection will be encrypted using SSL 
      */
     explicit connection(boost::asio::io_service& io_service, const bool ssl_flag = false)
-        :
+        : m_socket(io_service),
 #ifdef PION_HAVE_SSL
-        m_ssl_context(io_service, boost::asio::ssl::context::sslv23),
-        m_ssl_socket(io_service, m_ssl_context),
+        m_ssl_context(NULL),
         m_ssl_flag(ssl_flag),
 #else
-        m_ssl_context(0),
-        m_ssl_socket(io_service),
         m_ssl_flag(false),
 #endif
-        m_lifecycle(LIFECYCLE_CLOSE)
+        m_lifecycle(LIFECYCLE_CLOSE), m_registry_index(0),
+        m_timer_wheel(NULL), m_deadline(*this)
     {
         save_read_pos(NULL, NULL);
+        if (m_ssl_flag) get_ssl_socket();
     }
     
     /**
@@ -129,42 +284,43 @@ public:
      * @param ssl_context asio ssl context associated with the connection
      */
     connection(boost::asio::io_service& io_service, ssl_context_type& ssl_context)
-        :
+        : m_socket(io_service),
 #ifdef PION_HAVE_SSL
-        m_ssl_context(io_service, boost::asio::ssl::context::sslv23),
-        m_ssl_socket(io_service, ssl_context), m_ssl_flag(true),
+        m_ssl_context(&ssl_context), m_ssl_flag(true),
 #else
-        m_ssl_context(0),
-        m_ssl_socket(io_service), m_ssl_flag(false), 
+        m_ssl_flag(false), 
 #endif
-        m_lifecycle(LIFECYCLE_CLOSE)
+        m_lifecycle(LIFECYCLE_CLOSE), m_registry_index(0),
+        m_timer_wheel(NULL), m_deadline(*this)
     {
         save_read_pos(NULL, NULL);
+        if (m_ssl_flag) get_ssl_socket();
     }
     
     /// returns true if the connection is currently open
     inline bool is_open(void) const {
-        return const_cast<ssl_socket_type&>(m_ssl_socket).lowest_layer().is_open();
+        return m_socket.is_open();
     }
     
     /// closes the tcp socket and cancels any pending asynchronous operations
     inline void close(void) {
+        cancel_deadline();
         if (is_open()) {
             try {
 
                 // shutting down SSL will wait forever for a response from the remote end,
                 // which causes it to hang indefinitely if the other end died unexpectedly
-                // if (get_ssl_flag()) m_ssl_socket.shutdown();
+                // if (get_ssl_flag()) get_ssl_socket().shutdown();
 
                 // windows seems to require this otherwise it doesn't
                 // recognize that connections have been closed
-                m_ssl_socket.next_layer().shutdown(boost::asio::ip::tcp::socket::shutdown_both);
+                m_socket.shutdown(boost::asio::socket_base::shutdown_both);
                 
             } catch (...) {}    // ignore exceptions
             
             // close the underlying socket (ignore errors)
             boost::system::error_code ec;
-            m_ssl_socket.next_layer().close(ec);
+            m_socket.close(ec);
         }
     }
 
@@ -176,40 +332,67 @@ public:
     inline void cancel(void) {
 #if !defined(_MSC_VER) || (_WIN32_WINNT >= 0x0600)
         boost::system::error_code ec;
-        m_ssl_socket.next_layer().cancel(ec);
+        m_socket.cancel(ec);
 #endif
+        uring_engine& engine(uring_engine::get_instance());
+        if (engine.has_socket_io() && is_open())
+            engine.cancel(m_socket.native_handle());
     }
     
     /// virtual destructor
     virtual ~connection() { close(); }
     
     /**
-     * asynchronously accepts a new tcp connection
+     * sets a deadline for the operations that are pending on the connection.
+     * If it expires before cancel_deadline() is called, they are cancelled
+     * (and their handlers receive operation_aborted).  Each connection has
+     * one deadline, which is used for read, keep-alive idle and write
+     * timeouts; setting it again replaces the previous one.
+     *
+     * @param seconds minimum number of seconds before the deadline expires
+     */
+    inline void set_deadline(const boost::uint32_t seconds) {
+        if (m_timer_wheel == NULL)
+            m_timer_wheel = &boost::asio::use_service<timer_wheel>(get_io_service());
+        m_timer_wheel->arm(m_deadline, seconds);
+    }
+
+    /// cancels the connection's deadline (operations have completed)
+    inline void cancel_deadline(void) {
+        if (m_timer_wheel != NULL)
+            m_timer_wheel->disarm(m_deadline);
+    }
+    
+    /**
+     * asynchronously accepts a new connection
      *
-     * @param tcp_acceptor object used to accept new connections
+     * @param tcp_acceptor object used to accept new connections (a TCP or a
+     *                     Unix domain stream socket acceptor)
      * @param handler called after a new connection has been accepted
      *
      * @see boost::asio::basic_socket_acceptor::async_accept()
      */
-    template <typename AcceptHandler>
-    inline void async_accept(boost::asio::ip::tcp::acceptor& tcp_acceptor,
+    template <typename AcceptorType, typename AcceptHandler>
+    inline void async_accept(AcceptorType& tcp_acceptor,
                              AcceptHandler handler)
     {
-        tcp_acceptor.async_accept(m_ssl_socket.lowest_layer(), handler);
+        tcp_acceptor.async_accept(m_socket, handler);
     }
 
     /**
-     * accepts a new tcp connection (blocks until established)
+     * accepts a new connection (blocks until established)
      *
-     * @param tcp_acceptor object used to accept new connections
+     * @param tcp_acceptor object used to accept new connections (a TCP or a
+     *                     Unix domain stream socket acceptor)
      * @return boost::system::error_code contains error code if the connection fails
      *
      * @see boost::asio::basic_socket_acceptor::accept()
      */
-    inline boost::system::error_code accept(boost::asio::ip::tcp::acceptor& tcp_acceptor)
+    template <typename AcceptorType>
+    inline boost::system::error_code accept(AcceptorType& tcp_acceptor)
     {
         boost::system::error_code ec;
-        tcp_acceptor.accept(m_ssl_socket.lowest_layer(), ec);
+        tcp_acceptor.accept(m_socket, ec);
         return ec;
     }
     
@@ -225,9 +408,26 @@ public:
     inline void async_connect(const boost::asio::ip::tcp::endpoint& tcp_endpoint,
                               ConnectHandler handler)
     {
-        m_ssl_socket.lowest_layer().async_connect(tcp_endpoint, handler);
+        m_socket.async_connect(socket_type::endpoint_type(tcp_endpoint), handler);
     }
 
+#ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+    /**
+     * asynchronously connects to a Unix domain stream socket
+     *
+     * @param local_endpoint local endpoint (socket path) to connect to
+     * @param handler called after a new connection has been established
+     *
+     * @see boost::asio::basic_socket_acceptor::async_connect()
+     */
+    template <typename ConnectHandler>
+    inline void async_connect(const boost::asio::local::stream_protocol::endpoint& local_endpoint,
+                              ConnectHandler handler)
+    {
+        m_socket.async_connect(socket_type::endpoint_type(local_endpoint), handler);
+    }
+#endif
+
     /**
      * asynchronously connects to a (IPv4) remote endpoint
      *
@@ -246,6 +446,29 @@ public:
         async_connect(tcp_endpoint, handler);
     }
     
+    /**
+     * asynchronously connects to a remote endpoint with hostname lookup.
+     * The lookup is done on the scheduler's blocking pool, so that it does
+     * not hold up the thread that calls this.
+     *
+     * @param remote_server hostname of the remote server to connect to
+     * @param remote_port remote port number to connect to
+     * @param handler called after a new connection has been established
+     *                (or once every endpoint found has failed)
+     */
+    template <typename ConnectHandler>
+    inline void async_connect(const std::string& remote_server,
+                              const unsigned int remote_port,
+                              ConnectHandler handler)
+    {
+        resolved_endpoints_ptr result_ptr(new resolved_endpoints());
+        scheduler::offload(boost::bind(&connection::resolve_host, boost::ref(get_io_service()),
+                                       remote_server, remote_port, result_ptr),
+                           get_io_service(),
+                           boost::bind(&connection::connect_next_endpoint<ConnectHandler>,
+                                       shared_from_this(), result_ptr, handler));
+    }
+    
     /**
      * connects to a remote endpoint (blocks until established)
      *
@@ -257,9 +480,26 @@ public:
     inline boost::system::error_code connect(boost::asio::ip::tcp::endpoint& tcp_endpoint)
     {
         boost::system::error_code ec;
-        m_ssl_socket.lowest_layer().connect(tcp_endpoint, ec);
+        m_socket.connect(socket_type::endpoint_type(tcp_endpoint), ec);
+        return ec;
+    }
+
+#ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+    /**
+     * connects to a Unix domain stream socket (blocks until established)
+     *
+     * @param local_endpoint local endpoint (socket path) to connect to
+     * @return boost::system::error_code contains error code if the connection fails
+     *
+     * @see boost::asio::basic_socket_acceptor::connect()
+     */
+    inline boost::system::error_code connect(const boost::asio::local::stream_protocol::endpoint& local_endpoint)
+    {
+        boost::system::error_code ec;
+        m_socket.connect(socket_type::endpoint_type(local_endpoint), ec);
         return ec;
     }
+#endif
 
     /**
      * connects to a (IPv4) remote endpoint (blocks until established)
@@ -278,7 +518,9 @@ public:
     }
     
     /**
-     * connects to a remote endpoint with hostname lookup
+     * connects to a remote endpoint with hostname lookup (blocks until
+     * established, including the lookup; threads that handle I/O events
+     * should use async_connect() instead)
      *
      * @param remote_server hostname of the remote server to connect to
      * @param remote_port remote port number to connect to
@@ -291,7 +533,7 @@ public:
     {
         // query a list of matching endpoints
         boost::system::error_code ec;
-        boost::asio::ip::tcp::resolver resolver(m_ssl_socket.lowest_layer().get_io_service());
+        boost::asio::ip::tcp::resolver resolver(m_socket.get_io_service());
         boost::asio::ip::tcp::resolver::query query(remote_server,
             boost::lexical_cast<std::string>(remote_port),
             boost::asio::ip::tcp::resolver::query::numeric_service);
@@ -323,7 +565,7 @@ public:
     template <typename SSLHandshakeHandler>
     inline void async_handshake_client(SSLHandshakeHandler handler) {
 #ifdef PION_HAVE_SSL
-        m_ssl_socket.async_handshake(boost::asio::ssl::stream_base::client, handler);
+        get_ssl_socket().async_handshake(boost::asio::ssl::stream_base::client, handler);
         m_ssl_flag = true;
 #endif
     }
@@ -338,7 +580,7 @@ public:
     template <typename SSLHandshakeHandler>
     inline void async_handshake_server(SSLHandshakeHandler handler) {
 #ifdef PION_HAVE_SSL
-        m_ssl_socket.async_handshake(boost::asio::ssl::stream_base::server, handler);
+        get_ssl_socket().async_handshake(boost::asio::ssl::stream_base::server, handler);
         m_ssl_flag = true;
 #endif
     }
@@ -353,7 +595,7 @@ public:
     inline boost::system::error_code handshake_client(void) {
         boost::system::error_code ec;
 #ifdef PION_HAVE_SSL
-        m_ssl_socket.handshake(boost::asio::ssl::stream_base::client, ec);
+        get_ssl_socket().handshake(boost::asio::ssl::stream_base::client, ec);
         m_ssl_flag = true;
 #endif
         return ec;
@@ -369,14 +611,16 @@ public:
     inline boost::system::error_code handshake_server(void) {
         boost::system::error_code ec;
 #ifdef PION_HAVE_SSL
-        m_ssl_socket.handshake(boost::asio::ssl::stream_base::server, ec);
+        get_ssl_socket().handshake(boost::asio::ssl::stream_base::server, ec);
         m_ssl_flag = true;
 #endif
         return ec;
     }
     
     /**
-     * asynchronously reads some data into the connection's read buffer 
+     * asynchronously reads some data into the connection's read buffer.
+     * Reads from connections that do not use SSL are performed by the
+     * uring_engine, if it has been started and may be used for sockets.
      *
      * @param handler called after the read operation has completed
      *
@@ -386,11 +630,12 @@ public:
     inline void async_read_some(ReadHandler handler) {
 #ifdef PION_HAVE_SSL
         if (get_ssl_flag())
-            m_ssl_socket.async_read_some(boost::asio::buffer(m_read_buffer),
+            m_ssl_socket_ptr->async_read_some(m_read_buffer.prepare(),
                                          handler);
         else
 #endif      
-            m_ssl_socket.next_layer().async_read_some(boost::asio::buffer(m_read_buffer),
+        if (! uring_engine::get_instance().has_socket_io() || ! uring_read_some(handler))
+            m_socket.async_read_some(m_read_buffer.prepare(),
                                          handler);
     }
     
@@ -407,10 +652,10 @@ public:
                                 ReadHandler handler) {
 #ifdef PION_HAVE_SSL
         if (get_ssl_flag())
-            m_ssl_socket.async_read_some(read_buffer, handler);
+            m_ssl_socket_ptr->async_read_some(read_buffer, handler);
         else
 #endif      
-            m_ssl_socket.next_layer().async_read_some(read_buffer, handler);
+            m_socket.async_read_some(read_buffer, handler);
     }
     
     /**
@@ -424,10 +669,10 @@ public:
     inline std::size_t read_some(boost::system::error_code& ec) {
 #ifdef PION_HAVE_SSL
         if (get_ssl_flag())
-            return m_ssl_socket.read_some(boost::asio::buffer(m_read_buffer), ec);
+            return m_ssl_socket_ptr->read_some(m_read_buffer.prepare(), ec);
         else
 #endif      
-            return m_ssl_socket.next_layer().read_some(boost::asio::buffer(m_read_buffer), ec);
+            return m_socket.read_some(m_read_buffer.prepare(), ec);
     }
     
     /**
@@ -445,10 +690,24 @@ public:
     {
 #ifdef PION_HAVE_SSL
         if (get_ssl_flag())
-            return m_ssl_socket.read_some(read_buffer, ec);
+            return m_ssl_socket_ptr->read_some(read_buffer, ec);
         else
 #endif      
-            return m_ssl_socket.next_layer().read_some(read_buffer, ec);
+            return m_socket.read_some(read_buffer, ec);
+    }
+    
+    /**
+     * asynchronously waits until data is available to be read from the TCP
+     * socket, without using a read buffer.  Note that data which has already
+     * been decrypted by the SSL layer is not detected.
+     *
+     * @param handler called after data is available (or the wait has failed)
+     *
+     * @see boost::asio::null_buffers
+     */
+    template <typename WaitHandler>
+    inline void async_wait_for_data(WaitHandler handler) {
+        m_socket.async_read_some(boost::asio::null_buffers(), handler);
     }
     
     /**
@@ -466,11 +725,11 @@ public:
     {
 #ifdef PION_HAVE_SSL
         if (get_ssl_flag())
-            boost::asio::async_read(m_ssl_socket, boost::asio::buffer(m_read_buffer),
+            boost::asio::async_read(*m_ssl_socket_ptr, m_read_buffer.prepare(),
                                     completion_condition, handler);
         else
 #endif      
-            boost::asio::async_read(m_ssl_socket.next_layer(), boost::asio::buffer(m_read_buffer),
+            boost::asio::async_read(m_socket, m_read_buffer.prepare(),
                                     completion_condition, handler);
     }
             
@@ -491,11 +750,11 @@ public:
     {
 #ifdef PION_HAVE_SSL
         if (get_ssl_flag())
-            boost::asio::async_read(m_ssl_socket, buffers,
+            boost::asio::async_read(*m_ssl_socket_ptr, buffers,
                                     completion_condition, handler);
         else
 #endif      
-            boost::asio::async_read(m_ssl_socket.next_layer(), buffers,
+            boost::asio::async_read(m_socket, buffers,
                                     completion_condition, handler);
     }
     
@@ -515,11 +774,11 @@ public:
     {
 #ifdef PION_HAVE_SSL
         if (get_ssl_flag())
-            return boost::asio::async_read(m_ssl_socket, boost::asio::buffer(m_read_buffer),
+            return boost::asio::async_read(*m_ssl_socket_ptr, m_read_buffer.prepare(),
                                            completion_condition, ec);
         else
 #endif      
-            return boost::asio::async_read(m_ssl_socket.next_layer(), boost::asio::buffer(m_read_buffer),
+            return boost::asio::async_read(m_socket, m_read_buffer.prepare(),
                                            completion_condition, ec);
     }
     
@@ -541,16 +800,18 @@ public:
     {
 #ifdef PION_HAVE_SSL
         if (get_ssl_flag())
-            return boost::asio::read(m_ssl_socket, buffers,
+            return boost::asio::read(*m_ssl_socket_ptr, buffers,
                                      completion_condition, ec);
         else
 #endif      
-            return boost::asio::read(m_ssl_socket.next_layer(), buffers,
+            return boost::asio::read(m_socket, buffers,
                                      completion_condition, ec);
     }
     
     /**
-     * asynchronously writes data to the connection
+     * asynchronously writes data to the connection.  Writes to connections
+     * that do not use SSL are performed by the uring_engine, if it has been
+     * started and may be used for sockets.
      *
      * @param buffers one or more buffers containing the data to be written
      * @param handler called after the data has been written
@@ -561,10 +822,12 @@ public:
     inline void async_write(const ConstBufferSequence& buffers, write_handler_t handler) {
 #ifdef PION_HAVE_SSL
         if (get_ssl_flag())
-            boost::asio::async_write(m_ssl_socket, buffers, handler);
+            boost::asio::async_write(*m_ssl_socket_ptr, buffers, handler);
         else
 #endif      
-            boost::asio::async_write(m_ssl_socket.next_layer(), buffers, handler);
+        if (! uring_engine::get_instance().has_socket_io()
+            || ! uring_write(copy_buffers(buffers), 0, handler))
+            boost::asio::async_write(m_socket, buffers, handler);
     }   
         
     /**
@@ -582,18 +845,21 @@ public:
     {
 #ifdef PION_HAVE_SSL
         if (get_ssl_flag())
-            return boost::asio::write(m_ssl_socket, buffers,
+            return boost::asio::write(*m_ssl_socket_ptr, buffers,
                                       boost::asio::transfer_all(), ec);
         else
 #endif      
-            return boost::asio::write(m_ssl_socket.next_layer(), buffers,
+            return boost::asio::write(m_socket, buffers,
                                       boost::asio::transfer_all(), ec);
     }   
     
     
     /// This function should be called when a server has finished handling
     /// the connection
-    inline void finish(void) { if (m_finished_handler) m_finished_handler(shared_from_this()); }
+    inline void finish(void) {
+        cancel_deadline();
+        if (m_finished_handler) m_finished_handler(shared_from_this());
+    }
 
     /// returns true if the connection is encrypted using SSL
     inline bool get_ssl_flag(void) const { return m_ssl_flag; }
@@ -612,6 +878,17 @@ public:
 
     /// returns the buffer used for reading data from the TCP connection
     inline read_buffer_type& get_read_buffer(void) { return m_read_buffer; }
+
+    /**
+     * returns the read buffer to the buffer_pool until it is needed again,
+     * and shrinks it back to its initial size.  This must not be called
+     * while a read operation is pending, or while a saved read position
+     * points into the buffer.
+     */
+    inline void release_read_buffer(void) {
+        m_read_buffer.release();
+        m_read_buffer.reset_size();
+    }
     
     /**
      * saves a read position bookmark
@@ -635,16 +912,35 @@ public:
         read_end_ptr = m_read_position.second;
     }
 
-    /// returns an ASIO endpoint for the client connection
+    /// returns the position of the connection in its server's registry
+    inline std::size_t get_registry_index(void) const { return m_registry_index; }
+
+    /// sets the position of the connection in its server's registry
+    inline void set_registry_index(std::size_t n) { m_registry_index = n; }
+
+    /// returns true if the connection uses a Unix domain stream socket
+    inline bool is_local(void) const {
+#ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+        boost::system::error_code ec;
+        const socket_type::endpoint_type local_endpoint(m_socket.local_endpoint(ec));
+        return (! ec && local_endpoint.protocol().family() == AF_UNIX);
+#else
+        return false;
+#endif
+    }
+
+    /// returns an ASIO endpoint for the client connection (this is
+    /// unspecified for connections that do not use TCP)
     inline boost::asio::ip::tcp::endpoint get_remote_endpoint(void) const {
-        boost::asio::ip::tcp::endpoint remote_endpoint;
-        try {
-            // const_cast is required since lowest_layer() is only defined non-const in asio
-            remote_endpoint = const_cast<ssl_socket_type&>(m_ssl_socket).lowest_layer().remote_endpoint();
-        } catch (boost::system::system_error& /* e */) {
-            // do nothing
-        }
-        return remote_endpoint;
+        boost::system::error_code ec;
+        return get_tcp_endpoint(m_socket.remote_endpoint(ec), ec);
+    }
+
+    /// returns an ASIO endpoint for the local end of the connection (this is
+    /// unspecified for connections that do not use TCP)
+    inline boost::asio::ip::tcp::endpoint get_local_endpoint(void) const {
+        boost::system::error_code ec;
+        return get_tcp_endpoint(m_socket.local_endpoint(ec), ec);
     }
 
     /// returns the client's IP address
@@ -659,24 +955,66 @@ public:
     
     /// returns reference to the io_service used for async operations
     inline boost::asio::io_service& get_io_service(void) {
-        return m_ssl_socket.lowest_layer().get_io_service();
+        return m_socket.get_io_service();
     }
 
-    /// returns non-const reference to underlying TCP socket object
-    inline socket_type& get_socket(void) { return m_ssl_socket.next_layer(); }
+    /// returns non-const reference to underlying socket object
+    inline socket_type& get_socket(void) { return m_socket; }
     
     /// returns non-const reference to underlying SSL socket object
-    inline ssl_socket_type& get_ssl_socket(void) { return m_ssl_socket; }
+    /// (the SSL layer is created the first time that it is needed)
+    inline ssl_socket_type& get_ssl_socket(void) {
+        if (! m_ssl_socket_ptr) {
+#ifdef PION_HAVE_SSL
+            if (m_ssl_context == NULL) {
+                // no shared context was provided -> use one owned by this connection
+                m_ssl_context_ptr.reset(new ssl_context_type(boost::asio::ssl::context::sslv23));
+                m_ssl_context = m_ssl_context_ptr.get();
+            }
+            m_ssl_socket_ptr.reset(new ssl_socket_type(m_socket, *m_ssl_context));
+#else
+            m_ssl_socket_ptr.reset(new ssl_socket_type(m_socket));
+#endif
+        }
+        return *m_ssl_socket_ptr;
+    }
 
-    /// returns const reference to underlying TCP socket object
-    inline const socket_type& get_socket(void) const { return const_cast<ssl_socket_type&>(m_ssl_socket).next_layer(); }
+    /// returns const reference to underlying socket object
+    inline const socket_type& get_socket(void) const { return m_socket; }
     
     /// returns const reference to underlying SSL socket object
-    inline const ssl_socket_type& get_ssl_socket(void) const { return m_ssl_socket; }
+    inline const ssl_socket_type& get_ssl_socket(void) const {
+        return const_cast<connection*>(this)->get_ssl_socket();
+    }
 
     
 protected:
+
+    /**
+     * converts a generic socket endpoint into a TCP endpoint
+     *
+     * @param generic_endpoint the endpoint to convert
+     * @param ec error status from getting the endpoint
+     * @return boost::asio::ip::tcp::endpoint the TCP endpoint (unspecified
+     *         if the endpoint is not an IPv4 or IPv6 address)
+     */
+    static inline boost::asio::ip::tcp::endpoint get_tcp_endpoint(const socket_type::endpoint_type& generic_endpoint,
+                                                                  const boost::system::error_code& ec)
+    {
+        boost::asio::ip::tcp::endpoint tcp_endpoint;
+        if (! ec && (generic_endpoint.protocol().family() == AF_INET
+                     || generic_endpoint.protocol().family() == AF_INET6)
+            && generic_endpoint.size() <= tcp_endpoint.capacity())
+        {
+            std::memcpy(tcp_endpoint.data(), generic_endpoint.data(), generic_endpoint.size());
+            tcp_endpoint.resize(generic_endpoint.size());
+        }
+        return tcp_endpoint;
+    }
         
+    /// connection_cache creates and recycles connection objects
+    friend class connection_cache;
+
     /**
      * protected constructor restricts creation of objects (use create())
      *
@@ -690,18 +1028,40 @@ protected:
                   ssl_context_type& ssl_context,
                   const bool ssl_flag,
                   connection_handler finished_handler)
-        :
+        : m_socket(io_service),
 #ifdef PION_HAVE_SSL
-        m_ssl_context(io_service, boost::asio::ssl::context::sslv23),
-        m_ssl_socket(io_service, ssl_context), m_ssl_flag(ssl_flag),
+        m_ssl_context(&ssl_context), m_ssl_flag(ssl_flag),
 #else
-        m_ssl_context(0),
-        m_ssl_socket(io_service), m_ssl_flag(false), 
+        m_ssl_flag(false), 
 #endif
-        m_lifecycle(LIFECYCLE_CLOSE),
+        m_lifecycle(LIFECYCLE_CLOSE), m_registry_index(0),
+        m_timer_wheel(NULL), m_deadline(*this),
         m_finished_handler(finished_handler)
     {
         save_read_pos(NULL, NULL);
+        if (m_ssl_flag) get_ssl_socket();
+    }
+    
+    /**
+     * resets a closed connection object so that it may be used to accept
+     * another connection (used by connection_cache)
+     *
+     * @param ssl_flag if true then the connection will be encrypted using SSL 
+     */
+    inline void recycle(const bool ssl_flag) {
+        close();
+        // the SSL layer keeps per-session state, so it cannot be reused
+        m_ssl_socket_ptr.reset();
+#ifdef PION_HAVE_SSL
+        m_ssl_flag = ssl_flag;
+#else
+        (void)ssl_flag;
+#endif
+        m_lifecycle = LIFECYCLE_CLOSE;
+        save_read_pos(NULL, NULL);
+        m_read_buffer.release();
+        m_read_buffer.set_size(READ_BUFFER_SIZE, READ_BUFFER_SIZE);
+        if (m_ssl_flag) get_ssl_socket();
     }
     
 
@@ -710,17 +1070,281 @@ private:
     /// data type for a read position bookmark
     typedef std::pair<const char*, const char*>     read_pos_type;
 
+    ///
+    /// resolved_endpoints: endpoints found by a hostname lookup, which are
+    /// tried in turn by async_connect()
+    ///
+    struct resolved_endpoints {
+        resolved_endpoints(void) : m_next(0) {}
+
+        /// endpoints found for the hostname
+        std::vector<boost::asio::ip::tcp::endpoint>     m_endpoints;
+
+        /// position of the next endpoint to try
+        std::size_t                                     m_next;
+
+        /// error from the lookup, or from the last endpoint tried
+        boost::system::error_code                       m_ec;
+    };
+
+    /// data type for a pointer to resolved_endpoints
+    typedef boost::shared_ptr<resolved_endpoints>       resolved_endpoints_ptr;
+
+    /// data type for the data that remains to be written by the uring_engine
+    typedef std::vector<boost::asio::const_buffer>      uring_buffers_type;
+
+    /// data type for a pointer to uring_buffers_type
+    typedef boost::shared_ptr<uring_buffers_type>       uring_buffers_ptr;
+
+
+    /**
+     * looks up the endpoints for a hostname (runs on the blocking pool)
+     *
+     * @param service IO service used for the lookup
+     * @param remote_server hostname of the remote server
+     * @param remote_port remote port number
+     * @param result_ptr receives the endpoints found
+     */
+    static inline void resolve_host(boost::asio::io_service& service,
+                                    const std::string& remote_server,
+                                    const unsigned int remote_port,
+                                    const resolved_endpoints_ptr& result_ptr)
+    {
+        boost::asio::ip::tcp::resolver resolver(service);
+        boost::asio::ip::tcp::resolver::query query(remote_server,
+            boost::lexical_cast<std::string>(remote_port),
+            boost::asio::ip::tcp::resolver::query::numeric_service);
+        boost::asio::ip::tcp::resolver::iterator endpoint_iterator = resolver.resolve(query, result_ptr->m_ec);
+        boost::asio::ip::tcp::resolver::iterator end;
+        for ( ; endpoint_iterator != end; ++endpoint_iterator)
+            result_ptr->m_endpoints.push_back(endpoint_iterator->endpoint());
+        if (! result_ptr->m_ec)
+            result_ptr->m_ec = boost::asio::error::host_not_found;
+    }
+
+    /**
+     * tries to connect to the next endpoint found by a hostname lookup
+     *
+     * @param result_ptr the endpoints found
+     * @param handler called after a new connection has been established
+     *                (or once every endpoint has failed)
+     */
+    template <typename ConnectHandler>
+    inline void connect_next_endpoint(const resolved_endpoints_ptr& result_ptr,
+                                      ConnectHandler handler)
+    {
+        if (result_ptr->m_next >= result_ptr->m_endpoints.size()) {
+            handler(result_ptr->m_ec);
+            return;
+        }
+        async_connect(result_ptr->m_endpoints[result_ptr->m_next++],
+                      boost::bind(&connection::handle_endpoint_connect<ConnectHandler>,
+                                  shared_from_this(), result_ptr, handler,
+                                  boost::asio::placeholders::error));
+    }
+
+    /**
+     * handles the result of connecting to an endpoint found by a hostname
+     * lookup, and tries the next one if it failed
+     *
+     * @param result_ptr the endpoints found
+     * @param handler called after a new connection has been established
+     * @param ec the result of the connection attempt
+     */
+    template <typename ConnectHandler>
+    inline void handle_endpoint_connect(const resolved_endpoints_ptr& result_ptr,
+                                        ConnectHandler handler,
+                                        const boost::system::error_code& ec)
+    {
+        if (ec) {
+            close();
+            result_ptr->m_ec = ec;
+            connect_next_endpoint(result_ptr, handler);
+        } else {
+            handler(ec);
+        }
+    }
+
+    /**
+     * reads some data into the connection's read buffer using the uring_engine
+     *
+     * @param handler called after the read operation has completed
+     * @return true if the read was queued (the engine refuses reads while
+     *         too many operations are in flight)
+     */
+    inline bool uring_read_some(const uring_engine::read_handler_t& handler) {
+        m_read_buffer.prepare();
+        return uring_engine::get_instance().async_recv(m_socket.native_handle(),
+            m_read_buffer.data(), m_read_buffer.size(), get_io_service(),
+            boost::bind(&connection::finish_uring_read, shared_from_this(),
+                        handler, boost::asio::placeholders::error,
+                        boost::asio::placeholders::bytes_transferred));
+    }
+
+    /**
+     * handles the result of a read performed by the uring_engine
+     *
+     * @param handler called after the read operation has completed
+     * @param ec the result of the read
+     * @param bytes_read number of bytes read (0 once the peer has closed
+     *                   the connection, which asio reports as eof)
+     */
+    inline void finish_uring_read(const uring_engine::read_handler_t& handler,
+                                  const boost::system::error_code& ec,
+                                  std::size_t bytes_read)
+    {
+        if (ec == boost::asio::error::would_block) {
+            // the kernel did not wait for data, so leave that to asio
+            m_socket.async_read_some(boost::asio::buffer(m_read_buffer.data(), m_read_buffer.size()),
+                                     handler);
+        } else if (! ec && bytes_read == 0) {
+            const boost::system::error_code eof_ec(boost::asio::error::eof);
+            handler(eof_ec, bytes_read);
+        } else {
+            handler(ec, bytes_read);
+        }
+    }
+
+    /**
+     * copies the list of buffers to be written by the uring_engine
+     *
+     * @param buffers one or more buffers containing the data to be written
+     */
+    template <typename ConstBufferSequence>
+    static inline uring_buffers_ptr copy_buffers(const ConstBufferSequence& buffers) {
+        uring_buffers_ptr buffers_ptr(new uring_buffers_type);
+#if BOOST_VERSION >= 106600
+        buffers_ptr->assign(boost::asio::buffer_sequence_begin(buffers),
+                            boost::asio::buffer_sequence_end(buffers));
+#else
+        buffers_ptr->assign(buffers.begin(), buffers.end());
+#endif
+        return buffers_ptr;
+    }
+
+    /**
+     * removes data that has been written from a list of buffers
+     *
+     * @param buffers the data that remains to be written
+     * @param bytes number of bytes written
+     */
+    static inline void consume_buffers(uring_buffers_type& buffers, std::size_t bytes) {
+        uring_buffers_type::iterator it = buffers.begin();
+        while (it != buffers.end() && boost::asio::buffer_size(*it) <= bytes) {
+            bytes -= boost::asio::buffer_size(*it);
+            ++it;
+        }
+        if (it != buffers.end())
+            *it = *it + bytes;
+        buffers.erase(buffers.begin(), it);
+    }
+
+    /**
+     * writes data to the connection using the uring_engine
+     *
+     * @param buffers_ptr the data that remains to be written
+     * @param bytes_written number of bytes written so far
+     * @param handler called after all of the data has been written
+     * @return true if the write was queued (the engine refuses writes while
+     *         too many operations are in flight)
+     */
+    inline bool uring_write(const uring_buffers_ptr& buffers_ptr,
+                            std::size_t bytes_written,
+                            const uring_engine::write_handler_t& handler)
+    {
+        return uring_engine::get_instance().async_send(m_socket.native_handle(),
+            *buffers_ptr, get_io_service(),
+            boost::bind(&connection::finish_uring_write, shared_from_this(),
+                        buffers_ptr, bytes_written, handler,
+                        boost::asio::placeholders::error,
+                        boost::asio::placeholders::bytes_transferred));
+    }
+
+    /**
+     * handles the result of a write performed by the uring_engine, which
+     * may have sent only part of the data; the rest is written by the
+     * engine or, if it refuses the write, by asio
+     *
+     * @param buffers_ptr the data that remained to be written
+     * @param bytes_written number of bytes written before this write
+     * @param handler called after all of the data has been written
+     * @param ec the result of the write
+     * @param bytes number of bytes sent by this write
+     */
+    inline void finish_uring_write(const uring_buffers_ptr& buffers_ptr,
+                                   std::size_t bytes_written,
+                                   const uring_engine::write_handler_t& handler,
+                                   const boost::system::error_code& ec,
+                                   std::size_t bytes)
+    {
+        bytes_written += bytes;
+        if (ec && ec != boost::asio::error::would_block) {
+            handler(ec, bytes_written);
+            return;
+        }
+        consume_buffers(*buffers_ptr, bytes);
+        if (buffers_ptr->empty()) {
+            const boost::system::error_code success_ec;
+            handler(success_ec, bytes_written);
+        } else if (bytes == 0 || ! uring_write(buffers_ptr, bytes_written, handler)) {
+            boost::asio::async_write(m_socket, *buffers_ptr,
+                                     boost::bind(&connection::finish_asio_write,
+                                                 bytes_written, handler,
+                                                 boost::asio::placeholders::error,
+                                                 boost::asio::placeholders::bytes_transferred));
+        }
+    }
+
+    /**
+     * handles the result of writing the rest of the data using asio, after
+     * the uring_engine has written the first part of it
+     *
+     * @param bytes_written number of bytes written by the uring_engine
+     * @param handler called after all of the data has been written
+     * @param ec the result of the write
+     * @param bytes number of bytes written by asio
+     */
+    static inline void finish_asio_write(std::size_t bytes_written,
+                                         const uring_engine::write_handler_t& handler,
+                                         const boost::system::error_code& ec,
+                                         std::size_t bytes)
+    {
+        handler(ec, bytes_written + bytes);
+    }
+
+    ///
+    /// deadline_entry: cancels the connection's operations when its deadline expires
+    ///
+    class deadline_entry :
+        public timer_wheel::entry
+    {
+    public:
+        explicit deadline_entry(connection& conn) : m_conn(conn) {}
+        virtual ~deadline_entry() {}
+        virtual void expired(void) { m_conn.cancel(); }
+    private:
+        connection &    m_conn;
+    };
+
     
-    /// context object for the SSL connection socket
-    ssl_context_type        m_ssl_context;
+    /// connection socket (TCP or Unix domain)
+    socket_type                         m_socket;
 
-    /// SSL connection socket
-    ssl_socket_type         m_ssl_socket;
+#ifdef PION_HAVE_SSL
+    /// context used for the SSL layer (usually shared with the server)
+    ssl_context_type *                  m_ssl_context;
+
+    /// context owned by this connection, if no shared context was provided
+    boost::scoped_ptr<ssl_context_type> m_ssl_context_ptr;
+#endif
+
+    /// SSL layer over m_socket (only created for connections that use SSL)
+    boost::scoped_ptr<ssl_socket_type>  m_ssl_socket_ptr;
 
     /// true if the connection is encrypted using SSL
     bool                    m_ssl_flag;
 
-    /// buffer used for reading data from the TCP connection
+    /// buffer used for reading data from the TCP connection (borrowed while in use)
     read_buffer_type        m_read_buffer;
     
     /// saved read position bookmark
@@ -729,6 +1353,15 @@ private:
     /// lifecycle state for the connection
     lifecycle_type          m_lifecycle;
 
+    /// position of the connection in its server's registry
+    std::size_t             m_registry_index;
+
+    /// tracks the connection's deadline (set the first time that it is needed)
+    timer_wheel *           m_timer_wheel;
+
+    /// the connection's deadline
+    deadline_entry          m_deadline;
+
     /// function called when a server has finished handling the connection
     connection_handler      m_finished_handler;
 };
@@ -0,0 +1,193 @@
+// ---------------------------------------------------------------------
+// pion:  a Boost C++ framework for building lightweight HTTP interfaces
+// ---------------------------------------------------------------------
+// Copyright (C) 2007-2014 Splunk Inc.  (https://github.com/splunk/pion)
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See http://www.boost.org/LICENSE_1_0.txt
+//
+
+#ifndef __PION_TCP_CONNECTION_CACHE_HEADER__
+#define __PION_TCP_CONNECTION_CACHE_HEADER__
+
+#include <vector>
+#include <cstddef>
+#include <boost/asio.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/weak_ptr.hpp>
+#include <boost/enable_shared_from_this.hpp>
+#include <boost/thread/mutex.hpp>
+#include <pion/config.hpp>
+#include <pion/tcp/connection.hpp>
+
+
+namespace pion {    // begin namespace pion
+namespace tcp {     // begin namespace tcp
+
+
+///
+/// connection_cache: keeps a free list of connection objects (including their
+/// read buffers) for one I/O service, so that a server can reuse them for
+/// new connections instead of allocating new ones each time
+///
+class PION_API connection_cache :
+    public boost::enable_shared_from_this<connection_cache>,
+    private boost::noncopyable
+{
+public:
+
+    /// default maximum number of unused connection objects kept by a cache
+    enum { DEFAULT_MAX_SIZE = 256 };
+
+
+    /**
+     * creates a new connection_cache object
+     *
+     * @param io_service asio service used by all of the cache's connections
+     * @param ssl_context asio ssl context used by all of the cache's connections
+     * @param finished_handler function called when a server has finished
+     *                         handling a connection
+     * @param max_size maximum number of unused connection objects to keep
+     */
+    connection_cache(boost::asio::io_service& io_service,
+                     connection::ssl_context_type& ssl_context,
+                     connection::connection_handler finished_handler,
+                     std::size_t max_size = DEFAULT_MAX_SIZE);
+
+    /// virtual destructor frees all of the unused connection objects
+    virtual ~connection_cache();
+
+    /**
+     * returns a connection object that is ready to accept a new connection.
+     * The object goes back into the cache once the last reference to it has
+     * been released.
+     *
+     * @param ssl_flag if true then the connection will be encrypted using SSL
+     */
+    connection_ptr acquire(const bool ssl_flag);
+
+    /// frees all of the unused connection objects
+    void clear(void);
+
+    /// returns the asio service used by the cache's connections
+    inline boost::asio::io_service& get_io_service(void) { return m_io_service; }
+
+    /// returns the maximum number of unused connection objects to keep
+    std::size_t get_max_size(void) const;
+
+    /// sets the maximum number of unused connection objects to keep (0 disables reuse)
+    void set_max_size(std::size_t n);
+
+    /// returns the number of unused connection objects currently cached
+    std::size_t get_size(void) const;
+
+    /// returns the number of connection objects handed out by acquire()
+    boost::uint64_t get_acquisitions(void) const;
+
+    /// returns the number of heap allocations made for connection objects
+    /// and their shared pointer control blocks
+    boost::uint64_t get_allocations(void) const;
+
+
+private:
+
+    /// returns connection objects to their cache when the last reference is released
+    struct recycler {
+        explicit recycler(const boost::weak_ptr<connection_cache>& cache_ptr)
+            : m_cache_ptr(cache_ptr) {}
+        void operator()(connection *conn_ptr) const;
+        boost::weak_ptr<connection_cache>   m_cache_ptr;
+    };
+
+    /// allocator that reuses the memory of shared pointer control blocks
+    template <typename T>
+    struct block_allocator {
+        typedef T               value_type;
+        typedef T *             pointer;
+        typedef const T *       const_pointer;
+        typedef T &             reference;
+        typedef const T &       const_reference;
+        typedef std::size_t     size_type;
+        typedef std::ptrdiff_t  difference_type;
+        template <typename U> struct rebind { typedef block_allocator<U> other; };
+
+        explicit block_allocator(const boost::weak_ptr<connection_cache>& cache_ptr)
+            : m_cache_ptr(cache_ptr) {}
+        template <typename U> block_allocator(const block_allocator<U>& a)
+            : m_cache_ptr(a.m_cache_ptr) {}
+
+        inline pointer allocate(size_type n, const void * = 0) {
+            return static_cast<pointer>(allocate_block(m_cache_ptr, n * sizeof(T)));
+        }
+        inline void deallocate(pointer p, size_type n) {
+            deallocate_block(m_cache_ptr, p, n * sizeof(T));
+        }
+        inline void construct(pointer p, const T& t) { new (static_cast<void*>(p)) T(t); }
+        inline void destroy(pointer p) { p->~T(); }
+        inline size_type max_size(void) const { return static_cast<size_type>(-1) / sizeof(T); }
+        template <typename U> inline bool operator==(const block_allocator<U>&) const { return true; }
+        template <typename U> inline bool operator!=(const block_allocator<U>&) const { return false; }
+
+        boost::weak_ptr<connection_cache>   m_cache_ptr;
+    };
+
+    /// data type for a list of unused connection objects
+    typedef std::vector<connection*>    connection_list_type;
+
+    /// data type for a list of unused memory blocks
+    typedef std::vector<void*>          block_list_type;
+
+
+    /// puts a connection object back into the cache (or frees it if the cache is full)
+    void release(connection *conn_ptr);
+
+    /// allocates a memory block, reusing one from the cache if possible
+    static void *allocate_block(const boost::weak_ptr<connection_cache>& cache_ptr,
+                                std::size_t block_size);
+
+    /// puts a memory block back into the cache (or frees it if the cache is full)
+    static void deallocate_block(const boost::weak_ptr<connection_cache>& cache_ptr,
+                                 void *block_ptr, std::size_t block_size);
+
+
+    /// asio service used by the cache's connections
+    boost::asio::io_service &           m_io_service;
+
+    /// asio ssl context used by the cache's connections
+    connection::ssl_context_type &      m_ssl_context;
+
+    /// function called when a server has finished handling a connection
+    connection::connection_handler      m_finished_handler;
+
+    /// unused connection objects that are ready to be reused
+    connection_list_type                m_connections;
+
+    /// unused shared pointer control blocks that are ready to be reused
+    block_list_type                     m_blocks;
+
+    /// size of the memory blocks in m_blocks (0 until the first block is allocated)
+    std::size_t                         m_block_size;
+
+    /// maximum number of unused connection objects (and blocks) to keep
+    std::size_t                         m_max_size;
+
+    /// number of connection objects handed out by acquire()
+    boost::uint64_t                     m_acquisitions;
+
+    /// number of heap allocations made for connection objects and control blocks
+    boost::uint64_t                     m_allocations;
+
+    /// mutex to make class thread-safe
+    mutable boost::mutex                m_mutex;
+};
+
+
+/// data type for a connection_cache pointer
+typedef boost::shared_ptr<connection_cache>     connection_cache_ptr;
+
+
+}   // end namespace tcp
+}   // end namespace pion
+
+#endif
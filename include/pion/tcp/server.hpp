@@ -10,7 +10,8 @@
 #ifndef __PION_TCP_SERVER_HEADER__
 #define __PION_TCP_SERVER_HEADER__
 
-#include <set>
+#include <string>
+#include <vector>
 #include <boost/asio.hpp>
 #include <boost/noncopyable.hpp>
 #include <boost/shared_ptr.hpp>
@@ -20,6 +21,7 @@
 #include <pion/logger.hpp>
 #include <pion/scheduler.hpp>
 #include <pion/tcp/connection.hpp>
+#include <pion/tcp/connection_cache.hpp>
 
 
 namespace pion {    // begin namespace pion
@@ -34,6 +36,10 @@ class PION_API server :
 {
 public:
 
+    /// default maximum size that connection read buffers may grow to
+    enum { DEFAULT_MAX_READ_BUFFER_SIZE = 65536 };
+
+
     /// default destructor
     virtual ~server() { if (m_is_listening) stop(false); }
     
@@ -78,6 +84,23 @@ public:
     /// sets tcp endpoint that the server listens for connections on
     inline void set_endpoint(const boost::asio::ip::tcp::endpoint& ep) { m_endpoint = ep; }
 
+    /// returns the path of the Unix domain socket that the server listens
+    /// for connections on (empty if it listens on its TCP endpoint)
+    inline const std::string& get_local_path(void) const { return m_local_path; }
+    
+    /**
+     * sets the path of a Unix domain (AF_UNIX) stream socket that the server
+     * listens for connections on, instead of its TCP endpoint.  The socket
+     * file is created by start() and removed by stop().  This must be set
+     * before start() is called, and is not supported on all platforms.
+     *
+     * @param path filesystem path of the socket (empty to use the TCP endpoint)
+     */
+    inline void set_local_path(const std::string& path) { m_local_path = path; }
+    
+    /// returns true if the server listens on a Unix domain socket
+    inline bool is_local(void) const { return ! m_local_path.empty(); }
+
     /// returns true if the server uses SSL to encrypt connections
     inline bool get_ssl_flag(void) const { return m_ssl_flag; }
     
@@ -90,6 +113,159 @@ public:
     /// returns true if the server is listening for connections
     inline bool is_listening(void) const { return m_is_listening; }
     
+    /// returns true if the server opens one SO_REUSEPORT acceptor per I/O service
+    inline bool get_reuse_port(void) const { return m_reuse_port; }
+    
+    /**
+     * enables or disables reuse port mode.  When enabled, start() opens one
+     * acceptor with SO_REUSEPORT for each of the scheduler's I/O services,
+     * so that the kernel load-balances new connections across them and each
+     * connection is accepted and handled by the service that owns it.
+     * Acceptors are opened and closed as the scheduler adds and retires
+     * services.  This must be set before start() is called, and falls back
+     * to a single acceptor on platforms that do not support SO_REUSEPORT.
+     *
+     * @param b true to enable reuse port mode
+     */
+    inline void set_reuse_port(bool b = true) { m_reuse_port = b; }
+    
+    /// returns the initial size of each connection's read buffer
+    inline std::size_t get_read_buffer_size(void) const { return m_read_buffer_size; }
+    
+    /// returns the largest size that each connection's read buffer may grow to
+    inline std::size_t get_max_read_buffer_size(void) const { return m_max_read_buffer_size; }
+    
+    /**
+     * sets the size of the read buffer used by new connections.  A buffer
+     * doubles in size while reads keep filling it (such as for bulk uploads),
+     * up to max_size, and shrinks back when reads become small again or the
+     * connection goes idle.  Sizes are rounded up to a power of two between
+     * 1 KB and 1 MB.
+     *
+     * @param size initial size of each connection's read buffer in bytes
+     * @param max_size largest size that a read buffer may grow to (use the
+     *                 same value as size to disable growth)
+     */
+    inline void set_read_buffer_size(std::size_t size,
+                                     std::size_t max_size = DEFAULT_MAX_READ_BUFFER_SIZE)
+    {
+        m_read_buffer_size = buffer_pool::get_block_size(size);
+        m_max_read_buffer_size = buffer_pool::get_block_size(max_size);
+        if (m_max_read_buffer_size < m_read_buffer_size)
+            m_max_read_buffer_size = m_read_buffer_size;
+    }
+    
+    /// returns the maximum length of the queue of connections waiting to be accepted
+    inline int get_listen_backlog(void) const { return m_listen_backlog; }
+
+    /// sets the maximum length of the queue of connections waiting to be
+    /// accepted (must be set before start() is called)
+    inline void set_listen_backlog(int n) { m_listen_backlog = n; }
+
+    /// returns true if TCP_NODELAY is set for new connections
+    inline bool get_no_delay(void) const { return m_no_delay; }
+
+    /// if true, new connections disable Nagle's algorithm (TCP_NODELAY)
+    inline void set_no_delay(bool b = true) { m_no_delay = b; }
+
+    /// returns the number of seconds that accepting waits for data (0 if disabled)
+    inline int get_defer_accept(void) const { return m_defer_accept; }
+
+    /**
+     * sets TCP_DEFER_ACCEPT, so that a connection is not accepted until its
+     * first data arrives or a number of seconds have passed.  This must be
+     * set before start() is called, and is ignored on platforms that do not
+     * support it.
+     *
+     * @param seconds maximum number of seconds to wait for data (0 to disable)
+     */
+    inline void set_defer_accept(int seconds) { m_defer_accept = seconds; }
+
+    /// returns the maximum number of pending TCP Fast Open requests (0 if disabled)
+    inline int get_fast_open(void) const { return m_fast_open; }
+
+    /**
+     * enables TCP_FASTOPEN, so that clients may send data with their SYN.
+     * This must be set before start() is called, and is ignored on platforms
+     * that do not support it.
+     *
+     * @param queue_length maximum number of pending Fast Open requests (0 to disable)
+     */
+    inline void set_fast_open(int queue_length) { m_fast_open = queue_length; }
+
+    /// returns the size of the kernel receive buffer for connections (0 for the system default)
+    inline int get_receive_buffer_size(void) const { return m_receive_buffer_size; }
+
+    /// sets the size of the kernel receive buffer for connections (SO_RCVBUF);
+    /// 0 uses the system default.  Must be set before start() is called.
+    inline void set_receive_buffer_size(int n) { m_receive_buffer_size = n; }
+
+    /// returns the size of the kernel send buffer for connections (0 for the system default)
+    inline int get_send_buffer_size(void) const { return m_send_buffer_size; }
+
+    /// sets the size of the kernel send buffer for connections (SO_SNDBUF);
+    /// 0 uses the system default.  Must be set before start() is called.
+    inline void set_send_buffer_size(int n) { m_send_buffer_size = n; }
+
+    /// returns the maximum number of connections accepted for each wakeup
+    inline unsigned int get_accept_batch_size(void) const { return m_accept_batch_size; }
+
+    /**
+     * sets the maximum number of connections accepted for each wakeup.  When
+     * larger than 1, each completed accept also takes connections that are
+     * already waiting in the listen queue, without another trip through the
+     * I/O service.  This must be set before start() is called.
+     *
+     * @param n maximum number of connections to accept at a time (at least 1)
+     */
+    inline void set_accept_batch_size(unsigned int n) { m_accept_batch_size = (n > 0 ? n : 1); }
+
+    /// returns the SO_BUSY_POLL time set for connections in microseconds (0 if disabled)
+    inline int get_busy_poll(void) const { return m_busy_poll; }
+
+    /**
+     * sets SO_BUSY_POLL for new connections, so that blocking reads poll the
+     * network device's receive queue for a number of microseconds before
+     * sleeping.  It pairs with the scheduler's busy polling mode.  This must
+     * be set before start() is called, is ignored on platforms that do not
+     * support it, and may need CAP_NET_ADMIN to exceed net.core.busy_read.
+     *
+     * @param usec microseconds to busy poll for (0 to disable)
+     */
+    inline void set_busy_poll(int usec) { m_busy_poll = usec; }
+
+    /**
+     * sets a configuration option by name (used by piond).  Recognized
+     * options are backlog, no_delay, defer_accept, fast_open,
+     * receive_buffer_size, send_buffer_size, accept_batch_size, busy_poll,
+     * reuse_port, read_buffer_size, max_read_buffer_size,
+     * max_cached_connections and local_path.
+     *
+     * @param name the name of the option to change
+     * @param value the value of the option
+     */
+    void set_option(const std::string& name, const std::string& value);
+
+    /// returns the maximum number of unused connection objects kept for each I/O service
+    std::size_t get_max_cached_connections(void) const;
+
+    /**
+     * sets the maximum number of unused connection objects that are kept for
+     * each I/O service and reused for new connections, instead of allocating
+     * new ones every time a connection is accepted
+     *
+     * @param n maximum number of unused connection objects (0 disables reuse)
+     */
+    void set_max_cached_connections(std::size_t n);
+
+    /// returns the number of connection objects used to accept connections
+    boost::uint64_t get_total_connections(void) const;
+
+    /// returns the number of heap allocations made for connection objects
+    /// (divide by get_total_connections() to get the number of allocations
+    /// per connection)
+    boost::uint64_t get_connection_allocations(void) const;
+    
     /// sets the logger to be used
     inline void set_logger(logger log_ptr) { m_logger = log_ptr; }
     
@@ -97,9 +273,11 @@ public:
     inline logger get_logger(void) { return m_logger; }
     
     /// returns mutable reference to the TCP connection acceptor
+    /// (this is not used if reuse port mode is enabled)
     inline boost::asio::ip::tcp::acceptor& get_acceptor(void) { return m_tcp_acceptor; }
 
     /// returns const reference to the TCP connection acceptor
+    /// (this is not used if reuse port mode is enabled)
     inline const boost::asio::ip::tcp::acceptor& get_acceptor(void) const { return m_tcp_acceptor; }
 
     
@@ -154,6 +332,9 @@ protected:
     
     /// returns an async I/O service used to schedule work
     inline boost::asio::io_service& get_io_service(void) { return m_active_scheduler.get_io_service(); }
+
+    /// returns the scheduler used to manage worker threads
+    inline scheduler& get_active_scheduler(void) { return m_active_scheduler; }
     
     
     /// primary logging interface used by this class
@@ -162,20 +343,185 @@ protected:
     
 private:
         
+    /// number of seconds between sweeps for orphaned connections
+    enum { ORPHAN_SWEEP_INTERVAL = 5 };
+
+
+    ///
+    /// service_shard: registry of the connections that use one of the
+    /// scheduler's I/O services, along with a cache of unused connection objects
+    ///
+    struct service_shard :
+        private boost::noncopyable
+    {
+        /// constructs a new service_shard for an I/O service
+        service_shard(boost::asio::io_service& service, scheduler::load_counter_type *load_ptr)
+            : m_service(service), m_load_ptr(load_ptr), m_num_accepting(0)
+        {}
+
+        /// adds a connection to the registry (once it has been accepted)
+        void add(const tcp::connection_ptr& tcp_conn);
+
+        /// records that a connection object is waiting for an accept to complete
+        void begin_accept(void);
+
+        /// records that an accept has completed (or failed)
+        void end_accept(void);
+
+        /// removes a connection from the registry (returns false if not found)
+        bool remove(const tcp::connection_ptr& tcp_conn);
+
+        /// closes all of the connections in the registry
+        void close_all(void);
+
+        /**
+         * removes connections that are no longer referenced outside of the registry
+         *
+         * @param orphans the connections removed are appended to this list
+         * @return std::size_t number of connections remaining in the registry,
+         *                     plus the number of accepts still pending
+         */
+        std::size_t prune(std::vector<tcp::connection_ptr>& orphans);
+
+        /// returns the number of connections in the registry (pending
+        /// accepts are not included)
+        std::size_t size(void) const;
+
+        /// I/O service used by all of the shard's connections
+        boost::asio::io_service &           m_service;
+
+        /// the scheduler's count of active connections for the I/O service (may be null)
+        scheduler::load_counter_type *      m_load_ptr;
+
+        /// cache of unused connection objects for the I/O service
+        connection_cache_ptr                m_cache_ptr;
+
+        /// connections in the registry (each knows its index in the vector)
+        std::vector<tcp::connection_ptr>    m_connections;
+
+        /// number of accepts that are pending (these do not count towards
+        /// the service's load, so that a service with only an acceptor may
+        /// be retired)
+        std::size_t                         m_num_accepting;
+
+        /// mutex used to protect the registry
+        mutable boost::mutex                m_mutex;
+    };
+
+    /// data type for a pointer to a service_shard
+    typedef boost::shared_ptr<service_shard>        service_shard_ptr;
+
+    /// data type for a collection of service_shard objects
+    typedef std::vector<service_shard_ptr>          shard_pool_type;
+
+
+    ///
+    /// service_acceptor: a TCP acceptor bound to one of the scheduler's I/O
+    /// services (used when reuse port mode is enabled)
+    ///
+    struct service_acceptor :
+        private boost::noncopyable
+    {
+        /// constructs a new service_acceptor for an I/O service
+        explicit service_acceptor(const service_shard_ptr& shard_ptr)
+            : m_shard_ptr(shard_ptr), m_acceptor(shard_ptr->m_service)
+        {}
+
+        /// shard for the I/O service used by the acceptor and by all connections it accepts
+        service_shard_ptr                   m_shard_ptr;
+
+        /// manages async TCP connections for the I/O service
+        boost::asio::ip::tcp::acceptor      m_acceptor;
+    };
+
+    /// data type for a pointer to a service_acceptor
+    typedef boost::shared_ptr<service_acceptor>     service_acceptor_ptr;
+
+    /// data type for a collection of service_acceptor objects
+    typedef std::vector<service_acceptor_ptr>       acceptor_pool_type;
+
+
     /// handles a request to stop the server
     void handle_stop_request(void);
     
-    /// listens for a new connection
-    void listen(void);
+    /**
+     * opens, binds and starts listening using a TCP acceptor
+     *
+     * @param tcp_acceptor the acceptor to open
+     * @param reuse_port if true, the acceptor's socket is configured with SO_REUSEPORT
+     */
+    void open_acceptor(boost::asio::ip::tcp::acceptor& tcp_acceptor, bool reuse_port);
+    
+    /// opens, binds and starts listening using the Unix domain socket acceptor
+    void open_local_acceptor(void);
+    
+    /// removes the Unix domain socket file (if it exists)
+    void remove_local_socket(void);
+    
+    /**
+     * listens for a new connection
+     *
+     * @param acceptor_ptr acceptor to use (if null, the default acceptor is used)
+     */
+    void listen(const service_acceptor_ptr& acceptor_ptr);
 
     /**
      * handles new connections (checks if there was an accept error)
      *
      * @param tcp_conn the new TCP connection (if no error occurred)
+     * @param acceptor_ptr acceptor that accepted the connection (null for the default acceptor)
+     * @param shard_ptr shard that the connection is added to once it is accepted
      * @param accept_error true if an error occurred while accepting connections
      */
     void handle_accept(const tcp::connection_ptr& tcp_conn,
-                      const boost::system::error_code& accept_error);
+                       const service_acceptor_ptr& acceptor_ptr,
+                       const service_shard_ptr& shard_ptr,
+                       const boost::system::error_code& accept_error);
+
+    /**
+     * finishes a pending accept that failed (the connection object that was
+     * not accepted is returned to the cache once it is released)
+     *
+     * @param shard_ptr shard that the connection would have been added to
+     */
+    void finish_accept(const service_shard_ptr& shard_ptr);
+
+    /// opens acceptors for services that the scheduler has added, and closes
+    /// those of services that it has retired (used in reuse port mode)
+    void handle_resize(void);
+
+    /// closes an acceptor; this is run by the acceptor's own I/O service so
+    /// that it does not race with the acceptor's pending accept
+    static void close_acceptor(const service_acceptor_ptr& acceptor_ptr);
+
+    /**
+     * accepts connections that are already waiting, up to the batch size,
+     * using non-blocking accepts; assumes that no other accept operation is
+     * pending for the acceptor
+     *
+     * @param acceptor_ptr acceptor to use (null for the default acceptor)
+     * @param new_connections the connections that were accepted
+     */
+    void accept_pending(const service_acceptor_ptr& acceptor_ptr,
+                        std::vector<tcp::connection_ptr>& new_connections);
+
+    /**
+     * accepts connections that are already waiting using an acceptor
+     *
+     * @param acceptor the TCP or Unix domain socket acceptor to use
+     * @param shard_ptr shard for the I/O service used by the acceptor
+     * @param new_connections the connections that were accepted
+     */
+    template <typename AcceptorType>
+    void accept_pending(AcceptorType& acceptor, const service_shard_ptr& shard_ptr,
+                        std::vector<tcp::connection_ptr>& new_connections);
+
+    /**
+     * starts handling a connection that has just been accepted
+     *
+     * @param tcp_conn the new TCP connection
+     */
+    void start_connection(const tcp::connection_ptr& tcp_conn);
 
     /**
      * handles new connections following an SSL handshake (checks for errors)
@@ -190,15 +536,30 @@ private:
     /// finished handling a connection.  If the keep_alive flag is true,
     /// it will call handle_connection(); otherwise, it will close the
     /// connection and remove it from the server's management pool
-    void finish_connection(const tcp::connection_ptr& tcp_conn);
+    void finish_connection(service_shard *shard_ptr, const tcp::connection_ptr& tcp_conn);
+    
+    /**
+     * returns the shard for an I/O service (creates it if necessary);
+     * assumes that a server lock has already been acquired
+     *
+     * @param service the I/O service used by the connections
+     */
+    const service_shard_ptr& get_service_shard(boost::asio::io_service& service);
     
-    /// prunes orphaned connections that did not close cleanly
-    /// and returns the remaining number of connections in the pool
-    std::size_t prune_connections(void);
+    /**
+     * prunes orphaned connections that did not close cleanly
+     *
+     * @param shards the shards to prune
+     * @return std::size_t the remaining number of connections in the shards
+     */
+    std::size_t prune_connections(const shard_pool_type& shards);
     
+    /// schedules the next sweep for orphaned connections; assumes that a
+    /// server lock has already been acquired
+    void schedule_sweep(void);
     
-    /// data type for a pool of TCP connections
-    typedef std::set<tcp::connection_ptr>   ConnectionPool;
+    /// periodically prunes orphaned connections while the server is listening
+    void handle_sweep(const boost::system::error_code& ec);
     
     
     /// the default scheduler object used to manage worker threads
@@ -207,9 +568,18 @@ private:
     /// reference to the active scheduler object used to manage worker threads
     scheduler &                             m_active_scheduler;
     
-    /// manages async TCP connections
+    /// manages async TCP connections (the acceptors and the sweep timer use
+    /// the scheduler's first service, which is never retired by resizing)
     boost::asio::ip::tcp::acceptor          m_tcp_acceptor;
 
+#ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+    /// manages async Unix domain socket connections (only used if m_local_path is set)
+    boost::asio::local::stream_protocol::acceptor   m_local_acceptor;
+#endif
+
+    /// one acceptor per I/O service (only used in reuse port mode)
+    acceptor_pool_type                      m_acceptor_pool;
+
     /// context used for SSL configuration
     connection::ssl_context_type            m_ssl_context;
         
@@ -219,18 +589,60 @@ private:
     /// condition triggered when the connection pool is empty
     boost::condition                        m_no_more_connections;
 
-    /// pool of active connections associated with this server 
-    ConnectionPool                          m_conn_pool;
+    /// registries of active connections associated with this server (one per I/O service)
+    shard_pool_type                         m_shard_pool;
+
+    /// timer used to sweep for orphaned connections
+    boost::asio::deadline_timer             m_sweep_timer;
+
+    /// maximum number of unused connection objects kept for each I/O service
+    std::size_t                             m_max_cached_connections;
 
     /// tcp endpoint used to listen for new connections
     boost::asio::ip::tcp::endpoint          m_endpoint;
 
+    /// path of the Unix domain socket used to listen for new connections (if not empty)
+    std::string                             m_local_path;
+
     /// true if the server uses SSL to encrypt connections
     bool                                    m_ssl_flag;
 
     /// set to true when the server is listening for new connections
     bool                                    m_is_listening;
 
+    /// true if the server opens one SO_REUSEPORT acceptor per I/O service
+    bool                                    m_reuse_port;
+
+    /// initial size of each connection's read buffer
+    std::size_t                             m_read_buffer_size;
+
+    /// largest size that each connection's read buffer may grow to
+    std::size_t                             m_max_read_buffer_size;
+
+    /// maximum length of the queue of connections waiting to be accepted
+    int                                     m_listen_backlog;
+
+    /// true if new connections disable Nagle's algorithm (TCP_NODELAY)
+    bool                                    m_no_delay;
+
+    /// number of seconds that accepting waits for data (TCP_DEFER_ACCEPT; 0 if disabled)
+    int                                     m_defer_accept;
+
+    /// maximum number of pending TCP Fast Open requests (0 if disabled)
+    int                                     m_fast_open;
+
+    /// size of the kernel receive buffer for connections (0 for the system default)
+    int                                     m_receive_buffer_size;
+
+    /// size of the kernel send buffer for connections (0 for the system default)
+    int                                     m_send_buffer_size;
+
+    /// maximum number of connections accepted for each wakeup
+    unsigned int                            m_accept_batch_size;
+
+    /// microseconds that connections busy poll for with SO_BUSY_POLL (0 if disabled)
+    int                                     m_busy_poll;
+
     /// mutex to make class thread-safe
     mutable boost::mutex                    m_mutex;
 };
@@ -54,7 +54,8 @@ public:
      * @param conn_ptr pointer to the TCP connection to use for reading & writing
      */
     explicit stream_buffer(const tcp::connection_ptr& conn_ptr)
-        : m_conn_ptr(conn_ptr), m_bytes_transferred(0), m_read_buf(m_conn_ptr->get_read_buffer().c_array())
+        : m_conn_ptr(conn_ptr), m_bytes_transferred(0), m_read_buf(m_conn_ptr->get_read_buffer().c_array()),
+        m_read_buf_size(m_conn_ptr->get_read_buffer().size())
     {
         setup_buffers();
     }
@@ -68,7 +69,8 @@ public:
     explicit stream_buffer(boost::asio::io_service& io_service,
                              const bool ssl_flag = false)
         : m_conn_ptr(new connection(io_service, ssl_flag)),
-        m_read_buf(m_conn_ptr->get_read_buffer().c_array())
+        m_read_buf(m_conn_ptr->get_read_buffer().c_array()),
+        m_read_buf_size(m_conn_ptr->get_read_buffer().size())
     {
         setup_buffers();
     }
@@ -82,7 +84,8 @@ public:
     stream_buffer(boost::asio::io_service& io_service,
                     connection::ssl_context_type& ssl_context)
         : m_conn_ptr(new connection(io_service, ssl_context)),
-        m_read_buf(m_conn_ptr->get_read_buffer().c_array())
+        m_read_buf(m_conn_ptr->get_read_buffer().c_array()),
+        m_read_buf_size(m_conn_ptr->get_read_buffer().size())
     {
         setup_buffers();
     }
@@ -156,7 +159,7 @@ protected:
         boost::mutex::scoped_lock async_lock(m_async_mutex);
         m_bytes_transferred = 0;
         m_conn_ptr->async_read_some(boost::asio::buffer(m_read_buf+PUT_BACK_MAX,
-                                                        connection::READ_BUFFER_SIZE-PUT_BACK_MAX),
+                                                        m_read_buf_size-PUT_BACK_MAX),
                                     boost::bind(&stream_buffer::operation_finished, this,
                                                 boost::asio::placeholders::error,
                                                 boost::asio::placeholders::bytes_transferred));
@@ -311,6 +314,9 @@ private:
     
     /// pointer to the start of the TCP connection's read buffer
     char_type *                 m_read_buf;
+
+    /// size of the TCP connection's read buffer
+    std::size_t                 m_read_buf_size;
              
     /// buffer used to write output
     char_type                   m_write_buf[WRITE_BUFFER_SIZE];
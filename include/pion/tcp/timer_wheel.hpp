@@ -0,0 +1,176 @@
+// ---------------------------------------------------------------------
+// pion:  a Boost C++ framework for building lightweight HTTP interfaces
+// ---------------------------------------------------------------------
+// Copyright (C) 2007-2014 Splunk Inc.  (https://github.com/splunk/pion)
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See http://www.boost.org/LICENSE_1_0.txt
+//
+
+#ifndef __PION_TCP_TIMER_WHEEL_HEADER__
+#define __PION_TCP_TIMER_WHEEL_HEADER__
+
+#include <boost/asio.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/date_time/posix_time/posix_time_types.hpp>
+#include <pion/config.hpp>
+
+
+namespace pion {    // begin namespace pion
+namespace tcp {     // begin namespace tcp
+
+
+///
+/// timer_wheel: hierarchical timing wheel that tracks the deadlines of all
+/// of the connections that use an I/O service, using a single deadline
+/// timer.  Entries are embedded in their owners, so arming and disarming a
+/// deadline takes constant time and does not allocate memory.
+///
+/// There is one timer_wheel per I/O service; use
+/// boost::asio::use_service<pion::tcp::timer_wheel>(io_service) to get it.
+///
+class PION_API timer_wheel :
+    public boost::asio::io_service::service
+{
+public:
+
+    /// number of slots in each level of the wheel (as a power of two)
+    enum { WHEEL_BITS = 6, WHEEL_SIZE = (1 << WHEEL_BITS), WHEEL_MASK = WHEEL_SIZE - 1 };
+
+    /// number of levels in the wheel (one second ticks cover about 194 days)
+    enum { WHEEL_LEVELS = 4 };
+
+
+    ///
+    /// entry: a deadline that can be tracked by a timer_wheel
+    ///
+    class entry :
+        private boost::noncopyable
+    {
+    public:
+
+        /// default constructor
+        entry(void) : m_prev(NULL), m_next(NULL), m_slot(NULL), m_expires(0) {}
+
+        /// virtual destructor
+        virtual ~entry() {}
+
+        /// returns true if the entry is currently armed
+        inline bool is_armed(void) const { return m_next != NULL; }
+
+        /// called when the deadline expires (while the wheel's lock is held,
+        /// so this must not arm or disarm any entries)
+        virtual void expired(void) = 0;
+
+    private:
+
+        /// the timer_wheel links entries into its slots
+        friend class timer_wheel;
+
+        /// previous entry in the slot
+        entry *             m_prev;
+
+        /// next entry in the slot (NULL if the entry is not armed)
+        entry *             m_next;
+
+        /// head of the slot that the entry is linked into
+        entry **            m_slot;
+
+        /// tick at which the deadline expires
+        boost::uint64_t     m_expires;
+    };
+
+
+    /// identifies the service within an io_service
+    static boost::asio::io_service::id  id;
+
+
+    /**
+     * constructs a new timer_wheel
+     *
+     * @param io_service asio service that the wheel belongs to
+     */
+    explicit timer_wheel(boost::asio::io_service& io_service);
+
+    /// virtual destructor
+    virtual ~timer_wheel() {}
+
+    /**
+     * arms (or re-arms) a deadline
+     *
+     * @param e the deadline to arm
+     * @param seconds minimum number of seconds before the deadline expires
+     */
+    void arm(entry& e, const boost::uint32_t seconds);
+
+    /// disarms a deadline (does nothing if it is not armed)
+    void disarm(entry& e);
+
+    /// returns the number of deadlines that are currently armed
+    std::size_t get_size(void) const;
+
+    /// returns the number of deadlines that have expired
+    boost::uint64_t get_expired(void) const;
+
+
+private:
+
+    /// cancels the wheel's timer when the io_service is shutting down
+    virtual void shutdown_service(void);
+
+    /// returns the number of ticks that have passed since the wheel was created
+    boost::uint64_t get_now(void) const;
+
+    /// links an entry into the slot for its expiration tick; assumes the lock is held
+    void insert(entry& e);
+
+    /// unlinks an entry from its slot; assumes the lock is held
+    void remove(entry& e);
+
+    /// processes all of the ticks that have passed; assumes the lock is held
+    void advance(const boost::uint64_t now);
+
+    /// processes a single tick; assumes the lock is held
+    void process_tick(void);
+
+    /// starts the timer for the next tick if necessary; assumes the lock is held
+    void schedule_tick(void);
+
+    /// called by the deadline timer once per tick
+    void handle_tick(const boost::system::error_code& ec);
+
+
+    /// slot list heads for each level of the wheel (circular lists, NULL if empty)
+    entry *                         m_slots[WHEEL_LEVELS][WHEEL_SIZE];
+
+    /// time when the wheel was created (tick zero)
+    const boost::posix_time::ptime  m_start_time;
+
+    /// all deadlines up to and including this tick have been processed
+    boost::uint64_t                 m_current;
+
+    /// number of deadlines that are currently armed
+    std::size_t                     m_size;
+
+    /// number of deadlines that have expired
+    boost::uint64_t                 m_expired;
+
+    /// timer used to drive the wheel while deadlines are armed
+    boost::asio::deadline_timer     m_timer;
+
+    /// true if the timer is waiting for the next tick
+    bool                            m_timer_active;
+
+    /// true if the io_service is shutting down
+    bool                            m_shutdown;
+
+    /// mutex to make class thread-safe
+    mutable boost::mutex            m_mutex;
+};
+
+
+}   // end namespace tcp
+}   // end namespace pion
+
+#endif
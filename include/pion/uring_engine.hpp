@@ -0,0 +1,366 @@
+// ---------------------------------------------------------------------
+// pion:  a Boost C++ framework for building lightweight HTTP interfaces
+// ---------------------------------------------------------------------
+// Copyright (C) 2007-2014 Splunk Inc.  (https://github.com/splunk/pion)
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See http://www.boost.org/LICENSE_1_0.txt
+//
+
+#ifndef __PION_URING_ENGINE_HEADER__
+#define __PION_URING_ENGINE_HEADER__
+
+#include <vector>
+#include <boost/asio.hpp>
+#include <boost/cstdint.hpp>
+#include <boost/function/function2.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/system/error_code.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition.hpp>
+#include <boost/thread/once.hpp>
+#include <pion/config.hpp>
+#include <pion/logger.hpp>
+
+
+namespace pion {    // begin namespace pion
+
+///
+/// uring_engine: reads files asynchronously using Linux io_uring, so that
+/// file reads neither block the threads that handle async I/O events nor
+/// need a thread of their own.  Reads queued while an IO service runs its
+/// handlers are submitted to the kernel together, and reads into the
+/// engine's registered buffers avoid mapping the pages for every read.
+/// If the kernel polls sockets for io_uring itself (Linux 5.7 and later),
+/// tcp::connection also uses the engine to read from and write to sockets.
+///
+/// The engine is chosen at startup by calling start(), which returns false
+/// if the kernel (or platform) does not support io_uring; callers should
+/// check is_running() and fall back to reading files on the blocking_pool
+/// (and to asio's reactor for sockets).  Callers also fall back whenever
+/// an operation is refused because too many are in flight.
+///
+class PION_API uring_engine :
+    private boost::noncopyable
+{
+public:
+
+    /// data type for the function called when a read has finished; it is
+    /// passed the error status and the number of bytes read (0 at the end
+    /// of the file)
+    typedef boost::function2<void, const boost::system::error_code&, std::size_t>    read_handler_t;
+
+    /// data type for the function called when a socket write has finished;
+    /// it is passed the error status and the number of bytes written
+    typedef read_handler_t      write_handler_t;
+
+
+    /// constructs a new uring_engine (normally only the singleton is used)
+    uring_engine(void);
+
+    /// virtual destructor
+    virtual ~uring_engine();
+
+    /**
+     * starts the engine, unless it is already running
+     *
+     * @param queue_depth maximum number of reads in flight
+     * @param num_buffers number of buffers registered with the kernel (0
+     *                    for none)
+     * @param buffer_size size of each registered buffer in bytes
+     *
+     * @return true if the engine is running, or false if io_uring is not
+     *         supported (the engine remains stopped)
+     */
+    bool start(boost::uint32_t queue_depth = DEFAULT_QUEUE_DEPTH,
+               boost::uint32_t num_buffers = DEFAULT_NUM_BUFFERS,
+               std::size_t buffer_size = DEFAULT_BUFFER_SIZE);
+
+    /// cancels socket operations, waits for the other operations in flight
+    /// to finish and stops the engine.  Operations that cannot be submitted
+    /// to the kernel are finished with an error instead.
+    void shutdown(void);
+
+    /// returns true if the engine is running
+    inline bool is_running(void) const { return m_is_running; }
+
+    /// returns true if the engine is running and may be used for sockets
+    inline bool has_socket_io(void) const { return m_is_running && m_has_socket_io; }
+
+    /**
+     * reads part of a file asynchronously.  The read is submitted to the
+     * kernel along with any others queued before the resume service runs
+     * its next handler.
+     *
+     * @param fd descriptor of the file to read
+     * @param offset position in the file to read from
+     * @param buf buffer to read into; it must remain valid until the handler
+     *            is called, and is read into directly if it is one of the
+     *            engine's registered buffers
+     * @param length number of bytes to read (a read may return fewer)
+     * @param resume_service IO service used to call the handler
+     * @param handler function called once the read has finished
+     *
+     * @return true if the read was queued, or false if the engine is not
+     *         running or too many reads are in flight (the handler is not
+     *         called)
+     */
+    bool async_read(int fd, boost::uint64_t offset, char *buf, std::size_t length,
+                    boost::asio::io_service& resume_service, read_handler_t handler);
+
+    /**
+     * receives data from a socket asynchronously (IORING_OP_RECV)
+     *
+     * @param fd descriptor of the socket
+     * @param buf buffer to read into; it must remain valid until the handler
+     *            is called
+     * @param length size of the buffer (a read may return fewer bytes, and
+     *               returns 0 once the peer has closed the connection)
+     * @param resume_service IO service used to call the handler
+     * @param handler function called once the read has finished
+     *
+     * @return true if the read was queued, or false if the engine cannot be
+     *         used for sockets or too many operations are in flight (the
+     *         handler is not called)
+     */
+    bool async_recv(int fd, char *buf, std::size_t length,
+                    boost::asio::io_service& resume_service, read_handler_t handler);
+
+    /**
+     * sends data to a socket asynchronously (IORING_OP_SENDMSG).  A write
+     * may send only part of the data, like a single sendmsg() call.
+     *
+     * @param fd descriptor of the socket
+     * @param buffers data to send; the memory must remain valid until the
+     *                handler is called (the list itself is copied)
+     * @param resume_service IO service used to call the handler
+     * @param handler function called once the write has finished
+     *
+     * @return true if the write was queued, or false if the engine cannot be
+     *         used for sockets or too many operations are in flight (the
+     *         handler is not called)
+     */
+    bool async_send(int fd, const std::vector<boost::asio::const_buffer>& buffers,
+                    boost::asio::io_service& resume_service, write_handler_t handler);
+
+    /**
+     * cancels the socket operations that are in flight for a descriptor;
+     * their handlers are passed boost::asio::error::operation_aborted
+     *
+     * @param fd descriptor of the socket
+     */
+    void cancel(int fd);
+
+    /// returns one of the registered buffers, or null if none are free.  The
+    /// buffers are allocated by the first call to start() and remain valid
+    /// until the engine is destroyed, even if it is shut down
+    char *acquire_buffer(void);
+
+    /// returns a buffer to the engine once it is no longer used
+    void release_buffer(char *buf);
+
+    /// returns the size of each registered buffer in bytes (0 if there are none)
+    inline std::size_t get_buffer_size(void) const { return m_buffer_size; }
+
+    /// returns the number of file reads that have been queued
+    boost::uint64_t get_num_reads(void) const;
+
+    /// returns the number of reads that used a registered buffer
+    boost::uint64_t get_num_fixed_reads(void) const;
+
+    /// returns the number of system calls used to submit reads (each one
+    /// submits a batch of reads)
+    boost::uint64_t get_num_batches(void) const;
+
+    /// returns the number of socket reads and writes that have been queued
+    boost::uint64_t get_num_socket_ops(void) const;
+
+    /// sets the logger to be used
+    inline void set_logger(logger log_ptr) { m_logger = log_ptr; }
+
+    /// returns the logger currently in use
+    inline logger get_logger(void) { return m_logger; }
+
+    /// returns the uring_engine singleton, which is shared by all services
+    static inline uring_engine& get_instance(void) {
+        boost::call_once(uring_engine::create_instance, m_instance_flag);
+        return *m_instance_ptr;
+    }
+
+
+    /// default maximum number of reads in flight
+    static const boost::uint32_t    DEFAULT_QUEUE_DEPTH;
+
+    /// default number of registered buffers
+    static const boost::uint32_t    DEFAULT_NUM_BUFFERS;
+
+    /// default size of each registered buffer in bytes
+    static const std::size_t        DEFAULT_BUFFER_SIZE;
+
+
+protected:
+
+    /// the kernel's submission and completion rings (platform specific)
+    struct ring_type;
+
+    /// an operation that has been queued, but has not finished yet
+    struct io_request;
+
+
+    /// submits all of the operations that have been queued to the kernel
+    void submit_queued(void);
+
+    /// submits the queued operations; assumes that the engine's lock has
+    /// already been acquired (returns false if the kernel refused them)
+    bool submit_entries(void);
+
+    /**
+     * adds an operation whose submission entry has been filled in to the
+     * queue; assumes that the engine's lock has already been acquired
+     *
+     * @param request_ptr the operation
+     * @param resume_service IO service used to submit the queued operations
+     */
+    void queue_request(io_request *request_ptr, boost::asio::io_service& resume_service);
+
+    /**
+     * removes a finished operation from the list of those in flight and
+     * posts its handler; assumes that the engine's lock has already been
+     * acquired
+     *
+     * @param request_ptr the operation (it is deleted)
+     * @param ec error status passed to the handler
+     * @param bytes number of bytes passed to the handler
+     */
+    void finish_request(io_request *request_ptr, const boost::system::error_code& ec,
+                        std::size_t bytes);
+
+    /**
+     * finishes the operations that have not been submitted to the kernel
+     * with an error, and removes them from the submission ring; assumes
+     * that the engine's lock has already been acquired
+     *
+     * @param ec error status passed to the handlers
+     */
+    void fail_queued(const boost::system::error_code& ec);
+
+    /**
+     * cancels socket operations that are in flight; assumes that the
+     * engine's lock has already been acquired.  If the cancellations cannot
+     * be submitted, the sockets are shut down so that the operations finish.
+     *
+     * @param fd descriptor of the socket (-1 for all sockets)
+     */
+    void cancel_requests(int fd);
+
+    /**
+     * thread function used to wait for operations to finish and call their
+     * handlers
+     *
+     * @param ring_ptr the kernel's rings (shared with the thread, so that a
+     *                 thread that cannot be stopped never uses them after
+     *                 they have been released)
+     */
+    void process_completions(boost::shared_ptr<ring_type> ring_ptr);
+
+    /// closes the kernel's rings
+    void release_ring(void);
+
+    /// returns the index of the registered buffer that holds the range
+    /// [buf, buf + length), or -1 if it is not within one of them
+    int get_buffer_index(const char *buf, std::size_t length) const;
+
+
+    /// primary logging interface used by this class
+    logger                                  m_logger;
+
+    /// the kernel's rings (null unless the engine is running)
+    boost::shared_ptr<ring_type>            m_ring_ptr;
+
+    /// thread used to wait for reads to finish
+    boost::scoped_ptr<boost::thread>        m_completion_thread;
+
+    /// memory used by the registered buffers
+    char *                                  m_buffer_memory;
+
+    /// size of each registered buffer in bytes
+    std::size_t                             m_buffer_size;
+
+    /// number of registered buffers
+    boost::uint32_t                         m_num_buffers;
+
+    /// registered buffers that are not being used
+    std::vector<char *>                     m_free_buffers;
+
+    /// maximum number of operations in flight
+    boost::uint32_t                         m_queue_depth;
+
+    /// number of operations queued or in flight
+    boost::uint32_t                         m_num_in_flight;
+
+    /// number of submission entries queued, but not yet submitted to the kernel
+    boost::uint32_t                         m_num_queued;
+
+    /// number of socket operations queued or in flight (limited to half of
+    /// the queue depth, so that idle connections cannot hold up file reads)
+    boost::uint32_t                         m_num_socket_in_flight;
+
+    /// operations queued or in flight, most recent first
+    io_request *                            m_requests;
+
+    /// number of file reads that have been queued
+    boost::uint64_t                         m_num_reads;
+
+    /// number of reads that used a registered buffer
+    boost::uint64_t                         m_num_fixed_reads;
+
+    /// number of system calls used to submit reads
+    boost::uint64_t                         m_num_batches;
+
+    /// number of socket reads and writes that have been queued
+    boost::uint64_t                         m_num_socket_ops;
+
+    /// true if a call to submit_queued() has been posted, but has not run yet
+    bool                                    m_submit_pending;
+
+    /// true if the engine is running
+    bool                                    m_is_running;
+
+    /// true if the kernel polls sockets for io_uring (IORING_FEAT_FAST_POLL),
+    /// so that socket operations do not tie up its worker threads
+    bool                                    m_has_socket_io;
+
+    /// true once the completion thread can no longer wait for the ring; no
+    /// more operations are accepted, and it polls for those in flight
+    bool                                    m_has_failed;
+
+    /// mutex used to protect the submission ring and counters
+    mutable boost::mutex                    m_mutex;
+
+    /// signaled when the last operation in flight has finished
+    boost::condition                        m_reads_finished;
+
+    /// mutex used to serialize start() and shutdown()
+    boost::mutex                            m_state_mutex;
+
+
+private:
+
+    /// creates the uring_engine singleton
+    static void create_instance(void);
+
+
+    /// points to the uring_engine singleton
+    static uring_engine *                   m_instance_ptr;
+
+    /// used to make sure that the singleton is created only once
+    static boost::once_flag                 m_instance_flag;
+};
+
+
+}   // end namespace pion
+
+#endif
@@ -20,8 +20,15 @@
 #include <pion/error.hpp>
 #include <pion/plugin.hpp>
 #include <pion/algorithm.hpp>
+#include <pion/scheduler.hpp>
+#include <pion/uring_engine.hpp>
 #include <pion/http/response_writer.hpp>
 
+#ifdef PION_HAVE_IO_URING
+    #include <fcntl.h>
+    #include <unistd.h>
+#endif
+
 using namespace pion;
 
 namespace pion {        // begin namespace pion
@@ -209,21 +216,178 @@ void FileService::operator()(const http::request_ptr& http_request_ptr, const tc
     if (http_request_ptr->get_method() == http::types::REQUEST_METHOD_GET 
         || http_request_ptr->get_method() == http::types::REQUEST_METHOD_HEAD)
     {
-        // the type of response we will send
-        enum ResponseType {
-            RESPONSE_UNDEFINED,     // initial state until we know how to respond
-            RESPONSE_OK,            // normal response that includes the file's content
-            RESPONSE_HEAD_OK,       // response to HEAD request (would send file's content)
-            RESPONSE_NOT_FOUND,     // Not Found (404)
-            RESPONSE_NOT_MODIFIED   // Not Modified (304) response to If-Modified-Since
-        } response_type = RESPONSE_UNDEFINED;
-
-        // used to hold our response information
-        DiskFile response_file;
+        // finding the file may mean reading it from disk, so it is done on
+        // the blocking pool, and the response is sent once it has finished
+        FileResponsePtr response_ptr(new FileResponse());
+        pion::scheduler::offload(boost::bind(&FileService::findResponseFile, this,
+                                             relative_path, file_path,
+                                             http_request_ptr->get_header(http::types::HEADER_IF_MODIFIED_SINCE),
+                                             http_request_ptr->get_method() == http::types::REQUEST_METHOD_HEAD,
+                                             response_ptr),
+                                 tcp_conn->get_io_service(),
+                                 boost::bind(&FileService::sendFileResponse, this,
+                                             http_request_ptr, tcp_conn, response_ptr));
+    } else if (http_request_ptr->get_method() == http::types::REQUEST_METHOD_POST
+               || http_request_ptr->get_method() == http::types::REQUEST_METHOD_PUT
+               || http_request_ptr->get_method() == http::types::REQUEST_METHOD_DELETE)
+    {
+        // If not writable, then send 405 (Method Not Allowed) response for POST, PUT or DELETE requests.
+        if (!m_writable) {
+            static const std::string NOT_ALLOWED_HTML_START =
+                "<html><head>\n"
+                "<title>405 Method Not Allowed</title>\n"
+                "</head><body>\n"
+                "<h1>Not Allowed</h1>\n"
+                "<p>The requested method ";
+            static const std::string NOT_ALLOWED_HTML_FINISH =
+                " is not allowed on this server.</p>\n"
+                "</body></html>\n";
+            http::response_writer_ptr writer(http::response_writer::create(tcp_conn, *http_request_ptr,
+                                         boost::bind(&tcp::connection::finish, tcp_conn)));
+            writer->get_response().set_status_code(http::types::RESPONSE_CODE_METHOD_NOT_ALLOWED);
+            writer->get_response().set_status_message(http::types::RESPONSE_MESSAGE_METHOD_NOT_ALLOWED);
+            writer->write_no_copy(NOT_ALLOWED_HTML_START);
+            writer << algorithm::xml_encode(http_request_ptr->get_method());
+            writer->write_no_copy(NOT_ALLOWED_HTML_FINISH);
+            writer->get_response().add_header("Allow", "GET, HEAD");
+            writer->send();
+        } else {
+            http::response_writer_ptr writer(http::response_writer::create(tcp_conn, *http_request_ptr,
+                                         boost::bind(&tcp::connection::finish, tcp_conn)));
+            if (http_request_ptr->get_method() == http::types::REQUEST_METHOD_POST
+                || http_request_ptr->get_method() == http::types::REQUEST_METHOD_PUT)
+            {
+                if (boost::filesystem::exists(file_path)) {
+                    writer->get_response().set_status_code(http::types::RESPONSE_CODE_NO_CONTENT);
+                    writer->get_response().set_status_message(http::types::RESPONSE_MESSAGE_NO_CONTENT);
+                } else {
+                    // The file doesn't exist yet, so it will be created below, unless the
+                    // directory of the requested file also doesn't exist.
+                    if (!boost::filesystem::exists(file_path.branch_path())) {
+                        static const std::string NOT_FOUND_HTML_START =
+                            "<html><head>\n"
+                            "<title>404 Not Found</title>\n"
+                            "</head><body>\n"
+                            "<h1>Not Found</h1>\n"
+                            "<p>The directory of the requested URL ";
+                        static const std::string NOT_FOUND_HTML_FINISH =
+                            " was not found on this server.</p>\n"
+                            "</body></html>\n";
+                        writer->get_response().set_status_code(http::types::RESPONSE_CODE_NOT_FOUND);
+                        writer->get_response().set_status_message(http::types::RESPONSE_MESSAGE_NOT_FOUND);
+                        writer->write_no_copy(NOT_FOUND_HTML_START);
+                        writer << algorithm::xml_encode(http_request_ptr->get_resource());
+                        writer->write_no_copy(NOT_FOUND_HTML_FINISH);
+                        writer->send();
+                        return;
+                    }
+                    static const std::string CREATED_HTML_START =
+                        "<html><head>\n"
+                        "<title>201 Created</title>\n"
+                        "</head><body>\n"
+                        "<h1>Created</h1>\n"
+                        "<p>";
+                    static const std::string CREATED_HTML_FINISH =
+                        "</p>\n"
+                        "</body></html>\n";
+                    writer->get_response().set_status_code(http::types::RESPONSE_CODE_CREATED);
+                    writer->get_response().set_status_message(http::types::RESPONSE_MESSAGE_CREATED);
+                    writer->get_response().add_header(http::types::HEADER_LOCATION, http_request_ptr->get_resource());
+                    writer->write_no_copy(CREATED_HTML_START);
+                    writer << algorithm::xml_encode(http_request_ptr->get_resource());
+                    writer->write_no_copy(CREATED_HTML_FINISH);
+                }
+                std::ios_base::openmode mode = http_request_ptr->get_method() == http::types::REQUEST_METHOD_POST?
+                                               std::ios::app : std::ios::out;
+                boost::filesystem::ofstream file_stream(file_path, mode);
+                file_stream.write(http_request_ptr->get_content(), http_request_ptr->get_content_length());
+                file_stream.close();
+                if (!boost::filesystem::exists(file_path)) {
+                    static const std::string PUT_FAILED_HTML_START =
+                        "<html><head>\n"
+                        "<title>500 Server Error</title>\n"
+                        "</head><body>\n"
+                        "<h1>Server Error</h1>\n"
+                        "<p>Error writing to ";
+                    static const std::string PUT_FAILED_HTML_FINISH =
+                        ".</p>\n"
+                        "</body></html>\n";
+                    writer->get_response().set_status_code(http::types::RESPONSE_CODE_SERVER_ERROR);
+                    writer->get_response().set_status_message(http::types::RESPONSE_MESSAGE_SERVER_ERROR);
+                    writer->write_no_copy(PUT_FAILED_HTML_START);
+                    writer << algorithm::xml_encode(http_request_ptr->get_resource());
+                    writer->write_no_copy(PUT_FAILED_HTML_FINISH);
+                }
+                writer->send();
+            } else if (http_request_ptr->get_method() == http::types::REQUEST_METHOD_DELETE) {
+                if (!boost::filesystem::exists(file_path)) {
+                    sendNotFoundResponse(http_request_ptr, tcp_conn);
+                } else {
+                    try {
+                        boost::filesystem::remove(file_path);
+                        writer->get_response().set_status_code(http::types::RESPONSE_CODE_NO_CONTENT);
+                        writer->get_response().set_status_message(http::types::RESPONSE_MESSAGE_NO_CONTENT);
+                        writer->send();
+                    } catch (std::exception& e) {
+                        static const std::string DELETE_FAILED_HTML_START =
+                            "<html><head>\n"
+                            "<title>500 Server Error</title>\n"
+                            "</head><body>\n"
+                            "<h1>Server Error</h1>\n"
+                            "<p>Could not delete ";
+                        static const std::string DELETE_FAILED_HTML_FINISH =
+                            ".</p>\n"
+                            "</body></html>\n";
+                        writer->get_response().set_status_code(http::types::RESPONSE_CODE_SERVER_ERROR);
+                        writer->get_response().set_status_message(http::types::RESPONSE_MESSAGE_SERVER_ERROR);
+                        writer->write_no_copy(DELETE_FAILED_HTML_START);
+                        writer << algorithm::xml_encode(http_request_ptr->get_resource())
+                            << ".</p><p>"
+                            << boost::diagnostic_information(e);
+                        writer->write_no_copy(DELETE_FAILED_HTML_FINISH);
+                        writer->send();
+                    }
+                }
+            } else {
+                // This should never be reached.
+                writer->get_response().set_status_code(http::types::RESPONSE_CODE_SERVER_ERROR);
+                writer->get_response().set_status_message(http::types::RESPONSE_MESSAGE_SERVER_ERROR);
+                writer->send();
+            }
+        }
+    }
+    // Any method not handled above is unimplemented.
+    else {
+        static const std::string NOT_IMPLEMENTED_HTML_START =
+            "<html><head>\n"
+            "<title>501 Not Implemented</title>\n"
+            "</head><body>\n"
+            "<h1>Not Implemented</h1>\n"
+            "<p>The requested method ";
+        static const std::string NOT_IMPLEMENTED_HTML_FINISH =
+            " is not implemented on this server.</p>\n"
+            "</body></html>\n";
+        http::response_writer_ptr writer(http::response_writer::create(tcp_conn, *http_request_ptr,
+                                     boost::bind(&tcp::connection::finish, tcp_conn)));
+        writer->get_response().set_status_code(http::types::RESPONSE_CODE_NOT_IMPLEMENTED);
+        writer->get_response().set_status_message(http::types::RESPONSE_MESSAGE_NOT_IMPLEMENTED);
+        writer->write_no_copy(NOT_IMPLEMENTED_HTML_START);
+        writer << algorithm::xml_encode(http_request_ptr->get_method());
+        writer->write_no_copy(NOT_IMPLEMENTED_HTML_FINISH);
+        writer->send();
+    }
+}
 
-        // get the If-Modified-Since request header
-        const std::string if_modified_since(http_request_ptr->get_header(http::types::HEADER_IF_MODIFIED_SINCE));
+void FileService::findResponseFile(const std::string& relative_path,
+                                   const boost::filesystem::path& file_path,
+                                   const std::string& if_modified_since,
+                                   const bool is_head,
+                                   const FileResponsePtr& response_ptr)
+{
+    ResponseType& response_type(response_ptr->m_response_type);
+    DiskFile& response_file(response_ptr->m_response_file);
 
+    try {
         // check the cache for a corresponding entry (if enabled)
         // note that m_cache_setting may equal 0 if m_scan_setting == 1
         if (m_cache_setting > 0 || m_scan_setting > 0) {
@@ -268,7 +432,7 @@ void FileService::operator()(const http::request_ptr& http_request_ptr, const tc
                         // no need to read the file; the modified times match!
                         response_type = RESPONSE_NOT_MODIFIED;
                     } else {
-                        if (http_request_ptr->get_method() == http::types::REQUEST_METHOD_HEAD) {
+                        if (is_head) {
                             response_type = RESPONSE_HEAD_OK;
                         } else {
                             response_type = RESPONSE_OK;
@@ -305,7 +469,7 @@ void FileService::operator()(const http::request_ptr& http_request_ptr, const tc
                     // get the response type
                     if (cache_itr->second.getLastModifiedString() == if_modified_since) {
                         response_type = RESPONSE_NOT_MODIFIED;
-                    } else if (http_request_ptr->get_method() == http::types::REQUEST_METHOD_HEAD) {
+                    } else if (is_head) {
                         response_type = RESPONSE_HEAD_OK;
                     } else {
                         response_type = RESPONSE_OK;
@@ -331,7 +495,7 @@ void FileService::operator()(const http::request_ptr& http_request_ptr, const tc
             if (! boost::filesystem::exists(file_path)) {
                 PION_LOG_WARN(m_logger, "File not found ("
                               << get_resource() << "): " << relative_path);
-                sendNotFoundResponse(http_request_ptr, tcp_conn);
+                response_type = RESPONSE_NOT_FOUND;
                 return;
             }
 
@@ -354,7 +518,7 @@ void FileService::operator()(const http::request_ptr& http_request_ptr, const tc
             if (response_file.getLastModifiedString() == if_modified_since) {
                 // no need to read the file; the modified times match!
                 response_type = RESPONSE_NOT_MODIFIED;
-            } else if (http_request_ptr->get_method() == http::types::REQUEST_METHOD_HEAD) {
+            } else if (is_head) {
                 response_type = RESPONSE_HEAD_OK;
             } else {
                 response_type = RESPONSE_OK;
@@ -371,196 +535,66 @@ void FileService::operator()(const http::request_ptr& http_request_ptr, const tc
                 }
             }
         }
+    } catch (std::exception& e) {
+        // the error is sent to the client by sendFileResponse()
+        PION_LOG_ERROR(m_logger, "Unable to find file (" << get_resource() << "): "
+                       << pion::diagnostic_information(e));
+        response_ptr->m_error = e.what();
+    }
+}
 
-        if (response_type == RESPONSE_OK) {
-            // use DiskFileSender to send a file
-            DiskFileSenderPtr sender_ptr(DiskFileSender::create(response_file,
-                                                                http_request_ptr, tcp_conn,
-                                                                m_max_chunk_size));
-            sender_ptr->send();
-        } else if (response_type == RESPONSE_NOT_FOUND) {
-            sendNotFoundResponse(http_request_ptr, tcp_conn);
-        } else {
-            // sending headers only -> use our own response object
+void FileService::sendFileResponse(const http::request_ptr& http_request_ptr,
+                                   const tcp::connection_ptr& tcp_conn,
+                                   const FileResponsePtr& response_ptr)
+{
+    if (! response_ptr->m_error.empty()) {
+        http::server::handle_server_error(http_request_ptr, tcp_conn, response_ptr->m_error);
+        return;
+    }
 
-            // prepare a response and set the Content-Type
-            http::response_writer_ptr writer(http::response_writer::create(tcp_conn, *http_request_ptr,
-                                         boost::bind(&tcp::connection::finish, tcp_conn)));
-            writer->get_response().set_content_type(response_file.getMimeType());
-
-            // set Last-Modified header to enable client-side caching
-            writer->get_response().add_header(http::types::HEADER_LAST_MODIFIED,
-                                            response_file.getLastModifiedString());
-
-            switch(response_type) {
-                case RESPONSE_UNDEFINED:
-                case RESPONSE_NOT_FOUND:
-                case RESPONSE_OK:
-                    // this should never happen
-                    BOOST_ASSERT(false);
-                    break;
-                case RESPONSE_NOT_MODIFIED:
-                    // set "Not Modified" response
-                    writer->get_response().set_status_code(http::types::RESPONSE_CODE_NOT_MODIFIED);
-                    writer->get_response().set_status_message(http::types::RESPONSE_MESSAGE_NOT_MODIFIED);
-                    break;
-                case RESPONSE_HEAD_OK:
-                    // set "OK" response (not really necessary since this is the default)
-                    writer->get_response().set_status_code(http::types::RESPONSE_CODE_OK);
-                    writer->get_response().set_status_message(http::types::RESPONSE_MESSAGE_OK);
-                    break;
-            }
+    const ResponseType response_type(response_ptr->m_response_type);
+    DiskFile& response_file(response_ptr->m_response_file);
+
+    if (response_type == RESPONSE_OK) {
+        // use DiskFileSender to send a file
+        DiskFileSenderPtr sender_ptr(DiskFileSender::create(response_file,
+                                                            http_request_ptr, tcp_conn,
+                                                            m_max_chunk_size));
+        sender_ptr->send();
+    } else if (response_type == RESPONSE_NOT_FOUND) {
+        sendNotFoundResponse(http_request_ptr, tcp_conn);
+    } else {
+        // sending headers only -> use our own response object
 
-            // send the response
-            writer->send();
-        }
-    } else if (http_request_ptr->get_method() == http::types::REQUEST_METHOD_POST
-               || http_request_ptr->get_method() == http::types::REQUEST_METHOD_PUT
-               || http_request_ptr->get_method() == http::types::REQUEST_METHOD_DELETE)
-    {
-        // If not writable, then send 405 (Method Not Allowed) response for POST, PUT or DELETE requests.
-        if (!m_writable) {
-            static const std::string NOT_ALLOWED_HTML_START =
-                "<html><head>\n"
-                "<title>405 Method Not Allowed</title>\n"
-                "</head><body>\n"
-                "<h1>Not Allowed</h1>\n"
-                "<p>The requested method ";
-            static const std::string NOT_ALLOWED_HTML_FINISH =
-                " is not allowed on this server.</p>\n"
-                "</body></html>\n";
-            http::response_writer_ptr writer(http::response_writer::create(tcp_conn, *http_request_ptr,
-                                         boost::bind(&tcp::connection::finish, tcp_conn)));
-            writer->get_response().set_status_code(http::types::RESPONSE_CODE_METHOD_NOT_ALLOWED);
-            writer->get_response().set_status_message(http::types::RESPONSE_MESSAGE_METHOD_NOT_ALLOWED);
-            writer->write_no_copy(NOT_ALLOWED_HTML_START);
-            writer << algorithm::xml_encode(http_request_ptr->get_method());
-            writer->write_no_copy(NOT_ALLOWED_HTML_FINISH);
-            writer->get_response().add_header("Allow", "GET, HEAD");
-            writer->send();
-        } else {
-            http::response_writer_ptr writer(http::response_writer::create(tcp_conn, *http_request_ptr,
-                                         boost::bind(&tcp::connection::finish, tcp_conn)));
-            if (http_request_ptr->get_method() == http::types::REQUEST_METHOD_POST
-                || http_request_ptr->get_method() == http::types::REQUEST_METHOD_PUT)
-            {
-                if (boost::filesystem::exists(file_path)) {
-                    writer->get_response().set_status_code(http::types::RESPONSE_CODE_NO_CONTENT);
-                    writer->get_response().set_status_message(http::types::RESPONSE_MESSAGE_NO_CONTENT);
-                } else {
-                    // The file doesn't exist yet, so it will be created below, unless the
-                    // directory of the requested file also doesn't exist.
-                    if (!boost::filesystem::exists(file_path.branch_path())) {
-                        static const std::string NOT_FOUND_HTML_START =
-                            "<html><head>\n"
-                            "<title>404 Not Found</title>\n"
-                            "</head><body>\n"
-                            "<h1>Not Found</h1>\n"
-                            "<p>The directory of the requested URL ";
-                        static const std::string NOT_FOUND_HTML_FINISH =
-                            " was not found on this server.</p>\n"
-                            "</body></html>\n";
-                        writer->get_response().set_status_code(http::types::RESPONSE_CODE_NOT_FOUND);
-                        writer->get_response().set_status_message(http::types::RESPONSE_MESSAGE_NOT_FOUND);
-                        writer->write_no_copy(NOT_FOUND_HTML_START);
-                        writer << algorithm::xml_encode(http_request_ptr->get_resource());
-                        writer->write_no_copy(NOT_FOUND_HTML_FINISH);
-                        writer->send();
-                        return;
-                    }
-                    static const std::string CREATED_HTML_START =
-                        "<html><head>\n"
-                        "<title>201 Created</title>\n"
-                        "</head><body>\n"
-                        "<h1>Created</h1>\n"
-                        "<p>";
-                    static const std::string CREATED_HTML_FINISH =
-                        "</p>\n"
-                        "</body></html>\n";
-                    writer->get_response().set_status_code(http::types::RESPONSE_CODE_CREATED);
-                    writer->get_response().set_status_message(http::types::RESPONSE_MESSAGE_CREATED);
-                    writer->get_response().add_header(http::types::HEADER_LOCATION, http_request_ptr->get_resource());
-                    writer->write_no_copy(CREATED_HTML_START);
-                    writer << algorithm::xml_encode(http_request_ptr->get_resource());
-                    writer->write_no_copy(CREATED_HTML_FINISH);
-                }
-                std::ios_base::openmode mode = http_request_ptr->get_method() == http::types::REQUEST_METHOD_POST?
-                                               std::ios::app : std::ios::out;
-                boost::filesystem::ofstream file_stream(file_path, mode);
-                file_stream.write(http_request_ptr->get_content(), http_request_ptr->get_content_length());
-                file_stream.close();
-                if (!boost::filesystem::exists(file_path)) {
-                    static const std::string PUT_FAILED_HTML_START =
-                        "<html><head>\n"
-                        "<title>500 Server Error</title>\n"
-                        "</head><body>\n"
-                        "<h1>Server Error</h1>\n"
-                        "<p>Error writing to ";
-                    static const std::string PUT_FAILED_HTML_FINISH =
-                        ".</p>\n"
-                        "</body></html>\n";
-                    writer->get_response().set_status_code(http::types::RESPONSE_CODE_SERVER_ERROR);
-                    writer->get_response().set_status_message(http::types::RESPONSE_MESSAGE_SERVER_ERROR);
-                    writer->write_no_copy(PUT_FAILED_HTML_START);
-                    writer << algorithm::xml_encode(http_request_ptr->get_resource());
-                    writer->write_no_copy(PUT_FAILED_HTML_FINISH);
-                }
-                writer->send();
-            } else if (http_request_ptr->get_method() == http::types::REQUEST_METHOD_DELETE) {
-                if (!boost::filesystem::exists(file_path)) {
-                    sendNotFoundResponse(http_request_ptr, tcp_conn);
-                } else {
-                    try {
-                        boost::filesystem::remove(file_path);
-                        writer->get_response().set_status_code(http::types::RESPONSE_CODE_NO_CONTENT);
-                        writer->get_response().set_status_message(http::types::RESPONSE_MESSAGE_NO_CONTENT);
-                        writer->send();
-                    } catch (std::exception& e) {
-                        static const std::string DELETE_FAILED_HTML_START =
-                            "<html><head>\n"
-                            "<title>500 Server Error</title>\n"
-                            "</head><body>\n"
-                            "<h1>Server Error</h1>\n"
-                            "<p>Could not delete ";
-                        static const std::string DELETE_FAILED_HTML_FINISH =
-                            ".</p>\n"
-                            "</body></html>\n";
-                        writer->get_response().set_status_code(http::types::RESPONSE_CODE_SERVER_ERROR);
-                        writer->get_response().set_status_message(http::types::RESPONSE_MESSAGE_SERVER_ERROR);
-                        writer->write_no_copy(DELETE_FAILED_HTML_START);
-                        writer << algorithm::xml_encode(http_request_ptr->get_resource())
-                            << ".</p><p>"
-                            << boost::diagnostic_information(e);
-                        writer->write_no_copy(DELETE_FAILED_HTML_FINISH);
-                        writer->send();
-                    }
-                }
-            } else {
-                // This should never be reached.
-                writer->get_response().set_status_code(http::types::RESPONSE_CODE_SERVER_ERROR);
-                writer->get_response().set_status_message(http::types::RESPONSE_MESSAGE_SERVER_ERROR);
-                writer->send();
-            }
-        }
-    }
-    // Any method not handled above is unimplemented.
-    else {
-        static const std::string NOT_IMPLEMENTED_HTML_START =
-            "<html><head>\n"
-            "<title>501 Not Implemented</title>\n"
-            "</head><body>\n"
-            "<h1>Not Implemented</h1>\n"
-            "<p>The requested method ";
-        static const std::string NOT_IMPLEMENTED_HTML_FINISH =
-            " is not implemented on this server.</p>\n"
-            "</body></html>\n";
+        // prepare a response and set the Content-Type
         http::response_writer_ptr writer(http::response_writer::create(tcp_conn, *http_request_ptr,
                                      boost::bind(&tcp::connection::finish, tcp_conn)));
-        writer->get_response().set_status_code(http::types::RESPONSE_CODE_NOT_IMPLEMENTED);
-        writer->get_response().set_status_message(http::types::RESPONSE_MESSAGE_NOT_IMPLEMENTED);
-        writer->write_no_copy(NOT_IMPLEMENTED_HTML_START);
-        writer << algorithm::xml_encode(http_request_ptr->get_method());
-        writer->write_no_copy(NOT_IMPLEMENTED_HTML_FINISH);
+        writer->get_response().set_content_type(response_file.getMimeType());
+
+        // set Last-Modified header to enable client-side caching
+        writer->get_response().add_header(http::types::HEADER_LAST_MODIFIED,
+                                        response_file.getLastModifiedString());
+
+        switch(response_type) {
+            case RESPONSE_UNDEFINED:
+            case RESPONSE_NOT_FOUND:
+            case RESPONSE_OK:
+                // this should never happen
+                BOOST_ASSERT(false);
+                break;
+            case RESPONSE_NOT_MODIFIED:
+                // set "Not Modified" response
+                writer->get_response().set_status_code(http::types::RESPONSE_CODE_NOT_MODIFIED);
+                writer->get_response().set_status_message(http::types::RESPONSE_MESSAGE_NOT_MODIFIED);
+                break;
+            case RESPONSE_HEAD_OK:
+                // set "OK" response (not really necessary since this is the default)
+                writer->get_response().set_status_code(http::types::RESPONSE_CODE_OK);
+                writer->get_response().set_status_message(http::types::RESPONSE_MESSAGE_OK);
+                break;
+        }
+
+        // send the response
         writer->send();
     }
 }
@@ -815,7 +849,12 @@ DiskFileSender::DiskFileSender(DiskFile& file, const pion::http::request_ptr& ht
                                unsigned long max_chunk_size)
     : m_logger(PION_GET_LOGGER("pion.FileService.DiskFileSender")), m_disk_file(file),
     m_writer(pion::http::response_writer::create(tcp_conn, *http_request_ptr, boost::bind(&tcp::connection::finish, tcp_conn))),
-    m_max_chunk_size(max_chunk_size), m_file_bytes_to_send(0), m_bytes_sent(0)
+    m_registered_buf(NULL),
+#ifdef PION_HAVE_IO_URING
+    m_file_fd(-1),
+#endif
+    m_max_chunk_size(max_chunk_size), m_file_bytes_to_send(0), m_bytes_sent(0),
+    m_read_ok(false)
 {
 # if defined(BOOST_FILESYSTEM_VERSION) && BOOST_FILESYSTEM_VERSION >= 3
     PION_LOG_DEBUG(m_logger, "Preparing to send file"
@@ -839,6 +878,16 @@ DiskFileSender::DiskFileSender(DiskFile& file, const pion::http::request_ptr& ht
     m_writer->get_response().set_status_message(http::types::RESPONSE_MESSAGE_OK);
 }
 
+DiskFileSender::~DiskFileSender()
+{
+    if (m_registered_buf != NULL)
+        uring_engine::get_instance().release_buffer(m_registered_buf);
+#ifdef PION_HAVE_IO_URING
+    if (m_file_fd >= 0)
+        ::close(m_file_fd);
+#endif
+}
+
 void DiskFileSender::send(void)
 {
     // check if we have nothing to send (send 0 byte response content)
@@ -852,63 +901,150 @@ void DiskFileSender::send(void)
     if (m_max_chunk_size > 0 && m_file_bytes_to_send > m_max_chunk_size)
         m_file_bytes_to_send = m_max_chunk_size;
 
-    // get the content to send (file_content_ptr)
-    char *file_content_ptr;
-
     if (m_disk_file.hasFileContent()) {
-
         // the entire file IS cached in memory (m_disk_file.file_content)
-        file_content_ptr = m_disk_file.getFileContent() + m_bytes_sent;
-
+        send_content(m_disk_file.getFileContent() + m_bytes_sent);
     } else {
-        // the file is not cached in memory
+#ifdef PION_HAVE_IO_URING
+        // read the next block using io_uring if the engine is running
+        if (read_content_async(0))
+            return;
+#endif
+        // the file is not cached in memory -> read the next block on the
+        // blocking pool, and send it once it has been read
+        pion::scheduler::offload(boost::bind(&DiskFileSender::read_content, shared_from_this()),
+                                 m_writer->get_connection()->get_io_service(),
+                                 boost::bind(&DiskFileSender::handle_read, shared_from_this()));
+    }
+}
+
+void DiskFileSender::read_content(void)
+{
+    m_read_ok = false;
 
-        // check if the file has been opened yet
+    // check if the file has been opened yet
+    if (! m_file_stream.is_open()) {
+        // open the file for reading
+        m_file_stream.open(m_disk_file.getFilePath(), std::ios::in | std::ios::binary);
         if (! m_file_stream.is_open()) {
-            // open the file for reading
-            m_file_stream.open(m_disk_file.getFilePath(), std::ios::in | std::ios::binary);
-            if (! m_file_stream.is_open()) {
 # if defined(BOOST_FILESYSTEM_VERSION) && BOOST_FILESYSTEM_VERSION >= 3
-                PION_LOG_ERROR(m_logger, "Unable to open file: "
-                               << m_disk_file.getFilePath().string());
+            PION_LOG_ERROR(m_logger, "Unable to open file: "
+                           << m_disk_file.getFilePath().string());
 #else
-                PION_LOG_ERROR(m_logger, "Unable to open file: "
-                               << m_disk_file.getFilePath().file_string());
+            PION_LOG_ERROR(m_logger, "Unable to open file: "
+                           << m_disk_file.getFilePath().file_string());
 #endif
-                return;
-            }
-        }
-
-        // check if the content buffer was initialized yet
-        if (! m_content_buf) {
-            // allocate memory for the new content buffer
-            m_content_buf.reset(new char[m_file_bytes_to_send]);
+            return;
         }
-        file_content_ptr = m_content_buf.get();
+    }
 
-        // read a block of data from the file into the content buffer
-        if (! m_file_stream.read(m_content_buf.get(), m_file_bytes_to_send)) {
-            if (m_file_stream.gcount() > 0) {
+    // read a block of data from the file into the content buffer (earlier
+    // blocks may have been read using the uring_engine)
+    m_file_stream.seekg(m_bytes_sent);
+    if (! m_file_stream.read(get_read_buffer(), m_file_bytes_to_send)) {
+        if (m_file_stream.gcount() > 0) {
 # if defined(BOOST_FILESYSTEM_VERSION) && BOOST_FILESYSTEM_VERSION >= 3
-                PION_LOG_ERROR(m_logger, "File size inconsistency: "
-                               << m_disk_file.getFilePath().string());
+            PION_LOG_ERROR(m_logger, "File size inconsistency: "
+                           << m_disk_file.getFilePath().string());
 #else
-                PION_LOG_ERROR(m_logger, "File size inconsistency: "
-                               << m_disk_file.getFilePath().file_string());
+            PION_LOG_ERROR(m_logger, "File size inconsistency: "
+                           << m_disk_file.getFilePath().file_string());
 #endif
-            } else {
+        } else {
 # if defined(BOOST_FILESYSTEM_VERSION) && BOOST_FILESYSTEM_VERSION >= 3
-                PION_LOG_ERROR(m_logger, "Unable to read file: "
-                               << m_disk_file.getFilePath().string());
+            PION_LOG_ERROR(m_logger, "Unable to read file: "
+                           << m_disk_file.getFilePath().string());
 #else
-                PION_LOG_ERROR(m_logger, "Unable to read file: "
-                               << m_disk_file.getFilePath().file_string());
+            PION_LOG_ERROR(m_logger, "Unable to read file: "
+                           << m_disk_file.getFilePath().file_string());
 #endif
-            }
-            return;
         }
+        return;
+    }
+
+    m_read_ok = true;
+}
+
+void DiskFileSender::handle_read(void)
+{
+    // the connection is dropped if the file could not be read
+    if (m_read_ok)
+        send_content(get_read_buffer());
+}
+
+char *DiskFileSender::get_read_buffer(void)
+{
+    if (m_registered_buf != NULL)
+        return m_registered_buf;
+
+    // check if the content buffer was initialized yet
+    if (! m_content_buf) {
+        // allocate memory for the new content buffer
+        m_content_buf.reset(new char[m_file_bytes_to_send]);
+    }
+    return m_content_buf.get();
+}
+
+#ifdef PION_HAVE_IO_URING
+bool DiskFileSender::read_content_async(unsigned long bytes_read)
+{
+    uring_engine& engine(uring_engine::get_instance());
+    if (! engine.is_running())
+        return false;
+
+    // check if the file has been opened yet
+    if (m_file_fd < 0) {
+        // errors are reported by read_content() on the blocking pool
+        m_file_fd = ::open(m_disk_file.getFilePath().string().c_str(), O_RDONLY | O_CLOEXEC);
+        if (m_file_fd < 0)
+            return false;
+    }
+
+    // read into one of the engine's registered buffers if the block fits
+    if (m_registered_buf == NULL && ! m_content_buf
+        && m_file_bytes_to_send <= engine.get_buffer_size())
+        m_registered_buf = engine.acquire_buffer();
+
+    return engine.async_read(m_file_fd, m_bytes_sent + bytes_read,
+                             get_read_buffer() + bytes_read, m_file_bytes_to_send - bytes_read,
+                             m_writer->get_connection()->get_io_service(),
+                             boost::bind(&DiskFileSender::handle_async_read, shared_from_this(),
+                                         _1, bytes_read, _2));
+}
+
+void DiskFileSender::handle_async_read(const boost::system::error_code& read_error,
+                                       unsigned long bytes_read, std::size_t bytes_transferred)
+{
+    // the connection is dropped if the file could not be read
+    if (read_error || bytes_transferred == 0) {
+        if (read_error) {
+            PION_LOG_ERROR(m_logger, "Unable to read file: "
+                           << m_disk_file.getFilePath().string() << " (" << read_error.message() << ')');
+        } else {
+            PION_LOG_ERROR(m_logger, "File size inconsistency: "
+                           << m_disk_file.getFilePath().string());
+        }
+        return;
     }
 
+    bytes_read += bytes_transferred;
+    if (bytes_read < m_file_bytes_to_send) {
+        // the read was short -> read the rest of the block, using the
+        // blocking pool if the engine cannot take another read
+        if (! read_content_async(bytes_read)) {
+            pion::scheduler::offload(boost::bind(&DiskFileSender::read_content, shared_from_this()),
+                                     m_writer->get_connection()->get_io_service(),
+                                     boost::bind(&DiskFileSender::handle_read, shared_from_this()));
+        }
+        return;
+    }
+
+    send_content(get_read_buffer());
+}
+#endif
+
+void DiskFileSender::send_content(char *file_content_ptr)
+{
     // send the content
     m_writer->write_no_copy(file_content_ptr, m_file_bytes_to_send);
 
@@ -153,8 +153,8 @@ public:
                                                                     tcp_conn, max_chunk_size));
     }
 
-    /// default virtual destructor 
-    virtual ~DiskFileSender() {}
+    /// virtual destructor (releases the file and read buffer)
+    virtual ~DiskFileSender();
 
     /// Begins sending the file to the client.  Following a call to this
     /// function, it is not thread safe to use your reference to the
@@ -183,6 +183,47 @@ protected:
                    const pion::tcp::connection_ptr& tcp_conn,
                    unsigned long max_chunk_size);
 
+    /**
+     * reads the next block of the file into the content buffer (runs on the
+     * scheduler's blocking pool; used if the file is not cached in memory)
+     */
+    void read_content(void);
+
+    /// sends the block of the file read by read_content()
+    void handle_read(void);
+
+    /// returns the buffer that the next block of the file is read into
+    char *get_read_buffer(void);
+
+#ifdef PION_HAVE_IO_URING
+    /**
+     * reads the next block of the file using the uring_engine
+     *
+     * @param bytes_read number of bytes of the block that have already been read
+     *
+     * @return true if the read was queued, or false if the block should be
+     *         read on the blocking pool instead
+     */
+    bool read_content_async(unsigned long bytes_read);
+
+    /**
+     * handler called after the uring_engine has read part of the block
+     *
+     * @param read_error error status from the read operation
+     * @param bytes_read total number of bytes of the block read so far
+     * @param bytes_transferred number of bytes read by the read operation
+     */
+    void handle_async_read(const boost::system::error_code& read_error,
+                           unsigned long bytes_read, std::size_t bytes_transferred);
+#endif
+
+    /**
+     * sends the next block of the file
+     *
+     * @param file_content_ptr points to the content to send
+     */
+    void send_content(char *file_content_ptr);
+
     /**
      * handler called after a send operation has completed
      *
@@ -211,6 +252,14 @@ private:
     /// buffer used to send file content
     boost::shared_array<char>               m_content_buf;
 
+    /// the uring_engine's registered buffer used to send file content, if any
+    char *                                  m_registered_buf;
+
+#ifdef PION_HAVE_IO_URING
+    /// descriptor used to read the file with the uring_engine (-1 if not open)
+    int                                     m_file_fd;
+#endif
+
     /**
      * maximum chunk size (in bytes): files larger than this size will be
      * delivered to clients using HTTP chunked responses.  A value of
@@ -223,6 +272,9 @@ private:
 
     /// the number of bytes we have sent so far
     unsigned long                           m_bytes_sent;
+
+    /// true if read_content() read the next block of the file
+    bool                                    m_read_ok;
 };
 
 /// data type for a DiskFileSender pointer
@@ -278,6 +330,63 @@ protected:
     /// data type for map of file extensions to MIME types
     typedef PION_HASH_MAP<std::string, std::string, PION_HASH_STRING >  MIMETypeMap;
 
+    /// the type of response sent for a GET or HEAD request
+    enum ResponseType {
+        RESPONSE_UNDEFINED,     // initial state until we know how to respond
+        RESPONSE_OK,            // normal response that includes the file's content
+        RESPONSE_HEAD_OK,       // response to HEAD request (would send file's content)
+        RESPONSE_NOT_FOUND,     // Not Found (404)
+        RESPONSE_NOT_MODIFIED   // Not Modified (304) response to If-Modified-Since
+    };
+
+    ///
+    /// FileResponse: the file found for a GET or HEAD request, and the type
+    /// of response to send for it
+    ///
+    struct FileResponse {
+        FileResponse(void) : m_response_type(RESPONSE_UNDEFINED) {}
+
+        /// the type of response we will send
+        ResponseType    m_response_type;
+
+        /// used to hold our response information
+        DiskFile        m_response_file;
+
+        /// error message if the file could not be found or read
+        std::string     m_error;
+    };
+
+    /// data type for a FileResponse pointer
+    typedef boost::shared_ptr<FileResponse>     FileResponsePtr;
+
+    /**
+     * finds the file for a GET or HEAD request, using the cache if enabled.
+     * This runs on the scheduler's blocking pool, since the file may be
+     * read from disk.
+     *
+     * @param relative_path path for the file relative to the root directory
+     * @param file_path actual path to the file on disk
+     * @param if_modified_since value of the request's If-Modified-Since header
+     * @param is_head true if the request is a HEAD request
+     * @param response_ptr receives the file and the type of response to send
+     */
+    void findResponseFile(const std::string& relative_path,
+                          const boost::filesystem::path& file_path,
+                          const std::string& if_modified_since,
+                          const bool is_head,
+                          const FileResponsePtr& response_ptr);
+
+    /**
+     * sends the response for a GET or HEAD request once its file has been found
+     *
+     * @param http_request_ptr the request to respond to
+     * @param tcp_conn the TCP connection used to send the response
+     * @param response_ptr the file found and the type of response to send
+     */
+    void sendFileResponse(const pion::http::request_ptr& http_request_ptr,
+                          const pion::tcp::connection_ptr& tcp_conn,
+                          const FileResponsePtr& response_ptr);
+
     /**
      * adds all files within a directory to the cache
      *
@@ -0,0 +1,124 @@
+// ---------------------------------------------------------------------
+// pion:  a Boost C++ framework for building lightweight HTTP interfaces
+// ---------------------------------------------------------------------
+// Copyright (C) 2007-2014 Splunk Inc.  (https://github.com/splunk/pion)
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See http://www.boost.org/LICENSE_1_0.txt
+//
+
+#include <sstream>
+#include "SchedulerService.hpp"
+#include <pion/http/response_writer.hpp>
+
+using namespace pion;
+
+namespace pion {        // begin namespace pion
+namespace plugins {     // begin namespace plugins
+
+    
+// SchedulerService member functions
+
+/// handles requests for SchedulerService
+void SchedulerService::operator()(const http::request_ptr& http_request_ptr, const tcp::connection_ptr& tcp_conn)
+{
+    std::vector<scheduler::stats> stats_list;
+    scheduler::get_all_stats(stats_list);
+    std::ostringstream json;
+    writeJSON(json, stats_list);
+
+    http::response_writer_ptr writer(http::response_writer::create(tcp_conn, *http_request_ptr,
+                                                            boost::bind(&tcp::connection::finish, tcp_conn)));
+    writer->get_response().set_content_type(http::types::CONTENT_TYPE_JSON);
+    // measurements change with every request
+    writer->get_response().add_header("Cache-Control", "no-cache");
+    writer->write(json.str());
+    writer->send();
+}
+
+void SchedulerService::writeJSON(std::ostream& out, const std::vector<scheduler::stats>& stats_list)
+{
+    out << "{\"schedulers\":[";
+    for (std::vector<scheduler::stats>::const_iterator i = stats_list.begin(); i != stats_list.end(); ++i) {
+        if (i != stats_list.begin())
+            out << ',';
+        out << "{\"running\":" << (i->m_is_running ? "true" : "false")
+            << ",\"num_threads\":" << i->m_num_threads
+            << ",\"stalls\":" << i->m_num_stalls
+            << ",\"busy_poll_usec\":" << i->m_busy_poll_usec
+            << ",\"queue_delay\":";
+        writeHistogram(out, i->m_queue_delay);
+        out << ",\"run_time\":";
+        writeHistogram(out, i->m_run_time);
+        out << ",\"threads\":[";
+        for (std::vector<scheduler::thread_usage>::const_iterator t = i->m_threads.begin();
+             t != i->m_threads.end(); ++t)
+        {
+            // the CPU time is the better measure of how busy the thread is,
+            // since it also covers the I/O events that are not posted work
+            const boost::uint64_t busy_usec = (t->m_cpu_usec > 0 ? t->m_cpu_usec : t->m_work_usec);
+            const boost::uint64_t busy_percent = (t->m_elapsed_usec > 0
+                ? (busy_usec >= t->m_elapsed_usec ? 100 : busy_usec * 100 / t->m_elapsed_usec) : 0);
+            if (t != i->m_threads.begin())
+                out << ',';
+            out << "{\"thread\":" << t->m_thread_num
+                << ",\"running\":" << (t->m_is_running ? "true" : "false")
+                << ",\"work\":" << t->m_num_work
+                << ",\"elapsed_usec\":" << t->m_elapsed_usec
+                << ",\"work_usec\":" << t->m_work_usec
+                << ",\"cpu_usec\":" << t->m_cpu_usec
+                << ",\"busy_percent\":" << busy_percent
+                << ",\"stalls\":" << t->m_num_stalls
+                << ",\"spin_usec\":" << t->m_spin_usec
+                << ",\"spin_hits\":" << t->m_num_spin_hits
+                << ",\"spin_misses\":" << t->m_num_spin_misses
+                << '}';
+        }
+        out << "]}";
+    }
+    out << "]}";
+}
+
+void SchedulerService::writeHistogram(std::ostream& out, const scheduler::histogram& h)
+{
+    out << "{\"count\":" << h.m_num_samples
+        << ",\"mean_usec\":" << (h.m_num_samples > 0 ? h.m_total_usec / h.m_num_samples : 0)
+        << ",\"max_usec\":" << h.m_max_usec
+        << ",\"p50_usec\":" << h.get_percentile(50)
+        << ",\"p90_usec\":" << h.get_percentile(90)
+        << ",\"p99_usec\":" << h.get_percentile(99)
+        << ",\"buckets\":[";
+    // buckets are listed by their upper limits, leaving out empty ones
+    bool first = true;
+    for (unsigned int n = 0; n < scheduler::histogram::NUM_BUCKETS; ++n) {
+        if (h.m_counts[n] == 0)
+            continue;
+        if (! first)
+            out << ',';
+        first = false;
+        out << "{\"le_usec\":";
+        if (n + 1 < scheduler::histogram::NUM_BUCKETS)
+            out << scheduler::histogram::get_bucket_limit(n);
+        else
+            out << "null";
+        out << ",\"count\":" << h.m_counts[n] << '}';
+    }
+    out << "]}";
+}
+
+
+}   // end namespace plugins
+}   // end namespace pion
+
+
+/// creates new SchedulerService objects
+extern "C" PION_PLUGIN pion::plugins::SchedulerService *pion_create_SchedulerService(void)
+{
+    return new pion::plugins::SchedulerService();
+}
+
+/// destroys SchedulerService objects
+extern "C" PION_PLUGIN void pion_destroy_SchedulerService(pion::plugins::SchedulerService *service_ptr)
+{
+    delete service_ptr;
+}
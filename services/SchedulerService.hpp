@@ -0,0 +1,53 @@
+// ---------------------------------------------------------------------
+// pion:  a Boost C++ framework for building lightweight HTTP interfaces
+// ---------------------------------------------------------------------
+// Copyright (C) 2007-2014 Splunk Inc.  (https://github.com/splunk/pion)
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See http://www.boost.org/LICENSE_1_0.txt
+//
+
+#ifndef __PION_SCHEDULERSERVICE_HEADER__
+#define __PION_SCHEDULERSERVICE_HEADER__
+
+#include <ostream>
+#include <vector>
+#include <pion/scheduler.hpp>
+#include <pion/http/plugin_service.hpp>
+
+
+namespace pion {        // begin namespace pion
+namespace plugins {     // begin namespace plugins
+
+///
+/// SchedulerService: web service that reports the measurements taken by
+/// all of the process' schedulers as JSON (the work histograms are only
+/// filled in for schedulers that have instrumentation enabled)
+/// 
+class SchedulerService :
+    public pion::http::plugin_service
+{
+public:
+    SchedulerService(void) {}
+    virtual ~SchedulerService() {}
+    virtual void operator()(const pion::http::request_ptr& http_request_ptr,
+                            const pion::tcp::connection_ptr& tcp_conn);
+
+    /**
+     * writes scheduler measurements as a JSON document
+     *
+     * @param out the stream to write to
+     * @param stats_list the measurements of each scheduler
+     */
+    static void writeJSON(std::ostream& out, const std::vector<pion::scheduler::stats>& stats_list);
+
+protected:
+
+    /// writes a histogram as a JSON object
+    static void writeHistogram(std::ostream& out, const pion::scheduler::histogram& h);
+};
+
+}   // end namespace plugins
+}   // end namespace pion
+
+#endif
@@ -0,0 +1,247 @@
+// ---------------------------------------------------------------------
+// pion:  a Boost C++ framework for building lightweight HTTP interfaces
+// ---------------------------------------------------------------------
+// Copyright (C) 2007-2014 Splunk Inc.  (https://github.com/splunk/pion)
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See http://www.boost.org/LICENSE_1_0.txt
+//
+
+#include <algorithm>
+#include <pion/flat_multimap.hpp>
+
+
+namespace pion {    // begin namespace pion
+
+
+// names of the known keys, in lower case and in the order of known_key_t
+// (which is sorted by length)
+static const char *KNOWN_KEY_NAMES[] = {
+    "host", "date", "etag",
+    "range",
+    "accept", "cookie", "origin", "pragma", "server",
+    "expires", "referer", "upgrade",
+    "location",
+    "client-ip",
+    "connection", "set-cookie", "user-agent",
+    "content-type",
+    "authorization", "cache-control", "if-none-match", "last-modified",
+    "content-length",
+    "accept-encoding", "accept-language", "x-forwarded-for",
+    "content-encoding", "content-location",
+    "if-modified-since", "transfer-encoding",
+    "content-disposition"
+};
+
+
+// static members of flat_multimap
+
+const boost::uint32_t   flat_multimap::NPOS;
+const std::size_t       flat_multimap::LINEAR_SEARCH_MAX = 32;
+
+
+// flat_multimap member functions
+
+flat_multimap::size_type flat_multimap::count(const key_type& key) const
+{
+    size_type n = 0;
+    std::pair<const_iterator, const_iterator> range = equal_range(key);
+    for (const_iterator i = range.first; i != range.second; ++i)
+        ++n;
+    return n;
+}
+
+flat_multimap::iterator flat_multimap::insert(const value_type& value)
+{
+    const boost::uint32_t pos = static_cast<boost::uint32_t>(m_entries.size());
+    m_entries.push_back(entry_t(value));
+    link_entry(pos);
+    return iterator(this, pos, false);
+}
+
+flat_multimap::iterator flat_multimap::erase(const_iterator pos)
+{
+    const std::size_t n = pos.get_position();
+    m_entries.erase(m_entries.begin() + n);
+    relink_entries();
+    return iterator(this, n, false);
+}
+
+void flat_multimap::erase(const_iterator first, const_iterator last)
+{
+    // the range may follow the entries for one key, so they are not contiguous
+    std::vector<std::size_t> positions;
+    for (const_iterator i = first; i != last; ++i)
+        positions.push_back(i.get_position());
+    if (positions.empty())
+        return;
+    std::sort(positions.begin(), positions.end());
+
+    std::size_t to = positions[0];
+    std::vector<std::size_t>::const_iterator next_erased = positions.begin();
+    for (std::size_t from = positions[0]; from < m_entries.size(); ++from) {
+        if (next_erased != positions.end() && *next_erased == from) {
+            ++next_erased;
+        } else {
+            m_entries[to] = m_entries[from];
+            ++to;
+        }
+    }
+    m_entries.erase(m_entries.begin() + to, m_entries.end());
+    relink_entries();
+}
+
+flat_multimap::size_type flat_multimap::erase(const key_type& key)
+{
+    const size_type n = count(key);
+    if (n > 0) {
+        std::pair<const_iterator, const_iterator> range = equal_range(key);
+        erase(range.first, range.second);
+    }
+    return n;
+}
+
+flat_multimap::known_key_t flat_multimap::get_known_key(const char *ptr, std::size_t length)
+{
+    // only the known keys with the same length need to be compared
+    int first_id;
+    int last_id;
+    switch (length) {
+    case 4:  first_id = KEY_HOST; last_id = KEY_ETAG; break;
+    case 5:  first_id = last_id = KEY_RANGE; break;
+    case 6:  first_id = KEY_ACCEPT; last_id = KEY_SERVER; break;
+    case 7:  first_id = KEY_EXPIRES; last_id = KEY_UPGRADE; break;
+    case 8:  first_id = last_id = KEY_LOCATION; break;
+    case 9:  first_id = last_id = KEY_CLIENT_IP; break;
+    case 10: first_id = KEY_CONNECTION; last_id = KEY_USER_AGENT; break;
+    case 12: first_id = last_id = KEY_CONTENT_TYPE; break;
+    case 13: first_id = KEY_AUTHORIZATION; last_id = KEY_LAST_MODIFIED; break;
+    case 14: first_id = last_id = KEY_CONTENT_LENGTH; break;
+    case 15: first_id = KEY_ACCEPT_ENCODING; last_id = KEY_X_FORWARDED_FOR; break;
+    case 16: first_id = KEY_CONTENT_ENCODING; last_id = KEY_CONTENT_LOCATION; break;
+    case 17: first_id = KEY_IF_MODIFIED_SINCE; last_id = KEY_TRANSFER_ENCODING; break;
+    case 19: first_id = last_id = KEY_CONTENT_DISPOSITION; break;
+    default: return KEY_UNKNOWN;
+    }
+    for (int id = first_id; id <= last_id; ++id) {
+        if (keys_equal(ptr, KNOWN_KEY_NAMES[id], length))
+            return static_cast<known_key_t>(id);
+    }
+    return KEY_UNKNOWN;
+}
+
+std::size_t flat_multimap::find_position(const key_type& key) const
+{
+    const boost::uint32_t pos = find_first(get_known_key(key.data(), key.size()),
+                                           key.data(), key.size());
+    return (pos == NPOS ? m_entries.size() : pos);
+}
+
+boost::uint32_t flat_multimap::find_first(boost::uint32_t key_id, const char *key_ptr,
+                                          std::size_t key_length) const
+{
+    if (key_id != KEY_UNKNOWN)
+        return m_known_keys[key_id];
+
+    if (! m_index.empty()) {
+        const std::size_t mask = m_index.size() - 1;
+        for (std::size_t n = hash_key(key_ptr, key_length) & mask; m_index[n] != NPOS; n = (n + 1) & mask) {
+            const entry_t& entry = m_entries[m_index[n]];
+            if (entry.value.first.size() == key_length
+                && keys_equal(entry.value.first.data(), key_ptr, key_length))
+                return m_index[n];
+        }
+        return NPOS;
+    }
+
+    for (std::size_t pos = 0; pos < m_entries.size(); ++pos) {
+        const entry_t& entry = m_entries[pos];
+        if (entry.last != NPOS && entry.key_id == KEY_UNKNOWN
+            && entry.value.first.size() == key_length
+            && keys_equal(entry.value.first.data(), key_ptr, key_length))
+            return static_cast<boost::uint32_t>(pos);
+    }
+    return NPOS;
+}
+
+void flat_multimap::link_entry(boost::uint32_t pos)
+{
+    entry_t& entry = m_entries[pos];
+    const std::string& key = entry.value.first;
+    entry.key_id = get_known_key(key.data(), key.size());
+    entry.next = entry.last = NPOS;
+
+    // large dictionaries find the other keys using a hash index
+    if (entry.key_id == KEY_UNKNOWN && m_index.empty() && pos >= LINEAR_SEARCH_MAX)
+        build_index();
+
+    const boost::uint32_t first = find_first(entry.key_id, key.data(), key.size());
+    if (first == NPOS) {
+        // this is the first entry for the key
+        entry.last = pos;
+        if (entry.key_id != KEY_UNKNOWN) {
+            m_known_keys[entry.key_id] = pos;
+        } else if (! m_index.empty()) {
+            add_to_index(pos);
+        }
+    } else {
+        m_entries[m_entries[first].last].next = pos;
+        m_entries[first].last = pos;
+    }
+}
+
+void flat_multimap::relink_entries(void)
+{
+    clear_known_keys();
+    m_index.clear();
+    m_index_size = 0;
+    for (std::size_t pos = 0; pos < m_entries.size(); ++pos)
+        m_entries[pos].next = m_entries[pos].last = NPOS;
+    for (std::size_t pos = 0; pos < m_entries.size(); ++pos)
+        link_entry(static_cast<boost::uint32_t>(pos));
+}
+
+void flat_multimap::add_to_index(boost::uint32_t pos)
+{
+    // keep the index at most half full; a new index includes the entry
+    if ((m_index_size + 1) * 2 > m_index.size()) {
+        build_index();
+        return;
+    }
+    const std::string& key = m_entries[pos].value.first;
+    const std::size_t mask = m_index.size() - 1;
+    std::size_t n = hash_key(key.data(), key.size()) & mask;
+    while (m_index[n] != NPOS)
+        n = (n + 1) & mask;
+    m_index[n] = pos;
+    ++m_index_size;
+}
+
+void flat_multimap::build_index(void)
+{
+    // leave room for every entry to have its own key
+    std::size_t index_size = LINEAR_SEARCH_MAX * 4;
+    while (index_size < (m_entries.size() + 1) * 2)
+        index_size *= 2;
+    m_index.assign(index_size, NPOS);
+    m_index_size = 0;
+    for (std::size_t pos = 0; pos < m_entries.size(); ++pos) {
+        const entry_t& entry = m_entries[pos];
+        if (entry.last != NPOS && entry.key_id == KEY_UNKNOWN)
+            add_to_index(static_cast<boost::uint32_t>(pos));
+    }
+}
+
+std::size_t flat_multimap::hash_key(const char *ptr, std::size_t length)
+{
+    // FNV-1a
+    boost::uint32_t hash = 2166136261U;
+    for (std::size_t n = 0; n < length; ++n) {
+        hash ^= static_cast<unsigned char>(fold_case(ptr[n]));
+        hash *= 16777619U;
+    }
+    return hash;
+}
+
+
+}   // end namespace pion
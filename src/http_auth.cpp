@@ -8,6 +8,8 @@
 //
 
 #include <boost/algorithm/string.hpp>
+#include <boost/bind.hpp>
+#include <pion/scheduler.hpp>
 #include <pion/http/auth.hpp>
 #include <pion/http/server.hpp>
 
@@ -16,6 +18,21 @@ namespace pion {    // begin namespace pion
 namespace http {    // begin namespace http
 
 
+/// looks up a user by username and password (runs on the blocking pool)
+static void find_user(const user_manager_ptr& user_manager, const std::string& username,
+                      const std::string& password, const boost::shared_ptr<user_ptr>& result_ptr)
+{
+    *result_ptr = user_manager->get_user(username, password);
+}
+
+/// passes the user found by find_user() to a handler
+static void handle_found_user(const boost::function1<void, user_ptr>& handler,
+                              const boost::shared_ptr<user_ptr>& result_ptr)
+{
+    handler(*result_ptr);
+}
+
+
 // auth member functions
 
 void auth::add_restrict(const std::string& resource)
@@ -80,6 +97,16 @@ bool auth::find_resource(const resource_set_type& resource_set,
     return false;
 }
 
+void auth::async_get_user(const std::string& username, const std::string& password,
+                          const tcp::connection_ptr& tcp_conn,
+                          boost::function1<void, user_ptr> handler)
+{
+    boost::shared_ptr<user_ptr> result_ptr(new user_ptr());
+    scheduler::offload(boost::bind(&find_user, m_user_manager, username, password, result_ptr),
+                       tcp_conn->get_io_service(),
+                       boost::bind(&handle_found_user, handler, result_ptr));
+}
+
   
 }   // end namespace http
 }   // end namespace pion
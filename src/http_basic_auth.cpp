@@ -8,6 +8,7 @@
 //
 
 #include <boost/algorithm/string.hpp>
+#include <boost/bind.hpp>
 #include <pion/algorithm.hpp>
 #include <pion/http/basic_auth.hpp>
 #include <pion/http/response_writer.hpp>
@@ -75,6 +76,15 @@ bool basic_auth::handle_request(const http::request_ptr& http_request_ptr, const
             std::string password;
     
             if (parse_credentials(credentials, username, password)) {
+                if (m_resume_handler) {
+                    // match username/password on the blocking pool, and
+                    // resume handling the request once the user is found
+                    async_get_user(username, password, tcp_conn,
+                                   boost::bind(&basic_auth::handle_user, this,
+                                               http_request_ptr, tcp_conn, credentials, _1));
+                    return false;
+                }
+
                 // match username/password
                 user_ptr user=m_user_manager->get_user(username, password);
                 if (user) {
@@ -93,6 +103,27 @@ bool basic_auth::handle_request(const http::request_ptr& http_request_ptr, const
     return false;
 }
     
+void basic_auth::handle_user(const http::request_ptr& http_request_ptr,
+                             const tcp::connection_ptr& tcp_conn,
+                             const std::string& credentials, user_ptr user)
+{
+    if (! user) {
+        handle_unauthorized(http_request_ptr, tcp_conn);
+        return;
+    }
+
+    // add user to the cache
+    {
+        boost::posix_time::ptime time_now(boost::posix_time::second_clock::universal_time());
+        boost::mutex::scoped_lock cache_lock(m_cache_mutex);
+        m_user_cache.insert(std::make_pair(credentials, std::make_pair(time_now, user)));
+    }
+
+    // add user credentials to the request object
+    http_request_ptr->set_user(user);
+    m_resume_handler(http_request_ptr, tcp_conn);
+}
+    
 void basic_auth::set_option(const std::string& name, const std::string& value) 
 {
     if (name=="realm")
@@ -8,6 +8,7 @@
 //
 
 #include <boost/algorithm/string.hpp>
+#include <boost/bind.hpp>
 #include <pion/algorithm.hpp>
 #include <pion/http/cookie_auth.hpp>
 #include <pion/http/response_writer.hpp>
@@ -112,8 +113,6 @@ bool cookie_auth::process_login(const http::request_ptr& http_request_ptr, const
     }
 
     std::string redirect_url = http_request_ptr->get_query("url");
-    std::string new_cookie;
-    bool delete_cookie = false;
 
     if (resource == m_login) {
         // process login
@@ -121,26 +120,16 @@ bool cookie_auth::process_login(const http::request_ptr& http_request_ptr, const
         std::string username = http_request_ptr->get_query("user");
         std::string password = http_request_ptr->get_query("pass");
 
-        // match username/password
-        user_ptr user=m_user_manager->get_user(username,password);
-        if (!user) { // authentication failed, process as in case of failed authentication...
-            handle_unauthorized(http_request_ptr,tcp_conn);
-            return true;
-        }
-        // ok we have a new user session, create  a new cookie, add to cache
-
-        // create random cookie
-        std::string rand_binary;
-        rand_binary.reserve(RANDOM_COOKIE_BYTES);
-        for (unsigned int i=0; i<RANDOM_COOKIE_BYTES ; i++) {
-            rand_binary += static_cast<unsigned char>(m_random_die());
+        if (m_resume_handler) {
+            // match username/password on the blocking pool
+            async_get_user(username, password, tcp_conn,
+                           boost::bind(&cookie_auth::handle_login, this,
+                                       http_request_ptr, tcp_conn, redirect_url, _1));
+        } else {
+            // match username/password
+            handle_login(http_request_ptr, tcp_conn, redirect_url,
+                         m_user_manager->get_user(username,password));
         }
-        algorithm::base64_encode(rand_binary, new_cookie);
-
-        // add new session to cache
-        boost::posix_time::ptime time_now(boost::posix_time::second_clock::universal_time());
-        boost::mutex::scoped_lock cache_lock(m_cache_mutex);
-        m_user_cache.insert(std::make_pair(new_cookie,std::make_pair(time_now,user)));
     } else {
         // process logout sequence
         // if auth cookie presented - clean cache out
@@ -153,9 +142,47 @@ bool cookie_auth::process_login(const http::request_ptr& http_request_ptr, const
             }
         }
         // and remove cookie from browser
-        delete_cookie = true;
+        send_login_response(http_request_ptr,tcp_conn,redirect_url,"",true);
     }
-    
+
+    // yes, we processed login/logout somehow
+    return true;
+}
+
+void cookie_auth::handle_login(const http::request_ptr& http_request_ptr,
+                               const tcp::connection_ptr& tcp_conn,
+                               const std::string& redirect_url, user_ptr user)
+{
+    if (!user) { // authentication failed, process as in case of failed authentication...
+        handle_unauthorized(http_request_ptr,tcp_conn);
+        return;
+    }
+    // ok we have a new user session, create  a new cookie, add to cache
+
+    // create random cookie
+    std::string new_cookie;
+    std::string rand_binary;
+    rand_binary.reserve(RANDOM_COOKIE_BYTES);
+    for (unsigned int i=0; i<RANDOM_COOKIE_BYTES ; i++) {
+        rand_binary += static_cast<unsigned char>(m_random_die());
+    }
+    algorithm::base64_encode(rand_binary, new_cookie);
+
+    // add new session to cache
+    {
+        boost::posix_time::ptime time_now(boost::posix_time::second_clock::universal_time());
+        boost::mutex::scoped_lock cache_lock(m_cache_mutex);
+        m_user_cache.insert(std::make_pair(new_cookie,std::make_pair(time_now,user)));
+    }
+
+    send_login_response(http_request_ptr,tcp_conn,redirect_url,new_cookie,false);
+}
+
+void cookie_auth::send_login_response(const http::request_ptr& http_request_ptr,
+                                      const tcp::connection_ptr& tcp_conn,
+                                      const std::string& redirect_url,
+                                      const std::string& new_cookie, bool delete_cookie)
+{
     // if redirect defined - send redirect
     if (! redirect_url.empty()) {
         handle_redirection(http_request_ptr,tcp_conn,redirect_url,new_cookie,delete_cookie);
@@ -163,9 +190,6 @@ bool cookie_auth::process_login(const http::request_ptr& http_request_ptr, const
         // otherwise - OK
         handle_ok(http_request_ptr,tcp_conn,new_cookie,delete_cookie);
     }
-
-    // yes, we processed login/logout somehow
-    return true;
 }
 
 void cookie_auth::handle_unauthorized(const http::request_ptr& http_request_ptr,
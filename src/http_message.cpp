@@ -74,11 +74,22 @@ std::size_t message::receive(tcp::connection& tcp_conn,
     boost::tribool parse_result;
     while (true) {
         // parse bytes available in the read buffer
-        parse_result = http_parser.parse(*this, ec);
-        if (! boost::indeterminate(parse_result)) break;
+        // (there are none after payload content has been read directly)
+        if (! http_parser.eof()) {
+            parse_result = http_parser.parse(*this, ec);
+            if (! boost::indeterminate(parse_result)) break;
+        }
 
-        // read more bytes from the connection
-        last_bytes_read = tcp_conn.read_some(ec);
+        // read more bytes from the connection (the rest of large payload
+        // content is read straight into the content buffer instead)
+        const std::size_t direct_length = http_parser.get_direct_content_length(*this);
+        const bool read_direct = (direct_length >= tcp_conn.get_read_buffer().size());
+        if (read_direct) {
+            last_bytes_read = tcp_conn.read_some(boost::asio::buffer(get_content()
+                + http_parser.get_content_bytes_read(), direct_length), ec);
+        } else {
+            last_bytes_read = tcp_conn.read_some(ec);
+        }
         if (ec || last_bytes_read == 0) {
             if (http_parser.check_premature_eof(*this)) {
                 // premature EOF encountered
@@ -97,8 +108,15 @@ std::size_t message::receive(tcp::connection& tcp_conn,
             break;
         }
 
-        // update the HTTP parser's read buffer
-        http_parser.set_read_buffer(tcp_conn.get_read_buffer().data(), last_bytes_read);
+        if (read_direct) {
+            // consume the payload content that was read
+            parse_result = http_parser.consume_direct_content(*this, last_bytes_read);
+            if (! boost::indeterminate(parse_result)) break;
+        } else {
+            // update the HTTP parser's read buffer
+            tcp_conn.get_read_buffer().update_size(last_bytes_read);
+            http_parser.set_read_buffer(tcp_conn.get_read_buffer().data(), last_bytes_read);
+        }
     }
     
     if (parse_result == false) {
@@ -231,6 +249,74 @@ std::size_t message::read(std::istream& in,
     return read(in, ec, http_parser);
 }
 
+bool message::find_header_view(const std::string& key, const char *& value_ptr,
+                               std::size_t& value_length, std::size_t n) const
+{
+    // headers that were copied into strings came before those still held
+    // as views (such as footers parsed after the headers were used)
+    std::pair<ihash_multimap::const_iterator, ihash_multimap::const_iterator>
+        result_pair = m_headers.equal_range(key);
+    for (ihash_multimap::const_iterator i = result_pair.first;
+         i != m_headers.end() && i != result_pair.second; ++i)
+    {
+        if (n-- == 0) {
+            value_ptr = i->second.data();
+            value_length = i->second.size();
+            return true;
+        }
+    }
+
+    for (header_views_t::const_iterator i = m_header_views.begin(); i != m_header_views.end(); ++i) {
+        if (i->name_length == key.size()
+            && flat_multimap::keys_equal(get_header_buffer_ptr(i->name_offset), key.data(), key.size())
+            && n-- == 0)
+        {
+            value_ptr = get_header_buffer_ptr(i->value_offset);
+            value_length = i->value_length;
+            return true;
+        }
+    }
+    return false;
+}
+
+void message::add_header_view(const char *name_ptr, std::size_t name_length,
+                              const char *value_ptr, std::size_t value_length)
+{
+    if (m_header_views.empty())
+        m_header_views.reserve(HEADER_VIEWS_INITIAL_SIZE);
+    header_view_t view;
+    view.name_offset = copy_to_header_buffer(name_ptr, name_length);
+    view.name_length = name_length;
+    view.value_offset = copy_to_header_buffer(value_ptr, value_length);
+    view.value_length = value_length;
+    m_header_views.push_back(view);
+}
+
+void message::copy_header_views(void) const
+{
+    for (header_views_t::const_iterator i = m_header_views.begin(); i != m_header_views.end(); ++i) {
+        m_headers.insert(std::make_pair(std::string(get_header_buffer_ptr(i->name_offset), i->name_length),
+                                        std::string(get_header_buffer_ptr(i->value_offset), i->value_length)));
+    }
+    m_header_views.clear();
+}
+
+void message::parse_cookie_headers(void) const
+{
+    m_has_deferred_cookies = false;
+    const std::string& header_name(m_deferred_set_cookies ? HEADER_SET_COOKIE : HEADER_COOKIE);
+    const char *cookie_ptr;
+    std::size_t cookie_length;
+    for (std::size_t n = 0; find_header_view(header_name, cookie_ptr, cookie_length, n); ++n) {
+        if (! parser::parse_cookie_header(m_cookie_params, cookie_ptr, cookie_length,
+                                          m_deferred_set_cookies))
+        {
+            PION_LOG_WARN(PION_GET_LOGGER("pion.http.parser"),
+                          (m_deferred_set_cookies ? "Set-Cookie" : "Cookie") << " header parsing failed");
+        }
+    }
+}
+
 void message::concatenate_chunks(void)
 {
     set_content_length(m_chunk_cache.size());
@@ -28,6 +28,17 @@
 #include <pion/http/response.hpp>
 #include <pion/http/message.hpp>
 
+#if defined(__AVX2__)
+    #include <immintrin.h>
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #include <emmintrin.h>
+    #define PION_PARSER_USE_SSE2
+#endif
+#if defined(_MSC_VER)
+    #include <intrin.h>
+#endif
+
 
 namespace pion {    // begin namespace pion
 namespace http {    // begin namespace http
@@ -50,6 +61,19 @@ parser::error_category_t * parser::m_error_category_ptr = NULL;
 boost::once_flag            parser::m_instance_flag = BOOST_ONCE_INIT;
 
 
+// returns the position of the lowest bit set in a non-zero mask
+static inline unsigned int find_first_bit(boost::uint32_t mask)
+{
+#if defined(_MSC_VER)
+    unsigned long index;
+    _BitScanForward(&index, mask);
+    return static_cast<unsigned int>(index);
+#else
+    return static_cast<unsigned int>(__builtin_ctz(mask));
+#endif
+}
+
+
 // parser member functions
 
 boost::tribool parser::parse(http::message& http_msg,
@@ -161,8 +185,11 @@ boost::tribool parser::parse_missing_data(http::message& http_msg,
                     for (std::size_t n = 0; n < len; ++n)
                         m_payload_handler(&MISSING_DATA_CHAR, 1);
                 } else {
-                    for (std::size_t n = 0; n < len && http_msg.get_chunk_cache().size() < m_max_content_length; ++n) 
-                        http_msg.get_chunk_cache().push_back(MISSING_DATA_CHAR);
+                    http::message::chunk_cache_t& chunks(http_msg.get_chunk_cache());
+                    if (chunks.size() < m_max_content_length) {
+                        const std::size_t room = m_max_content_length - chunks.size();
+                        chunks.insert(chunks.end(), (len > room ? room : len), MISSING_DATA_CHAR);
+                    }
                 }
 
                 m_bytes_read_in_current_chunk += len;
@@ -310,11 +337,14 @@ boost::tribool parser::parse_headers(http::message& http_msg,
             } else if (is_control(*m_read_ptr)) {
                 set_error(ec, ERROR_URI_CHAR);
                 return false;
-            } else if (m_resource.size() >= RESOURCE_MAX) {
-                set_error(ec, ERROR_URI_SIZE);
-                return false;
             } else {
-                m_resource.push_back(*m_read_ptr);
+                // append the rest of the URI stem in the read buffer at once
+                const char *stem_end = find_text_end(m_read_ptr + 1, m_read_end_ptr, false, ' ', '?');
+                if (m_resource.size() + (stem_end - m_read_ptr) > RESOURCE_MAX) {
+                    set_error(ec, ERROR_URI_SIZE);
+                    return false;
+                }
+                append_span(m_resource, stem_end);
             }
             break;
 
@@ -333,11 +363,14 @@ boost::tribool parser::parse_headers(http::message& http_msg,
             } else if (is_control(*m_read_ptr)) {
                 set_error(ec, ERROR_QUERY_CHAR);
                 return false;
-            } else if (m_query_string.size() >= QUERY_STRING_MAX) {
-                set_error(ec, ERROR_QUERY_SIZE);
-                return false;
             } else {
-                m_query_string.push_back(*m_read_ptr);
+                // append the rest of the query string in the read buffer at once
+                const char *query_end = find_text_end(m_read_ptr + 1, m_read_end_ptr, false, ' ');
+                if (m_query_string.size() + (query_end - m_read_ptr) > QUERY_STRING_MAX) {
+                    set_error(ec, ERROR_QUERY_SIZE);
+                    return false;
+                }
+                append_span(m_query_string, query_end);
             }
             break;
 
@@ -507,11 +540,14 @@ boost::tribool parser::parse_headers(http::message& http_msg,
             } else if (is_control(*m_read_ptr)) {
                 set_error(ec, ERROR_STATUS_CHAR);
                 return false;
-            } else if (m_status_message.size() >= STATUS_MESSAGE_MAX) {
-                set_error(ec, ERROR_STATUS_CHAR);
-                return false;
             } else {
-                m_status_message.push_back(*m_read_ptr);
+                // append the rest of the status message in the read buffer at once
+                const char *message_end = find_text_end(m_read_ptr + 1, m_read_end_ptr, false);
+                if (m_status_message.size() + (message_end - m_read_ptr) > STATUS_MESSAGE_MAX) {
+                    set_error(ec, ERROR_STATUS_CHAR);
+                    return false;
+                }
+                append_span(m_status_message, message_end);
             }
             break;
 
@@ -619,12 +655,14 @@ boost::tribool parser::parse_headers(http::message& http_msg,
             } else if (!is_char(*m_read_ptr) || is_control(*m_read_ptr) || is_special(*m_read_ptr)) {
                 set_error(ec, ERROR_HEADER_CHAR);
                 return false;
-            } else if (m_header_name.size() >= HEADER_NAME_MAX) {
-                set_error(ec, ERROR_HEADER_NAME_SIZE);
-                return false;
             } else {
-                // character (not first) for the name of a header
-                m_header_name.push_back(*m_read_ptr);
+                // characters (not first) for the name of a header
+                const char *name_end = find_token_end(m_read_ptr + 1, m_read_end_ptr);
+                if (m_header_name.size() + (name_end - m_read_ptr) > HEADER_NAME_MAX) {
+                    set_error(ec, ERROR_HEADER_NAME_SIZE);
+                    return false;
+                }
+                append_span(m_header_name, name_end);
             }
             break;
 
@@ -633,10 +671,10 @@ boost::tribool parser::parse_headers(http::message& http_msg,
             if (*m_read_ptr == ' ') {
                 m_headers_parse_state = PARSE_HEADER_VALUE;
             } else if (*m_read_ptr == '\r') {
-                http_msg.add_header(m_header_name, m_header_value);
+                add_parsed_header(http_msg);
                 m_headers_parse_state = PARSE_EXPECTING_NEWLINE;
             } else if (*m_read_ptr == '\n') {
-                http_msg.add_header(m_header_name, m_header_value);
+                add_parsed_header(http_msg);
                 m_headers_parse_state = PARSE_EXPECTING_CR;
             } else if (!is_char(*m_read_ptr) || is_control(*m_read_ptr) || is_special(*m_read_ptr)) {
                 set_error(ec, ERROR_HEADER_CHAR);
@@ -651,10 +689,10 @@ boost::tribool parser::parse_headers(http::message& http_msg,
         case PARSE_HEADER_VALUE:
             // parsing the value of a header
             if (*m_read_ptr == '\r') {
-                http_msg.add_header(m_header_name, m_header_value);
+                add_parsed_header(http_msg);
                 m_headers_parse_state = PARSE_EXPECTING_NEWLINE;
             } else if (*m_read_ptr == '\n') {
-                http_msg.add_header(m_header_name, m_header_value);
+                add_parsed_header(http_msg);
                 m_headers_parse_state = PARSE_EXPECTING_CR;
             } else if (*m_read_ptr != '\t' && is_control(*m_read_ptr)) {
                 // RFC 2616, 2.2 basic Rules.
@@ -665,12 +703,14 @@ boost::tribool parser::parse_headers(http::message& http_msg,
                 //       doesn't work properly still
                 set_error(ec, ERROR_HEADER_CHAR);
                 return false;
-            } else if (m_header_value.size() >= HEADER_VALUE_MAX) {
-                set_error(ec, ERROR_HEADER_VALUE_SIZE);
-                return false;
             } else {
-                // character (not first) for the value of a header
-                m_header_value.push_back(*m_read_ptr);
+                // characters (not first) for the value of a header
+                const char *value_end = find_text_end(m_read_ptr + 1, m_read_end_ptr, true);
+                if (m_header_value.size() + (value_end - m_read_ptr) > HEADER_VALUE_MAX) {
+                    set_error(ec, ERROR_HEADER_VALUE_SIZE);
+                    return false;
+                }
+                append_span(m_header_value, value_end);
             }
             break;
 
@@ -695,6 +735,68 @@ boost::tribool parser::parse_headers(http::message& http_msg,
     return boost::indeterminate;
 }
 
+const char *parser::find_text_end(const char *ptr, const char *end, bool allow_tab,
+                                  char delim1, char delim2)
+{
+    // a character ends the run if it is <= 0x1f (but not an allowed tab),
+    // 0x7f or one of the delimiters; characters >= 0x80 are text
+#if defined(__AVX2__)
+    {
+        const __m256i control_max = _mm256_set1_epi8(0x1f);
+        const __m256i del = _mm256_set1_epi8(0x7f);
+        const __m256i tab = _mm256_set1_epi8(allow_tab ? '\t' : 0x7f);
+        const __m256i first_delim = _mm256_set1_epi8(delim1);
+        const __m256i second_delim = _mm256_set1_epi8(delim2);
+        for (; end - ptr >= 32; ptr += 32) {
+            const __m256i chars = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(ptr));
+            __m256i stop = _mm256_cmpeq_epi8(_mm256_max_epu8(chars, control_max), control_max);
+            stop = _mm256_andnot_si256(_mm256_cmpeq_epi8(chars, tab), stop);
+            stop = _mm256_or_si256(stop, _mm256_cmpeq_epi8(chars, del));
+            stop = _mm256_or_si256(stop, _mm256_cmpeq_epi8(chars, first_delim));
+            stop = _mm256_or_si256(stop, _mm256_cmpeq_epi8(chars, second_delim));
+            const boost::uint32_t mask = static_cast<boost::uint32_t>(_mm256_movemask_epi8(stop));
+            if (mask != 0)
+                return ptr + find_first_bit(mask);
+        }
+    }
+#endif
+#ifdef PION_PARSER_USE_SSE2
+    {
+        const __m128i control_max = _mm_set1_epi8(0x1f);
+        const __m128i del = _mm_set1_epi8(0x7f);
+        const __m128i tab = _mm_set1_epi8(allow_tab ? '\t' : 0x7f);
+        const __m128i first_delim = _mm_set1_epi8(delim1);
+        const __m128i second_delim = _mm_set1_epi8(delim2);
+        for (; end - ptr >= 16; ptr += 16) {
+            const __m128i chars = _mm_loadu_si128(reinterpret_cast<const __m128i*>(ptr));
+            __m128i stop = _mm_cmpeq_epi8(_mm_max_epu8(chars, control_max), control_max);
+            stop = _mm_andnot_si128(_mm_cmpeq_epi8(chars, tab), stop);
+            stop = _mm_or_si128(stop, _mm_cmpeq_epi8(chars, del));
+            stop = _mm_or_si128(stop, _mm_cmpeq_epi8(chars, first_delim));
+            stop = _mm_or_si128(stop, _mm_cmpeq_epi8(chars, second_delim));
+            const boost::uint32_t mask = static_cast<boost::uint32_t>(_mm_movemask_epi8(stop));
+            if (mask != 0)
+                return ptr + find_first_bit(mask);
+        }
+    }
+#endif
+    // check the remaining characters one at a time
+    for (; ptr < end; ++ptr) {
+        if ((is_control(*ptr) && !(allow_tab && *ptr == '\t'))
+            || *ptr == delim1 || *ptr == delim2)
+            break;
+    }
+    return ptr;
+}
+
+const char *parser::find_token_end(const char *ptr, const char *end)
+{
+    // tokens are short, so a SIMD scan would not pay for itself
+    while (ptr < end && is_char(*ptr) && !is_control(*ptr) && !is_special(*ptr))
+        ++ptr;
+    return ptr;
+}
+
 void parser::update_message_with_header_data(http::message& http_msg) const
 {
     if (is_parsing_request()) {
@@ -702,28 +804,23 @@ void parser::update_message_with_header_data(http::message& http_msg) const
         // finish an HTTP request message
 
         http::request& http_request(dynamic_cast<http::request&>(http_msg));
-        http_request.set_method(m_method);
-        http_request.set_resource(m_resource);
-        http_request.set_query_string(m_query_string);
-
-        // parse query pairs from the URI query string
-        if (! m_query_string.empty()) {
-            if (! parse_url_encoded(http_request.get_queries(),
-                                  m_query_string.c_str(),
-                                  m_query_string.size())) 
-                PION_LOG_WARN(m_logger, "Request query string parsing failed (URI)");
+        if (m_parse_header_views) {
+            http_request.set_request_line_views(m_method, m_resource, m_query_string);
+        } else {
+            http_request.set_method(m_method);
+            http_request.set_resource(m_resource);
+            http_request.set_query_string(m_query_string);
         }
 
-        // parse "Cookie" headers in request
-        std::pair<ihash_multimap::const_iterator, ihash_multimap::const_iterator>
-        cookie_pair = http_request.get_headers().equal_range(http::types::HEADER_COOKIE);
-        for (ihash_multimap::const_iterator cookie_iterator = cookie_pair.first;
-             cookie_iterator != http_request.get_headers().end()
-             && cookie_iterator != cookie_pair.second; ++cookie_iterator)
-        {
-            if (! parse_cookie_header(http_request.get_cookies(),
-                                    cookie_iterator->second, false) )
-                PION_LOG_WARN(m_logger, "Cookie header parsing failed");
+        // query pairs from the URI query string and "Cookie" headers are
+        // parsed when they are first used
+        if (! m_query_string.empty())
+            http_request.defer_query_string();
+        if (http_request.has_header(http::types::HEADER_COOKIE))
+            http_request.defer_cookie_headers(false);
+        if (! m_lazy_params) {
+            http_request.get_queries();
+            http_request.get_cookies();
         }
 
     } else {
@@ -734,17 +831,11 @@ void parser::update_message_with_header_data(http::message& http_msg) const
         http_response.set_status_code(m_status_code);
         http_response.set_status_message(m_status_message);
 
-        // parse "Set-Cookie" headers in response
-        std::pair<ihash_multimap::const_iterator, ihash_multimap::const_iterator>
-        cookie_pair = http_response.get_headers().equal_range(http::types::HEADER_SET_COOKIE);
-        for (ihash_multimap::const_iterator cookie_iterator = cookie_pair.first;
-             cookie_iterator != http_response.get_headers().end()
-             && cookie_iterator != cookie_pair.second; ++cookie_iterator)
-        {
-            if (! parse_cookie_header(http_response.get_cookies(),
-                                    cookie_iterator->second, true) )
-                PION_LOG_WARN(m_logger, "Set-Cookie header parsing failed");
-        }
+        // "Set-Cookie" headers are parsed when the cookies are first used
+        if (http_response.has_header(http::types::HEADER_SET_COOKIE))
+            http_response.defer_cookie_headers(true);
+        if (! m_lazy_params)
+            http_response.get_cookies();
 
     }
 }
@@ -1368,8 +1459,7 @@ boost::tribool parser::parse_chunks(http::message::chunk_cache_t& chunks,
         case PARSE_CHUNK_SIZE_START:
             // we have not yet started parsing the next chunk size
             if (is_hex_digit(*m_read_ptr)) {
-                m_chunk_size_str.erase();
-                m_chunk_size_str.push_back(*m_read_ptr);
+                m_size_of_current_chunk = get_hex_digit_value(*m_read_ptr);
                 m_chunked_content_parse_state = PARSE_CHUNK_SIZE;
             } else if (*m_read_ptr == ' ' || *m_read_ptr == '\x09' || *m_read_ptr == '\x0D' || *m_read_ptr == '\x0A') {
                 // Ignore leading whitespace.  Technically, the standard probably doesn't allow white space here, 
@@ -1383,7 +1473,12 @@ boost::tribool parser::parse_chunks(http::message::chunk_cache_t& chunks,
 
         case PARSE_CHUNK_SIZE:
             if (is_hex_digit(*m_read_ptr)) {
-                m_chunk_size_str.push_back(*m_read_ptr);
+                // the chunk size is accumulated as it is read; reject sizes that do not fit
+                if (m_size_of_current_chunk > (static_cast<std::size_t>(-1) >> 4)) {
+                    set_error(ec, ERROR_CHUNK_CHAR);
+                    return false;
+                }
+                m_size_of_current_chunk = (m_size_of_current_chunk << 4) | get_hex_digit_value(*m_read_ptr);
             } else if (*m_read_ptr == '\x0D') {
                 m_chunked_content_parse_state = PARSE_EXPECTING_LF_AFTER_CHUNK_SIZE;
             } else if (*m_read_ptr == ' ' || *m_read_ptr == '\x09') {
@@ -1424,7 +1519,6 @@ boost::tribool parser::parse_chunks(http::message::chunk_cache_t& chunks,
             // if we see anything other than LF, we can't be certain where the chunk starts.
             if (*m_read_ptr == '\x0A') {
                 m_bytes_read_in_current_chunk = 0;
-                m_size_of_current_chunk = strtol(m_chunk_size_str.c_str(), 0, 16);
                 if (m_size_of_current_chunk == 0) {
                     m_chunked_content_parse_state = PARSE_EXPECTING_FINAL_CR_OR_FOOTERS_AFTER_LAST_CHUNK;
                 } else {
@@ -1438,17 +1532,16 @@ boost::tribool parser::parse_chunks(http::message::chunk_cache_t& chunks,
 
         case PARSE_CHUNK:
             if (m_bytes_read_in_current_chunk < m_size_of_current_chunk) {
-                if (m_payload_handler) {
-                    const std::size_t bytes_avail = bytes_available();
-                    const std::size_t bytes_in_chunk = m_size_of_current_chunk - m_bytes_read_in_current_chunk;
-                    const std::size_t len = (bytes_in_chunk > bytes_avail) ? bytes_avail : bytes_in_chunk;
+                // consume as much of the chunk as is in the read buffer at once
+                const std::size_t bytes_avail = bytes_available();
+                const std::size_t bytes_in_chunk = m_size_of_current_chunk - m_bytes_read_in_current_chunk;
+                const std::size_t len = (bytes_in_chunk > bytes_avail) ? bytes_avail : bytes_in_chunk;
+                if (m_payload_handler)
                     m_payload_handler(m_read_ptr, len);
-                    m_bytes_read_in_current_chunk += len;
-                    if (len > 1) m_read_ptr += (len - 1);
-                } else if (chunks.size() < m_max_content_length) {
-                    chunks.push_back(*m_read_ptr);
-                    m_bytes_read_in_current_chunk++;
-                }
+                else
+                    append_to_chunk_cache(chunks, m_read_ptr, len);
+                m_bytes_read_in_current_chunk += len;
+                if (len > 1) m_read_ptr += (len - 1);
             }
             if (m_bytes_read_in_current_chunk == m_size_of_current_chunk) {
                 m_chunked_content_parse_state = PARSE_EXPECTING_CR_AFTER_CHUNK;
@@ -1561,6 +1654,26 @@ boost::tribool parser::consume_content(http::message& http_msg,
     return rc;
 }
 
+boost::tribool parser::consume_direct_content(http::message& http_msg,
+    std::size_t bytes_read)
+{
+    BOOST_ASSERT(m_message_parse_state == PARSE_CONTENT);
+    BOOST_ASSERT(bytes_read <= m_bytes_content_remaining);
+
+    m_bytes_content_remaining -= bytes_read;
+    m_bytes_content_read += bytes_read;
+    m_bytes_total_read += bytes_read;
+    m_bytes_last_read = bytes_read;
+
+    if (m_bytes_content_remaining > 0)
+        return boost::indeterminate;
+
+    // we have all of the payload content
+    m_message_parse_state = PARSE_END;
+    finish(http_msg);
+    return true;
+}
+
 std::size_t parser::consume_content_as_next_chunk(http::message::chunk_cache_t& chunks)
 {
     if (bytes_available() == 0) {
@@ -1568,16 +1681,11 @@ std::size_t parser::consume_content_as_next_chunk(http::message::chunk_cache_t&
     } else {
         // note: m_bytes_last_read must be > 0 because of bytes_available() check
         m_bytes_last_read = (m_read_end_ptr - m_read_ptr);
-        if (m_payload_handler) {
+        if (m_payload_handler)
             m_payload_handler(m_read_ptr, m_bytes_last_read);
-            m_read_ptr += m_bytes_last_read;
-        } else {
-            while (m_read_ptr < m_read_end_ptr) {
-                if (chunks.size() < m_max_content_length)
-                    chunks.push_back(*m_read_ptr);
-                ++m_read_ptr;
-            }
-        }
+        else
+            append_to_chunk_cache(chunks, m_read_ptr, m_bytes_last_read);
+        m_read_ptr += m_bytes_last_read;
         m_bytes_total_read += m_bytes_last_read;
         m_bytes_content_read += m_bytes_last_read;
     }
@@ -1625,23 +1733,24 @@ void parser::finish(http::message& http_msg) const
         // Parse query pairs from post content if content type is x-www-form-urlencoded.
         // Type could be followed by parameters (as defined in section 3.6 of RFC 2616)
         // e.g. Content-Type: application/x-www-form-urlencoded; charset=UTF-8
+        // The content is parsed when the query pairs are first used.
         http::request& http_request(dynamic_cast<http::request&>(http_msg));
-        const std::string& content_type_header = http_request.get_header(http::types::HEADER_CONTENT_TYPE);
-        if (content_type_header.compare(0, http::types::CONTENT_TYPE_URLENCODED.length(),
-                                        http::types::CONTENT_TYPE_URLENCODED) == 0)
-        {
-            if (! parse_url_encoded(http_request.get_queries(),
-                                  http_request.get_content(),
-                                  http_request.get_content_length()))
-                PION_LOG_WARN(m_logger, "Request form data parsing failed (POST urlencoded)");
-        } else if (content_type_header.compare(0, http::types::CONTENT_TYPE_MULTIPART_FORM_DATA.length(),
-                                               http::types::CONTENT_TYPE_MULTIPART_FORM_DATA) == 0)
-        {
-            if (! parse_multipart_form_data(http_request.get_queries(),
-                                            content_type_header,
-                                            http_request.get_content(),
-                                            http_request.get_content_length()))
-                PION_LOG_WARN(m_logger, "Request form data parsing failed (POST multipart)");
+        const char *content_type_ptr;
+        std::size_t content_type_length;
+        if (http_request.find_header_view(http::types::HEADER_CONTENT_TYPE, content_type_ptr, content_type_length)) {
+            const std::string& urlencoded(http::types::CONTENT_TYPE_URLENCODED);
+            const std::string& multipart(http::types::CONTENT_TYPE_MULTIPART_FORM_DATA);
+            if (content_type_length >= urlencoded.size()
+                && memcmp(content_type_ptr, urlencoded.data(), urlencoded.size()) == 0)
+            {
+                http_request.defer_form_content(http::request::FORM_CONTENT_URLENCODED);
+            } else if (content_type_length >= multipart.size()
+                       && memcmp(content_type_ptr, multipart.data(), multipart.size()) == 0)
+            {
+                http_request.defer_form_content(http::request::FORM_CONTENT_MULTIPART);
+            }
+            if (! m_lazy_params)
+                http_request.get_queries();
         }
     }
 }
@@ -20,6 +20,7 @@ namespace http {    // begin namespace http
 // reader static members
     
 const boost::uint32_t       reader::DEFAULT_READ_TIMEOUT = 10;
+const boost::uint32_t       reader::DEFAULT_IDLE_TIMEOUT = 10;
 
 
 // reader member functions
@@ -33,19 +34,37 @@ void reader::receive(void)
         consume_bytes();
     } else {
         // no pipelined messages available in the read buffer -> read bytes from the socket
+        // (a kept-alive connection may sit idle before the next message begins)
+        const bool is_idle = m_tcp_conn->get_keep_alive();
         m_tcp_conn->set_lifecycle(tcp::connection::LIFECYCLE_CLOSE);   // default to close the connection
-        read_bytes_with_timeout();
+        if (m_release_idle_buffer && is_idle && ! m_tcp_conn->get_ssl_flag()) {
+            // wait for the message to begin without holding on to a read buffer
+            // (SSL may have decrypted data buffered already, so it must always read)
+            m_tcp_conn->release_read_buffer();
+            set_deadline(m_idle_timeout);
+            wait_for_bytes();
+        } else {
+            read_bytes_with_timeout(is_idle ? m_idle_timeout : m_read_timeout);
+        }
+    }
+}
+
+void reader::data_ready(const boost::system::error_code& wait_error)
+{
+    if (wait_error) {
+        // handle the error the same way as a failed read
+        consume_bytes(wait_error, 0);
+    } else {
+        // the message has begun -> read it using the read timeout
+        read_bytes_with_timeout(m_read_timeout);
     }
 }
 
 void reader::consume_bytes(const boost::system::error_code& read_error,
                               std::size_t bytes_read)
 {
-    // cancel read timer if operation didn't time-out
-    if (m_timer_ptr) {
-        m_timer_ptr->cancel();
-        m_timer_ptr.reset();
-    }
+    // cancel read timeout if operation didn't time-out
+    m_tcp_conn->cancel_deadline();
 
     if (read_error) {
         // a read error occured
@@ -56,6 +75,9 @@ void reader::consume_bytes(const boost::system::error_code& read_error,
     PION_LOG_DEBUG(m_logger, "Read " << bytes_read << " bytes from HTTP "
                    << (is_parsing_request() ? "request" : "response"));
 
+    // adapt the size of the next read to the amount of data received
+    m_tcp_conn->get_read_buffer().update_size(bytes_read);
+
     // set pointers for new HTTP header data to be consumed
     set_read_buffer(m_tcp_conn->get_read_buffer().data(), bytes_read);
 
@@ -85,6 +107,32 @@ void reader::consume_bytes(void)
         PION_LOG_DEBUG(m_logger, "Parsed " << gcount() << " HTTP bytes");
     }
 
+    handle_parse_result(result, ec);
+}
+
+void reader::consume_content_bytes(const boost::system::error_code& read_error,
+                                   std::size_t bytes_read)
+{
+    // cancel read timeout if operation didn't time-out
+    m_tcp_conn->cancel_deadline();
+
+    if (read_error) {
+        // a read error occured
+        handle_read_error(read_error);
+        return;
+    }
+
+    PION_LOG_DEBUG(m_logger, "Read " << bytes_read << " bytes of HTTP "
+                   << (is_parsing_request() ? "request" : "response")
+                   << " content directly");
+
+    boost::system::error_code ec;
+    handle_parse_result(consume_direct_content(get_message(), bytes_read), ec);
+}
+
+void reader::handle_parse_result(boost::tribool result,
+                                 const boost::system::error_code& ec)
+{
     if (result == true) {
         // finished reading HTTP message and it is valid
 
@@ -118,23 +166,33 @@ void reader::consume_bytes(void)
         m_tcp_conn->set_lifecycle(tcp::connection::LIFECYCLE_CLOSE);   // make sure it will get closed
         get_message().set_is_valid(false);
         finished_reading(ec);
+    } else if (get_direct_content_length(get_message()) >= m_tcp_conn->get_read_buffer().size()) {
+        // the rest of the payload content is large -> read it straight into
+        // the message's content buffer rather than copying it from the read buffer
+        set_deadline(m_read_timeout);
+        read_content(get_message().get_content() + get_content_bytes_read(),
+                     get_direct_content_length(get_message()));
     } else {
         // not yet finished parsing the message -> read more data
-        read_bytes_with_timeout();
+        read_bytes_with_timeout(m_read_timeout);
     }
 }
 
-void reader::read_bytes_with_timeout(void)
+void reader::read_bytes_with_timeout(const boost::uint32_t seconds)
 {
-    if (m_read_timeout > 0) {
-        m_timer_ptr.reset(new tcp::timer(m_tcp_conn));
-        m_timer_ptr->start(m_read_timeout);
-    } else if (m_timer_ptr) {
-        m_timer_ptr.reset();
-    }
+    set_deadline(seconds);
     read_bytes();
 }
 
+void reader::set_deadline(const boost::uint32_t seconds)
+{
+    if (seconds > 0) {
+        m_tcp_conn->set_deadline(seconds);
+    } else {
+        m_tcp_conn->cancel_deadline();
+    }
+}
+
 void reader::handle_read_error(const boost::system::error_code& read_error)
 {
     // close the connection, forcing the client to establish a new one
@@ -32,6 +32,11 @@ void server::handle_connection(const tcp::connection_ptr& tcp_conn)
     my_reader_ptr = request_reader::create(tcp_conn, boost::bind(&server::handle_request,
                                            this, _1, _2, _3));
     my_reader_ptr->set_max_content_length(m_max_content_length);
+    my_reader_ptr->set_timeout(m_read_timeout);
+    my_reader_ptr->set_idle_timeout(m_keep_alive_timeout);
+    my_reader_ptr->set_release_idle_buffer(m_release_idle_buffers);
+    my_reader_ptr->set_parse_header_views(m_parse_header_views);
+    my_reader_ptr->set_lazy_params(m_lazy_params);
     my_reader_ptr->receive();
 }
 
@@ -84,7 +89,8 @@ void server::handle_request(const http::request_ptr& http_request_ptr,
     if (m_auth_ptr) {
         // try to verify authentication
         if (! m_auth_ptr->handle_request(http_request_ptr, tcp_conn)) {
-            // the HTTP 401 message has already been sent by the authentication object
+            // the HTTP 401 message has already been sent by the authentication
+            // object, or the request will be resumed once it is authenticated
             PION_LOG_DEBUG(m_logger, "Authentication required for HTTP resource: "
                 << resource_requested);
             if (http_request_ptr->get_resource() != http_request_ptr->get_original_resource()) {
@@ -93,13 +99,24 @@ void server::handle_request(const http::request_ptr& http_request_ptr,
             return;
         }
     }
-    
+
+    handle_authorized_request(http_request_ptr, tcp_conn);
+}
+
+void server::handle_authorized_request(const http::request_ptr& http_request_ptr,
+                                       const tcp::connection_ptr& tcp_conn)
+{
+    // the resource has already been redirected, if necessary
+    const std::string resource_requested(strip_trailing_slash(http_request_ptr->get_resource()));
+
     // search for a handler matching the resource requested
     request_handler_t request_handler;
     if (find_request_handler(resource_requested, request_handler)) {
         
-        // try to handle the request
+        // try to handle the request (the scheduler's watchdog reports it
+        // if it holds up the thread for too long)
         try {
+            scheduler::handler_scope scope(get_active_scheduler(), resource_requested);
             request_handler(http_request_ptr, tcp_conn);
             PION_LOG_DEBUG(m_logger, "Found request handler for HTTP resource: "
                            << resource_requested);
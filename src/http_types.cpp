@@ -50,6 +50,7 @@ const std::string   types::HEADER_CLIENT_IP("Client-IP");
 const std::string   types::CONTENT_TYPE_HTML("text/html");
 const std::string   types::CONTENT_TYPE_TEXT("text/plain");
 const std::string   types::CONTENT_TYPE_XML("text/xml");
+const std::string   types::CONTENT_TYPE_JSON("application/json");
 const std::string   types::CONTENT_TYPE_URLENCODED("application/x-www-form-urlencoded");
 const std::string   types::CONTENT_TYPE_MULTIPART_FORM_DATA("multipart/form-data");
 
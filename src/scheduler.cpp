@@ -7,10 +7,27 @@
 // See http://www.boost.org/LICENSE_1_0.txt
 //
 
+#include <algorithm>
+#include <fstream>
 #include <boost/exception/diagnostic_information.hpp>
+#include <boost/date_time/gregorian/gregorian_types.hpp>
 #include <boost/date_time/posix_time/posix_time_duration.hpp>
+#include <boost/lexical_cast.hpp>
+#include <pion/error.hpp>
 #include <pion/scheduler.hpp>
 
+#if defined(__linux__)
+    #include <pthread.h>
+    #include <sched.h>
+#endif
+
+#if defined(__linux__) && defined(__GLIBC__)
+    #include <cstdlib>
+    #include <cstring>
+    #include <execinfo.h>
+    #include <signal.h>
+#endif
+
 namespace pion {    // begin namespace pion
 
 
@@ -20,10 +37,617 @@ const boost::uint32_t   scheduler::DEFAULT_NUM_THREADS = 8;
 const boost::uint32_t   scheduler::NSEC_IN_SECOND = 1000000000; // (10^9)
 const boost::uint32_t   scheduler::MICROSEC_IN_SECOND = 1000000;    // (10^6)
 const boost::uint32_t   scheduler::KEEP_RUNNING_TIMER_SECONDS = 5;
+const std::string       scheduler::POSTED_WORK_RESOURCE("work scheduled using post()");
+boost::once_flag        scheduler::m_registry_flag = BOOST_ONCE_INIT;
+scheduler::registry_type *  scheduler::m_registry_ptr = NULL;
+
+
+// static members of multi_thread_scheduler
+
+const boost::uint32_t   multi_thread_scheduler::DEFAULT_MAX_THREADS = 64;
+const boost::uint32_t   multi_thread_scheduler::DEFAULT_MAX_QUEUE_LATENCY = 10000;   // 10 ms
+const boost::uint32_t   multi_thread_scheduler::AUTOSCALE_INTERVAL_MSEC = 1000;
+const boost::uint32_t   multi_thread_scheduler::HIGH_UTILIZATION = 85;
+const boost::uint32_t   multi_thread_scheduler::LOW_UTILIZATION = 25;
+const boost::uint32_t   multi_thread_scheduler::AUTOSCALE_IDLE_INTERVALS = 5;
+#if defined(__linux__)
+const boost::uint32_t   multi_thread_scheduler::MAX_CPUS = CPU_SETSIZE;
+#elif defined(PION_WIN32)
+const boost::uint32_t   multi_thread_scheduler::MAX_CPUS = sizeof(DWORD_PTR) * 8;
+#else
+const boost::uint32_t   multi_thread_scheduler::MAX_CPUS = 1024;
+#endif
+
+
+// static members of one_to_one_scheduler
+
+const boost::uint32_t   one_to_one_scheduler::DRAIN_CHECK_MSEC = 100;
+
+
+// static members of blocking_pool
+
+const boost::uint32_t   blocking_pool::DEFAULT_NUM_THREADS = 4;
+const boost::uint32_t   blocking_pool::DEFAULT_MAX_QUEUED_WORK = 1024;
+blocking_pool *         blocking_pool::m_instance_ptr = NULL;
+boost::once_flag        blocking_pool::m_instance_flag = BOOST_ONCE_INIT;
+
+
+// blocking_pool member functions
+
+blocking_pool::blocking_pool(void)
+    : m_logger(PION_GET_LOGGER("pion.blocking_pool")),
+    m_num_threads(DEFAULT_NUM_THREADS), m_max_queued_work(DEFAULT_MAX_QUEUED_WORK),
+    m_num_idle(0), m_num_wakeups(0), m_num_offloaded(0), m_num_run_inline(0), m_is_stopping(false)
+{}
+
+void blocking_pool::create_instance(void)
+{
+    m_instance_ptr = new blocking_pool();
+}
+
+void blocking_pool::offload(boost::function0<void> blocking_func,
+                            boost::asio::io_service& resume_service,
+                            boost::function0<void> continuation)
+{
+    blocking_work work;
+    work.m_blocking_func.swap(blocking_func);
+    work.m_resume_service = &resume_service;
+    work.m_continuation.swap(continuation);
+
+    {
+        boost::mutex::scoped_lock pool_lock(m_mutex);
+        if (m_num_threads > 0 && m_work.size() < m_max_queued_work) {
+            m_work.push_back(work);
+            if (m_num_idle > m_num_wakeups) {
+                // claim an idle thread that has not been woken already
+                ++m_num_wakeups;
+                m_work_available.notify_one();
+            } else if (m_threads.size() < m_num_threads) {
+                // all of the threads are busy -> start another one
+                boost::shared_ptr<boost::thread> new_thread(new boost::thread(
+                    boost::bind(&blocking_pool::process_blocking_work, this) ));
+                m_threads.push_back(new_thread);
+            }
+            return;
+        }
+        ++m_num_run_inline;
+    }
+
+    // the queue is full: run the work on this thread, which also slows
+    // down whoever is producing it
+    PION_LOG_DEBUG(m_logger, "Blocking work queue is full; running work on the calling thread");
+    run_blocking_work(work);
+}
+
+void blocking_pool::shutdown(void)
+{
+    std::vector<boost::shared_ptr<boost::thread> > threads;
+    {
+        boost::mutex::scoped_lock pool_lock(m_mutex);
+        m_is_stopping = true;
+        m_work_available.notify_all();
+        threads.swap(m_threads);
+    }
+
+    // wait until all threads in the pool have stopped
+    boost::thread current_thread;
+    for (std::vector<boost::shared_ptr<boost::thread> >::iterator i = threads.begin();
+         i != threads.end(); ++i)
+    {
+        // make sure we do not call join() for the current thread,
+        // since this may yield "undefined behavior"
+        if (**i != current_thread) (*i)->join();
+    }
+
+    boost::mutex::scoped_lock pool_lock(m_mutex);
+    m_is_stopping = false;
+    m_num_wakeups = 0;
+}
+
+std::size_t blocking_pool::get_queued_work(void) const
+{
+    boost::mutex::scoped_lock pool_lock(m_mutex);
+    return m_work.size();
+}
+
+boost::uint32_t blocking_pool::get_num_idle_threads(void) const
+{
+    boost::mutex::scoped_lock pool_lock(m_mutex);
+    return m_num_idle;
+}
+
+boost::uint64_t blocking_pool::get_num_offloaded(void) const
+{
+    boost::mutex::scoped_lock pool_lock(m_mutex);
+    return m_num_offloaded;
+}
+
+boost::uint64_t blocking_pool::get_num_run_inline(void) const
+{
+    boost::mutex::scoped_lock pool_lock(m_mutex);
+    return m_num_run_inline;
+}
+
+void blocking_pool::run_blocking_work(blocking_work& work)
+{
+    try {
+        work.m_blocking_func();
+    } catch (std::exception& e) {
+        PION_LOG_ERROR(m_logger, boost::diagnostic_information(e));
+    } catch (...) {
+        PION_LOG_ERROR(m_logger, "caught unrecognized exception");
+    }
+    work.m_resume_service->post(work.m_continuation);
+}
+
+void blocking_pool::process_blocking_work(void)
+{
+    boost::mutex::scoped_lock pool_lock(m_mutex);
+    while (true) {
+        if (m_work.empty()) {
+            if (m_is_stopping)
+                break;
+            ++m_num_idle;
+            m_work_available.wait(pool_lock);
+            --m_num_idle;
+            if (m_num_wakeups > 0)
+                --m_num_wakeups;
+            continue;
+        }
+
+        blocking_work work;
+        work.m_blocking_func.swap(m_work.front().m_blocking_func);
+        work.m_resume_service = m_work.front().m_resume_service;
+        work.m_continuation.swap(m_work.front().m_continuation);
+        m_work.pop_front();
+        ++m_num_offloaded;
+
+        pool_lock.unlock();
+        run_blocking_work(work);
+        pool_lock.lock();
+    }
+}
+
+
+// scheduler::histogram member functions
+
+void scheduler::histogram::reset(void)
+{
+    for (int n = 0; n < NUM_BUCKETS; ++n)
+        m_counts[n] = 0;
+    m_num_samples = m_total_usec = m_max_usec = 0;
+}
+
+void scheduler::histogram::add(boost::uint64_t usec)
+{
+    // the bucket is the number of bits needed to hold the duration
+    unsigned int n = 0;
+    for (boost::uint64_t value = usec; value != 0 && n + 1 < NUM_BUCKETS; value >>= 1)
+        ++n;
+    ++m_counts[n];
+    ++m_num_samples;
+    m_total_usec += usec;
+    if (usec > m_max_usec)
+        m_max_usec = usec;
+}
+
+void scheduler::histogram::merge(const histogram& other)
+{
+    for (int n = 0; n < NUM_BUCKETS; ++n)
+        m_counts[n] += other.m_counts[n];
+    m_num_samples += other.m_num_samples;
+    m_total_usec += other.m_total_usec;
+    if (other.m_max_usec > m_max_usec)
+        m_max_usec = other.m_max_usec;
+}
+
+boost::uint64_t scheduler::histogram::get_percentile(unsigned int percent) const
+{
+    if (m_num_samples == 0)
+        return 0;
+    const boost::uint64_t rank = (m_num_samples * (percent > 100 ? 100 : percent) + 99) / 100;
+    boost::uint64_t num_counted = 0;
+    for (unsigned int n = 0; n < NUM_BUCKETS; ++n) {
+        num_counted += m_counts[n];
+        if (num_counted >= rank && num_counted > 0)
+            return get_bucket_limit(n);
+    }
+    return get_bucket_limit(NUM_BUCKETS - 1);
+}
+
+
+#if defined(__linux__) && defined(__GLIBC__)
+
+// stalled threads are sampled by sending them SIGURG, which is ignored by
+// default, so a stray signal does no harm
+
+/// maximum number of frames in a sampled backtrace
+static const int                MAX_BACKTRACE_FRAMES = 64;
+
+/// frames of the most recently sampled backtrace
+static void *                   g_backtrace_frames[MAX_BACKTRACE_FRAMES];
+
+/// number of frames in g_backtrace_frames
+static volatile sig_atomic_t    g_num_backtrace_frames = 0;
+
+/// set while a backtrace has been requested but not yet sampled
+static volatile sig_atomic_t    g_backtrace_requested = 0;
+
+/// true if the signal handler used to sample backtraces is installed
+static bool                     g_backtrace_installed = false;
+
+/// used to install the signal handler only once
+static boost::once_flag         g_backtrace_flag = BOOST_ONCE_INIT;
+
+/// used to sample one thread at a time
+static boost::mutex             g_backtrace_mutex;
+
+/// signal handler that samples the backtrace of the thread that receives it
+static void handle_backtrace_signal(int /* sig */)
+{
+    if (g_backtrace_requested) {
+        g_num_backtrace_frames = backtrace(g_backtrace_frames, MAX_BACKTRACE_FRAMES);
+        g_backtrace_requested = 0;
+    }
+}
+
+/// installs handle_backtrace_signal(), unless the program handles SIGURG itself
+static void install_backtrace_handler(void)
+{
+    // backtrace() loads libgcc the first time that it is called, which is
+    // not safe to do within a signal handler
+    void *frame;
+    backtrace(&frame, 1);
+
+    struct sigaction action;
+    struct sigaction old_action;
+    std::memset(&action, 0, sizeof(action));
+    action.sa_handler = handle_backtrace_signal;
+    action.sa_flags = SA_RESTART;   // don't interrupt the stalled thread's system calls
+    sigemptyset(&action.sa_mask);
+    if (sigaction(SIGURG, &action, &old_action) != 0)
+        return;
+    if (old_action.sa_handler != SIG_DFL && old_action.sa_handler != SIG_IGN) {
+        sigaction(SIGURG, &old_action, NULL);
+        return;
+    }
+    g_backtrace_installed = true;
+}
+
+#endif
+
+
+// scheduler::handler_scope member functions
+
+scheduler::handler_scope::handler_scope(scheduler& sched, const std::string& resource)
+    : m_scheduler(sched), m_is_marked(false)
+{
+    if (sched.m_stall_threshold == 0)
+        return;
+    thread_stats *stats_ptr = sched.m_thread_stats.get();
+    if (stats_ptr != NULL) {
+        boost::mutex::scoped_lock thread_lock(stats_ptr->m_mutex);
+        if (stats_ptr->m_handler_resource == NULL) {
+            stats_ptr->m_handler_start_usec = get_time_usec();
+            stats_ptr->m_handler_resource = &resource;
+            stats_ptr->m_stall_reported = false;
+            m_is_marked = true;
+        }
+    }
+}
+
+scheduler::handler_scope::~handler_scope()
+{
+    if (m_is_marked) {
+        thread_stats *stats_ptr = m_scheduler.m_thread_stats.get();
+        boost::mutex::scoped_lock thread_lock(stats_ptr->m_mutex);
+        stats_ptr->m_handler_start_usec = 0;
+        stats_ptr->m_handler_resource = NULL;
+    }
+}
+
+
+// scheduler::thread_stats member functions
+
+scheduler::thread_stats::thread_stats(boost::uint32_t thread_num)
+    : m_start_usec(get_time_usec()), m_handler_start_usec(0),
+    m_handler_resource(NULL), m_stall_reported(false)
+{
+    m_usage.m_thread_num = thread_num;
+    m_usage.m_is_running = true;
+#if defined(__linux__)
+    m_native_thread = pthread_self();
+    m_has_cpu_clock = (pthread_getcpuclockid(pthread_self(), &m_cpu_clock) == 0);
+#endif
+}
+
+boost::uint64_t scheduler::thread_stats::get_cpu_usec(void) const
+{
+#if defined(__linux__)
+    struct timespec cpu_time;
+    if (m_has_cpu_clock && clock_gettime(m_cpu_clock, &cpu_time) == 0)
+        return static_cast<boost::uint64_t>(cpu_time.tv_sec) * MICROSEC_IN_SECOND + cpu_time.tv_nsec / 1000;
+#endif
+    return 0;
+}
 
 
 // scheduler member functions
 
+void scheduler::create_registry(void)
+{
+    static registry_type UNIQUE_REGISTRY;
+    m_registry_ptr = &UNIQUE_REGISTRY;
+}
+
+void scheduler::add_scheduler(scheduler *sched_ptr)
+{
+    registry_type& registry(get_registry());
+    boost::mutex::scoped_lock registry_lock(registry.m_mutex);
+    registry.m_schedulers.push_back(sched_ptr);
+}
+
+void scheduler::remove_scheduler(scheduler *sched_ptr)
+{
+    registry_type& registry(get_registry());
+    boost::mutex::scoped_lock registry_lock(registry.m_mutex);
+    std::vector<scheduler *>::iterator i = std::find(registry.m_schedulers.begin(),
+                                                     registry.m_schedulers.end(), sched_ptr);
+    if (i != registry.m_schedulers.end())
+        registry.m_schedulers.erase(i);
+}
+
+void scheduler::get_all_stats(std::vector<stats>& stats_list)
+{
+    registry_type& registry(get_registry());
+    boost::mutex::scoped_lock registry_lock(registry.m_mutex);
+    for (std::vector<scheduler *>::const_iterator i = registry.m_schedulers.begin();
+         i != registry.m_schedulers.end(); ++i)
+    {
+        stats_list.push_back((*i)->get_stats());
+    }
+}
+
+scheduler::stats scheduler::get_stats(void) const
+{
+    // this only uses the base class, since it may be called while a
+    // derived scheduler is being destroyed
+    stats snapshot;
+    snapshot.m_num_threads = m_num_threads;
+    snapshot.m_is_running = m_is_running;
+    const boost::uint64_t now_usec = get_time_usec();
+    snapshot.m_busy_poll_usec = m_busy_poll_usec;
+    boost::mutex::scoped_lock stats_lock(m_stats_mutex);
+    snapshot.m_num_stalls = m_num_stalls;
+    for (stats_pool_type::const_iterator i = m_stats_pool.begin(); i != m_stats_pool.end(); ++i) {
+        const thread_stats& ts(**i);
+        boost::mutex::scoped_lock thread_lock(ts.m_mutex);
+        snapshot.m_queue_delay.merge(ts.m_queue_delay);
+        snapshot.m_run_time.merge(ts.m_run_time);
+        snapshot.m_threads.push_back(ts.m_usage);
+        if (ts.m_usage.m_is_running) {
+            snapshot.m_threads.back().m_elapsed_usec = now_usec - ts.m_start_usec;
+            snapshot.m_threads.back().m_cpu_usec = ts.get_cpu_usec();
+        }
+    }
+    return snapshot;
+}
+
+void scheduler::reset_stats(void)
+{
+    boost::mutex::scoped_lock stats_lock(m_stats_mutex);
+    m_num_stalls = 0;
+    stats_pool_type::iterator i = m_stats_pool.begin();
+    while (i != m_stats_pool.end()) {
+        boost::mutex::scoped_lock thread_lock((*i)->m_mutex);
+        if ((*i)->m_usage.m_is_running) {
+            (*i)->m_queue_delay.reset();
+            (*i)->m_run_time.reset();
+            (*i)->m_usage.m_num_work = (*i)->m_usage.m_work_usec = 0;
+            (*i)->m_usage.m_num_stalls = (*i)->m_usage.m_spin_usec = 0;
+            (*i)->m_usage.m_num_spin_hits = (*i)->m_usage.m_num_spin_misses = 0;
+            ++i;
+        } else {
+            thread_lock.unlock();
+            i = m_stats_pool.erase(i);
+        }
+    }
+}
+
+scheduler::thread_stats& scheduler::get_thread_stats(void)
+{
+    thread_stats *stats_ptr = m_thread_stats.get();
+    if (stats_ptr == NULL) {
+        boost::mutex::scoped_lock stats_lock(m_stats_mutex);
+        boost::uint32_t thread_num = 0;
+        if (! m_stats_pool.empty())
+            thread_num = m_stats_pool.back()->m_usage.m_thread_num + 1;
+        boost::shared_ptr<thread_stats> new_stats(new thread_stats(thread_num));
+        m_stats_pool.push_back(new_stats);
+        stats_ptr = new_stats.get();
+        m_thread_stats.reset(stats_ptr);
+    }
+    return *stats_ptr;
+}
+
+void scheduler::stop_thread_stats(void)
+{
+    thread_stats *stats_ptr = m_thread_stats.get();
+    if (stats_ptr != NULL) {
+        // the thread's CPU clock is no longer valid once it exits
+        const boost::uint64_t cpu_usec = stats_ptr->get_cpu_usec();
+        boost::mutex::scoped_lock thread_lock(stats_ptr->m_mutex);
+        stats_ptr->m_usage.m_is_running = false;
+        stats_ptr->m_usage.m_elapsed_usec = get_time_usec() - stats_ptr->m_start_usec;
+        stats_ptr->m_usage.m_cpu_usec = cpu_usec;
+        thread_lock.unlock();
+        m_thread_stats.reset();
+    }
+}
+
+void scheduler::get_cpu_usage(boost::uint64_t& cpu_usec, boost::uint64_t& spin_usec) const
+{
+    cpu_usec = spin_usec = 0;
+    boost::mutex::scoped_lock stats_lock(m_stats_mutex);
+    for (stats_pool_type::const_iterator i = m_stats_pool.begin(); i != m_stats_pool.end(); ++i) {
+        const thread_stats& ts(**i);
+        boost::mutex::scoped_lock thread_lock(ts.m_mutex);
+        cpu_usec += (ts.m_usage.m_is_running ? ts.get_cpu_usec() : ts.m_usage.m_cpu_usec);
+        spin_usec += ts.m_usage.m_spin_usec;
+    }
+}
+
+boost::function0<void> scheduler::instrument_work(const boost::function0<void>& work_func)
+{
+    if (! m_instrumentation && m_stall_threshold == 0)
+        return work_func;
+    return boost::bind(&scheduler::run_instrumented_work, this, work_func, get_time_usec());
+}
+
+void scheduler::run_instrumented_work(const boost::function0<void>& work_func, boost::uint64_t posted_usec)
+{
+    thread_stats& ts(get_thread_stats());
+    const boost::uint64_t start_usec = get_time_usec();
+    try {
+        handler_scope scope(*this, POSTED_WORK_RESOURCE);
+        work_func();
+    } catch (...) {
+        if (m_instrumentation) {
+            boost::mutex::scoped_lock thread_lock(ts.m_mutex);
+            ts.m_queue_delay.add(start_usec - posted_usec);
+        }
+        throw;
+    }
+    if (! m_instrumentation)
+        return;
+    const boost::uint64_t run_usec = get_time_usec() - start_usec;
+    boost::mutex::scoped_lock thread_lock(ts.m_mutex);
+    ts.m_queue_delay.add(start_usec - posted_usec);
+    ts.m_run_time.add(run_usec);
+    ++ts.m_usage.m_num_work;
+    ts.m_usage.m_work_usec += run_usec;
+}
+
+boost::uint64_t scheduler::get_time_usec(void)
+{
+#if defined(__linux__)
+    struct timespec now;
+    if (clock_gettime(CLOCK_MONOTONIC, &now) == 0)
+        return static_cast<boost::uint64_t>(now.tv_sec) * MICROSEC_IN_SECOND + now.tv_nsec / 1000;
+#endif
+    static const boost::posix_time::ptime EPOCH(boost::gregorian::date(1970, 1, 1));
+    return static_cast<boost::uint64_t>((boost::get_system_time() - EPOCH).total_microseconds());
+}
+
+boost::uint64_t scheduler::get_num_stalls(void) const
+{
+    boost::mutex::scoped_lock stats_lock(m_stats_mutex);
+    return m_num_stalls;
+}
+
+void scheduler::set_stall_threshold(boost::uint32_t msec)
+{
+    if (msec == 0) {
+        stop_watchdog();
+        return;
+    }
+    boost::mutex::scoped_lock watchdog_lock(m_watchdog_mutex);
+    m_stall_threshold = msec;
+    if (! m_watchdog_thread) {
+        m_watchdog_thread.reset(new boost::thread(boost::bind(&scheduler::process_watchdog, this)));
+        PION_LOG_DEBUG(m_logger, "Started stall watchdog (threshold = " << msec << " ms)");
+    }
+}
+
+void scheduler::stop_watchdog(void)
+{
+    boost::mutex::scoped_lock watchdog_lock(m_watchdog_mutex);
+    m_stall_threshold = 0;
+    boost::scoped_ptr<boost::thread> watchdog_thread;
+    watchdog_thread.swap(m_watchdog_thread);
+    m_watchdog_wakeup.notify_all();
+    watchdog_lock.unlock();
+    if (watchdog_thread)
+        watchdog_thread->join();
+}
+
+void scheduler::process_watchdog(void)
+{
+    boost::mutex::scoped_lock watchdog_lock(m_watchdog_mutex);
+    while (m_stall_threshold > 0) {
+        // check often enough that stalls are reported soon after they begin
+        const boost::uint32_t interval_msec = (m_stall_threshold < 4 ? 1 : m_stall_threshold / 4);
+        m_watchdog_wakeup.timed_wait(watchdog_lock, boost::get_system_time()
+                                     + boost::posix_time::milliseconds(interval_msec));
+        if (m_stall_threshold == 0)
+            break;
+        const boost::uint64_t threshold_usec = static_cast<boost::uint64_t>(m_stall_threshold) * 1000;
+        watchdog_lock.unlock();
+        check_for_stalls(threshold_usec);
+        watchdog_lock.lock();
+    }
+}
+
+void scheduler::check_for_stalls(boost::uint64_t threshold_usec)
+{
+    boost::mutex::scoped_lock stats_lock(m_stats_mutex);
+    for (stats_pool_type::iterator i = m_stats_pool.begin(); i != m_stats_pool.end(); ++i) {
+        thread_stats& ts(**i);
+        boost::mutex::scoped_lock thread_lock(ts.m_mutex);
+        if (ts.m_handler_resource == NULL || ts.m_stall_reported)
+            continue;
+        const boost::uint64_t now_usec = get_time_usec();
+        if (now_usec - ts.m_handler_start_usec < threshold_usec)
+            continue;
+
+        // report each stalled handler only once
+        ts.m_stall_reported = true;
+        ++ts.m_usage.m_num_stalls;
+        ++m_num_stalls;
+        PION_LOG_WARN(m_logger, "Scheduler thread " << ts.m_usage.m_thread_num
+                      << " has been running a handler for "
+                      << (now_usec - ts.m_handler_start_usec) / 1000
+                      << " ms: " << *ts.m_handler_resource << sample_backtrace(ts));
+    }
+}
+
+std::string scheduler::sample_backtrace(const thread_stats& ts)
+{
+    std::string trace;
+#if defined(__linux__) && defined(__GLIBC__)
+    boost::call_once(install_backtrace_handler, g_backtrace_flag);
+    if (! g_backtrace_installed)
+        return trace;
+
+    // the frames are collected by the stalled thread itself, within the
+    // signal handler, so wait up to 100 ms for it to run
+    boost::mutex::scoped_lock backtrace_lock(g_backtrace_mutex);
+    g_num_backtrace_frames = 0;
+    g_backtrace_requested = 1;
+    if (pthread_kill(ts.m_native_thread, SIGURG) != 0) {
+        g_backtrace_requested = 0;
+        return trace;
+    }
+    for (unsigned int n = 0; n < 100 && g_backtrace_requested; ++n)
+        boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+    if (g_backtrace_requested) {
+        g_backtrace_requested = 0;
+        return trace;
+    }
+
+    char **symbols = backtrace_symbols(g_backtrace_frames, g_num_backtrace_frames);
+    if (symbols != NULL) {
+        for (int n = 0; n < g_num_backtrace_frames; ++n) {
+            trace += "\n    ";
+            trace += symbols[n];
+        }
+        std::free(symbols);
+    }
+#endif
+    return trace;
+}
+
+
 void scheduler::shutdown(void)
 {
     // lock mutex for thread safety
@@ -45,6 +669,7 @@ void scheduler::shutdown(void)
         stop_threads();
         finish_services();
         finish_threads();
+        finish_lanes();
         
         PION_LOG_INFO(m_logger, "The thread scheduler has shutdown");
 
@@ -58,6 +683,7 @@ void scheduler::shutdown(void)
         stop_threads();
         finish_services();
         finish_threads();
+        finish_lanes();
         
         // Make sure anyone waiting on shutdown gets notified
         // even if the scheduler did not startup successfully
@@ -99,6 +725,122 @@ void scheduler::remove_active_user(void)
         m_no_more_active_users.notify_all();
 }
 
+void scheduler::add_resize_handler(const void *owner, const resize_handler_type& handler)
+{
+    boost::mutex::scoped_lock handler_lock(m_resize_handler_mutex);
+    for (std::size_t n = 0; n < m_resize_handlers.size(); ++n) {
+        if (m_resize_handlers[n].first == owner) {
+            m_resize_handlers[n].second = handler;
+            return;
+        }
+    }
+    m_resize_handlers.push_back(std::make_pair(owner, handler));
+}
+
+void scheduler::remove_resize_handler(const void *owner)
+{
+    boost::mutex::scoped_lock handler_lock(m_resize_handler_mutex);
+    for (std::size_t n = 0; n < m_resize_handlers.size(); ++n) {
+        if (m_resize_handlers[n].first == owner) {
+            m_resize_handlers.erase(m_resize_handlers.begin() + n);
+            return;
+        }
+    }
+}
+
+void scheduler::notify_resize(void)
+{
+    // the lock is held while the handlers run, so that they cannot be
+    // removed (and their owners destroyed) while they are running
+    boost::mutex::scoped_lock handler_lock(m_resize_handler_mutex);
+    for (std::size_t n = 0; n < m_resize_handlers.size(); ++n)
+        m_resize_handlers[n].second();
+}
+
+void scheduler::post(boost::function0<void> work_func, priority_type priority)
+{
+    BOOST_ASSERT(priority >= PRIORITY_HIGH && priority < NUM_PRIORITIES);
+    boost::shared_ptr<work_lanes> lanes_ptr(get_work_lanes(get_io_service()));
+    {
+        boost::mutex::scoped_lock lanes_lock(lanes_ptr->m_mutex);
+        std::deque<boost::function0<void> >& lane(lanes_ptr->m_work[priority]);
+        lane.push_back(instrument_work(work_func));
+        if (lane.size() > lanes_ptr->m_peak_depth[priority])
+            lanes_ptr->m_peak_depth[priority] = lane.size();
+    }
+    // the token runs whichever work is most urgent once it reaches the front
+    // of the IO service's queue, which may not be the work just posted
+    lanes_ptr->m_service.post(boost::bind(&scheduler::run_priority_work, this, lanes_ptr));
+}
+
+std::size_t scheduler::get_lane_depth(priority_type priority) const
+{
+    BOOST_ASSERT(priority >= PRIORITY_HIGH && priority < NUM_PRIORITIES);
+    std::size_t depth = 0;
+    boost::mutex::scoped_lock pool_lock(m_lanes_mutex);
+    for (lanes_pool_type::const_iterator i = m_lanes_pool.begin(); i != m_lanes_pool.end(); ++i) {
+        boost::mutex::scoped_lock lanes_lock((*i)->m_mutex);
+        depth += (*i)->m_work[priority].size();
+    }
+    return depth;
+}
+
+std::size_t scheduler::get_lane_peak_depth(priority_type priority) const
+{
+    BOOST_ASSERT(priority >= PRIORITY_HIGH && priority < NUM_PRIORITIES);
+    std::size_t peak_depth = 0;
+    boost::mutex::scoped_lock pool_lock(m_lanes_mutex);
+    for (lanes_pool_type::const_iterator i = m_lanes_pool.begin(); i != m_lanes_pool.end(); ++i) {
+        boost::mutex::scoped_lock lanes_lock((*i)->m_mutex);
+        if ((*i)->m_peak_depth[priority] > peak_depth)
+            peak_depth = (*i)->m_peak_depth[priority];
+    }
+    return peak_depth;
+}
+
+boost::shared_ptr<scheduler::work_lanes> scheduler::get_work_lanes(boost::asio::io_service& service)
+{
+    boost::mutex::scoped_lock pool_lock(m_lanes_mutex);
+    for (lanes_pool_type::const_iterator i = m_lanes_pool.begin(); i != m_lanes_pool.end(); ++i) {
+        if (&(*i)->m_service == &service)
+            return *i;
+    }
+    boost::shared_ptr<work_lanes> lanes_ptr(new work_lanes(service));
+    m_lanes_pool.push_back(lanes_ptr);
+    return lanes_ptr;
+}
+
+void scheduler::run_priority_work(boost::shared_ptr<work_lanes> lanes_ptr)
+{
+    boost::function0<void> work_func;
+    {
+        boost::mutex::scoped_lock lanes_lock(lanes_ptr->m_mutex);
+
+        // work that has been passed over too many times runs first,
+        // otherwise the most urgent work does
+        int next = NUM_PRIORITIES;
+        for (int p = 0; p < NUM_PRIORITIES && next == NUM_PRIORITIES; ++p) {
+            if (! lanes_ptr->m_work[p].empty() && lanes_ptr->m_num_bypassed[p] >= MAX_PRIORITY_BYPASS)
+                next = p;
+        }
+        for (int p = 0; p < NUM_PRIORITIES && next == NUM_PRIORITIES; ++p) {
+            if (! lanes_ptr->m_work[p].empty())
+                next = p;
+        }
+        if (next == NUM_PRIORITIES)
+            return;
+
+        work_func.swap(lanes_ptr->m_work[next].front());
+        lanes_ptr->m_work[next].pop_front();
+        lanes_ptr->m_num_bypassed[next] = 0;
+        for (int p = 0; p < NUM_PRIORITIES; ++p) {
+            if (p != next && ! lanes_ptr->m_work[p].empty())
+                ++lanes_ptr->m_num_bypassed[p];
+        }
+    }
+    work_func();
+}
+
 boost::system_time scheduler::get_wakeup_time(boost::uint32_t sleep_sec,
     boost::uint32_t sleep_nsec)
 {
@@ -106,18 +848,333 @@ boost::system_time scheduler::get_wakeup_time(boost::uint32_t sleep_sec,
 }
                      
 void scheduler::process_service_work(boost::asio::io_service& service) {
+    get_thread_stats();
     while (m_is_running) {
         try {
-            service.run();
+            if (m_busy_poll_usec > 0)
+                run_busy_poll(service);
+            else
+                service.run();
+        } catch (thread_retired&) {
+            PION_LOG_DEBUG(m_logger, "Scheduler thread retired");
+            break;
         } catch (std::exception& e) {
             PION_LOG_ERROR(m_logger, boost::diagnostic_information(e));
         } catch (...) {
             PION_LOG_ERROR(m_logger, "caught unrecognized exception");
         }
     }   
+    stop_thread_stats();
+}
+
+void scheduler::run_busy_poll(boost::asio::io_service& service)
+{
+    thread_stats& ts(get_thread_stats());
+    while (! service.stopped()) {
+        const boost::uint64_t budget_usec = m_busy_poll_usec;
+        if (budget_usec == 0)
+            break;
+        if (service.poll() > 0)
+            continue;
+
+        // nothing is ready: keep polling until an event arrives, or the
+        // budget runs out (time spent running the handler is not counted)
+        const boost::uint64_t spin_start = get_time_usec();
+        boost::uint64_t spin_usec = 0;
+        bool found_work = false;
+        while (! service.stopped()) {
+            spin_usec = get_time_usec() - spin_start;
+            if (spin_usec >= budget_usec)
+                break;
+            if (service.poll_one() > 0) {
+                found_work = true;
+                break;
+            }
+        }
+
+        {
+            boost::mutex::scoped_lock thread_lock(ts.m_mutex);
+            ts.m_usage.m_spin_usec += spin_usec;
+            if (found_work)
+                ++ts.m_usage.m_num_spin_hits;
+            else
+                ++ts.m_usage.m_num_spin_misses;
+        }
+
+        // block until the next event
+        if (! found_work)
+            service.run_one();
+    }
 }
                      
 
+// multi_thread_scheduler member functions
+
+multi_thread_scheduler::cpu_list_type multi_thread_scheduler::parse_cpu_list(const std::string& str)
+{
+    cpu_list_type cpus;
+    if (str.compare(0, 4, "node") == 0) {
+        try {
+            cpus = get_node_cpus(boost::lexical_cast<boost::uint32_t>(str.substr(4)));
+        } catch (boost::bad_lexical_cast&) {}
+        if (cpus.empty())
+            BOOST_THROW_EXCEPTION( error::bad_arg() << error::errinfo_arg_name(str) );
+        return cpus;
+    }
+
+    std::string::size_type pos = 0;
+    while (pos < str.size()) {
+        std::string::size_type end = str.find(',', pos);
+        if (end == std::string::npos)
+            end = str.size();
+        const std::string range(str, pos, end - pos);
+        const std::string::size_type dash = range.find('-');
+        try {
+            const boost::uint32_t first = boost::lexical_cast<boost::uint32_t>(range.substr(0, dash));
+            const boost::uint32_t last = (dash == std::string::npos ? first
+                : boost::lexical_cast<boost::uint32_t>(range.substr(dash + 1)));
+            if (last < first || last >= MAX_CPUS)
+                BOOST_THROW_EXCEPTION( error::bad_arg() << error::errinfo_arg_name(str) );
+            for (boost::uint32_t cpu = first; cpu <= last; ++cpu)
+                cpus.push_back(cpu);
+        } catch (boost::bad_lexical_cast&) {
+            BOOST_THROW_EXCEPTION( error::bad_arg() << error::errinfo_arg_name(str) );
+        }
+        pos = end + 1;
+    }
+    if (cpus.empty())
+        BOOST_THROW_EXCEPTION( error::bad_arg() << error::errinfo_arg_name(str) );
+    return cpus;
+}
+
+multi_thread_scheduler::cpu_list_type multi_thread_scheduler::get_node_cpus(boost::uint32_t node)
+{
+    cpu_list_type cpus;
+#if defined(__linux__)
+    // the kernel lists the node's CPUs in the same format as parse_cpu_list()
+    std::ifstream cpu_list_file(("/sys/devices/system/node/node"
+        + boost::lexical_cast<std::string>(node) + "/cpulist").c_str());
+    std::string cpu_list;
+    if (std::getline(cpu_list_file, cpu_list) && ! cpu_list.empty()) {
+        try {
+            cpus = parse_cpu_list(cpu_list);
+        } catch (error::bad_arg&) {}
+    }
+#endif
+    return cpus;
+}
+
+bool multi_thread_scheduler::set_thread_affinity(boost::uint32_t cpu)
+{
+    if (cpu >= MAX_CPUS)
+        return false;
+#if defined(__linux__)
+    cpu_set_t cpu_set;
+    CPU_ZERO(&cpu_set);
+    CPU_SET(cpu, &cpu_set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(cpu_set), &cpu_set) == 0;
+#elif defined(PION_WIN32)
+    return SetThreadAffinityMask(GetCurrentThread(), static_cast<DWORD_PTR>(1) << cpu) != 0;
+#else
+    return false;
+#endif
+}
+
+void multi_thread_scheduler::set_num_threads(const boost::uint32_t n)
+{
+    boost::mutex::scoped_lock scheduler_lock(m_mutex);
+    if (m_is_running) {
+        resize_threads(n < m_min_threads ? m_min_threads
+                       : (n > m_max_threads ? m_max_threads : n));
+    } else {
+        m_num_threads = n;
+    }
+}
+
+void multi_thread_scheduler::set_thread_limits(boost::uint32_t min_threads, boost::uint32_t max_threads)
+{
+    if (min_threads == 0 || min_threads > max_threads)
+        BOOST_THROW_EXCEPTION( error::bad_arg() << error::errinfo_arg_name("thread limits") );
+    boost::mutex::scoped_lock scheduler_lock(m_mutex);
+    m_min_threads = min_threads;
+    m_max_threads = max_threads;
+}
+
+boost::uint32_t multi_thread_scheduler::get_queue_latency(void) const
+{
+    boost::mutex::scoped_lock latency_lock(m_latency_mutex);
+    return m_queue_latency;
+}
+
+void multi_thread_scheduler::bind_thread(boost::uint32_t n)
+{
+    if (m_cpu_affinity.empty())
+        return;
+    // this runs before the thread handles any work, so the memory that it
+    // allocates later is first touched on the CPU's own NUMA node
+    const boost::uint32_t cpu = m_cpu_affinity[n % m_cpu_affinity.size()];
+    if (set_thread_affinity(cpu)) {
+        PION_LOG_DEBUG(m_logger, "Pinned scheduler thread " << n << " to CPU " << cpu);
+    } else {
+        PION_LOG_WARN(m_logger, "Unable to pin scheduler thread " << n << " to CPU " << cpu);
+    }
+}
+
+
+void multi_thread_scheduler::start_thread(boost::uint32_t n, boost::asio::io_service& service)
+{
+    boost::shared_ptr<boost::thread> new_thread(new boost::thread( boost::bind(&multi_thread_scheduler::process_pinned_work,
+                                                                               this, n, boost::ref(service)) ));
+    m_thread_pool.push_back(new_thread);
+}
+
+void multi_thread_scheduler::prune_threads(void)
+{
+    ThreadPool::iterator i = m_thread_pool.begin();
+    while (i != m_thread_pool.end()) {
+        // retired threads have already finished, so this does not wait
+        if ((*i)->get_id() != boost::this_thread::get_id()
+            && (*i)->timed_join(boost::posix_time::seconds(0)))
+        {
+            i = m_thread_pool.erase(i);
+        } else {
+            ++i;
+        }
+    }
+}
+
+void multi_thread_scheduler::resize_threads(boost::uint32_t n)
+{
+    if (n != m_num_threads) {
+        PION_LOG_WARN(m_logger, "Scheduler cannot be resized while running; keeping "
+                      << m_num_threads << " threads");
+    }
+}
+
+void multi_thread_scheduler::start_autoscaling(void)
+{
+    if (! m_autoscaling)
+        return;
+    PION_LOG_INFO(m_logger, "Autoscaling scheduler between " << m_min_threads
+                  << " and " << m_max_threads << " threads");
+    m_last_check_time = boost::get_system_time();
+    get_cpu_usage(m_last_cpu_usec, m_last_spin_usec);
+    m_num_idle_intervals = 0;
+    m_num_probes_pending = 0;
+    m_autoscale_thread.reset(new boost::thread(boost::bind(&multi_thread_scheduler::process_autoscaling, this)));
+}
+
+void multi_thread_scheduler::stop_autoscaling(void)
+{
+    if (m_autoscale_thread) {
+        {
+            boost::mutex::scoped_lock latency_lock(m_latency_mutex);
+            m_autoscale_wakeup.notify_all();
+        }
+        m_autoscale_thread->join();
+        m_autoscale_thread.reset();
+    }
+}
+
+void multi_thread_scheduler::process_autoscaling(void)
+{
+    boost::mutex::scoped_lock latency_lock(m_latency_mutex);
+    while (m_is_running) {
+        sleep(m_autoscale_wakeup, latency_lock, AUTOSCALE_INTERVAL_MSEC / 1000,
+              (AUTOSCALE_INTERVAL_MSEC % 1000) * 1000000);
+        if (! m_is_running)
+            break;
+        latency_lock.unlock();
+        autoscale();
+        latency_lock.lock();
+    }
+}
+
+void multi_thread_scheduler::autoscale(void)
+{
+    // measure the interval that has just finished
+    const boost::system_time now(boost::get_system_time());
+    boost::uint64_t cpu_usec;
+    boost::uint64_t spin_usec;
+    get_cpu_usage(cpu_usec, spin_usec);
+    const boost::int64_t elapsed_usec = (now - m_last_check_time).total_microseconds();
+    // the totals go backwards if reset_stats() was called during the interval
+    if (cpu_usec >= m_last_cpu_usec && spin_usec >= m_last_spin_usec
+        && elapsed_usec > 0 && m_num_threads > 0)
+    {
+        // time spent busy polling uses the CPU but is not load
+        const boost::uint64_t used_usec = cpu_usec - m_last_cpu_usec;
+        const boost::uint64_t polled_usec = spin_usec - m_last_spin_usec;
+        const double busy_usec = static_cast<double>(used_usec > polled_usec ? used_usec - polled_usec : 0);
+        const double utilization = busy_usec * 100 / (static_cast<double>(elapsed_usec) * m_num_threads);
+        m_utilization = static_cast<boost::uint32_t>(utilization > 100 ? 100 : utilization);
+    }
+    m_last_check_time = now;
+    m_last_cpu_usec = cpu_usec;
+    m_last_spin_usec = spin_usec;
+    boost::uint32_t queue_latency;
+    bool probes_pending;
+    {
+        boost::mutex::scoped_lock latency_lock(m_latency_mutex);
+        // probes that have not run yet have waited for at least this long
+        probes_pending = (m_num_probes_pending > 0);
+        if (probes_pending) {
+            const boost::int64_t wait_usec = (now - m_probe_time).total_microseconds();
+            if (wait_usec > static_cast<boost::int64_t>(m_peak_latency))
+                m_peak_latency = static_cast<boost::uint32_t>(wait_usec);
+        }
+        m_queue_latency = queue_latency = m_peak_latency;
+        m_peak_latency = 0;
+    }
+
+    // never wait for the scheduler's mutex here, since shutdown() holds it
+    // while it waits for this thread to finish
+    boost::mutex::scoped_try_lock scheduler_lock(m_mutex);
+    if (scheduler_lock.owns_lock() && m_is_running) {
+        if (queue_latency > m_max_queue_latency || m_utilization >= HIGH_UTILIZATION) {
+            m_num_idle_intervals = 0;
+            if (m_num_threads < m_max_threads) {
+                PION_LOG_INFO(m_logger, "Autoscaling up to " << (m_num_threads + 1) << " threads (queue latency "
+                              << queue_latency << "us, utilization " << m_utilization << "%)");
+                resize_threads(m_num_threads + 1);
+            }
+        } else if (queue_latency <= m_max_queue_latency / 10 && m_utilization <= LOW_UTILIZATION) {
+            if (++m_num_idle_intervals >= AUTOSCALE_IDLE_INTERVALS) {
+                m_num_idle_intervals = 0;
+                if (m_num_threads > m_min_threads) {
+                    PION_LOG_INFO(m_logger, "Autoscaling down to " << (m_num_threads - 1) << " threads (queue latency "
+                                  << queue_latency << "us, utilization " << m_utilization << "%)");
+                    resize_threads(m_num_threads - 1);
+                }
+            }
+        } else {
+            m_num_idle_intervals = 0;
+        }
+
+        // probe how long work waits in each of the services used for new work
+        if (! probes_pending) {
+            boost::mutex::scoped_lock latency_lock(m_latency_mutex);
+            m_probe_time = now;
+            m_num_probes_pending = get_num_services();
+            for (boost::uint32_t n = 0; n < m_num_probes_pending; ++n) {
+                get_io_service(n).post(boost::bind(&multi_thread_scheduler::record_queue_latency, this, now));
+            }
+        }
+    }
+
+}
+
+void multi_thread_scheduler::record_queue_latency(const boost::system_time& posted_time)
+{
+    const boost::int64_t latency = (boost::get_system_time() - posted_time).total_microseconds();
+    boost::mutex::scoped_lock latency_lock(m_latency_mutex);
+    if (latency > static_cast<boost::int64_t>(m_peak_latency))
+        m_peak_latency = static_cast<boost::uint32_t>(latency);
+    if (m_num_probes_pending > 0)
+        --m_num_probes_pending;
+}
+
+
 // single_service_scheduler member functions
 
 void single_service_scheduler::startup(void)
@@ -132,13 +1189,48 @@ void single_service_scheduler::startup(void)
         // schedule a work item to make sure that the service doesn't complete
         m_service.reset();
         keep_running(m_service, m_timer);
+        m_num_retiring = 0;
         
         // start multiple threads to handle async tasks
         for (boost::uint32_t n = 0; n < m_num_threads; ++n) {
-            boost::shared_ptr<boost::thread> new_thread(new boost::thread( boost::bind(&scheduler::process_service_work,
-                                                                                       this, boost::ref(m_service)) ));
-            m_thread_pool.push_back(new_thread);
+            start_thread(n, m_service);
+        }
+
+        start_autoscaling();
+    }
+}
+
+void single_service_scheduler::resize_threads(boost::uint32_t n)
+{
+    prune_threads();
+    boost::mutex::scoped_lock resize_lock(m_resize_mutex);
+    const boost::uint32_t num_running = m_num_threads + m_num_retiring;
+    if (n >= num_running) {
+        // keep any threads that are waiting to be retired, and start the rest
+        for (boost::uint32_t i = num_running; i < n; ++i) {
+            start_thread(i, m_service);
+        }
+        m_num_retiring = 0;
+    } else if (n >= m_num_threads) {
+        m_num_retiring = num_running - n;
+    } else {
+        // whichever threads pick up the work are retired, once the work
+        // already queued ahead of it has been run
+        for (boost::uint32_t i = n; i < m_num_threads; ++i) {
+            m_service.post(boost::bind(&single_service_scheduler::retire_thread, this));
         }
+        m_num_retiring += m_num_threads - n;
+    }
+    PION_LOG_INFO(m_logger, "Resized thread scheduler from " << m_num_threads << " to " << n << " threads");
+    m_num_threads = n;
+}
+
+void single_service_scheduler::retire_thread(void)
+{
+    boost::mutex::scoped_lock resize_lock(m_resize_mutex);
+    if (m_num_retiring > 0) {
+        --m_num_retiring;
+        throw thread_retired();
     }
 }
 
@@ -155,10 +1247,147 @@ void one_to_one_scheduler::startup(void)
         m_is_running = true;
         
         // make sure there are enough services initialized
-        while (m_service_pool.size() < m_num_threads) {
+        create_services();
+
+        // schedule a work item for each service to make sure that it doesn't complete
+        for (service_pool_type::iterator i = m_service_pool.begin(); i != m_service_pool.end(); ++i) {
+            keep_running((*i)->first, (*i)->second);
+        }
+        
+        // start multiple threads to handle async tasks
+        for (boost::uint32_t n = 0; n < m_num_threads; ++n) {
+            start_thread(n, m_service_pool[n]->first);
+            m_service_pool[n]->m_has_thread = true;
+        }
+
+        start_autoscaling();
+    }
+}
+
+void one_to_one_scheduler::resize_threads(boost::uint32_t n)
+{
+    // threads read the pool without locking, so it cannot grow past the
+    // space that was reserved for it before the scheduler started
+    if (n > m_service_pool.capacity())
+        n = static_cast<boost::uint32_t>(m_service_pool.capacity());
+    prune_threads();
+    boost::mutex::scoped_lock resize_lock(m_resize_mutex);
+    if (n > m_num_threads) {
+        while (m_service_pool.size() < n) {
             boost::shared_ptr<service_pair_type>  service_ptr(new service_pair_type());
+            keep_running(service_ptr->first, service_ptr->second);
             m_service_pool.push_back(service_ptr);
         }
+        for (boost::uint32_t i = m_num_threads; i < n; ++i) {
+            // services that were retired may still have their threads
+            if (! m_service_pool[i]->m_has_thread) {
+                start_thread(i, m_service_pool[i]->first);
+                m_service_pool[i]->m_has_thread = true;
+            }
+        }
+    } else {
+        for (boost::uint32_t i = n; i < m_num_threads; ++i) {
+            m_service_pool[i]->first.post(boost::bind(&one_to_one_scheduler::retire_service, this,
+                                                      i, false, boost::system::error_code()));
+        }
+    }
+    PION_LOG_INFO(m_logger, "Resized thread scheduler from " << m_num_threads << " to " << n << " threads");
+    const bool is_resized = (n != m_num_threads);
+    m_num_threads = n;
+    if (is_resized) {
+        // the handlers may need locks that are held by our caller, so they
+        // are run by the first service (which is never retired)
+        m_service_pool[0]->first.post(boost::bind(&one_to_one_scheduler::notify_resize, this));
+    }
+}
+
+void one_to_one_scheduler::retire_service(boost::uint32_t n, bool was_idle, const boost::system::error_code& ec)
+{
+    // a newer check has replaced this one
+    if (ec == boost::asio::error::operation_aborted)
+        return;
+
+    service_pair_type& service_pair(*m_service_pool[n]);
+    boost::mutex::scoped_lock resize_lock(m_resize_mutex);
+    if (n < m_num_threads || ! m_is_running)
+        return;     // the service is being used for new work again
+
+    // work chosen for the service just before it was retired may still be
+    // on its way, so it must stay idle for a full interval
+    const bool is_idle = (service_pair.m_load == 0);
+    if (! is_idle || ! was_idle) {
+        service_pair.m_drain_timer.expires_from_now(boost::posix_time::milliseconds(DRAIN_CHECK_MSEC));
+        service_pair.m_drain_timer.async_wait(boost::bind(&one_to_one_scheduler::retire_service, this,
+                                                          n, is_idle, boost::asio::placeholders::error));
+        return;
+    }
+
+    service_pair.m_has_thread = false;
+    throw thread_retired();
+}
+
+scheduler::load_counter_type *one_to_one_scheduler::get_load_counter(boost::asio::io_service& service)
+{
+    boost::mutex::scoped_lock resize_lock(m_resize_mutex);
+    for (service_pool_type::iterator i = m_service_pool.begin(); i != m_service_pool.end(); ++i) {
+        if (&(*i)->first == &service)
+            return &(*i)->m_load;
+    }
+    return NULL;
+}
+
+void one_to_one_scheduler::create_services(void)
+{
+    boost::mutex::scoped_lock resize_lock(m_resize_mutex);
+    // make room for all of the services that resizing may add later
+    if (m_service_pool.empty())
+        m_service_pool.reserve(m_num_threads > m_max_threads ? m_num_threads : m_max_threads);
+    while (m_service_pool.size() < m_num_threads) {
+        boost::shared_ptr<service_pair_type>  service_ptr(new service_pair_type());
+        m_service_pool.push_back(service_ptr);
+    }
+    // the services are published to threads that do not lock once this is set
+    if (m_services_ready == 0)
+        ++m_services_ready;
+}
+
+boost::uint32_t one_to_one_scheduler::select_service(void)
+{
+    // the counter is shared by all threads, so round-robin order is kept
+    // without locking (and ties between loads are broken in the same way)
+    // (the number of services may change while the pool is resized)
+    const boost::uint32_t num_services = m_num_threads;
+    const boost::uint32_t first = static_cast<boost::uint32_t>(static_cast<unsigned long>(++m_next_service) % num_services);
+    if (m_service_policy != POLICY_LEAST_LOADED)
+        return first;
+
+    boost::uint32_t best = first;
+    long best_load = m_service_pool[first]->m_load;
+    for (boost::uint32_t i = 1; i < num_services && best_load > 0; ++i) {
+        const boost::uint32_t n = (first + i) % num_services;
+        const long load = m_service_pool[n]->m_load;
+        if (load < best_load) {
+            best = n;
+            best_load = load;
+        }
+    }
+    return best;
+}
+
+
+// work_stealing_scheduler member functions
+
+void work_stealing_scheduler::startup(void)
+{
+    // lock mutex for thread safety
+    boost::mutex::scoped_lock scheduler_lock(m_mutex);
+    
+    if (! m_is_running) {
+        PION_LOG_INFO(m_logger, "Starting thread scheduler");
+        m_is_running = true;
+        
+        // make sure there are enough services and run queues initialized
+        create_queues();
 
         // schedule a work item for each service to make sure that it doesn't complete
         for (service_pool_type::iterator i = m_service_pool.begin(); i != m_service_pool.end(); ++i) {
@@ -167,12 +1396,174 @@ void one_to_one_scheduler::startup(void)
         
         // start multiple threads to handle async tasks
         for (boost::uint32_t n = 0; n < m_num_threads; ++n) {
-            boost::shared_ptr<boost::thread> new_thread(new boost::thread( boost::bind(&scheduler::process_service_work,
-                                                                                       this, boost::ref(m_service_pool[n]->first)) ));
+            boost::shared_ptr<boost::thread> new_thread(new boost::thread( boost::bind(&work_stealing_scheduler::process_queue_work,
+                                                                                       this, n) ));
             m_thread_pool.push_back(new_thread);
         }
     }
 }
 
+void work_stealing_scheduler::post(boost::function0<void> work_func)
+{
+    // work posted by the owner itself is queued while one of its handlers
+    // (which may be a slow socket handler) is still running
+    work_queue *queue_ptr = m_current_queue.get();
+    bool owner_is_busy = (queue_ptr != NULL);
+    if (queue_ptr == NULL) {
+        // work posted from outside the thread pool is spread across the queues
+        boost::mutex::scoped_lock scheduler_lock(m_mutex);
+        create_queues();
+        if (++m_next_queue >= m_queue_pool.size())
+            m_next_queue = 0;
+        queue_ptr = m_queue_pool[m_next_queue].get();
+    }
+
+    {
+        // work that is already waiting means that the owner has not
+        // returned to its IO service since it was queued
+        boost::mutex::scoped_lock queue_lock(queue_ptr->m_mutex);
+        if (queue_ptr->m_is_busy || ! queue_ptr->m_work.empty())
+            owner_is_busy = true;
+        queue_ptr->m_work.push_back(instrument_work(work_func));
+    }
+    queue_ptr->m_service.post(boost::bind(&work_stealing_scheduler::run_queued_work,
+                                          this, queue_ptr->m_index));
+
+    // the owner will not get to the work until its current item finishes
+    if (owner_is_busy)
+        wake_thief(queue_ptr->m_index);
+}
+
+std::size_t work_stealing_scheduler::get_queued_work(void) const
+{
+    boost::mutex::scoped_lock resize_lock(m_resize_mutex);
+    std::size_t num_queued = 0;
+    for (queue_pool_type::const_iterator i = m_queue_pool.begin(); i != m_queue_pool.end(); ++i) {
+        boost::mutex::scoped_lock queue_lock((*i)->m_mutex);
+        num_queued += (*i)->m_work.size();
+    }
+    return num_queued;
+}
+
+boost::uint64_t work_stealing_scheduler::get_stolen_work(void) const
+{
+    boost::mutex::scoped_lock resize_lock(m_resize_mutex);
+    boost::uint64_t num_stolen = 0;
+    for (queue_pool_type::const_iterator i = m_queue_pool.begin(); i != m_queue_pool.end(); ++i) {
+        boost::mutex::scoped_lock queue_lock((*i)->m_mutex);
+        num_stolen += (*i)->m_num_stolen;
+    }
+    return num_stolen;
+}
+
+void work_stealing_scheduler::process_queue_work(boost::uint32_t n)
+{
+    bind_thread(n);
+    m_current_queue.reset(m_queue_pool[n].get());
+    process_service_work(m_service_pool[n]->first);
+    m_current_queue.reset();
+}
+
+void work_stealing_scheduler::run_queued_work(boost::uint32_t n)
+{
+    boost::function0<void> work_func;
+    for (unsigned int num_run = 0; num_run < MAX_WORK_BATCH_SIZE; ++num_run) {
+        if (! take_work(n, work_func))
+            return;
+        try {
+            work_func();
+        } catch (...) {
+            // make sure that the rest of the queued work still gets run
+            set_idle(n);
+            m_queue_pool[n]->m_service.post(boost::bind(&work_stealing_scheduler::run_queued_work,
+                                                        this, n));
+            throw;
+        }
+    }
+
+    // more work may be waiting -> handle other events before continuing
+    set_idle(n);
+    m_queue_pool[n]->m_service.post(boost::bind(&work_stealing_scheduler::run_queued_work,
+                                                this, n));
+}
+
+bool work_stealing_scheduler::take_work(boost::uint32_t n, boost::function0<void>& work_func)
+{
+    // check the thread's own queue first; the owner stays busy while it
+    // looks for work to steal, so that posts do not wait for it
+    {
+        work_queue& my_queue(*m_queue_pool[n]);
+        boost::mutex::scoped_lock queue_lock(my_queue.m_mutex);
+        my_queue.m_is_busy = true;
+        if (! my_queue.m_work.empty()) {
+            work_func.swap(my_queue.m_work.front());
+            my_queue.m_work.pop_front();
+            return true;
+        }
+    }
+
+    // steal from the other queues, starting with the next one
+    const std::size_t num_queues = get_num_queues();
+    for (std::size_t i = 1; i < num_queues; ++i) {
+        work_queue& other_queue(*m_queue_pool[(n + i) % num_queues]);
+        boost::mutex::scoped_lock queue_lock(other_queue.m_mutex);
+        if (! other_queue.m_work.empty()) {
+            work_func.swap(other_queue.m_work.front());
+            other_queue.m_work.pop_front();
+            ++other_queue.m_num_stolen;
+            return true;
+        }
+    }
+
+    set_idle(n);
+    return false;
+}
+
+void work_stealing_scheduler::set_idle(boost::uint32_t n)
+{
+    work_queue& my_queue(*m_queue_pool[n]);
+    boost::mutex::scoped_lock queue_lock(my_queue.m_mutex);
+    my_queue.m_is_busy = false;
+}
+
+void work_stealing_scheduler::wake_thief(boost::uint32_t n)
+{
+    // wake the first thread after the owner that is idle; if they are all
+    // busy, each one steals the work once its own queue runs dry
+    const std::size_t num_queues = get_num_queues();
+    for (std::size_t i = 1; i < num_queues; ++i) {
+        const boost::uint32_t thief = static_cast<boost::uint32_t>((n + i) % num_queues);
+        work_queue& thief_queue(*m_queue_pool[thief]);
+        {
+            boost::mutex::scoped_lock queue_lock(thief_queue.m_mutex);
+            if (thief_queue.m_is_busy)
+                continue;
+        }
+        thief_queue.m_service.post(boost::bind(&work_stealing_scheduler::run_queued_work,
+                                               this, thief));
+        return;
+    }
+}
+
+std::size_t work_stealing_scheduler::get_num_queues(void)
+{
+    boost::mutex::scoped_lock resize_lock(m_resize_mutex);
+    return m_queue_pool.size();
+}
+
+void work_stealing_scheduler::create_queues(void)
+{
+    create_services();
+    boost::mutex::scoped_lock resize_lock(m_resize_mutex);
+    // make room for every service so that queues never move while threads use them
+    if (m_queue_pool.empty())
+        m_queue_pool.reserve(m_service_pool.capacity());
+    while (m_queue_pool.size() < m_service_pool.size()) {
+        const boost::uint32_t n = static_cast<boost::uint32_t>(m_queue_pool.size());
+        boost::shared_ptr<work_queue>  queue_ptr(new work_queue(m_service_pool[n]->first, n));
+        m_queue_pool.push_back(queue_ptr);
+    }
+}
+
     
 }   // end namespace pion
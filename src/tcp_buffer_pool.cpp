@@ -0,0 +1,150 @@
+// ---------------------------------------------------------------------
+// pion:  a Boost C++ framework for building lightweight HTTP interfaces
+// ---------------------------------------------------------------------
+// Copyright (C) 2007-2014 Splunk Inc.  (https://github.com/splunk/pion)
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See http://www.boost.org/LICENSE_1_0.txt
+//
+
+#include <new>
+#include <boost/assert.hpp>
+#include <boost/detail/atomic_count.hpp>
+#include <boost/thread/tss.hpp>
+#include <pion/tcp/buffer_pool.hpp>
+
+
+namespace pion {    // begin namespace pion
+namespace tcp {     // begin namespace tcp
+
+
+/// log2 of buffer_pool::MIN_BLOCK_SIZE
+static const unsigned int MIN_BLOCK_BITS = 10;
+
+/// number of different block sizes
+static const unsigned int NUM_BLOCK_SIZES = 11;
+
+
+///
+/// free_block_list: a thread's list of free blocks of one size (linked
+/// through the first bytes of each block)
+///
+struct free_block_list {
+    free_block_list(void) : m_head(NULL), m_size(0) {}
+    ~free_block_list() {
+        while (m_head != NULL) {
+            char *next_ptr = *reinterpret_cast<char**>(m_head);
+            ::operator delete(m_head);
+            m_head = next_ptr;
+        }
+    }
+    char *          m_head;
+    std::size_t     m_size;
+};
+
+/// a thread's lists of free blocks, one for each block size
+struct free_block_lists {
+    free_block_list m_lists[NUM_BLOCK_SIZES];
+};
+
+/// number of blocks of one size that have been acquired but not released
+struct block_count {
+    block_count(void) : m_count(0) {}
+    boost::detail::atomic_count m_count;
+};
+
+/// free blocks kept by each thread (deleted when the thread exits)
+static boost::thread_specific_ptr<free_block_lists> g_free_blocks;
+
+/// number of blocks of each size that have been acquired but not released
+static block_count                                  g_blocks_in_use[NUM_BLOCK_SIZES];
+
+/// returns the index used for a valid block size
+static inline unsigned int get_block_index(std::size_t block_size)
+{
+    unsigned int index = 0;
+    while ((std::size_t(buffer_pool::MIN_BLOCK_SIZE) << index) < block_size)
+        ++index;
+    BOOST_ASSERT((std::size_t(buffer_pool::MIN_BLOCK_SIZE) << index) == block_size);
+    BOOST_ASSERT(index < NUM_BLOCK_SIZES);
+    return index;
+}
+
+/// returns the calling thread's list of free blocks for a block size
+static inline free_block_list& get_free_block_list(unsigned int index)
+{
+    free_block_lists *lists_ptr = g_free_blocks.get();
+    if (lists_ptr == NULL) {
+        lists_ptr = new free_block_lists;
+        g_free_blocks.reset(lists_ptr);
+    }
+    return lists_ptr->m_lists[index];
+}
+
+
+// buffer_pool member functions
+
+std::size_t buffer_pool::get_block_size(std::size_t n)
+{
+    if (n >= MAX_BLOCK_SIZE)
+        return MAX_BLOCK_SIZE;
+    std::size_t block_size = MIN_BLOCK_SIZE;
+    while (block_size < n)
+        block_size <<= 1;
+    return block_size;
+}
+
+char *buffer_pool::acquire(std::size_t block_size)
+{
+    const unsigned int index = get_block_index(block_size);
+    ++g_blocks_in_use[index].m_count;
+    free_block_list& free_list = get_free_block_list(index);
+    if (free_list.m_head == NULL)
+        return static_cast<char*>(::operator new(block_size));
+    char *block_ptr = free_list.m_head;
+    free_list.m_head = *reinterpret_cast<char**>(block_ptr);
+    --free_list.m_size;
+    return block_ptr;
+}
+
+void buffer_pool::release(char *block_ptr, std::size_t block_size)
+{
+    const unsigned int index = get_block_index(block_size);
+    --g_blocks_in_use[index].m_count;
+    free_block_list& free_list = get_free_block_list(index);
+    if (free_list.m_size == 0 || (free_list.m_size + 1) * block_size <= MAX_FREE_BYTES) {
+        *reinterpret_cast<char**>(block_ptr) = free_list.m_head;
+        free_list.m_head = block_ptr;
+        ++free_list.m_size;
+    } else {
+        ::operator delete(block_ptr);
+    }
+}
+
+long buffer_pool::get_blocks_in_use(void)
+{
+    long total = 0;
+    for (unsigned int index = 0; index < NUM_BLOCK_SIZES; ++index)
+        total += g_blocks_in_use[index].m_count;
+    return total;
+}
+
+long buffer_pool::get_bytes_in_use(void)
+{
+    long total = 0;
+    for (unsigned int index = 0; index < NUM_BLOCK_SIZES; ++index)
+        total += long(g_blocks_in_use[index].m_count) << (MIN_BLOCK_BITS + index);
+    return total;
+}
+
+std::size_t buffer_pool::get_free_blocks(void)
+{
+    std::size_t total = 0;
+    for (unsigned int index = 0; index < NUM_BLOCK_SIZES; ++index)
+        total += get_free_block_list(index).m_size;
+    return total;
+}
+
+
+}   // end namespace tcp
+}   // end namespace pion
@@ -0,0 +1,169 @@
+// ---------------------------------------------------------------------
+// pion:  a Boost C++ framework for building lightweight HTTP interfaces
+// ---------------------------------------------------------------------
+// Copyright (C) 2007-2014 Splunk Inc.  (https://github.com/splunk/pion)
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See http://www.boost.org/LICENSE_1_0.txt
+//
+
+#include <new>
+#include <pion/tcp/connection_cache.hpp>
+
+
+namespace pion {    // begin namespace pion
+namespace tcp {     // begin namespace tcp
+
+
+// connection_cache member functions
+
+connection_cache::connection_cache(boost::asio::io_service& io_service,
+                                   connection::ssl_context_type& ssl_context,
+                                   connection::connection_handler finished_handler,
+                                   std::size_t max_size)
+    : m_io_service(io_service), m_ssl_context(ssl_context),
+    m_finished_handler(finished_handler), m_block_size(0), m_max_size(max_size),
+    m_acquisitions(0), m_allocations(0)
+{}
+
+connection_cache::~connection_cache()
+{
+    clear();
+}
+
+connection_ptr connection_cache::acquire(const bool ssl_flag)
+{
+    connection *conn_ptr = NULL;
+    {
+        boost::mutex::scoped_lock cache_lock(m_mutex);
+        ++m_acquisitions;
+        if (m_connections.empty()) {
+            ++m_allocations;
+        } else {
+            conn_ptr = m_connections.back();
+            m_connections.pop_back();
+        }
+    }
+
+    if (conn_ptr == NULL) {
+        conn_ptr = new connection(m_io_service, m_ssl_context, ssl_flag, m_finished_handler);
+    } else {
+        conn_ptr->recycle(ssl_flag);
+    }
+
+    boost::weak_ptr<connection_cache> cache_ptr(shared_from_this());
+    return connection_ptr(conn_ptr, recycler(cache_ptr), block_allocator<connection>(cache_ptr));
+}
+
+void connection_cache::clear(void)
+{
+    connection_list_type conn_list;
+    block_list_type block_list;
+    {
+        boost::mutex::scoped_lock cache_lock(m_mutex);
+        conn_list.swap(m_connections);
+        block_list.swap(m_blocks);
+    }
+
+    // free the objects without holding the lock, since deleting a
+    // connection may release its previous control block back to us
+    for (connection_list_type::iterator i = conn_list.begin(); i != conn_list.end(); ++i)
+        delete *i;
+    for (block_list_type::iterator i = block_list.begin(); i != block_list.end(); ++i)
+        ::operator delete(*i);
+}
+
+std::size_t connection_cache::get_max_size(void) const
+{
+    boost::mutex::scoped_lock cache_lock(m_mutex);
+    return m_max_size;
+}
+
+void connection_cache::set_max_size(std::size_t n)
+{
+    boost::mutex::scoped_lock cache_lock(m_mutex);
+    m_max_size = n;
+}
+
+std::size_t connection_cache::get_size(void) const
+{
+    boost::mutex::scoped_lock cache_lock(m_mutex);
+    return m_connections.size();
+}
+
+boost::uint64_t connection_cache::get_acquisitions(void) const
+{
+    boost::mutex::scoped_lock cache_lock(m_mutex);
+    return m_acquisitions;
+}
+
+boost::uint64_t connection_cache::get_allocations(void) const
+{
+    boost::mutex::scoped_lock cache_lock(m_mutex);
+    return m_allocations;
+}
+
+void connection_cache::release(connection *conn_ptr)
+{
+    // nothing else references the object, so it is safe to close it
+    // and return its read buffer here
+    conn_ptr->close();
+    conn_ptr->release_read_buffer();
+
+    boost::mutex::scoped_lock cache_lock(m_mutex);
+    if (m_connections.size() < m_max_size) {
+        m_connections.push_back(conn_ptr);
+    } else {
+        cache_lock.unlock();
+        delete conn_ptr;
+    }
+}
+
+void *connection_cache::allocate_block(const boost::weak_ptr<connection_cache>& cache_ptr,
+                                       std::size_t block_size)
+{
+    connection_cache_ptr cache(cache_ptr.lock());
+    if (cache) {
+        boost::mutex::scoped_lock cache_lock(cache->m_mutex);
+        if (cache->m_block_size == 0)
+            cache->m_block_size = block_size;
+        if (block_size == cache->m_block_size && !cache->m_blocks.empty()) {
+            void *block_ptr = cache->m_blocks.back();
+            cache->m_blocks.pop_back();
+            return block_ptr;
+        }
+        ++cache->m_allocations;
+    }
+    return ::operator new(block_size);
+}
+
+void connection_cache::deallocate_block(const boost::weak_ptr<connection_cache>& cache_ptr,
+                                        void *block_ptr, std::size_t block_size)
+{
+    connection_cache_ptr cache(cache_ptr.lock());
+    if (cache) {
+        boost::mutex::scoped_lock cache_lock(cache->m_mutex);
+        if (block_size == cache->m_block_size && cache->m_blocks.size() < cache->m_max_size) {
+            cache->m_blocks.push_back(block_ptr);
+            return;
+        }
+    }
+    ::operator delete(block_ptr);
+}
+
+
+// connection_cache::recycler member functions
+
+void connection_cache::recycler::operator()(connection *conn_ptr) const
+{
+    connection_cache_ptr cache(m_cache_ptr.lock());
+    if (cache) {
+        cache->release(conn_ptr);
+    } else {
+        delete conn_ptr;
+    }
+}
+
+
+}   // end namespace tcp
+}   // end namespace pion
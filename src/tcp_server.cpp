@@ -9,63 +9,149 @@
 
 #include <boost/asio.hpp>
 #include <boost/bind.hpp>
+#include <boost/filesystem/operations.hpp>
+#include <boost/lexical_cast.hpp>
 #include <boost/thread/mutex.hpp>
 #include <pion/admin_rights.hpp>
+#include <pion/error.hpp>
 #include <pion/tcp/server.hpp>
 
 
 namespace pion {    // begin namespace pion
 namespace tcp {     // begin namespace tcp
 
+
+#ifdef SO_REUSEPORT
+/// socket option that allows multiple acceptors to bind to the same port
+typedef boost::asio::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT>   reuse_port_option;
+#endif
+
+#ifdef TCP_DEFER_ACCEPT
+/// socket option that delays accepting a connection until data arrives
+typedef boost::asio::detail::socket_option::integer<IPPROTO_TCP, TCP_DEFER_ACCEPT>  defer_accept_option;
+#endif
+
+#ifdef TCP_FASTOPEN
+/// socket option that allows clients to send data with their SYN
+typedef boost::asio::detail::socket_option::integer<IPPROTO_TCP, TCP_FASTOPEN>  fast_open_option;
+#endif
+
+#ifdef SO_BUSY_POLL
+/// socket option that busy polls the device queue before a read sleeps
+typedef boost::asio::detail::socket_option::integer<SOL_SOCKET, SO_BUSY_POLL>   busy_poll_option;
+#endif
+
+
+/// converts the value of a server option (throws error::bad_arg if invalid)
+template <typename T>
+static inline T get_option_value(const std::string& name, const std::string& value)
+{
+    try {
+        return boost::lexical_cast<T>(value);
+    } catch (boost::bad_lexical_cast&) {
+        BOOST_THROW_EXCEPTION( error::bad_arg() << error::errinfo_arg_name(name) );
+    }
+}
+
+/// converts the value of a boolean server option (throws error::bad_arg if invalid)
+static inline bool get_bool_option_value(const std::string& name, const std::string& value)
+{
+    if (value == "1" || value == "true")
+        return true;
+    if (value == "0" || value == "false")
+        return false;
+    BOOST_THROW_EXCEPTION( error::bad_arg() << error::errinfo_arg_name(name) );
+}
+
     
 // tcp::server member functions
 
 server::server(scheduler& sched, const unsigned int tcp_port)
     : m_logger(PION_GET_LOGGER("pion.tcp.server")),
     m_active_scheduler(sched),
-    m_tcp_acceptor(m_active_scheduler.get_io_service()),
+    m_tcp_acceptor(m_active_scheduler.get_io_service(0)),
+#ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+    m_local_acceptor(m_active_scheduler.get_io_service(0)),
+#endif
 #ifdef PION_HAVE_SSL
-    m_ssl_context(m_active_scheduler.get_io_service(), boost::asio::ssl::context::sslv23),
+    m_ssl_context(boost::asio::ssl::context::sslv23),
 #else
     m_ssl_context(0),
 #endif
-    m_endpoint(boost::asio::ip::tcp::v4(), tcp_port), m_ssl_flag(false), m_is_listening(false)
+    m_sweep_timer(m_active_scheduler.get_io_service(0)),
+    m_max_cached_connections(connection_cache::DEFAULT_MAX_SIZE),
+    m_endpoint(boost::asio::ip::tcp::v4(), tcp_port), m_ssl_flag(false), m_is_listening(false), m_reuse_port(false),
+    m_read_buffer_size(connection::READ_BUFFER_SIZE),
+    m_max_read_buffer_size(DEFAULT_MAX_READ_BUFFER_SIZE),
+    m_listen_backlog(boost::asio::socket_base::max_connections), m_no_delay(false),
+    m_defer_accept(0), m_fast_open(0), m_receive_buffer_size(0), m_send_buffer_size(0),
+    m_accept_batch_size(1), m_busy_poll(0)
 {}
     
 server::server(scheduler& sched, const boost::asio::ip::tcp::endpoint& endpoint)
     : m_logger(PION_GET_LOGGER("pion.tcp.server")),
     m_active_scheduler(sched),
-    m_tcp_acceptor(m_active_scheduler.get_io_service()),
+    m_tcp_acceptor(m_active_scheduler.get_io_service(0)),
+#ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+    m_local_acceptor(m_active_scheduler.get_io_service(0)),
+#endif
 #ifdef PION_HAVE_SSL
-    m_ssl_context(m_active_scheduler.get_io_service(), boost::asio::ssl::context::sslv23),
+    m_ssl_context(boost::asio::ssl::context::sslv23),
 #else
     m_ssl_context(0),
 #endif
-    m_endpoint(endpoint), m_ssl_flag(false), m_is_listening(false)
+    m_sweep_timer(m_active_scheduler.get_io_service(0)),
+    m_max_cached_connections(connection_cache::DEFAULT_MAX_SIZE),
+    m_endpoint(endpoint), m_ssl_flag(false), m_is_listening(false), m_reuse_port(false),
+    m_read_buffer_size(connection::READ_BUFFER_SIZE),
+    m_max_read_buffer_size(DEFAULT_MAX_READ_BUFFER_SIZE),
+    m_listen_backlog(boost::asio::socket_base::max_connections), m_no_delay(false),
+    m_defer_accept(0), m_fast_open(0), m_receive_buffer_size(0), m_send_buffer_size(0),
+    m_accept_batch_size(1), m_busy_poll(0)
 {}
 
 server::server(const unsigned int tcp_port)
     : m_logger(PION_GET_LOGGER("pion.tcp.server")),
     m_default_scheduler(), m_active_scheduler(m_default_scheduler),
-    m_tcp_acceptor(m_active_scheduler.get_io_service()),
+    m_tcp_acceptor(m_active_scheduler.get_io_service(0)),
+#ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+    m_local_acceptor(m_active_scheduler.get_io_service(0)),
+#endif
 #ifdef PION_HAVE_SSL
-    m_ssl_context(m_active_scheduler.get_io_service(), boost::asio::ssl::context::sslv23),
+    m_ssl_context(boost::asio::ssl::context::sslv23),
 #else
     m_ssl_context(0),
 #endif
-    m_endpoint(boost::asio::ip::tcp::v4(), tcp_port), m_ssl_flag(false), m_is_listening(false)
+    m_sweep_timer(m_active_scheduler.get_io_service(0)),
+    m_max_cached_connections(connection_cache::DEFAULT_MAX_SIZE),
+    m_endpoint(boost::asio::ip::tcp::v4(), tcp_port), m_ssl_flag(false), m_is_listening(false), m_reuse_port(false),
+    m_read_buffer_size(connection::READ_BUFFER_SIZE),
+    m_max_read_buffer_size(DEFAULT_MAX_READ_BUFFER_SIZE),
+    m_listen_backlog(boost::asio::socket_base::max_connections), m_no_delay(false),
+    m_defer_accept(0), m_fast_open(0), m_receive_buffer_size(0), m_send_buffer_size(0),
+    m_accept_batch_size(1), m_busy_poll(0)
 {}
 
 server::server(const boost::asio::ip::tcp::endpoint& endpoint)
     : m_logger(PION_GET_LOGGER("pion.tcp.server")),
     m_default_scheduler(), m_active_scheduler(m_default_scheduler),
-    m_tcp_acceptor(m_active_scheduler.get_io_service()),
+    m_tcp_acceptor(m_active_scheduler.get_io_service(0)),
+#ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+    m_local_acceptor(m_active_scheduler.get_io_service(0)),
+#endif
 #ifdef PION_HAVE_SSL
-    m_ssl_context(m_active_scheduler.get_io_service(), boost::asio::ssl::context::sslv23),
+    m_ssl_context(boost::asio::ssl::context::sslv23),
 #else
     m_ssl_context(0),
 #endif
-    m_endpoint(endpoint), m_ssl_flag(false), m_is_listening(false)
+    m_sweep_timer(m_active_scheduler.get_io_service(0)),
+    m_max_cached_connections(connection_cache::DEFAULT_MAX_SIZE),
+    m_endpoint(endpoint), m_ssl_flag(false), m_is_listening(false), m_reuse_port(false),
+    m_read_buffer_size(connection::READ_BUFFER_SIZE),
+    m_max_read_buffer_size(DEFAULT_MAX_READ_BUFFER_SIZE),
+    m_listen_backlog(boost::asio::socket_base::max_connections), m_no_delay(false),
+    m_defer_accept(0), m_fast_open(0), m_receive_buffer_size(0), m_send_buffer_size(0),
+    m_accept_batch_size(1), m_busy_poll(0)
 {}
     
 void server::start(void)
@@ -74,71 +160,123 @@ void server::start(void)
     boost::mutex::scoped_lock server_lock(m_mutex);
 
     if (! m_is_listening) {
-        PION_LOG_INFO(m_logger, "Starting server on port " << get_port());
+        if (is_local()) {
+            PION_LOG_INFO(m_logger, "Starting server on socket " << m_local_path);
+        } else {
+            PION_LOG_INFO(m_logger, "Starting server on port " << get_port());
+        }
         
         before_starting();
 
         // configure the acceptor service
         try {
             // get admin permissions in case we're binding to a privileged port
-            pion::admin_rights use_admin_rights(get_port() > 0 && get_port() < 1024);
-            m_tcp_acceptor.open(m_endpoint.protocol());
-            // allow the acceptor to reuse the address (i.e. SO_REUSEADDR)
-            // ...except when running not on Windows - see http://msdn.microsoft.com/en-us/library/ms740621%28VS.85%29.aspx
-#ifndef PION_WIN32
-            m_tcp_acceptor.set_option(boost::asio::ip::tcp::acceptor::reuse_address(true));
+            pion::admin_rights use_admin_rights(! is_local() && get_port() > 0 && get_port() < 1024);
+            if (is_local()) {
+                if (m_reuse_port)
+                    PION_LOG_WARN(m_logger, "Reuse port mode is not used for Unix domain sockets");
+                open_local_acceptor();
+            } else
+#ifdef SO_REUSEPORT
+            if (m_reuse_port) {
+                // make sure that all of the scheduler's services are available
+                m_active_scheduler.startup();
+                m_acceptor_pool.clear();
+                for (boost::uint32_t n = 0; n < m_active_scheduler.get_num_services(); ++n) {
+                    service_acceptor_ptr acceptor_ptr(new service_acceptor(get_service_shard(m_active_scheduler.get_io_service(n))));
+                    open_acceptor(acceptor_ptr->m_acceptor, true);
+                    m_acceptor_pool.push_back(acceptor_ptr);
+                }
+            } else
 #endif
-            m_tcp_acceptor.bind(m_endpoint);
-            if (m_endpoint.port() == 0) {
-                // update the endpoint to reflect the port chosen by bind
-                m_endpoint = m_tcp_acceptor.local_endpoint();
+            {
+                if (m_reuse_port)
+                    PION_LOG_WARN(m_logger, "SO_REUSEPORT is not supported; using a single acceptor");
+                open_acceptor(m_tcp_acceptor, false);
             }
-            m_tcp_acceptor.listen();
         } catch (std::exception& e) {
             PION_LOG_ERROR(m_logger, "Unable to bind to port " << get_port() << ": " << e.what());
+            for (acceptor_pool_type::iterator i = m_acceptor_pool.begin(); i != m_acceptor_pool.end(); ++i) {
+                boost::system::error_code ec;
+                (*i)->m_acceptor.close(ec);
+            }
+            m_acceptor_pool.clear();
             throw;
         }
 
         m_is_listening = true;
+        schedule_sweep();
 
         // unlock the mutex since listen() requires its own lock
         server_lock.unlock();
-        listen();
+        if (m_acceptor_pool.empty()) {
+            listen(service_acceptor_ptr());
+        } else {
+            for (acceptor_pool_type::iterator i = m_acceptor_pool.begin(); i != m_acceptor_pool.end(); ++i)
+                listen(*i);
+        }
         
         // notify the thread scheduler that we need it now
         m_active_scheduler.add_active_user();
+
+        if (! m_acceptor_pool.empty()) {
+            // keep an acceptor for each service as the scheduler is resized
+            // (including any resizing since the acceptors were opened)
+            m_active_scheduler.add_resize_handler(this, boost::bind(&server::handle_resize, this));
+            handle_resize();
+        }
     }
 }
 
 void server::stop(bool wait_until_finished)
 {
+    // this waits for the resize handler to finish, so it must not be
+    // called while the server is locked
+    m_active_scheduler.remove_resize_handler(this);
+
     // lock mutex for thread safety
     boost::mutex::scoped_lock server_lock(m_mutex);
 
     if (m_is_listening) {
-        PION_LOG_INFO(m_logger, "Shutting down server on port " << get_port());
+        if (is_local()) {
+            PION_LOG_INFO(m_logger, "Shutting down server on socket " << m_local_path);
+        } else {
+            PION_LOG_INFO(m_logger, "Shutting down server on port " << get_port());
+        }
     
         m_is_listening = false;
+        m_sweep_timer.cancel();
 
         // this terminates any connections waiting to be accepted
         m_tcp_acceptor.close();
+#ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+        if (m_local_acceptor.is_open()) {
+            m_local_acceptor.close();
+            remove_local_socket();
+        }
+#endif
+        for (acceptor_pool_type::iterator i = m_acceptor_pool.begin(); i != m_acceptor_pool.end(); ++i)
+            (*i)->m_acceptor.close();
+        m_acceptor_pool.clear();
         
         if (! wait_until_finished) {
             // this terminates any other open connections
-            std::for_each(m_conn_pool.begin(), m_conn_pool.end(),
-                          boost::bind(&connection::close, _1));
+            std::for_each(m_shard_pool.begin(), m_shard_pool.end(),
+                          boost::bind(&service_shard::close_all, _1));
         }
     
         // wait for all pending connections to complete
-        while (! m_conn_pool.empty()) {
-            // try to prun connections that didn't finish cleanly
-            if (prune_connections() == 0)
-                break;  // if no more left, then we can stop waiting
+        // (prune connections that didn't finish cleanly while waiting)
+        while (prune_connections(m_shard_pool) > 0) {
             // sleep for up to a quarter second to give open connections a chance to finish
             PION_LOG_INFO(m_logger, "Waiting for open connections to finish");
             scheduler::sleep(m_no_more_connections, server_lock, 0, 250000000);
         }
         
+        // free any unused connection objects
+        for (shard_pool_type::iterator i = m_shard_pool.begin(); i != m_shard_pool.end(); ++i)
+            (*i)->m_cache_ptr->clear();
+        
         // notify the thread scheduler that we no longer need it
         m_active_scheduler.remove_active_user();
         
@@ -170,63 +308,331 @@ void server::set_ssl_key_file(const std::string& pem_key_file)
 #endif
 }
 
-void server::listen(void)
+void server::set_option(const std::string& name, const std::string& value)
 {
-    // lock mutex for thread safety
-    boost::mutex::scoped_lock server_lock(m_mutex);
-    
-    if (m_is_listening) {
-        // create a new TCP connection object
-        tcp::connection_ptr new_connection(connection::create(get_io_service(),
-                                                              m_ssl_context, m_ssl_flag,
-                                                              boost::bind(&server::finish_connection,
-                                                                          this, _1)));
-        
-        // prune connections that finished uncleanly
-        prune_connections();
+    if (name == "backlog") {
+        set_listen_backlog(get_option_value<int>(name, value));
+    } else if (name == "no_delay") {
+        set_no_delay(get_bool_option_value(name, value));
+    } else if (name == "defer_accept") {
+        set_defer_accept(get_option_value<int>(name, value));
+    } else if (name == "fast_open") {
+        set_fast_open(get_option_value<int>(name, value));
+    } else if (name == "receive_buffer_size") {
+        set_receive_buffer_size(get_option_value<int>(name, value));
+    } else if (name == "send_buffer_size") {
+        set_send_buffer_size(get_option_value<int>(name, value));
+    } else if (name == "accept_batch_size") {
+        set_accept_batch_size(get_option_value<unsigned int>(name, value));
+    } else if (name == "busy_poll") {
+        set_busy_poll(get_option_value<int>(name, value));
+    } else if (name == "reuse_port") {
+        set_reuse_port(get_bool_option_value(name, value));
+    } else if (name == "read_buffer_size") {
+        set_read_buffer_size(get_option_value<std::size_t>(name, value), get_max_read_buffer_size());
+    } else if (name == "max_read_buffer_size") {
+        set_read_buffer_size(get_read_buffer_size(), get_option_value<std::size_t>(name, value));
+    } else if (name == "max_cached_connections") {
+        set_max_cached_connections(get_option_value<std::size_t>(name, value));
+    } else if (name == "local_path") {
+        set_local_path(value);
+    } else {
+        BOOST_THROW_EXCEPTION( error::bad_arg() << error::errinfo_arg_name(name) );
+    }
+}
+
+void server::open_acceptor(boost::asio::ip::tcp::acceptor& tcp_acceptor, bool reuse_port)
+{
+    tcp_acceptor.open(m_endpoint.protocol());
+    // allow the acceptor to reuse the address (i.e. SO_REUSEADDR)
+    // ...except when running not on Windows - see http://msdn.microsoft.com/en-us/library/ms740621%28VS.85%29.aspx
+#ifndef PION_WIN32
+    tcp_acceptor.set_option(boost::asio::ip::tcp::acceptor::reuse_address(true));
+#endif
+#ifdef SO_REUSEPORT
+    // allow several acceptors to share the same port (i.e. SO_REUSEPORT)
+    if (reuse_port)
+        tcp_acceptor.set_option(reuse_port_option(true));
+#endif
+    // kernel buffer sizes are inherited by accepted connections (and the
+    // receive buffer must be set before listening to affect window scaling)
+    if (m_receive_buffer_size > 0)
+        tcp_acceptor.set_option(boost::asio::socket_base::receive_buffer_size(m_receive_buffer_size));
+    if (m_send_buffer_size > 0)
+        tcp_acceptor.set_option(boost::asio::socket_base::send_buffer_size(m_send_buffer_size));
+    tcp_acceptor.bind(m_endpoint);
+    if (m_endpoint.port() == 0) {
+        // update the endpoint to reflect the port chosen by bind
+        m_endpoint = tcp_acceptor.local_endpoint();
+    }
+    boost::system::error_code ec;
+    if (m_defer_accept > 0) {
+#ifdef TCP_DEFER_ACCEPT
+        tcp_acceptor.set_option(defer_accept_option(m_defer_accept), ec);
+        if (ec)
+            PION_LOG_WARN(m_logger, "Unable to set TCP_DEFER_ACCEPT: " << ec.message());
+#else
+        PION_LOG_WARN(m_logger, "TCP_DEFER_ACCEPT is not supported");
+#endif
+    }
+    if (m_fast_open > 0) {
+#ifdef TCP_FASTOPEN
+        tcp_acceptor.set_option(fast_open_option(m_fast_open), ec);
+        if (ec)
+            PION_LOG_WARN(m_logger, "Unable to set TCP_FASTOPEN: " << ec.message());
+#else
+        PION_LOG_WARN(m_logger, "TCP_FASTOPEN is not supported");
+#endif
+    }
+    if (m_busy_poll > 0) {
+        // this is set for each connection, but checked here so that errors
+        // (such as lacking permission) are only logged once
+#ifdef SO_BUSY_POLL
+        tcp_acceptor.set_option(busy_poll_option(m_busy_poll), ec);
+        if (ec)
+            PION_LOG_WARN(m_logger, "Unable to set SO_BUSY_POLL: " << ec.message());
+#else
+        PION_LOG_WARN(m_logger, "SO_BUSY_POLL is not supported");
+#endif
+    }
+    // batches are accepted without blocking once the listen queue is empty
+    if (m_accept_batch_size > 1)
+        tcp_acceptor.non_blocking(true);
+    tcp_acceptor.listen(m_listen_backlog);
+}
+
+void server::open_local_acceptor(void)
+{
+#ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+    // a socket file left behind by a server that did not stop cleanly
+    // would make bind() fail
+    remove_local_socket();
+    boost::asio::local::stream_protocol::endpoint local_endpoint(m_local_path);
+    m_local_acceptor.open(local_endpoint.protocol());
+    if (m_receive_buffer_size > 0)
+        m_local_acceptor.set_option(boost::asio::socket_base::receive_buffer_size(m_receive_buffer_size));
+    if (m_send_buffer_size > 0)
+        m_local_acceptor.set_option(boost::asio::socket_base::send_buffer_size(m_send_buffer_size));
+    m_local_acceptor.bind(local_endpoint);
+    if (m_accept_batch_size > 1)
+        m_local_acceptor.non_blocking(true);
+    m_local_acceptor.listen(m_listen_backlog);
+#else
+    BOOST_THROW_EXCEPTION( error::bad_arg() << error::errinfo_arg_name("local_path") );
+#endif
+}
+
+void server::remove_local_socket(void)
+{
+    // only remove sockets, never a regular file that happens to have the same name
+    boost::system::error_code ec;
+    if (boost::filesystem::status(m_local_path, ec).type() == boost::filesystem::socket_file)
+        boost::filesystem::remove(m_local_path, ec);
+}
+
+void server::listen(const service_acceptor_ptr& acceptor_ptr)
+{
+    service_shard_ptr shard_ptr;
+    if (acceptor_ptr) {
+        // connections accepted by a service_acceptor stay on its I/O service
+        shard_ptr = acceptor_ptr->m_shard_ptr;
+    } else {
+        // lock mutex for thread safety
+        boost::mutex::scoped_lock server_lock(m_mutex);
+        shard_ptr = get_service_shard(get_io_service());
+    }
 
-        // keep track of the object in the server's connection pool
-        m_conn_pool.insert(new_connection);
+    // the acceptor of a retired service has been closed
+    if (m_is_listening && (! acceptor_ptr || acceptor_ptr->m_acceptor.is_open())) {
+        // get a TCP connection object (reusing an old one if possible)
+        tcp::connection_ptr new_connection(shard_ptr->m_cache_ptr->acquire(m_ssl_flag));
+        new_connection->get_read_buffer().set_size(m_read_buffer_size, m_max_read_buffer_size);
+        
+        // the object is only added to the server's connection pool once it
+        // has been accepted, so that it does not count towards the load
+        shard_ptr->begin_accept();
         
         // use the object to accept a new connection
-        new_connection->async_accept(m_tcp_acceptor,
-                                     boost::bind(&server::handle_accept,
-                                                 this, new_connection,
-                                                 boost::asio::placeholders::error));
+#ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+        if (is_local()) {
+            new_connection->async_accept(m_local_acceptor,
+                                         boost::bind(&server::handle_accept,
+                                                     this, new_connection, acceptor_ptr, shard_ptr,
+                                                     boost::asio::placeholders::error));
+        } else
+#endif
+            new_connection->async_accept(acceptor_ptr ? acceptor_ptr->m_acceptor : m_tcp_acceptor,
+                                         boost::bind(&server::handle_accept,
+                                                     this, new_connection, acceptor_ptr, shard_ptr,
+                                                     boost::asio::placeholders::error));
     }
 }
 
 void server::handle_accept(const tcp::connection_ptr& tcp_conn,
-                             const boost::system::error_code& accept_error)
+                           const service_acceptor_ptr& acceptor_ptr,
+                           const service_shard_ptr& shard_ptr,
+                           const boost::system::error_code& accept_error)
 {
     if (accept_error) {
         // an error occured while trying to a accept a new connection
-        // this happens when the server is being shut down
-        if (m_is_listening) {
-            listen();   // schedule acceptance of another connection
+        // this happens when the server is being shut down, or when the
+        // acceptor of a retired service has been closed
+        if (m_is_listening && (! acceptor_ptr || acceptor_ptr->m_acceptor.is_open())) {
+            listen(acceptor_ptr);   // schedule acceptance of another connection
             PION_LOG_WARN(m_logger, "Accept error on port " << get_port() << ": " << accept_error.message());
         }
-        finish_connection(tcp_conn);
+        finish_accept(shard_ptr);
     } else {
         // got a new TCP connection
         PION_LOG_DEBUG(m_logger, "New" << (tcp_conn->get_ssl_flag() ? " SSL " : " ")
                        << "connection on port " << get_port());
 
-        // schedule the acceptance of another new connection
+        // keep track of the connection in the server's connection pool
+        shard_ptr->add(tcp_conn);
+        shard_ptr->end_accept();
+
+        // take any other connections that are already waiting, then schedule
+        // the acceptance of another new connection
         // (this returns immediately since it schedules it as an event)
-        if (m_is_listening) listen();
+        std::vector<tcp::connection_ptr> new_connections;
+        if (m_is_listening) {
+            if (m_accept_batch_size > 1)
+                accept_pending(acceptor_ptr, new_connections);
+            listen(acceptor_ptr);
+        }
         
-        // handle the new connection
-#ifdef PION_HAVE_SSL
-        if (tcp_conn->get_ssl_flag()) {
-            tcp_conn->async_handshake_server(boost::bind(&server::handle_ssl_handshake,
-                                                         this, tcp_conn,
-                                                         boost::asio::placeholders::error));
-        } else
+        // handle the new connections
+        start_connection(tcp_conn);
+        for (std::vector<tcp::connection_ptr>::const_iterator i = new_connections.begin();
+             i != new_connections.end(); ++i)
+        {
+            start_connection(*i);
+        }
+    }
+}
+
+void server::finish_accept(const service_shard_ptr& shard_ptr)
+{
+    // hold the server lock while it is stopping, so that stop() cannot
+    // return (and the server be destroyed) before we are done with it
+    boost::mutex::scoped_lock server_lock(m_mutex, boost::defer_lock);
+    if (! m_is_listening)
+        server_lock.lock();
+
+    shard_ptr->end_accept();
+
+    // trigger the no more connections condition if we're waiting to stop
+    if (server_lock.owns_lock())
+        m_no_more_connections.notify_all();
+}
+
+void server::handle_resize(void)
+{
+    std::vector<service_acceptor_ptr> new_acceptors;
+    {
+        // lock mutex for thread safety
+        boost::mutex::scoped_lock server_lock(m_mutex);
+        if (! m_is_listening || m_acceptor_pool.empty())
+            return;
+
+        // services are retired from the end of the pool, and the kernel
+        // stops sending connections to a service once its acceptor is closed
+        const boost::uint32_t num_services = m_active_scheduler.get_num_services();
+        while (m_acceptor_pool.size() > num_services) {
+            const service_acceptor_ptr acceptor_ptr(m_acceptor_pool.back());
+            m_acceptor_pool.pop_back();
+            acceptor_ptr->m_shard_ptr->m_service.post(boost::bind(&server::close_acceptor, acceptor_ptr));
+        }
+
+        // open an acceptor for each service that has been added
+        while (m_acceptor_pool.size() < num_services) {
+            const boost::uint32_t n = static_cast<boost::uint32_t>(m_acceptor_pool.size());
+            service_acceptor_ptr acceptor_ptr(new service_acceptor(get_service_shard(m_active_scheduler.get_io_service(n))));
+            try {
+                open_acceptor(acceptor_ptr->m_acceptor, true);
+            } catch (std::exception& e) {
+                PION_LOG_ERROR(m_logger, "Unable to bind to port " << get_port() << ": " << e.what());
+                break;
+            }
+            m_acceptor_pool.push_back(acceptor_ptr);
+            new_acceptors.push_back(acceptor_ptr);
+        }
+    }
+
+    // listen() requires its own lock
+    for (std::vector<service_acceptor_ptr>::iterator i = new_acceptors.begin(); i != new_acceptors.end(); ++i)
+        listen(*i);
+}
+
+void server::close_acceptor(const service_acceptor_ptr& acceptor_ptr)
+{
+    // this makes the pending accept fail, without scheduling another one
+    boost::system::error_code ec;
+    acceptor_ptr->m_acceptor.close(ec);
+}
+
+void server::accept_pending(const service_acceptor_ptr& acceptor_ptr,
+                            std::vector<tcp::connection_ptr>& new_connections)
+{
+    service_shard_ptr shard_ptr;
+    if (acceptor_ptr) {
+        shard_ptr = acceptor_ptr->m_shard_ptr;
+    } else {
+        // lock mutex for thread safety
+        boost::mutex::scoped_lock server_lock(m_mutex);
+        shard_ptr = get_service_shard(get_io_service());
+    }
+
+#ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+    if (is_local())
+        accept_pending(m_local_acceptor, shard_ptr, new_connections);
+    else
 #endif
-            // not SSL -> call the handler immediately
-            handle_connection(tcp_conn);
+        accept_pending(acceptor_ptr ? acceptor_ptr->m_acceptor : m_tcp_acceptor,
+                       shard_ptr, new_connections);
+    if (! new_connections.empty())
+        PION_LOG_DEBUG(m_logger, "Accepted " << new_connections.size()
+                       << " waiting connections on port " << get_port());
+}
+
+template <typename AcceptorType>
+void server::accept_pending(AcceptorType& acceptor, const service_shard_ptr& shard_ptr,
+                            std::vector<tcp::connection_ptr>& new_connections)
+{
+    while (new_connections.size() + 1 < m_accept_batch_size && m_is_listening) {
+        // an unused connection object goes back to the cache when released
+        tcp::connection_ptr new_connection(shard_ptr->m_cache_ptr->acquire(m_ssl_flag));
+        if (new_connection->accept(acceptor))
+            break;  // the listen queue is empty (or the acceptor was closed)
+        new_connection->get_read_buffer().set_size(m_read_buffer_size, m_max_read_buffer_size);
+        shard_ptr->add(new_connection);
+        new_connections.push_back(new_connection);
+    }
+}
+
+void server::start_connection(const tcp::connection_ptr& tcp_conn)
+{
+    if (m_no_delay && ! is_local()) {
+        boost::system::error_code ec;
+        tcp_conn->get_socket().set_option(boost::asio::ip::tcp::no_delay(true), ec);
+    }
+#ifdef SO_BUSY_POLL
+    if (m_busy_poll > 0 && ! is_local()) {
+        boost::system::error_code ec;
+        tcp_conn->get_socket().set_option(busy_poll_option(m_busy_poll), ec);
     }
+#endif
+
+    // handle the new connection
+#ifdef PION_HAVE_SSL
+    if (tcp_conn->get_ssl_flag()) {
+        tcp_conn->async_handshake_server(boost::bind(&server::handle_ssl_handshake,
+                                                     this, tcp_conn,
+                                                     boost::asio::placeholders::error));
+    } else
+#endif
+        // not SSL -> call the handler immediately
+        handle_connection(tcp_conn);
 }
 
 void server::handle_ssl_handshake(const tcp::connection_ptr& tcp_conn,
@@ -236,7 +642,7 @@ void server::handle_ssl_handshake(const tcp::connection_ptr& tcp_conn,
         // an error occured while trying to establish the SSL connection
         PION_LOG_WARN(m_logger, "SSL handshake failed on port " << get_port()
                       << " (" << handshake_error.message() << ')');
-        finish_connection(tcp_conn);
+        tcp_conn->finish();
     } else {
         // handle the new connection
         PION_LOG_DEBUG(m_logger, "SSL handshake succeeded on port " << get_port());
@@ -244,9 +650,8 @@ void server::handle_ssl_handshake(const tcp::connection_ptr& tcp_conn,
     }
 }
 
-void server::finish_connection(const tcp::connection_ptr& tcp_conn)
+void server::finish_connection(service_shard *shard_ptr, const tcp::connection_ptr& tcp_conn)
 {
-    boost::mutex::scoped_lock server_lock(m_mutex);
     if (m_is_listening && tcp_conn->get_keep_alive()) {
         
         // keep the connection alive
@@ -255,41 +660,195 @@ void server::finish_connection(const tcp::connection_ptr& tcp_conn)
     } else {
         PION_LOG_DEBUG(m_logger, "Closing connection on port " << get_port());
         
+        // hold the server lock while it is stopping, so that stop() cannot
+        // return (and the server be destroyed) before we are done with it
+        boost::mutex::scoped_lock server_lock(m_mutex, boost::defer_lock);
+        if (! m_is_listening)
+            server_lock.lock();
+
         // remove the connection from the server's management pool
-        ConnectionPool::iterator conn_itr = m_conn_pool.find(tcp_conn);
-        if (conn_itr != m_conn_pool.end())
-            m_conn_pool.erase(conn_itr);
+        shard_ptr->remove(tcp_conn);
 
         // trigger the no more connections condition if we're waiting to stop
-        if (!m_is_listening && m_conn_pool.empty())
+        if (server_lock.owns_lock())
             m_no_more_connections.notify_all();
     }
 }
 
-std::size_t server::prune_connections(void)
+const server::service_shard_ptr& server::get_service_shard(boost::asio::io_service& service)
 {
     // assumes that a server lock has already been acquired
-    ConnectionPool::iterator conn_itr = m_conn_pool.begin();
-    while (conn_itr != m_conn_pool.end()) {
-        if (conn_itr->unique()) {
-            PION_LOG_WARN(m_logger, "Closing orphaned connection on port " << get_port());
-            ConnectionPool::iterator erase_itr = conn_itr;
-            ++conn_itr;
-            (*erase_itr)->close();
-            m_conn_pool.erase(erase_itr);
-        } else {
-            ++conn_itr;
-        }
+    for (shard_pool_type::const_iterator i = m_shard_pool.begin(); i != m_shard_pool.end(); ++i) {
+        if (&(*i)->m_service == &service)
+            return *i;
+    }
+    service_shard_ptr shard_ptr(new service_shard(service, m_active_scheduler.get_load_counter(service)));
+    shard_ptr->m_cache_ptr.reset(new connection_cache(service, m_ssl_context,
+                                                      boost::bind(&server::finish_connection,
+                                                                  this, shard_ptr.get(), _1),
+                                                      m_max_cached_connections));
+    m_shard_pool.push_back(shard_ptr);
+    return m_shard_pool.back();
+}
+
+std::size_t server::prune_connections(const shard_pool_type& shards)
+{
+    std::vector<tcp::connection_ptr> orphans;
+    std::size_t remaining = 0;
+    for (shard_pool_type::const_iterator i = shards.begin(); i != shards.end(); ++i)
+        remaining += (*i)->prune(orphans);
+
+    // close the orphans outside of the shard locks
+    for (std::vector<tcp::connection_ptr>::iterator i = orphans.begin(); i != orphans.end(); ++i) {
+        PION_LOG_WARN(m_logger, "Closing orphaned connection on port " << get_port());
+        (*i)->close();
     }
 
     // return the number of connections remaining
-    return m_conn_pool.size();
+    return remaining;
+}
+
+void server::schedule_sweep(void)
+{
+    // assumes that a server lock has already been acquired
+    m_sweep_timer.expires_from_now(boost::posix_time::seconds(static_cast<long>(ORPHAN_SWEEP_INTERVAL)));
+    m_sweep_timer.async_wait(boost::bind(&server::handle_sweep, this,
+                                         boost::asio::placeholders::error));
+}
+
+void server::handle_sweep(const boost::system::error_code& ec)
+{
+    if (ec == boost::asio::error::operation_aborted)
+        return;
+
+    shard_pool_type shards;
+    {
+        boost::mutex::scoped_lock server_lock(m_mutex);
+        if (! m_is_listening)
+            return;
+        shards = m_shard_pool;
+        schedule_sweep();
+    }
+
+    // walk the shards without blocking new connections
+    prune_connections(shards);
 }
 
 std::size_t server::get_connections(void) const
 {
     boost::mutex::scoped_lock server_lock(m_mutex);
-    return (m_is_listening ? (m_conn_pool.size() - 1) : m_conn_pool.size());
+    std::size_t total = 0;
+    for (shard_pool_type::const_iterator i = m_shard_pool.begin(); i != m_shard_pool.end(); ++i)
+        total += (*i)->size();
+    return total;
+}
+
+std::size_t server::get_max_cached_connections(void) const
+{
+    boost::mutex::scoped_lock server_lock(m_mutex);
+    return m_max_cached_connections;
+}
+
+void server::set_max_cached_connections(std::size_t n)
+{
+    boost::mutex::scoped_lock server_lock(m_mutex);
+    m_max_cached_connections = n;
+    for (shard_pool_type::iterator i = m_shard_pool.begin(); i != m_shard_pool.end(); ++i)
+        (*i)->m_cache_ptr->set_max_size(n);
+}
+
+boost::uint64_t server::get_total_connections(void) const
+{
+    boost::mutex::scoped_lock server_lock(m_mutex);
+    boost::uint64_t total = 0;
+    for (shard_pool_type::const_iterator i = m_shard_pool.begin(); i != m_shard_pool.end(); ++i)
+        total += (*i)->m_cache_ptr->get_acquisitions();
+    return total;
+}
+
+boost::uint64_t server::get_connection_allocations(void) const
+{
+    boost::mutex::scoped_lock server_lock(m_mutex);
+    boost::uint64_t total = 0;
+    for (shard_pool_type::const_iterator i = m_shard_pool.begin(); i != m_shard_pool.end(); ++i)
+        total += (*i)->m_cache_ptr->get_allocations();
+    return total;
+}
+
+
+
+// tcp::server::service_shard member functions
+
+void server::service_shard::add(const tcp::connection_ptr& tcp_conn)
+{
+    boost::mutex::scoped_lock shard_lock(m_mutex);
+    tcp_conn->set_registry_index(m_connections.size());
+    m_connections.push_back(tcp_conn);
+    if (m_load_ptr != NULL)
+        ++*m_load_ptr;
+}
+
+void server::service_shard::begin_accept(void)
+{
+    boost::mutex::scoped_lock shard_lock(m_mutex);
+    ++m_num_accepting;
+}
+
+void server::service_shard::end_accept(void)
+{
+    boost::mutex::scoped_lock shard_lock(m_mutex);
+    --m_num_accepting;
+}
+
+bool server::service_shard::remove(const tcp::connection_ptr& tcp_conn)
+{
+    boost::mutex::scoped_lock shard_lock(m_mutex);
+    const std::size_t n = tcp_conn->get_registry_index();
+    if (n >= m_connections.size() || m_connections[n] != tcp_conn)
+        return false;
+    // move the last connection into the empty slot
+    if (n + 1 < m_connections.size()) {
+        m_connections[n].swap(m_connections.back());
+        m_connections[n]->set_registry_index(n);
+    }
+    m_connections.pop_back();
+    if (m_load_ptr != NULL)
+        --*m_load_ptr;
+    return true;
+}
+
+void server::service_shard::close_all(void)
+{
+    boost::mutex::scoped_lock shard_lock(m_mutex);
+    std::for_each(m_connections.begin(), m_connections.end(),
+                  boost::bind(&connection::close, _1));
+}
+
+std::size_t server::service_shard::prune(std::vector<tcp::connection_ptr>& orphans)
+{
+    boost::mutex::scoped_lock shard_lock(m_mutex);
+    std::size_t n = 0;
+    while (n < m_connections.size()) {
+        if (m_connections[n].unique()) {
+            orphans.push_back(m_connections[n]);
+            if (n + 1 < m_connections.size()) {
+                m_connections[n].swap(m_connections.back());
+                m_connections[n]->set_registry_index(n);
+            }
+            m_connections.pop_back();
+            if (m_load_ptr != NULL)
+                --*m_load_ptr;
+        } else {
+            ++n;
+        }
+    }
+    return m_connections.size() + m_num_accepting;
+}
+
+std::size_t server::service_shard::size(void) const
+{
+    boost::mutex::scoped_lock shard_lock(m_mutex);
+    return m_connections.size();
 }
 
 }   // end namespace tcp
@@ -0,0 +1,194 @@
+// ---------------------------------------------------------------------
+// pion:  a Boost C++ framework for building lightweight HTTP interfaces
+// ---------------------------------------------------------------------
+// Copyright (C) 2007-2014 Splunk Inc.  (https://github.com/splunk/pion)
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See http://www.boost.org/LICENSE_1_0.txt
+//
+
+#include <boost/bind.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <pion/tcp/timer_wheel.hpp>
+
+
+namespace pion {    // begin namespace pion
+namespace tcp {     // begin namespace tcp
+
+
+// timer_wheel static members
+
+boost::asio::io_service::id     timer_wheel::id;
+
+
+// timer_wheel member functions
+
+timer_wheel::timer_wheel(boost::asio::io_service& io_service)
+    : boost::asio::io_service::service(io_service),
+    m_start_time(boost::posix_time::microsec_clock::universal_time()),
+    m_current(0), m_size(0), m_expired(0), m_timer(io_service),
+    m_timer_active(false), m_shutdown(false)
+{
+    for (unsigned int level = 0; level < WHEEL_LEVELS; ++level)
+        for (unsigned int n = 0; n < WHEEL_SIZE; ++n)
+            m_slots[level][n] = NULL;
+}
+
+void timer_wheel::arm(entry& e, const boost::uint32_t seconds)
+{
+    const boost::uint64_t now = get_now();
+    boost::mutex::scoped_lock wheel_lock(m_mutex);
+    if (e.is_armed()) {
+        remove(e);
+    } else {
+        ++m_size;
+    }
+    if (m_current < now && m_size == 1) {
+        // nothing else is armed, so there are no ticks to catch up on
+        m_current = now;
+    }
+    // round up so that the deadline never expires early
+    e.m_expires = (now > m_current ? now : m_current) + seconds + 1;
+    insert(e);
+    schedule_tick();
+}
+
+void timer_wheel::disarm(entry& e)
+{
+    boost::mutex::scoped_lock wheel_lock(m_mutex);
+    if (e.is_armed()) {
+        remove(e);
+        --m_size;
+    }
+}
+
+std::size_t timer_wheel::get_size(void) const
+{
+    boost::mutex::scoped_lock wheel_lock(m_mutex);
+    return m_size;
+}
+
+boost::uint64_t timer_wheel::get_expired(void) const
+{
+    boost::mutex::scoped_lock wheel_lock(m_mutex);
+    return m_expired;
+}
+
+void timer_wheel::shutdown_service(void)
+{
+    boost::mutex::scoped_lock wheel_lock(m_mutex);
+    m_shutdown = true;
+    boost::system::error_code ec;
+    m_timer.cancel(ec);
+}
+
+boost::uint64_t timer_wheel::get_now(void) const
+{
+    return (boost::posix_time::microsec_clock::universal_time() - m_start_time).total_seconds();
+}
+
+void timer_wheel::insert(entry& e)
+{
+    // pick the level whose range covers the time remaining
+    const boost::uint64_t delta = (e.m_expires > m_current ? e.m_expires - m_current : 0);
+    unsigned int level = 0;
+    while (level + 1 < WHEEL_LEVELS && delta >= (boost::uint64_t(1) << (WHEEL_BITS * (level + 1))))
+        ++level;
+
+    // deadlines beyond the last level are parked in its furthest slot,
+    // and get re-inserted each time that slot cascades
+    const boost::uint64_t max_delta = (boost::uint64_t(1) << (WHEEL_BITS * WHEEL_LEVELS)) - 1;
+    const boost::uint64_t slot_tick = (delta > max_delta ? m_current + max_delta : e.m_expires);
+    entry **slot = &m_slots[level][(slot_tick >> (WHEEL_BITS * level)) & WHEEL_MASK];
+
+    // append to the circular list for the slot
+    if (*slot == NULL) {
+        e.m_prev = e.m_next = &e;
+        *slot = &e;
+    } else {
+        e.m_next = *slot;
+        e.m_prev = (*slot)->m_prev;
+        e.m_prev->m_next = &e;
+        (*slot)->m_prev = &e;
+    }
+    e.m_slot = slot;
+}
+
+void timer_wheel::remove(entry& e)
+{
+    if (e.m_next == &e) {
+        *e.m_slot = NULL;
+    } else {
+        e.m_prev->m_next = e.m_next;
+        e.m_next->m_prev = e.m_prev;
+        if (*e.m_slot == &e)
+            *e.m_slot = e.m_next;
+    }
+    e.m_prev = e.m_next = NULL;
+    e.m_slot = NULL;
+}
+
+void timer_wheel::advance(const boost::uint64_t now)
+{
+    while (m_current < now && m_size > 0)
+        process_tick();
+    if (m_current < now)
+        m_current = now;
+}
+
+void timer_wheel::process_tick(void)
+{
+    ++m_current;
+
+    // move deadlines from higher levels down as their slots come due
+    for (unsigned int level = 1; level < WHEEL_LEVELS; ++level) {
+        if (((m_current >> (WHEEL_BITS * (level - 1))) & WHEEL_MASK) != 0)
+            break;
+        entry **slot = &m_slots[level][(m_current >> (WHEEL_BITS * level)) & WHEEL_MASK];
+        entry *e = *slot;
+        if (e == NULL)
+            continue;
+        // detach the whole list and re-insert each entry relative to the current tick
+        *slot = NULL;
+        e->m_prev->m_next = NULL;
+        while (e != NULL) {
+            entry *next_ptr = e->m_next;
+            insert(*e);
+            e = next_ptr;
+        }
+    }
+
+    // expire all of the deadlines in the current slot
+    entry **slot = &m_slots[0][m_current & WHEEL_MASK];
+    while (*slot != NULL) {
+        entry *e = *slot;
+        remove(*e);
+        --m_size;
+        ++m_expired;
+        e->expired();
+    }
+}
+
+void timer_wheel::schedule_tick(void)
+{
+    if (m_size > 0 && !m_timer_active && !m_shutdown) {
+        m_timer.expires_at(m_start_time + boost::posix_time::seconds(static_cast<long>(m_current + 1)));
+        m_timer.async_wait(boost::bind(&timer_wheel::handle_tick, this,
+                                       boost::asio::placeholders::error));
+        m_timer_active = true;
+    }
+}
+
+void timer_wheel::handle_tick(const boost::system::error_code& /* ec */)
+{
+    boost::mutex::scoped_lock wheel_lock(m_mutex);
+    m_timer_active = false;
+    if (m_shutdown)
+        return;
+    advance(get_now());
+    schedule_tick();
+}
+
+
+}   // end namespace tcp
+}   // end namespace pion
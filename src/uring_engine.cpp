@@ -0,0 +1,678 @@
+// ---------------------------------------------------------------------
+// pion:  a Boost C++ framework for building lightweight HTTP interfaces
+// ---------------------------------------------------------------------
+// Copyright (C) 2007-2014 Splunk Inc.  (https://github.com/splunk/pion)
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See http://www.boost.org/LICENSE_1_0.txt
+//
+
+#include <boost/bind.hpp>
+#include <pion/uring_engine.hpp>
+
+#ifdef PION_HAVE_IO_URING
+    #include <algorithm>
+    #include <cerrno>
+    #include <cstring>
+    #include <sys/mman.h>
+    #include <sys/socket.h>
+    #include <sys/syscall.h>
+    #include <sys/uio.h>
+    #include <unistd.h>
+    #include <linux/io_uring.h>
+#endif
+
+namespace pion {    // begin namespace pion
+
+
+// static members of uring_engine
+
+const boost::uint32_t   uring_engine::DEFAULT_QUEUE_DEPTH = 256;
+const boost::uint32_t   uring_engine::DEFAULT_NUM_BUFFERS = 64;
+const std::size_t       uring_engine::DEFAULT_BUFFER_SIZE = 64 * 1024;   // 64 KB
+uring_engine *          uring_engine::m_instance_ptr = NULL;
+boost::once_flag        uring_engine::m_instance_flag = BOOST_ONCE_INIT;
+
+
+#ifdef PION_HAVE_IO_URING
+
+/// user data of the no-op used to wake up the completion thread
+static const __u64 WAKEUP_USER_DATA = 0;
+
+/// user data of cancellations, whose completions are ignored
+static const __u64 CANCEL_USER_DATA = 1;
+
+/// maximum number of buffers passed to a single socket write
+static const std::size_t MAX_SEND_BUFFERS = 64;
+
+// io_uring is used through its system calls so that liburing is not needed
+
+static inline int sys_io_uring_setup(unsigned entries, struct io_uring_params *params)
+{
+    return static_cast<int>(::syscall(__NR_io_uring_setup, entries, params));
+}
+
+static inline int sys_io_uring_enter(int fd, unsigned to_submit, unsigned min_complete, unsigned flags)
+{
+    return static_cast<int>(::syscall(__NR_io_uring_enter, fd, to_submit, min_complete, flags, NULL, 0));
+}
+
+static inline int sys_io_uring_register(int fd, unsigned opcode, const void *arg, unsigned nr_args)
+{
+    return static_cast<int>(::syscall(__NR_io_uring_register, fd, opcode, arg, nr_args));
+}
+
+
+/// the rings shared with the kernel
+struct uring_engine::ring_type {
+    ring_type(void)
+        : m_fd(-1), m_sq_ptr(MAP_FAILED), m_sq_size(0), m_cq_ptr(MAP_FAILED), m_cq_size(0),
+        m_sqes(static_cast<struct io_uring_sqe*>(MAP_FAILED)), m_sqes_size(0),
+        m_sq_head(NULL), m_sq_tail(NULL), m_sq_array(NULL), m_sq_mask(0), m_sq_entries(0),
+        m_cq_head(NULL), m_cq_tail(NULL), m_cqes(NULL), m_cq_mask(0), m_has_buffers(false)
+    {}
+    ~ring_type() {
+        if (m_sqes != MAP_FAILED)
+            ::munmap(m_sqes, m_sqes_size);
+        if (m_cq_ptr != MAP_FAILED && m_cq_ptr != m_sq_ptr)
+            ::munmap(m_cq_ptr, m_cq_size);
+        if (m_sq_ptr != MAP_FAILED)
+            ::munmap(m_sq_ptr, m_sq_size);
+        if (m_fd >= 0)
+            ::close(m_fd);
+    }
+    /// returns true if there is no room in the submission ring
+    inline bool is_full(void) const {
+        return *m_sq_tail - __atomic_load_n(m_sq_head, __ATOMIC_ACQUIRE) >= m_sq_entries;
+    }
+    /// returns the next submission entry, cleared
+    inline struct io_uring_sqe& get_sqe(void) {
+        struct io_uring_sqe& sqe(m_sqes[*m_sq_tail & m_sq_mask]);
+        std::memset(&sqe, 0, sizeof(sqe));
+        return sqe;
+    }
+    /// adds the entry returned by get_sqe() to the submission ring
+    inline void push_sqe(void) {
+        const unsigned tail = *m_sq_tail;
+        m_sq_array[tail & m_sq_mask] = tail & m_sq_mask;
+        __atomic_store_n(m_sq_tail, tail + 1, __ATOMIC_RELEASE);
+    }
+    int                     m_fd;
+    void *                  m_sq_ptr;
+    std::size_t             m_sq_size;
+    void *                  m_cq_ptr;
+    std::size_t             m_cq_size;
+    struct io_uring_sqe *   m_sqes;
+    std::size_t             m_sqes_size;
+    unsigned *              m_sq_head;
+    unsigned *              m_sq_tail;
+    unsigned *              m_sq_array;
+    unsigned                m_sq_mask;
+    unsigned                m_sq_entries;
+    unsigned *              m_cq_head;
+    unsigned *              m_cq_tail;
+    struct io_uring_cqe *   m_cqes;
+    unsigned                m_cq_mask;
+    bool                    m_has_buffers;
+};
+
+/// an operation that has been queued; its address is the submission's user data
+struct uring_engine::io_request {
+    io_request(read_handler_t handler, boost::asio::io_service& resume_service,
+               int fd, bool is_socket)
+        : m_handler(handler), m_resume_service(&resume_service), m_fd(fd),
+        m_is_socket(is_socket), m_prev(NULL), m_next(NULL)
+    {
+        std::memset(&m_msg, 0, sizeof(m_msg));
+    }
+    read_handler_t              m_handler;
+    boost::asio::io_service *   m_resume_service;
+    int                         m_fd;
+    bool                        m_is_socket;
+    io_request *                m_prev;
+    io_request *                m_next;
+    std::vector<struct iovec>   m_iovs; // must remain valid until the operation has finished
+    struct msghdr               m_msg;
+};
+
+#else
+
+struct uring_engine::ring_type {};
+
+#endif
+
+
+// uring_engine member functions
+
+uring_engine::uring_engine(void)
+    : m_logger(PION_GET_LOGGER("pion.uring_engine")),
+    m_buffer_memory(NULL), m_buffer_size(0), m_num_buffers(0),
+    m_queue_depth(0), m_num_in_flight(0), m_num_queued(0), m_num_socket_in_flight(0),
+    m_requests(NULL), m_num_reads(0), m_num_fixed_reads(0), m_num_batches(0),
+    m_num_socket_ops(0), m_submit_pending(false), m_is_running(false),
+    m_has_socket_io(false), m_has_failed(false)
+{}
+
+uring_engine::~uring_engine()
+{
+    shutdown();
+#ifdef PION_HAVE_IO_URING
+    if (m_buffer_memory != NULL)
+        ::munmap(m_buffer_memory, m_num_buffers * m_buffer_size);
+#endif
+}
+
+void uring_engine::create_instance(void)
+{
+    m_instance_ptr = new uring_engine();
+}
+
+bool uring_engine::start(boost::uint32_t queue_depth, boost::uint32_t num_buffers,
+                         std::size_t buffer_size)
+{
+    boost::mutex::scoped_lock state_lock(m_state_mutex);
+    if (m_is_running)
+        return true;
+
+#ifdef PION_HAVE_IO_URING
+    boost::shared_ptr<ring_type> ring_ptr(new ring_type);
+    struct io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+    ring_ptr->m_fd = sys_io_uring_setup(queue_depth, &params);
+    if (ring_ptr->m_fd < 0) {
+        PION_LOG_WARN(m_logger, "io_uring is not supported: " << std::strerror(errno));
+        return false;
+    }
+
+    // map the submission ring, completion ring and submission entries
+    ring_ptr->m_sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring_ptr->m_cq_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+    bool single_mmap = false;
+#ifdef IORING_FEAT_SINGLE_MMAP
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        single_mmap = true;
+        ring_ptr->m_sq_size = ring_ptr->m_cq_size = (std::max)(ring_ptr->m_sq_size, ring_ptr->m_cq_size);
+    }
+#endif
+    ring_ptr->m_sq_ptr = ::mmap(NULL, ring_ptr->m_sq_size, PROT_READ | PROT_WRITE,
+                                MAP_SHARED | MAP_POPULATE, ring_ptr->m_fd, IORING_OFF_SQ_RING);
+    if (ring_ptr->m_sq_ptr != MAP_FAILED) {
+        ring_ptr->m_cq_ptr = (single_mmap ? ring_ptr->m_sq_ptr
+            : ::mmap(NULL, ring_ptr->m_cq_size, PROT_READ | PROT_WRITE,
+                     MAP_SHARED | MAP_POPULATE, ring_ptr->m_fd, IORING_OFF_CQ_RING));
+    }
+    if (ring_ptr->m_cq_ptr != MAP_FAILED) {
+        ring_ptr->m_sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+        ring_ptr->m_sqes = static_cast<struct io_uring_sqe*>(::mmap(NULL, ring_ptr->m_sqes_size,
+            PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring_ptr->m_fd, IORING_OFF_SQES));
+    }
+    if (ring_ptr->m_sqes == MAP_FAILED) {
+        PION_LOG_WARN(m_logger, "Unable to map the io_uring rings: " << std::strerror(errno));
+        return false;
+    }
+    char *sq_ptr = static_cast<char*>(ring_ptr->m_sq_ptr);
+    char *cq_ptr = static_cast<char*>(ring_ptr->m_cq_ptr);
+    ring_ptr->m_sq_head = reinterpret_cast<unsigned*>(sq_ptr + params.sq_off.head);
+    ring_ptr->m_sq_tail = reinterpret_cast<unsigned*>(sq_ptr + params.sq_off.tail);
+    ring_ptr->m_sq_array = reinterpret_cast<unsigned*>(sq_ptr + params.sq_off.array);
+    ring_ptr->m_sq_mask = *reinterpret_cast<unsigned*>(sq_ptr + params.sq_off.ring_mask);
+    ring_ptr->m_sq_entries = params.sq_entries;
+    ring_ptr->m_cq_head = reinterpret_cast<unsigned*>(cq_ptr + params.cq_off.head);
+    ring_ptr->m_cq_tail = reinterpret_cast<unsigned*>(cq_ptr + params.cq_off.tail);
+    ring_ptr->m_cqes = reinterpret_cast<struct io_uring_cqe*>(cq_ptr + params.cq_off.cqes);
+    ring_ptr->m_cq_mask = *reinterpret_cast<unsigned*>(cq_ptr + params.cq_off.ring_mask);
+
+    // the buffers are allocated once, since they may still be in use
+    // after the engine has been shut down and restarted
+    if (m_buffer_memory == NULL && num_buffers > 0 && buffer_size > 0) {
+        void *buffer_memory = ::mmap(NULL, num_buffers * buffer_size, PROT_READ | PROT_WRITE,
+                                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (buffer_memory != MAP_FAILED) {
+            m_buffer_memory = static_cast<char*>(buffer_memory);
+            m_buffer_size = buffer_size;
+            m_num_buffers = num_buffers;
+            for (boost::uint32_t n = 0; n < m_num_buffers; ++n)
+                m_free_buffers.push_back(m_buffer_memory + n * m_buffer_size);
+        }
+    }
+    if (m_buffer_memory != NULL) {
+        // registering the buffers pins their pages, which may exceed the
+        // locked memory limit; reads then use them as ordinary buffers
+        std::vector<struct iovec> iovecs(m_num_buffers);
+        for (boost::uint32_t n = 0; n < m_num_buffers; ++n) {
+            iovecs[n].iov_base = m_buffer_memory + n * m_buffer_size;
+            iovecs[n].iov_len = m_buffer_size;
+        }
+        if (sys_io_uring_register(ring_ptr->m_fd, IORING_REGISTER_BUFFERS, &iovecs[0], m_num_buffers) != 0) {
+            PION_LOG_WARN(m_logger, "Unable to register io_uring buffers: " << std::strerror(errno));
+        } else {
+            ring_ptr->m_has_buffers = true;
+            PION_LOG_DEBUG(m_logger, "Registered " << m_num_buffers << " io_uring buffers of "
+                << m_buffer_size << " bytes");
+        }
+    }
+
+    // keeping no more reads in flight than there are submission entries
+    // also keeps the completion ring (twice as large) from overflowing
+    boost::mutex::scoped_lock engine_lock(m_mutex);
+    m_queue_depth = ring_ptr->m_sq_entries;
+    m_num_in_flight = m_num_queued = m_num_socket_in_flight = 0;
+    m_requests = NULL;
+    m_submit_pending = false;
+    m_has_failed = false;
+    // without fast polling, socket operations that have to wait for data
+    // would each tie up one of the kernel's io_uring worker threads
+#ifdef IORING_FEAT_FAST_POLL
+    m_has_socket_io = ((params.features & IORING_FEAT_FAST_POLL) != 0);
+#else
+    m_has_socket_io = false;
+#endif
+    m_ring_ptr.swap(ring_ptr);
+    m_is_running = true;
+    engine_lock.unlock();
+
+    m_completion_thread.reset(new boost::thread(boost::bind(&uring_engine::process_completions,
+                                                            this, m_ring_ptr)));
+    PION_LOG_INFO(m_logger, "Started io_uring engine (queue depth = " << m_queue_depth
+        << (m_has_socket_io ? ", with socket I/O)" : ")"));
+    return true;
+#else
+    PION_LOG_WARN(m_logger, "io_uring is not supported on this platform");
+    return false;
+#endif
+}
+
+void uring_engine::shutdown(void)
+{
+    boost::mutex::scoped_lock state_lock(m_state_mutex);
+    if (! m_is_running)
+        return;
+
+#ifdef PION_HAVE_IO_URING
+    // stop accepting operations, submit (or fail) those queued, cancel
+    // socket operations, which may otherwise wait for data indefinitely,
+    // and wait for everything in flight to finish
+    boost::mutex::scoped_lock engine_lock(m_mutex);
+    m_is_running = false;
+    submit_entries();
+    cancel_requests(-1);
+    while (m_num_in_flight > 0)
+        m_reads_finished.wait(engine_lock);
+
+    // a completion thread that has failed stops once nothing is in flight;
+    // otherwise queue a no-op to wake it up
+    bool is_stopping = true;
+    if (! m_has_failed) {
+        ring_type& ring(*m_ring_ptr);
+        struct io_uring_sqe& sqe(ring.get_sqe());
+        sqe.opcode = IORING_OP_NOP;
+        sqe.user_data = WAKEUP_USER_DATA;
+        ring.push_sqe();
+        ++m_num_queued;
+        is_stopping = submit_entries();
+    }
+    engine_lock.unlock();
+
+    if (is_stopping) {
+        m_completion_thread->join();
+    } else {
+        // the thread keeps its own reference to the ring, which it may
+        // still be waiting for
+        PION_LOG_ERROR(m_logger, "Unable to stop the io_uring completion thread");
+        m_completion_thread->detach();
+    }
+    m_completion_thread.reset();
+    release_ring();
+    PION_LOG_INFO(m_logger, "Stopped io_uring engine");
+#endif
+}
+
+bool uring_engine::async_read(int fd, boost::uint64_t offset, char *buf, std::size_t length,
+                              boost::asio::io_service& resume_service, read_handler_t handler)
+{
+#ifdef PION_HAVE_IO_URING
+    boost::mutex::scoped_lock engine_lock(m_mutex);
+    if (! m_is_running || m_has_failed || m_num_in_flight >= m_queue_depth || m_ring_ptr->is_full())
+        return false;
+
+    io_request *request_ptr = new io_request(handler, resume_service, fd, false);
+
+    // only this thread (holding the mutex) writes the submission ring's tail
+    ring_type& ring(*m_ring_ptr);
+    struct io_uring_sqe& sqe(ring.get_sqe());
+    const int buffer_index = (ring.m_has_buffers ? get_buffer_index(buf, length) : -1);
+    if (buffer_index >= 0) {
+        sqe.opcode = IORING_OP_READ_FIXED;
+        sqe.addr = reinterpret_cast<__u64>(buf);
+        sqe.len = static_cast<__u32>(length);
+        sqe.buf_index = static_cast<__u16>(buffer_index);
+        ++m_num_fixed_reads;
+    } else {
+        request_ptr->m_iovs.resize(1);
+        request_ptr->m_iovs[0].iov_base = buf;
+        request_ptr->m_iovs[0].iov_len = length;
+        sqe.opcode = IORING_OP_READV;
+        sqe.addr = reinterpret_cast<__u64>(&request_ptr->m_iovs[0]);
+        sqe.len = 1;
+    }
+    sqe.fd = fd;
+    sqe.off = offset;
+    sqe.user_data = reinterpret_cast<__u64>(request_ptr);
+    ++m_num_reads;
+    queue_request(request_ptr, resume_service);
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool uring_engine::async_recv(int fd, char *buf, std::size_t length,
+                              boost::asio::io_service& resume_service, read_handler_t handler)
+{
+#if defined(PION_HAVE_IO_URING) && defined(IORING_FEAT_FAST_POLL)
+    boost::mutex::scoped_lock engine_lock(m_mutex);
+    if (! m_is_running || ! m_has_socket_io || m_has_failed
+        || m_num_socket_in_flight >= m_queue_depth / 2 || m_ring_ptr->is_full())
+        return false;
+
+    io_request *request_ptr = new io_request(handler, resume_service, fd, true);
+    struct io_uring_sqe& sqe(m_ring_ptr->get_sqe());
+    sqe.opcode = IORING_OP_RECV;
+    sqe.fd = fd;
+    sqe.addr = reinterpret_cast<__u64>(buf);
+    sqe.len = static_cast<__u32>(length);
+    sqe.user_data = reinterpret_cast<__u64>(request_ptr);
+    ++m_num_socket_ops;
+    queue_request(request_ptr, resume_service);
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool uring_engine::async_send(int fd, const std::vector<boost::asio::const_buffer>& buffers,
+                              boost::asio::io_service& resume_service, write_handler_t handler)
+{
+#if defined(PION_HAVE_IO_URING) && defined(IORING_FEAT_FAST_POLL)
+    boost::mutex::scoped_lock engine_lock(m_mutex);
+    if (! m_is_running || ! m_has_socket_io || m_has_failed || buffers.empty()
+        || m_num_socket_in_flight >= m_queue_depth / 2 || m_ring_ptr->is_full())
+        return false;
+
+    // the message and its buffer list must remain valid until the write has
+    // finished, since the kernel may copy them only when the socket is ready
+    io_request *request_ptr = new io_request(handler, resume_service, fd, true);
+    request_ptr->m_iovs.resize((std::min)(buffers.size(), MAX_SEND_BUFFERS));
+    for (std::size_t n = 0; n < request_ptr->m_iovs.size(); ++n) {
+        request_ptr->m_iovs[n].iov_base = const_cast<void*>(boost::asio::buffer_cast<const void*>(buffers[n]));
+        request_ptr->m_iovs[n].iov_len = boost::asio::buffer_size(buffers[n]);
+    }
+    request_ptr->m_msg.msg_iov = &request_ptr->m_iovs[0];
+    request_ptr->m_msg.msg_iovlen = request_ptr->m_iovs.size();
+
+    struct io_uring_sqe& sqe(m_ring_ptr->get_sqe());
+    sqe.opcode = IORING_OP_SENDMSG;
+    sqe.fd = fd;
+    sqe.addr = reinterpret_cast<__u64>(&request_ptr->m_msg);
+    sqe.len = 1;
+    sqe.msg_flags = MSG_NOSIGNAL;
+    sqe.user_data = reinterpret_cast<__u64>(request_ptr);
+    ++m_num_socket_ops;
+    queue_request(request_ptr, resume_service);
+    return true;
+#else
+    return false;
+#endif
+}
+
+void uring_engine::cancel(int fd)
+{
+#ifdef PION_HAVE_IO_URING
+    boost::mutex::scoped_lock engine_lock(m_mutex);
+    if (m_ring_ptr && m_num_socket_in_flight > 0)
+        cancel_requests(fd);
+#endif
+}
+
+void uring_engine::submit_queued(void)
+{
+#ifdef PION_HAVE_IO_URING
+    boost::mutex::scoped_lock engine_lock(m_mutex);
+    m_submit_pending = false;
+    if (m_ring_ptr)
+        submit_entries();
+#endif
+}
+
+bool uring_engine::submit_entries(void)
+{
+#ifdef PION_HAVE_IO_URING
+    while (m_num_queued > 0) {
+        const int result = sys_io_uring_enter(m_ring_ptr->m_fd, m_num_queued, 0, 0);
+        if (result < 0 && errno == EINTR)
+            continue;
+        if (result <= 0) {
+            // fail the operations rather than leaving them queued, since
+            // nothing may ever submit them (or wait for them) again
+            const boost::system::error_code ec((result < 0 ? errno : EAGAIN),
+                                               boost::system::system_category());
+            PION_LOG_ERROR(m_logger, "Unable to submit io_uring operations: " << ec.message());
+            fail_queued(ec);
+            return false;
+        }
+        m_num_queued -= result;
+        ++m_num_batches;
+    }
+#endif
+    return true;
+}
+
+void uring_engine::queue_request(io_request *request_ptr, boost::asio::io_service& resume_service)
+{
+#ifdef PION_HAVE_IO_URING
+    request_ptr->m_next = m_requests;
+    if (m_requests != NULL)
+        m_requests->m_prev = request_ptr;
+    m_requests = request_ptr;
+    if (request_ptr->m_is_socket)
+        ++m_num_socket_in_flight;
+    ++m_num_in_flight;
+    m_ring_ptr->push_sqe();
+    ++m_num_queued;
+
+    // submit everything queued before the resume service runs this
+    // handler using a single system call
+    if (! m_submit_pending) {
+        m_submit_pending = true;
+        resume_service.post(boost::bind(&uring_engine::submit_queued, this));
+    }
+#endif
+}
+
+void uring_engine::finish_request(io_request *request_ptr, const boost::system::error_code& ec,
+                                  std::size_t bytes)
+{
+#ifdef PION_HAVE_IO_URING
+    if (request_ptr->m_prev != NULL)
+        request_ptr->m_prev->m_next = request_ptr->m_next;
+    else
+        m_requests = request_ptr->m_next;
+    if (request_ptr->m_next != NULL)
+        request_ptr->m_next->m_prev = request_ptr->m_prev;
+    if (request_ptr->m_is_socket)
+        --m_num_socket_in_flight;
+    request_ptr->m_resume_service->post(boost::bind(request_ptr->m_handler, ec, bytes));
+    delete request_ptr;
+    if (--m_num_in_flight == 0)
+        m_reads_finished.notify_all();
+#endif
+}
+
+void uring_engine::fail_queued(const boost::system::error_code& ec)
+{
+#ifdef PION_HAVE_IO_URING
+    // entries between the ring's head and tail have not been consumed by
+    // the kernel, so they are finished here and the tail is wound back
+    ring_type& ring(*m_ring_ptr);
+    const unsigned head = __atomic_load_n(ring.m_sq_head, __ATOMIC_ACQUIRE);
+    const unsigned tail = *ring.m_sq_tail;
+    for (unsigned n = head; n != tail; ++n) {
+        const struct io_uring_sqe& sqe(ring.m_sqes[ring.m_sq_array[n & ring.m_sq_mask]]);
+        if (sqe.user_data != WAKEUP_USER_DATA && sqe.user_data != CANCEL_USER_DATA)
+            finish_request(reinterpret_cast<io_request*>(sqe.user_data), ec, 0);
+    }
+    __atomic_store_n(ring.m_sq_tail, head, __ATOMIC_RELEASE);
+    m_num_queued = 0;
+#endif
+}
+
+void uring_engine::cancel_requests(int fd)
+{
+#ifdef PION_HAVE_IO_URING
+    ring_type& ring(*m_ring_ptr);
+    bool is_cancelled = ! m_has_failed;
+    bool is_queued = false;
+    for (io_request *request_ptr = m_requests; is_cancelled && request_ptr != NULL;
+         request_ptr = request_ptr->m_next)
+    {
+        if (! request_ptr->m_is_socket || (fd >= 0 && request_ptr->m_fd != fd))
+            continue;
+        // a failed submission finishes the operations that were queued,
+        // so the list must not be used after it
+        if (ring.is_full() && ! submit_entries()) {
+            is_cancelled = false;
+            break;
+        }
+        struct io_uring_sqe& sqe(ring.get_sqe());
+        sqe.opcode = IORING_OP_ASYNC_CANCEL;
+        sqe.fd = -1;
+        sqe.addr = reinterpret_cast<__u64>(request_ptr);
+        sqe.user_data = CANCEL_USER_DATA;
+        ring.push_sqe();
+        ++m_num_queued;
+        is_queued = true;
+    }
+    if (is_cancelled && is_queued)
+        is_cancelled = submit_entries();
+
+    if (! is_cancelled) {
+        // shutting the sockets down makes the operations in flight finish
+        for (io_request *request_ptr = m_requests; request_ptr != NULL;
+             request_ptr = request_ptr->m_next)
+        {
+            if (request_ptr->m_is_socket && (fd < 0 || request_ptr->m_fd == fd))
+                ::shutdown(request_ptr->m_fd, SHUT_RDWR);
+        }
+    }
+#endif
+}
+
+void uring_engine::process_completions(boost::shared_ptr<ring_type> ring_ptr)
+{
+#ifdef PION_HAVE_IO_URING
+    ring_type& ring(*ring_ptr);
+    bool is_polling = false;
+    bool stopping = false;
+    while (! stopping) {
+        if (is_polling) {
+            boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+        } else if (sys_io_uring_enter(ring.m_fd, 0, 1, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR) {
+            // the ring can no longer be waited for: stop accepting operations,
+            // fail those that have not been submitted and poll for the rest
+            const boost::system::error_code ec(errno, boost::system::system_category());
+            PION_LOG_ERROR(m_logger, "Unable to wait for io_uring completions: " << ec.message());
+            is_polling = true;
+            boost::mutex::scoped_lock engine_lock(m_mutex);
+            if (m_ring_ptr != ring_ptr)
+                break;  // the engine has already given up on this thread
+            m_has_failed = true;
+            fail_queued(ec);
+        }
+
+        boost::mutex::scoped_lock engine_lock(m_mutex);
+        unsigned head = *ring.m_cq_head;
+        const unsigned tail = __atomic_load_n(ring.m_cq_tail, __ATOMIC_ACQUIRE);
+        for (; head != tail; ++head) {
+            const struct io_uring_cqe& cqe(ring.m_cqes[head & ring.m_cq_mask]);
+            if (cqe.user_data == WAKEUP_USER_DATA) {
+                stopping = true;
+                continue;
+            }
+            if (cqe.user_data == CANCEL_USER_DATA)
+                continue;
+            boost::system::error_code ec;
+            std::size_t bytes = 0;
+            if (cqe.res == -ECANCELED)
+                ec = boost::asio::error::operation_aborted;
+            else if (cqe.res < 0)
+                ec = boost::system::error_code(-cqe.res, boost::system::system_category());
+            else
+                bytes = static_cast<std::size_t>(cqe.res);
+            finish_request(reinterpret_cast<io_request*>(cqe.user_data), ec, bytes);
+        }
+        __atomic_store_n(ring.m_cq_head, head, __ATOMIC_RELEASE);
+        if (is_polling && m_num_in_flight == 0)
+            stopping = true;
+    }
+#endif
+}
+
+void uring_engine::release_ring(void)
+{
+    boost::mutex::scoped_lock engine_lock(m_mutex);
+    m_ring_ptr.reset();
+}
+
+int uring_engine::get_buffer_index(const char *buf, std::size_t length) const
+{
+    if (m_buffer_memory == NULL || buf < m_buffer_memory
+        || buf >= m_buffer_memory + m_num_buffers * m_buffer_size)
+        return -1;
+    const std::size_t buffer_index = (buf - m_buffer_memory) / m_buffer_size;
+    if (buf + length > m_buffer_memory + (buffer_index + 1) * m_buffer_size)
+        return -1;
+    return static_cast<int>(buffer_index);
+}
+
+char *uring_engine::acquire_buffer(void)
+{
+    boost::mutex::scoped_lock engine_lock(m_mutex);
+    if (m_free_buffers.empty())
+        return NULL;
+    char *buf = m_free_buffers.back();
+    m_free_buffers.pop_back();
+    return buf;
+}
+
+void uring_engine::release_buffer(char *buf)
+{
+    boost::mutex::scoped_lock engine_lock(m_mutex);
+    m_free_buffers.push_back(buf);
+}
+
+boost::uint64_t uring_engine::get_num_reads(void) const
+{
+    boost::mutex::scoped_lock engine_lock(m_mutex);
+    return m_num_reads;
+}
+
+boost::uint64_t uring_engine::get_num_fixed_reads(void) const
+{
+    boost::mutex::scoped_lock engine_lock(m_mutex);
+    return m_num_fixed_reads;
+}
+
+boost::uint64_t uring_engine::get_num_batches(void) const
+{
+    boost::mutex::scoped_lock engine_lock(m_mutex);
+    return m_num_batches;
+}
+
+boost::uint64_t uring_engine::get_num_socket_ops(void) const
+{
+    boost::mutex::scoped_lock engine_lock(m_mutex);
+    return m_num_socket_ops;
+}
+
+
+}   // end namespace pion
@@ -495,6 +495,45 @@ BOOST_AUTO_TEST_CASE(testHTTPParserSimpleResponse)
     BOOST_CHECK(boost::regex_match(http_response.get_content(), content_regex));
 }
 
+BOOST_AUTO_TEST_CASE(testHTTPParserDirectContent)
+{
+    static const std::string REQUEST_HEAD("POST / HTTP/1.1\r\nContent-Length: 10\r\n\r\nabc");
+    http::parser request_parser(true);
+    request_parser.set_read_buffer(REQUEST_HEAD.c_str(), REQUEST_HEAD.size());
+
+    http::request http_request;
+    boost::system::error_code ec;
+    BOOST_CHECK(boost::indeterminate(request_parser.parse(http_request, ec)));
+    BOOST_CHECK(!ec);
+
+    // the rest of the content may be read straight into the content buffer
+    BOOST_REQUIRE_EQUAL(request_parser.get_direct_content_length(http_request), 7UL);
+    memcpy(http_request.get_content() + request_parser.get_content_bytes_read(), "defg", 4);
+    BOOST_CHECK(boost::indeterminate(request_parser.consume_direct_content(http_request, 4)));
+    BOOST_REQUIRE_EQUAL(request_parser.get_direct_content_length(http_request), 3UL);
+    memcpy(http_request.get_content() + request_parser.get_content_bytes_read(), "hij", 3);
+    BOOST_CHECK(request_parser.consume_direct_content(http_request, 3));
+
+    BOOST_CHECK_EQUAL(request_parser.get_direct_content_length(http_request), 0UL);
+    BOOST_CHECK_EQUAL(request_parser.get_total_bytes_read(), REQUEST_HEAD.size() + 7);
+    BOOST_CHECK_EQUAL(request_parser.get_content_bytes_read(), 10UL);
+    BOOST_CHECK_EQUAL(std::string(http_request.get_content()), "abcdefghij");
+}
+
+BOOST_AUTO_TEST_CASE(testHTTPParserNoDirectContentBeyondMaxSize)
+{
+    static const std::string REQUEST_HEAD("POST / HTTP/1.1\r\nContent-Length: 10\r\n\r\nabc");
+    http::parser request_parser(true);
+    request_parser.set_read_buffer(REQUEST_HEAD.c_str(), REQUEST_HEAD.size());
+    request_parser.set_max_content_length(5);
+
+    // content that does not fit in the content buffer must be parsed
+    http::request http_request;
+    boost::system::error_code ec;
+    BOOST_CHECK(boost::indeterminate(request_parser.parse(http_request, ec)));
+    BOOST_CHECK_EQUAL(request_parser.get_direct_content_length(http_request), 0UL);
+}
+
 BOOST_AUTO_TEST_CASE(testHTTPParserBadRequest)
 {
     http::parser request_parser(true);
@@ -643,6 +682,54 @@ BOOST_AUTO_TEST_CASE(testHTTPParserWithErrorInFooters)
     BOOST_CHECK_EQUAL(http_request.get_header("some-footer"), "some-value");
 }
 
+BOOST_AUTO_TEST_CASE(testHTTPParserLargeChunks)
+{
+    const std::string chunk1(0x1000, 'a');
+    const std::string chunk2(0x2A, 'b');
+    const std::string request_str("POST /upload HTTP/1.1\r\n"
+                                  "Transfer-Encoding: chunked\r\n"
+                                  "\r\n"
+                                  "1000\r\n" + chunk1 + "\r\n"
+                                  "002a;name=value\r\n" + chunk2 + "\r\n"
+                                  "0\r\n"
+                                  "\r\n");
+    boost::system::error_code ec;
+
+    // feed the request a few bytes at a time, so that chunks span read buffers
+    http::parser request_parser(true);
+    http::request http_request;
+    boost::tribool rc = boost::indeterminate;
+    for (std::size_t pos = 0; pos < request_str.size() && boost::indeterminate(rc); pos += 1000) {
+        request_parser.set_read_buffer(request_str.data() + pos, std::min<std::size_t>(1000, request_str.size() - pos));
+        rc = request_parser.parse(http_request, ec);
+    }
+    BOOST_CHECK(rc == true);
+    BOOST_CHECK(!ec);
+    BOOST_CHECK_EQUAL(http_request.get_content_length(), chunk1.size() + chunk2.size());
+    BOOST_CHECK(std::string(http_request.get_content(), http_request.get_content_length()) == chunk1 + chunk2);
+    BOOST_CHECK_EQUAL(request_parser.get_total_bytes_read(), request_str.size());
+
+    // content beyond the maximum length is dropped, but the chunks are still parsed
+    http::parser small_parser(true, 100);
+    small_parser.set_read_buffer(request_str.data(), request_str.size());
+    http::request small_request;
+    BOOST_CHECK(small_parser.parse(small_request, ec) == true);
+    BOOST_CHECK(!ec);
+    BOOST_CHECK_EQUAL(small_request.get_content_length(), 100U);
+    BOOST_CHECK_EQUAL(small_parser.get_total_bytes_read(), request_str.size());
+
+    // chunk sizes that do not fit are rejected
+    const std::string huge_request("POST /upload HTTP/1.1\r\n"
+                                   "Transfer-Encoding: chunked\r\n"
+                                   "\r\n"
+                                   "1" + std::string(sizeof(std::size_t) * 2, '0') + "\r\n");
+    http::parser huge_parser(true);
+    huge_parser.set_read_buffer(huge_request.data(), huge_request.size());
+    http::request huge_http_request;
+    BOOST_CHECK(huge_parser.parse(huge_http_request, ec) == false);
+    BOOST_CHECK_EQUAL(ec.value(), http::parser::ERROR_CHUNK_CHAR);
+}
+
 BOOST_AUTO_TEST_CASE(testHTTP_0_9_RequestParser)
 {
     http::parser request_parser(true);
@@ -696,7 +783,233 @@ BOOST_AUTO_TEST_CASE(testHTTP_0_9_ResponseParser)
     BOOST_CHECK(http_response.is_valid()); // must be a valid response
     BOOST_CHECK(http_response.get_version_major() == 0);
     BOOST_CHECK(response_str.compare(http_response.get_content()) == 0);
-    
+
+}
+
+BOOST_AUTO_TEST_CASE(testHTTPParserLongTextSpans)
+{
+    // spans longer than the parser's SIMD blocks, ending at every offset;
+    // tabs and non-ASCII bytes are part of header values
+    for (std::size_t len = 1; len <= 80; ++len) {
+        std::string value;
+        for (std::size_t n = 0; n < len; ++n)
+            value.push_back(n % 7 == 3 ? '\t' : (n % 11 == 5 ? '\xe9' : static_cast<char>('a' + n % 26)));
+        std::string stem("/");
+        std::string query;
+        for (std::size_t n = 0; n < len; ++n) {
+            stem.push_back(n % 11 == 5 ? '\xe9' : static_cast<char>('a' + n % 26));
+            query.push_back(static_cast<char>('A' + n % 26));
+        }
+        const std::string request_str("GET " + stem + "?" + query + " HTTP/1.1\r\nX-Long-Header-" + query
+                                      + ": v" + value + "\r\n\r\n");
+
+        for (int one_at_a_time = 0; one_at_a_time < 2; ++one_at_a_time) {
+            http::parser request_parser(true);
+            request_parser.set_save_raw_headers(true);
+            http::request http_request;
+            boost::system::error_code ec;
+            boost::tribool rc = boost::indeterminate;
+            if (one_at_a_time) {
+                // spans are split across reads
+                for (std::size_t n = 0; n < request_str.size() && boost::indeterminate(rc); ++n) {
+                    request_parser.set_read_buffer(request_str.data() + n, 1);
+                    rc = request_parser.parse(http_request, ec);
+                }
+            } else {
+                request_parser.set_read_buffer(request_str.data(), request_str.size());
+                rc = request_parser.parse(http_request, ec);
+            }
+            BOOST_REQUIRE(rc == true);
+            BOOST_CHECK(!ec);
+            BOOST_CHECK_EQUAL(http_request.get_resource(), stem);
+            BOOST_CHECK_EQUAL(http_request.get_query_string(), query);
+            BOOST_CHECK_EQUAL(http_request.get_header("X-Long-Header-" + query), "v" + value);
+            BOOST_CHECK_EQUAL(request_parser.get_raw_headers(), request_str);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(testHTTPParserControlCharInLongHeaderValue)
+{
+    static const std::size_t VALUE_SIZE = 70;
+    for (std::size_t pos = 0; pos < VALUE_SIZE; ++pos) {
+        std::string value(VALUE_SIZE, 'x');
+        value[pos] = (pos % 2 ? '\x7f' : '\x01');
+        const std::string request_str("GET / HTTP/1.1\r\nX-Header: " + value + "\r\n\r\n");
+
+        http::parser request_parser(true);
+        request_parser.set_read_buffer(request_str.data(), request_str.size());
+        http::request http_request;
+        boost::system::error_code ec;
+        BOOST_CHECK(request_parser.parse(http_request, ec) == false);
+        BOOST_CHECK_EQUAL(ec.value(), http::parser::ERROR_HEADER_CHAR);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(testHTTPParserHeaderViews)
+{
+    const std::string request_str("POST /search/results?q=pion HTTP/1.1\r\n"
+                                  "Host: www.example.com\r\n"
+                                  "Cookie: session=abc; theme=dark\r\n"
+                                  "X-Forwarded-For: 10.0.0.1\r\n"
+                                  "X-Forwarded-For: 10.0.0.2\r\n"
+                                  "Content-Length: 4\r\n"
+                                  "\r\n"
+                                  "test");
+    http::parser request_parser(true);
+    request_parser.set_parse_header_views(true);
+    request_parser.set_read_buffer(request_str.data(), request_str.size());
+    http::request http_request;
+    boost::system::error_code ec;
+    BOOST_REQUIRE(request_parser.parse(http_request, ec) == true);
+    BOOST_CHECK(!ec);
+
+    // parsing leaves the headers in the header buffer
+    BOOST_CHECK(http_request.has_header_views());
+    BOOST_CHECK_EQUAL(http_request.get_content_length(), 4U);
+    BOOST_CHECK_EQUAL(http_request.get_cookie("theme"), "dark");
+    BOOST_CHECK_EQUAL(http_request.get_query("q"), "pion");
+    BOOST_CHECK(http_request.has_header("content-length"));
+    BOOST_CHECK(! http_request.has_header("Content-Type"));
+    const char *value_ptr;
+    std::size_t value_length;
+    BOOST_REQUIRE(http_request.find_header_view("x-forwarded-for", value_ptr, value_length, 1));
+    BOOST_CHECK_EQUAL(std::string(value_ptr, value_length), "10.0.0.2");
+    BOOST_CHECK(! http_request.find_header_view("X-Forwarded-For", value_ptr, value_length, 2));
+    BOOST_CHECK(http_request.check_keep_alive());
+    BOOST_CHECK(http_request.has_header_views());
+
+    // strings are created once the request line and headers are used
+    BOOST_CHECK_EQUAL(http_request.get_method(), "POST");
+    BOOST_CHECK_EQUAL(http_request.get_resource(), "/search/results");
+    BOOST_CHECK_EQUAL(http_request.get_original_resource(), "/search/results");
+    BOOST_CHECK_EQUAL(http_request.get_query_string(), "q=pion");
+    BOOST_CHECK_EQUAL(http_request.get_header("HOST"), "www.example.com");
+    BOOST_CHECK(! http_request.has_header_views());
+    BOOST_CHECK_EQUAL(http_request.get_headers().count("X-Forwarded-For"), 2U);
+    BOOST_CHECK_EQUAL(http_request.get_headers().size(), 5U);
+
+    // changes made afterwards are kept
+    http_request.change_resource("/other");
+    http_request.change_header(http::types::HEADER_CONNECTION, "close");
+    BOOST_CHECK_EQUAL(http_request.get_resource(), "/other");
+    BOOST_CHECK_EQUAL(http_request.get_original_resource(), "/search/results");
+    BOOST_CHECK(! http_request.check_keep_alive());
+}
+
+BOOST_AUTO_TEST_CASE(testHTTPParserHeaderViewsAfterSync)
+{
+    const std::string request_str("POST /upload HTTP/1.1\r\n"
+                                  "Host: www.example.com\r\n"
+                                  "Connection: close\r\n"
+                                  "Transfer-Encoding: chunked\r\n"
+                                  "\r\n"
+                                  "4\r\n"
+                                  "test\r\n"
+                                  "0\r\n"
+                                  "some-footer: some-value\r\n"
+                                  "\r\n");
+    const std::size_t headers_length = request_str.find("\r\n\r\n") + 4;
+    http::parser request_parser(true);
+    request_parser.set_parse_header_views(true);
+    http::request http_request;
+    boost::system::error_code ec;
+
+    // use the headers before the content and its footers are parsed
+    request_parser.set_read_buffer(request_str.data(), headers_length);
+    BOOST_CHECK(boost::indeterminate(request_parser.parse(http_request, ec)));
+    BOOST_CHECK_EQUAL(http_request.get_header("Host"), "www.example.com");
+    BOOST_CHECK(! http_request.has_header_views());
+
+    // the footer is added as a view after the other headers
+    request_parser.set_read_buffer(request_str.data() + headers_length, request_str.size() - headers_length);
+    BOOST_CHECK(request_parser.parse(http_request, ec) == true);
+    BOOST_CHECK(!ec);
+    BOOST_CHECK(http_request.has_header_views());
+
+    // both the earlier headers and the footer are found
+    BOOST_CHECK(http_request.has_header("Host"));
+    BOOST_CHECK(http_request.has_header("some-footer"));
+    BOOST_CHECK(! http_request.check_keep_alive());
+    BOOST_CHECK(http_request.is_chunked());
+    const char *value_ptr;
+    std::size_t value_length;
+    http_request.add_header_view("Host", 4, "other.example.com", 17);
+    BOOST_REQUIRE(http_request.find_header_view("host", value_ptr, value_length, 1));
+    BOOST_CHECK_EQUAL(std::string(value_ptr, value_length), "other.example.com");
+    BOOST_CHECK_EQUAL(http_request.get_content_length(), 4U);
+    BOOST_CHECK_EQUAL(http_request.get_header("some-footer"), "some-value");
+    BOOST_CHECK_EQUAL(http_request.get_headers().count("Host"), 2U);
+}
+
+BOOST_AUTO_TEST_CASE(testHTTPParserLazyParams)
+{
+    const std::string request_str("POST /form?a=1&b=2 HTTP/1.1\r\n"
+                                  "Cookie: session=abc; theme=dark\r\n"
+                                  "Cookie: lang=en\r\n"
+                                  "Content-Type: application/x-www-form-urlencoded; charset=UTF-8\r\n"
+                                  "Content-Length: 7\r\n"
+                                  "\r\n"
+                                  "c=3&d=4");
+    boost::system::error_code ec;
+
+    // the cookies and query pairs are parsed when they are first used
+    http::parser lazy_parser(true);
+    BOOST_CHECK(lazy_parser.get_lazy_params());
+    lazy_parser.set_read_buffer(request_str.data(), request_str.size());
+    http::request lazy_request;
+    BOOST_REQUIRE(lazy_parser.parse(lazy_request, ec) == true);
+    lazy_request.change_header(http::types::HEADER_COOKIE, "user=pion");
+    BOOST_CHECK(lazy_request.has_cookie("user"));
+    BOOST_CHECK(! lazy_request.has_cookie("session"));
+    BOOST_CHECK_EQUAL(lazy_request.get_cookies().size(), 1U);
+    BOOST_CHECK_EQUAL(lazy_request.get_query("b"), "2");
+    BOOST_CHECK_EQUAL(lazy_request.get_query("d"), "4");
+    BOOST_CHECK_EQUAL(lazy_request.get_queries().size(), 4U);
+
+    // a copy of the request parses them on its own
+    http::parser copied_parser(true);
+    copied_parser.set_read_buffer(request_str.data(), request_str.size());
+    http::request original_request;
+    BOOST_REQUIRE(copied_parser.parse(original_request, ec) == true);
+    http::request copied_request(original_request);
+    BOOST_CHECK_EQUAL(copied_request.get_cookie("lang"), "en");
+    BOOST_CHECK_EQUAL(copied_request.get_queries().size(), 4U);
+    BOOST_CHECK_EQUAL(original_request.get_cookies().size(), 3U);
+
+    // changes made before they are used keep the parsed values
+    http::parser changed_parser(true);
+    changed_parser.set_read_buffer(request_str.data(), request_str.size());
+    http::request changed_request;
+    BOOST_REQUIRE(changed_parser.parse(changed_request, ec) == true);
+    changed_request.add_query("e", "5");
+    changed_request.delete_cookie("theme");
+    BOOST_CHECK_EQUAL(changed_request.get_queries().size(), 5U);
+    BOOST_CHECK_EQUAL(changed_request.get_cookies().size(), 2U);
+
+    // they are parsed with the message if lazy parsing is turned off
+    http::parser eager_parser(true);
+    eager_parser.set_lazy_params(false);
+    eager_parser.set_read_buffer(request_str.data(), request_str.size());
+    http::request eager_request;
+    BOOST_REQUIRE(eager_parser.parse(eager_request, ec) == true);
+    eager_request.change_header(http::types::HEADER_COOKIE, "user=pion");
+    BOOST_CHECK(! eager_request.has_cookie("user"));
+    BOOST_CHECK_EQUAL(eager_request.get_cookie("session"), "abc");
+    BOOST_CHECK_EQUAL(eager_request.get_cookies().size(), 3U);
+    BOOST_CHECK_EQUAL(eager_request.get_queries().size(), 4U);
+
+    // responses defer their Set-Cookie headers too
+    const std::string response_str("HTTP/1.1 200 OK\r\n"
+                                   "Set-Cookie: id=42; Path=/\r\n"
+                                   "Content-Length: 0\r\n"
+                                   "\r\n");
+    http::parser response_parser(false);
+    response_parser.set_read_buffer(response_str.data(), response_str.size());
+    http::response http_response;
+    BOOST_REQUIRE(response_parser.parse(http_response, ec) == true);
+    BOOST_CHECK_EQUAL(http_response.get_cookie("id"), "42");
+    BOOST_CHECK_EQUAL(http_response.get_cookies().size(), 1U);
 }
 
 
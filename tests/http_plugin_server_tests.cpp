@@ -26,6 +26,7 @@
 #include <pion/http/request_writer.hpp>
 #include <pion/http/response_reader.hpp>
 #include <pion/http/plugin_server.hpp>
+#include <pion/tcp/buffer_pool.hpp>
 #include <pion/user.hpp>
 #include <pion/http/basic_auth.hpp>
 #include <pion/http/cookie_auth.hpp>
@@ -39,6 +40,7 @@ PION_DECLARE_PLUGIN(FileService)
 PION_DECLARE_PLUGIN(HelloService)
 PION_DECLARE_PLUGIN(LogService)
 PION_DECLARE_PLUGIN(CookieService)
+PION_DECLARE_PLUGIN(SchedulerService)
 
 #if defined(PION_CMAKE_BUILD)
     #include "plugin_path.hpp"
@@ -439,6 +441,72 @@ BOOST_AUTO_TEST_CASE(checkSendRequestsAndReceiveResponseLeftoverConnection) {
     m_server.stop();
 }
 
+BOOST_AUTO_TEST_CASE(checkKeepAliveTimeoutClosesIdleConnection) {
+    // load simple Hello service and start the server
+    m_server.load_service("/hello", "HelloService");
+    m_server.set_keep_alive_timeout(1);
+    m_server.start();
+    
+    // open a connection
+    pion::tcp::connection tcp_conn(get_io_service());
+    tcp_conn.set_lifecycle(pion::tcp::connection::LIFECYCLE_KEEPALIVE);
+    boost::system::error_code error_code;
+    error_code = tcp_conn.connect(boost::asio::ip::address::from_string("127.0.0.1"), m_server.get_port());
+    BOOST_REQUIRE(! error_code);
+    
+    // send a request and receive the response, which keeps the connection alive
+    http::request http_request("/hello");
+    http_request.send(tcp_conn, error_code);
+    BOOST_REQUIRE(! error_code);
+    http::response http_response(http_request);
+    http_response.receive(tcp_conn, error_code);
+    BOOST_REQUIRE(! error_code);
+    BOOST_CHECK_EQUAL(http_response.get_header(http::types::HEADER_CONNECTION), "Keep-Alive");
+    
+    // the server should close the connection once it has been idle for a second
+    boost::posix_time::ptime start_time(boost::posix_time::microsec_clock::universal_time());
+    tcp_conn.read_some(error_code);
+    BOOST_CHECK(error_code == boost::asio::error::eof);
+    BOOST_CHECK(boost::posix_time::microsec_clock::universal_time() - start_time < boost::posix_time::seconds(5));
+}
+
+BOOST_AUTO_TEST_CASE(checkIdleKeepAliveConnectionReleasesReadBuffer) {
+    // load simple Hello service and start the server
+    m_server.load_service("/hello", "HelloService");
+    m_server.set_release_idle_buffers(true);
+    m_server.start();
+    const long blocks_in_use = pion::tcp::buffer_pool::get_blocks_in_use();
+    
+    // open a connection
+    pion::tcp::connection tcp_conn(get_io_service());
+    tcp_conn.set_lifecycle(pion::tcp::connection::LIFECYCLE_KEEPALIVE);
+    boost::system::error_code error_code;
+    error_code = tcp_conn.connect(boost::asio::ip::address::from_string("127.0.0.1"), m_server.get_port());
+    BOOST_REQUIRE(! error_code);
+    
+    // send a request and receive the response, which keeps the connection alive
+    http::request http_request("/hello");
+    http_request.send(tcp_conn, error_code);
+    BOOST_REQUIRE(! error_code);
+    http::response http_response(http_request);
+    http_response.receive(tcp_conn, error_code);
+    BOOST_REQUIRE(! error_code);
+    BOOST_CHECK_EQUAL(http_response.get_header(http::types::HEADER_CONNECTION), "Keep-Alive");
+    tcp_conn.release_read_buffer();
+    
+    // the server should return its read buffer while waiting for the next request
+    for (int n = 0; n < 10 && pion::tcp::buffer_pool::get_blocks_in_use() > blocks_in_use; ++n)
+        pion::scheduler::sleep(0, 100000000);
+    BOOST_CHECK_EQUAL(pion::tcp::buffer_pool::get_blocks_in_use(), blocks_in_use);
+    
+    // and borrow one again to read it
+    http_request.send(tcp_conn, error_code);
+    BOOST_REQUIRE(! error_code);
+    http_response.receive(tcp_conn, error_code);
+    BOOST_REQUIRE(! error_code);
+    BOOST_CHECK_EQUAL(http_response.get_status_code(), 200U);
+}
+
 BOOST_AUTO_TEST_CASE(checkSendRequestAndReceiveResponseFromEchoService) {
     m_server.load_service("/echo", "EchoService");
     m_server.start();
@@ -471,6 +539,37 @@ BOOST_AUTO_TEST_CASE(checkSendRequestAndReceiveResponseFromEchoService) {
     BOOST_CHECK(boost::regex_match(http_response.get_content(), post_content));
 }
 
+BOOST_AUTO_TEST_CASE(checkSendLargeRequestAndReceiveResponseFromEchoService) {
+    m_server.load_service("/echo", "EchoService");
+    m_server.start();
+
+    // open a connection
+    tcp::connection_ptr tcp_conn(new pion::tcp::connection(get_io_service()));
+    tcp_conn->set_lifecycle(pion::tcp::connection::LIFECYCLE_KEEPALIVE);
+    boost::system::error_code error_code;
+    error_code = tcp_conn->connect(boost::asio::ip::address::from_string("127.0.0.1"), m_server.get_port());
+    BOOST_REQUIRE(!error_code);
+
+    // most of the content is read straight into the request's content buffer
+    const std::string content(200000, 'x');
+    pion::http::request_writer_ptr writer(pion::http::request_writer::create(tcp_conn));
+    writer->get_request().set_method("POST");
+    writer->get_request().set_resource("/echo");
+    writer->write_no_copy(content);
+    writer->send();
+
+    // receive the response from the server
+    http::response http_response(writer->get_request());
+    http_response.receive(*tcp_conn, error_code);
+    BOOST_CHECK(!error_code);
+
+    // check that all of the post content was echoed back
+    BOOST_CHECK(http_response.get_status_code() == 200);
+    const std::string response_content(http_response.get_content(), http_response.get_content_length());
+    BOOST_CHECK(response_content.find("[POST Content]") != std::string::npos);
+    BOOST_CHECK(response_content.find(content) != std::string::npos);
+}
+
 BOOST_AUTO_TEST_CASE(checkRedirectHelloServiceToEchoService) {
     m_server.load_service("/hello", "HelloService");
     m_server.load_service("/echo", "EchoService");
@@ -708,6 +807,11 @@ BOOST_AUTO_TEST_CASE(checkEchoServiceResponseContent) {
                                   boost::regex(".*\\[Request\\sEcho\\].*\\[POST\\sContent\\].*"));
 }
 
+BOOST_AUTO_TEST_CASE(checkSchedulerServiceResponseContent) {
+    checkWebServerResponseContent("SchedulerService", "/scheduler",
+                                  boost::regex("\\{\"schedulers\":\\[\\{\"running\":.*\"queue_delay\":.*\"run_time\":.*\"threads\":\\[.*"));
+}
+
 BOOST_AUTO_TEST_CASE(checkLogServiceResponseContent) {
 #if defined(PION_USE_LOG4CXX) || defined(PION_USE_LOG4CPLUS) || defined(PION_USE_LOG4CPP)
     // make sure that the log level is high enough so that the entry will be recorded
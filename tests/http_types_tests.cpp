@@ -10,6 +10,7 @@
 #include <pion/config.hpp>
 #include <pion/test/unit_test.hpp>
 #include <pion/http/types.hpp>
+#include <boost/lexical_cast.hpp>
 #include <boost/test/unit_test.hpp>
 
 using namespace pion;
@@ -68,4 +69,97 @@ BOOST_AUTO_TEST_CASE(testMultipleHeaderValues) {
     BOOST_CHECK(it == h.end());
 }
 
+BOOST_AUTO_TEST_CASE(testHeadersKeepTheirOrder) {
+    ihash_multimap h;
+    h.insert(std::make_pair("Host", "www.example.com"));
+    h.insert(std::make_pair("X-Custom", "1"));
+    h.insert(std::make_pair("Accept", "*/*"));
+    h.insert(std::make_pair("x-custom", "2"));
+
+    ihash_multimap::const_iterator it = h.begin();
+    BOOST_CHECK_EQUAL(it->first, "Host");
+    BOOST_CHECK_EQUAL((++it)->first, "X-Custom");
+    BOOST_CHECK_EQUAL((++it)->first, "Accept");
+    BOOST_CHECK_EQUAL((++it)->second, "2");
+    BOOST_CHECK(++it == h.end());
+
+    // equal_range visits only the values for the key
+    std::pair<ihash_multimap::const_iterator,ihash_multimap::const_iterator> hp = h.equal_range("X-CUSTOM");
+    BOOST_REQUIRE(hp.first != h.end());
+    BOOST_CHECK_EQUAL(hp.first->second, "1");
+    BOOST_REQUIRE(++hp.first != hp.second);
+    BOOST_CHECK_EQUAL(hp.first->second, "2");
+    BOOST_CHECK(++hp.first == hp.second);
+    BOOST_CHECK_EQUAL(h.count("x-Custom"), 2U);
+}
+
+BOOST_AUTO_TEST_CASE(testKnownHeaderNames) {
+    const std::string names[] = {
+        HEADER_HOST, HEADER_COOKIE, HEADER_SET_COOKIE, HEADER_CONNECTION, HEADER_CONTENT_TYPE,
+        HEADER_CONTENT_LENGTH, HEADER_CONTENT_LOCATION, HEADER_CONTENT_ENCODING,
+        HEADER_CONTENT_DISPOSITION, HEADER_LAST_MODIFIED, HEADER_IF_MODIFIED_SINCE,
+        HEADER_TRANSFER_ENCODING, HEADER_LOCATION, HEADER_AUTHORIZATION, HEADER_REFERER,
+        HEADER_USER_AGENT, HEADER_X_FORWARDED_FOR, HEADER_CLIENT_IP
+    };
+    for (std::size_t n = 0; n < sizeof(names) / sizeof(names[0]); ++n) {
+        BOOST_CHECK(flat_multimap::get_known_key(names[n].data(), names[n].size()) != flat_multimap::KEY_UNKNOWN);
+    }
+    BOOST_CHECK_EQUAL(flat_multimap::get_known_key("CONTENT-length", 14), flat_multimap::KEY_CONTENT_LENGTH);
+    BOOST_CHECK_EQUAL(flat_multimap::get_known_key("Content-Lengths", 15), flat_multimap::KEY_UNKNOWN);
+    BOOST_CHECK_EQUAL(flat_multimap::get_known_key("Hosts", 5), flat_multimap::KEY_UNKNOWN);
+
+    ihash_multimap h;
+    h.insert(std::make_pair("content-length", "10"));
+    BOOST_REQUIRE(h.find(flat_multimap::KEY_CONTENT_LENGTH) != h.end());
+    BOOST_CHECK_EQUAL(h.find(flat_multimap::KEY_CONTENT_LENGTH)->second, "10");
+    BOOST_CHECK(h.find(flat_multimap::KEY_HOST) == h.end());
+}
+
+BOOST_AUTO_TEST_CASE(testEraseHeaderValues) {
+    ihash_multimap h;
+    h.insert(std::make_pair("Cookie", "a=1"));
+    h.insert(std::make_pair("Host", "localhost"));
+    h.insert(std::make_pair("Cookie", "b=2"));
+    h.insert(std::make_pair("X-Custom", "1"));
+    h.insert(std::make_pair("Cookie", "c=3"));
+
+    // the values for a key need not be next to each other
+    std::pair<ihash_multimap::iterator,ihash_multimap::iterator> hp = h.equal_range("cookie");
+    ++hp.first;
+    h.erase(hp.first, hp.second);
+    BOOST_CHECK_EQUAL(h.size(), 3U);
+    BOOST_CHECK_EQUAL(h.count("Cookie"), 1U);
+    BOOST_CHECK_EQUAL(h.find("Cookie")->second, "a=1");
+    BOOST_CHECK_EQUAL(h.find("X-Custom")->second, "1");
+
+    h.erase(h.find("Cookie"));
+    BOOST_CHECK(h.find("Cookie") == h.end());
+    BOOST_CHECK_EQUAL(h.begin()->first, "Host");
+    BOOST_CHECK_EQUAL(h.erase("x-custom"), 1U);
+    BOOST_CHECK_EQUAL(h.size(), 1U);
+    BOOST_CHECK_EQUAL(h.find("Host")->second, "localhost");
+}
+
+BOOST_AUTO_TEST_CASE(testManyQueryParameters) {
+    // large dictionaries use a hash index for their keys
+    ihash_multimap h;
+    for (unsigned int n = 0; n < 1000; ++n)
+        h.insert(std::make_pair("field" + boost::lexical_cast<std::string>(n % 500),
+                                boost::lexical_cast<std::string>(n)));
+    BOOST_CHECK_EQUAL(h.size(), 1000U);
+    for (unsigned int n = 0; n < 500; ++n) {
+        const std::string key("FIELD" + boost::lexical_cast<std::string>(n));
+        BOOST_REQUIRE(h.find(key) != h.end());
+        BOOST_CHECK_EQUAL(h.find(key)->second, boost::lexical_cast<std::string>(n));
+        BOOST_CHECK_EQUAL(h.count(key), 2U);
+    }
+    BOOST_CHECK(h.find("field500") == h.end());
+
+    // the index is rebuilt after entries are removed
+    h.erase("field0");
+    BOOST_CHECK_EQUAL(h.size(), 998U);
+    BOOST_CHECK(h.find("field0") == h.end());
+    BOOST_CHECK_EQUAL(h.find("field499")->second, "499");
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,848 @@
+// ---------------------------------------------------------------------
+// pion:  a Boost C++ framework for building lightweight HTTP interfaces
+// ---------------------------------------------------------------------
+// Copyright (C) 2007-2014 Splunk Inc.  (https://github.com/splunk/pion)
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See http://www.boost.org/LICENSE_1_0.txt
+//
+
+#include <boost/bind.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition.hpp>
+#include <boost/test/unit_test.hpp>
+#include <pion/config.hpp>
+#include <pion/error.hpp>
+#include <pion/scheduler.hpp>
+
+#if defined(__linux__)
+    #include <sched.h>
+#endif
+
+using namespace std;
+using namespace pion;
+
+
+///
+/// work_stealing_scheduler_F: fixture that counts work run by a work_stealing_scheduler
+///
+class work_stealing_scheduler_F {
+public:
+    work_stealing_scheduler_F() : m_num_done(0), m_was_stolen(false) {
+        m_scheduler.set_num_threads(4);
+        m_scheduler.add_active_user();
+    }
+    ~work_stealing_scheduler_F() {
+        m_scheduler.remove_active_user();
+        m_scheduler.shutdown();
+    }
+
+    /// work item that sleeps for a number of milliseconds
+    void doWork(boost::uint32_t msec) {
+        if (msec > 0)
+            scheduler::sleep(0, msec * 1000000);
+        boost::mutex::scoped_lock work_lock(m_mutex);
+        ++m_num_done;
+        m_work_done.notify_all();
+    }
+
+    /// work item that posts more work from within the thread pool
+    void postMoreWork(unsigned int num_items) {
+        for (unsigned int n = 0; n < num_items; ++n)
+            m_scheduler.post(boost::bind(&work_stealing_scheduler_F::doWork, this, 0));
+        doWork(0);
+    }
+
+    /// work item that queues another one for its own thread, and then
+    /// blocks until some other thread has run it
+    void waitForQueuedWork(void) {
+        m_scheduler.post(boost::bind(&work_stealing_scheduler_F::doWork, this, 0));
+        m_was_stolen = waitForWork(1);
+        doWork(0);
+    }
+
+    /// IO service handler (not posted work, like a socket handler) that
+    /// queues work for its own thread, and then blocks until some other
+    /// thread has run it
+    void postFromHandler(void) {
+        m_scheduler.post(boost::bind(&work_stealing_scheduler_F::doWork, this, 0));
+        m_was_stolen = waitForWork(1);
+        doWork(0);
+    }
+
+    /// waits for up to five seconds for some number of work items to finish
+    bool waitForWork(unsigned int num_items) {
+        boost::mutex::scoped_lock work_lock(m_mutex);
+        while (m_num_done < num_items) {
+            if (! m_work_done.timed_wait(work_lock, boost::get_system_time() + boost::posix_time::seconds(5)))
+                return false;
+        }
+        return true;
+    }
+
+    work_stealing_scheduler     m_scheduler;
+    boost::mutex                m_mutex;
+    boost::condition            m_work_done;
+    unsigned int                m_num_done;
+    bool                        m_was_stolen;
+};
+
+BOOST_FIXTURE_TEST_SUITE(work_stealing_scheduler_S, work_stealing_scheduler_F)
+
+BOOST_AUTO_TEST_CASE(checkAllPostedWorkIsRun) {
+    for (unsigned int n = 0; n < 1000; ++n)
+        m_scheduler.post(boost::bind(&work_stealing_scheduler_F::doWork, this, 0));
+    BOOST_CHECK(waitForWork(1000));
+    BOOST_CHECK_EQUAL(m_scheduler.get_queued_work(), 0U);
+}
+
+BOOST_AUTO_TEST_CASE(checkWorkPostedFromPoolThreadsIsRun) {
+    for (unsigned int n = 0; n < 10; ++n)
+        m_scheduler.post(boost::bind(&work_stealing_scheduler_F::postMoreWork, this, 10));
+    BOOST_CHECK(waitForWork(110));
+}
+
+BOOST_AUTO_TEST_CASE(checkWorkQueuedBehindBusyOwnerIsStolen) {
+    // the owner cannot run the work item that it queued until it is done
+    m_scheduler.post(boost::bind(&work_stealing_scheduler_F::waitForQueuedWork, this));
+    BOOST_CHECK(waitForWork(2));
+    BOOST_CHECK(m_was_stolen);
+    BOOST_CHECK_EQUAL(m_scheduler.get_stolen_work(), 1U);
+}
+
+BOOST_AUTO_TEST_CASE(checkWorkQueuedFromOwnersHandlerIsStolen) {
+    // the other threads are idle, so nothing else makes them look for work
+    m_scheduler.get_io_service(0).post(boost::bind(&work_stealing_scheduler_F::postFromHandler, this));
+    BOOST_CHECK(waitForWork(2));
+    BOOST_CHECK(m_was_stolen);
+    BOOST_CHECK_EQUAL(m_scheduler.get_stolen_work(), 1U);
+}
+
+BOOST_AUTO_TEST_CASE(checkPrioritizedWorkIsRun) {
+    for (unsigned int n = 0; n < 100; ++n)
+        m_scheduler.post(boost::bind(&work_stealing_scheduler_F::doWork, this, 0),
+                         (n % 2) ? scheduler::PRIORITY_HIGH : scheduler::PRIORITY_LOW);
+    BOOST_CHECK(waitForWork(100));
+}
+
+BOOST_AUTO_TEST_CASE(checkIoServicesAreSeparate) {
+    BOOST_CHECK_EQUAL(m_scheduler.get_num_services(), 4U);
+    BOOST_CHECK(&m_scheduler.get_io_service(0) != &m_scheduler.get_io_service(1));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+
+///
+/// one_to_one_scheduler_F: fixture for testing how one_to_one_scheduler chooses services
+///
+class one_to_one_scheduler_F {
+public:
+    one_to_one_scheduler_F() {
+        m_scheduler.set_num_threads(4);
+    }
+    ~one_to_one_scheduler_F() {
+        m_scheduler.shutdown();
+    }
+
+    /// returns the number of an IO service
+    boost::uint32_t getServiceNumber(boost::asio::io_service& service) {
+        for (boost::uint32_t n = 0; n < m_scheduler.get_num_services(); ++n) {
+            if (&m_scheduler.get_io_service(n) == &service)
+                return n;
+        }
+        return m_scheduler.get_num_services();
+    }
+
+    one_to_one_scheduler    m_scheduler;
+};
+
+BOOST_FIXTURE_TEST_SUITE(one_to_one_scheduler_S, one_to_one_scheduler_F)
+
+BOOST_AUTO_TEST_CASE(checkRoundRobinUsesEachService) {
+    BOOST_CHECK_EQUAL(m_scheduler.get_service_policy(), one_to_one_scheduler::POLICY_ROUND_ROBIN);
+    std::vector<unsigned int> num_used(m_scheduler.get_num_services(), 0);
+    for (unsigned int n = 0; n < 40; ++n) {
+        const boost::uint32_t service_num = getServiceNumber(m_scheduler.get_io_service());
+        BOOST_REQUIRE(service_num < m_scheduler.get_num_services());
+        ++num_used[service_num];
+    }
+    for (unsigned int n = 0; n < num_used.size(); ++n)
+        BOOST_CHECK_EQUAL(num_used[n], 10U);
+}
+
+BOOST_AUTO_TEST_CASE(checkLoadCountersAreTracked) {
+    m_scheduler.get_io_service();
+    scheduler::load_counter_type *load_ptr = m_scheduler.get_load_counter(m_scheduler.get_io_service(2));
+    BOOST_REQUIRE(load_ptr != NULL);
+    ++*load_ptr;
+    ++*load_ptr;
+    BOOST_CHECK_EQUAL(m_scheduler.get_service_load(2), 2);
+    BOOST_CHECK_EQUAL(m_scheduler.get_service_load(1), 0);
+
+    boost::asio::io_service other_service;
+    BOOST_CHECK(m_scheduler.get_load_counter(other_service) == NULL);
+}
+
+BOOST_AUTO_TEST_CASE(checkLeastLoadedChoosesIdleService) {
+    m_scheduler.set_service_policy(one_to_one_scheduler::POLICY_LEAST_LOADED);
+    m_scheduler.get_io_service();
+    for (boost::uint32_t n = 0; n < m_scheduler.get_num_services(); ++n) {
+        if (n != 3)
+            ++*m_scheduler.get_load_counter(m_scheduler.get_io_service(n));
+    }
+    for (unsigned int n = 0; n < 10; ++n)
+        BOOST_CHECK_EQUAL(getServiceNumber(m_scheduler.get_io_service()), 3U);
+
+    // once the loads are even, all of the services are used again
+    ++*m_scheduler.get_load_counter(m_scheduler.get_io_service(3));
+    std::vector<unsigned int> num_used(m_scheduler.get_num_services(), 0);
+    for (unsigned int n = 0; n < 40; ++n)
+        ++num_used[getServiceNumber(m_scheduler.get_io_service())];
+    for (unsigned int n = 0; n < num_used.size(); ++n)
+        BOOST_CHECK_EQUAL(num_used[n], 10U);
+}
+
+BOOST_AUTO_TEST_CASE(checkServicesAreCreatedWithThreadCount) {
+    // the services exist before any of them has been used
+    one_to_one_scheduler sched;
+    sched.set_num_threads(6);
+    for (boost::uint32_t n = 0; n < sched.get_num_services(); ++n)
+        BOOST_CHECK(sched.get_load_counter(sched.get_io_service(n)) != NULL);
+
+    // and they are created again after the scheduler has been shut down
+    sched.shutdown();
+    boost::asio::io_service& service(sched.get_io_service());
+    BOOST_CHECK(sched.get_load_counter(service) != NULL);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+
+///
+/// priority_scheduler_F: fixture that records the order that prioritized work is run
+///
+class priority_scheduler_F {
+public:
+    priority_scheduler_F() : m_is_blocked(false) {
+        m_scheduler.set_num_threads(1);
+        m_scheduler.add_active_user();
+    }
+    ~priority_scheduler_F() {
+        unblock();
+        m_scheduler.remove_active_user();
+        m_scheduler.shutdown();
+    }
+
+    /// keeps the scheduler's only thread busy until unblock() is called
+    void block(void) {
+        boost::mutex::scoped_lock work_lock(m_mutex);
+        m_is_blocked = true;
+        m_scheduler.get_io_service().post(boost::bind(&priority_scheduler_F::waitForUnblock, this));
+    }
+
+    /// lets the scheduler's thread continue
+    void unblock(void) {
+        boost::mutex::scoped_lock work_lock(m_mutex);
+        m_is_blocked = false;
+        m_work_done.notify_all();
+    }
+
+    /// work item that waits until unblock() is called
+    void waitForUnblock(void) {
+        boost::mutex::scoped_lock work_lock(m_mutex);
+        while (m_is_blocked)
+            m_work_done.wait(work_lock);
+    }
+
+    /// work item that records its priority
+    void recordWork(scheduler::priority_type priority) {
+        boost::mutex::scoped_lock work_lock(m_mutex);
+        m_work_run.push_back(priority);
+        m_work_done.notify_all();
+    }
+
+    /// waits for up to five seconds for some number of work items to finish
+    bool waitForWork(std::size_t num_items) {
+        boost::mutex::scoped_lock work_lock(m_mutex);
+        while (m_work_run.size() < num_items) {
+            if (! m_work_done.timed_wait(work_lock, boost::get_system_time() + boost::posix_time::seconds(5)))
+                return false;
+        }
+        return true;
+    }
+
+    /// posts a number of work items with a priority class
+    void postWork(unsigned int num_items, scheduler::priority_type priority) {
+        for (unsigned int n = 0; n < num_items; ++n)
+            m_scheduler.post(boost::bind(&priority_scheduler_F::recordWork, this, priority), priority);
+    }
+
+    single_service_scheduler                m_scheduler;
+    boost::mutex                            m_mutex;
+    boost::condition                        m_work_done;
+    bool                                    m_is_blocked;
+    std::vector<scheduler::priority_type>   m_work_run;
+};
+
+BOOST_FIXTURE_TEST_SUITE(priority_scheduler_S, priority_scheduler_F)
+
+BOOST_AUTO_TEST_CASE(checkHighLaneDrainsFirst) {
+    block();
+    postWork(3, scheduler::PRIORITY_LOW);
+    postWork(3, scheduler::PRIORITY_NORMAL);
+    postWork(3, scheduler::PRIORITY_HIGH);
+    BOOST_CHECK_EQUAL(m_scheduler.get_lane_depth(scheduler::PRIORITY_HIGH), 3U);
+    BOOST_CHECK_EQUAL(m_scheduler.get_lane_depth(scheduler::PRIORITY_LOW), 3U);
+    unblock();
+
+    BOOST_REQUIRE(waitForWork(9));
+    for (std::size_t n = 0; n < m_work_run.size(); ++n)
+        BOOST_CHECK_EQUAL(m_work_run[n], static_cast<scheduler::priority_type>(n / 3));
+    BOOST_CHECK_EQUAL(m_scheduler.get_lane_depth(scheduler::PRIORITY_HIGH), 0U);
+    BOOST_CHECK_EQUAL(m_scheduler.get_lane_peak_depth(scheduler::PRIORITY_HIGH), 3U);
+}
+
+BOOST_AUTO_TEST_CASE(checkLowLaneIsNotStarved) {
+    block();
+    postWork(1, scheduler::PRIORITY_LOW);
+    postWork(30, scheduler::PRIORITY_HIGH);
+    unblock();
+
+    BOOST_REQUIRE(waitForWork(31));
+    std::size_t low_pos = 0;
+    while (m_work_run[low_pos] != scheduler::PRIORITY_LOW)
+        ++low_pos;
+    BOOST_CHECK_EQUAL(low_pos, static_cast<std::size_t>(scheduler::MAX_PRIORITY_BYPASS));
+    BOOST_CHECK_EQUAL(m_scheduler.get_lane_peak_depth(scheduler::PRIORITY_HIGH), 30U);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+
+///
+/// resize_scheduler_F: fixture that measures how many threads run work at once
+///
+class resize_scheduler_F {
+public:
+    resize_scheduler_F() : m_num_done(0), m_num_busy(0), m_max_busy(0) {}
+
+    /// work item that keeps its thread busy for a while
+    void keepBusy(boost::uint32_t msec) {
+        {
+            boost::mutex::scoped_lock work_lock(m_mutex);
+            if (++m_num_busy > m_max_busy)
+                m_max_busy = m_num_busy;
+        }
+        boost::this_thread::sleep(boost::posix_time::milliseconds(msec));
+        boost::mutex::scoped_lock work_lock(m_mutex);
+        --m_num_busy;
+        ++m_num_done;
+        m_work_done.notify_all();
+    }
+
+    /// waits up to five seconds for num_items work items to finish
+    void waitForWork(unsigned int num_items) {
+        boost::mutex::scoped_lock work_lock(m_mutex);
+        const boost::system_time deadline(boost::get_system_time() + boost::posix_time::seconds(5));
+        while (m_num_done < num_items && m_work_done.timed_wait(work_lock, deadline)) {}
+    }
+
+    /// posts work items to a service, and returns the most that ran at once
+    unsigned int runWork(boost::asio::io_service& service, unsigned int num_items) {
+        {
+            boost::mutex::scoped_lock work_lock(m_mutex);
+            m_num_done = m_max_busy = 0;
+        }
+        for (unsigned int i = 0; i < num_items; ++i)
+            service.post(boost::bind(&resize_scheduler_F::keepBusy, this, 50));
+        waitForWork(num_items);
+        boost::mutex::scoped_lock work_lock(m_mutex);
+        BOOST_CHECK_EQUAL(m_num_done, num_items);
+        return m_max_busy;
+    }
+
+    boost::mutex            m_mutex;
+    boost::condition        m_work_done;
+    unsigned int            m_num_done;
+    unsigned int            m_num_busy;
+    unsigned int            m_max_busy;
+};
+
+BOOST_FIXTURE_TEST_SUITE(resize_scheduler_S, resize_scheduler_F)
+
+BOOST_AUTO_TEST_CASE(checkSingleServiceSchedulerGrowsAndShrinks) {
+    single_service_scheduler sched;
+    sched.set_num_threads(2);
+    sched.add_active_user();
+    BOOST_CHECK_EQUAL(runWork(sched.get_io_service(), 8), 2U);
+
+    sched.set_num_threads(4);
+    BOOST_CHECK_EQUAL(sched.get_num_threads(), 4U);
+    BOOST_CHECK_EQUAL(runWork(sched.get_io_service(), 8), 4U);
+
+    sched.set_num_threads(1);
+    BOOST_CHECK_EQUAL(sched.get_num_threads(), 1U);
+    BOOST_CHECK_EQUAL(runWork(sched.get_io_service(), 4), 1U);
+
+    // resizing back up keeps the work flowing
+    sched.set_num_threads(3);
+    BOOST_CHECK_EQUAL(runWork(sched.get_io_service(), 6), 3U);
+    sched.remove_active_user();
+    sched.shutdown();
+}
+
+BOOST_AUTO_TEST_CASE(checkResizingIsLimited) {
+    single_service_scheduler sched;
+    BOOST_CHECK_THROW(sched.set_thread_limits(0, 2), error::bad_arg);
+    BOOST_CHECK_THROW(sched.set_thread_limits(3, 2), error::bad_arg);
+    sched.set_thread_limits(2, 3);
+    sched.set_num_threads(2);
+    sched.add_active_user();
+    sched.set_num_threads(8);
+    BOOST_CHECK_EQUAL(sched.get_num_threads(), 3U);
+    sched.set_num_threads(1);
+    BOOST_CHECK_EQUAL(sched.get_num_threads(), 2U);
+    sched.remove_active_user();
+    sched.shutdown();
+}
+
+BOOST_AUTO_TEST_CASE(checkRetiredServiceKeepsRunningWhileLoaded) {
+    one_to_one_scheduler sched;
+    sched.set_num_threads(2);
+    sched.add_active_user();
+    sched.set_num_threads(3);
+    BOOST_CHECK_EQUAL(sched.get_num_services(), 3U);
+    boost::asio::io_service& last_service(sched.get_io_service(2));
+    BOOST_CHECK_EQUAL(runWork(last_service, 1), 1U);
+
+    // a connection is still using the service when it is retired
+    scheduler::load_counter_type *load_ptr = sched.get_load_counter(last_service);
+    BOOST_REQUIRE(load_ptr != NULL);
+    ++*load_ptr;
+    sched.set_num_threads(2);
+    BOOST_CHECK_EQUAL(sched.get_num_services(), 2U);
+    boost::this_thread::sleep(boost::posix_time::milliseconds(300));
+    BOOST_CHECK_EQUAL(runWork(last_service, 1), 1U);
+
+    // once the connection has finished, the service's thread is retired
+    --*load_ptr;
+    boost::this_thread::sleep(boost::posix_time::milliseconds(500));
+    {
+        boost::mutex::scoped_lock work_lock(m_mutex);
+        m_num_done = 0;
+    }
+    last_service.post(boost::bind(&resize_scheduler_F::keepBusy, this, 0));
+    boost::this_thread::sleep(boost::posix_time::milliseconds(100));
+    {
+        boost::mutex::scoped_lock work_lock(m_mutex);
+        BOOST_CHECK_EQUAL(m_num_done, 0U);
+    }
+
+    // and using the service again gives it a new thread
+    sched.set_num_threads(3);
+    waitForWork(1);
+    {
+        boost::mutex::scoped_lock work_lock(m_mutex);
+        BOOST_CHECK_EQUAL(m_num_done, 1U);
+    }
+    sched.remove_active_user();
+    sched.shutdown();
+}
+
+BOOST_AUTO_TEST_CASE(checkAutoscalingAddsThreadsWhenWorkWaits) {
+    single_service_scheduler sched;
+    sched.set_num_threads(1);
+    sched.set_thread_limits(1, 2);
+    sched.set_autoscaling(true);
+    sched.add_active_user();
+    for (unsigned int i = 0; i < 100; ++i)
+        sched.post(boost::bind(&resize_scheduler_F::keepBusy, this, 30));
+    const boost::system_time deadline(boost::get_system_time() + boost::posix_time::seconds(5));
+    while (sched.get_num_threads() < 2 && boost::get_system_time() < deadline)
+        boost::this_thread::sleep(boost::posix_time::milliseconds(50));
+    BOOST_CHECK_EQUAL(sched.get_num_threads(), 2U);
+    BOOST_CHECK(sched.get_queue_latency() > sched.get_max_queue_latency());
+    sched.remove_active_user();
+    sched.shutdown();
+}
+
+BOOST_AUTO_TEST_CASE(checkAutoscalingIgnoresBusyPolling) {
+    single_service_scheduler sched;
+    sched.set_num_threads(1);
+    sched.set_thread_limits(1, 2);
+    sched.set_busy_poll(20000);
+    sched.set_autoscaling(true);
+    sched.add_active_user();
+
+    // light work that keeps the thread polling for most of the time
+    for (unsigned int i = 0; i < 250; ++i) {
+        sched.post(boost::bind(&resize_scheduler_F::keepBusy, this, 0));
+        boost::this_thread::sleep(boost::posix_time::milliseconds(10));
+    }
+    waitForWork(250);
+    BOOST_CHECK_EQUAL(sched.get_num_threads(), 1U);
+    BOOST_CHECK(sched.get_utilization() < 50U);
+    sched.remove_active_user();
+    sched.shutdown();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+
+///
+/// blocking_pool_F: fixture that offloads work to a private blocking_pool
+///
+class blocking_pool_F {
+public:
+    blocking_pool_F()
+        : m_num_blocked(0), m_num_resumed(0), m_num_resumed_on_blocker(0), m_num_meeting(0), m_num_met(0)
+    {
+        m_pool.set_num_threads(2);
+        m_scheduler.set_num_threads(1);
+    }
+    ~blocking_pool_F() {
+        m_pool.shutdown();
+        m_scheduler.shutdown();
+    }
+
+    /// blocking work item
+    void block(void) {
+        boost::this_thread::sleep(boost::posix_time::milliseconds(10));
+        boost::mutex::scoped_lock work_lock(m_mutex);
+        ++m_num_blocked;
+        m_blocking_thread = boost::this_thread::get_id();
+    }
+
+    /// blocking work item that waits up to five seconds for num_items of
+    /// them to be running at the same time
+    void meet(unsigned int num_items) {
+        boost::mutex::scoped_lock work_lock(m_mutex);
+        ++m_num_meeting;
+        m_work_done.notify_all();
+        const boost::system_time deadline(boost::get_system_time() + boost::posix_time::seconds(5));
+        while (m_num_meeting < num_items && m_work_done.timed_wait(work_lock, deadline)) {}
+        if (m_num_meeting >= num_items)
+            ++m_num_met;
+    }
+
+    /// continuation that counts how many times it was resumed
+    void resume(void) {
+        boost::mutex::scoped_lock work_lock(m_mutex);
+        if (boost::this_thread::get_id() == m_blocking_thread)
+            ++m_num_resumed_on_blocker;
+        ++m_num_resumed;
+        m_work_done.notify_all();
+    }
+
+    /// waits up to five seconds for num_items continuations to run
+    void waitForResumed(unsigned int num_items) {
+        boost::mutex::scoped_lock work_lock(m_mutex);
+        const boost::system_time deadline(boost::get_system_time() + boost::posix_time::seconds(5));
+        while (m_num_resumed < num_items && m_work_done.timed_wait(work_lock, deadline)) {}
+    }
+
+    blocking_pool           m_pool;
+    single_service_scheduler    m_scheduler;
+    boost::mutex            m_mutex;
+    boost::condition        m_work_done;
+    boost::thread::id       m_blocking_thread;
+    unsigned int            m_num_blocked;
+    unsigned int            m_num_resumed;
+    unsigned int            m_num_resumed_on_blocker;
+    unsigned int            m_num_meeting;
+    unsigned int            m_num_met;
+};
+
+BOOST_FIXTURE_TEST_SUITE(blocking_pool_S, blocking_pool_F)
+
+BOOST_AUTO_TEST_CASE(checkOffloadedWorkResumesOnIoService) {
+    m_scheduler.add_active_user();
+    for (unsigned int i = 0; i < 8; ++i)
+        m_pool.offload(boost::bind(&blocking_pool_F::block, this),
+                       m_scheduler.get_io_service(),
+                       boost::bind(&blocking_pool_F::resume, this));
+    waitForResumed(8);
+    {
+        boost::mutex::scoped_lock work_lock(m_mutex);
+        BOOST_CHECK_EQUAL(m_num_blocked, 8U);
+        BOOST_CHECK_EQUAL(m_num_resumed, 8U);
+        BOOST_CHECK_EQUAL(m_num_resumed_on_blocker, 0U);
+    }
+    BOOST_CHECK_EQUAL(m_pool.get_num_offloaded(), 8U);
+    BOOST_CHECK_EQUAL(m_pool.get_num_run_inline(), 0U);
+    m_scheduler.remove_active_user();
+}
+
+BOOST_AUTO_TEST_CASE(checkBurstStartsThreadsBeyondIdleOne) {
+    m_pool.set_num_threads(3);
+    m_scheduler.add_active_user();
+    m_pool.offload(boost::bind(&blocking_pool_F::block, this),
+                   m_scheduler.get_io_service(),
+                   boost::bind(&blocking_pool_F::resume, this));
+    waitForResumed(1);
+    const boost::system_time deadline(boost::get_system_time() + boost::posix_time::seconds(5));
+    while (m_pool.get_num_idle_threads() < 1 && boost::get_system_time() < deadline)
+        boost::this_thread::sleep(boost::posix_time::milliseconds(1));
+    BOOST_REQUIRE_EQUAL(m_pool.get_num_idle_threads(), 1U);
+
+    // one idle thread can take only one of the items; the pool must start
+    // threads for the others, or they would never run at the same time
+    for (unsigned int i = 0; i < 3; ++i)
+        m_pool.offload(boost::bind(&blocking_pool_F::meet, this, 3),
+                       m_scheduler.get_io_service(),
+                       boost::bind(&blocking_pool_F::resume, this));
+    waitForResumed(4);
+    {
+        boost::mutex::scoped_lock work_lock(m_mutex);
+        BOOST_CHECK_EQUAL(m_num_met, 3U);
+    }
+    m_scheduler.remove_active_user();
+}
+
+BOOST_AUTO_TEST_CASE(checkFullQueueRunsWorkInline) {
+    m_pool.set_max_queued_work(0);
+    m_scheduler.add_active_user();
+    m_pool.offload(boost::bind(&blocking_pool_F::block, this),
+                   m_scheduler.get_io_service(),
+                   boost::bind(&blocking_pool_F::resume, this));
+    {
+        // the blocking work must have finished before offload() returned
+        boost::mutex::scoped_lock work_lock(m_mutex);
+        BOOST_CHECK_EQUAL(m_num_blocked, 1U);
+        BOOST_CHECK(m_blocking_thread == boost::this_thread::get_id());
+    }
+    waitForResumed(1);
+    BOOST_CHECK_EQUAL(m_pool.get_num_run_inline(), 1U);
+    m_scheduler.remove_active_user();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+
+BOOST_AUTO_TEST_CASE(checkHistogramPercentiles) {
+    scheduler::histogram h;
+    BOOST_CHECK_EQUAL(h.get_percentile(50), 0U);
+    for (unsigned int i = 0; i < 90; ++i)
+        h.add(3);
+    for (unsigned int i = 0; i < 10; ++i)
+        h.add(1000);
+    BOOST_CHECK_EQUAL(h.m_num_samples, 100U);
+    BOOST_CHECK_EQUAL(h.m_max_usec, 1000U);
+    BOOST_CHECK_EQUAL(h.get_percentile(50), 4U);
+    BOOST_CHECK_EQUAL(h.get_percentile(90), 4U);
+    BOOST_CHECK_EQUAL(h.get_percentile(99), 1024U);
+
+    scheduler::histogram other;
+    other.add(10000000);
+    h.merge(other);
+    BOOST_CHECK_EQUAL(h.m_num_samples, 101U);
+    BOOST_CHECK_EQUAL(h.get_percentile(100), scheduler::histogram::get_bucket_limit(scheduler::histogram::NUM_BUCKETS - 1));
+}
+
+BOOST_FIXTURE_TEST_SUITE(scheduler_stats_S, resize_scheduler_F)
+
+BOOST_AUTO_TEST_CASE(checkPostedWorkIsMeasured) {
+    single_service_scheduler sched;
+    sched.set_num_threads(2);
+    sched.set_instrumentation(true);
+    sched.add_active_user();
+    for (unsigned int i = 0; i < 8; ++i)
+        sched.post(boost::bind(&resize_scheduler_F::keepBusy, this, 5));
+    waitForWork(8);
+    {
+        boost::mutex::scoped_lock work_lock(m_mutex);
+        BOOST_CHECK_EQUAL(m_num_done, 8U);
+    }
+
+    // the measurements are recorded after each work item returns
+    scheduler::stats snapshot(sched.get_stats());
+    for (unsigned int n = 0; n < 100 && snapshot.m_run_time.m_num_samples < 8; ++n) {
+        boost::this_thread::sleep(boost::posix_time::milliseconds(10));
+        snapshot = sched.get_stats();
+    }
+    BOOST_CHECK(snapshot.m_is_running);
+    BOOST_CHECK_EQUAL(snapshot.m_queue_delay.m_num_samples, 8U);
+    BOOST_CHECK_EQUAL(snapshot.m_run_time.m_num_samples, 8U);
+    BOOST_CHECK(snapshot.m_run_time.m_total_usec >= 8 * 5000U);
+    BOOST_CHECK_EQUAL(snapshot.m_threads.size(), 2U);
+    boost::uint64_t num_work = 0;
+    for (std::vector<scheduler::thread_usage>::const_iterator i = snapshot.m_threads.begin();
+         i != snapshot.m_threads.end(); ++i)
+    {
+        BOOST_CHECK(i->m_is_running);
+        BOOST_CHECK(i->m_work_usec <= i->m_elapsed_usec);
+        num_work += i->m_num_work;
+    }
+    BOOST_CHECK_EQUAL(num_work, 8U);
+
+    // the scheduler is included in the measurements of all schedulers
+    std::vector<scheduler::stats> stats_list;
+    scheduler::get_all_stats(stats_list);
+    bool found = false;
+    for (std::vector<scheduler::stats>::const_iterator i = stats_list.begin(); i != stats_list.end(); ++i)
+        if (i->m_run_time.m_num_samples == 8 && i->m_threads.size() == 2)
+            found = true;
+    BOOST_CHECK(found);
+
+    sched.reset_stats();
+    BOOST_CHECK_EQUAL(sched.get_stats().m_run_time.m_num_samples, 0U);
+    sched.remove_active_user();
+    sched.shutdown();
+}
+
+BOOST_AUTO_TEST_CASE(checkDisabledInstrumentationIsNotMeasured) {
+    single_service_scheduler sched;
+    sched.set_num_threads(1);
+    BOOST_CHECK(! sched.get_instrumentation());
+    sched.add_active_user();
+    for (unsigned int i = 0; i < 4; ++i)
+        sched.post(boost::bind(&resize_scheduler_F::keepBusy, this, 0));
+    waitForWork(4);
+    BOOST_CHECK_EQUAL(sched.get_stats().m_run_time.m_num_samples, 0U);
+    BOOST_CHECK_EQUAL(sched.get_stats().m_queue_delay.m_num_samples, 0U);
+    sched.remove_active_user();
+    sched.shutdown();
+}
+
+BOOST_AUTO_TEST_CASE(checkWatchdogCountsStalledWork) {
+    single_service_scheduler sched;
+    sched.set_num_threads(2);
+    sched.set_stall_threshold(50);
+    BOOST_CHECK_EQUAL(sched.get_stall_threshold(), 50U);
+    sched.add_active_user();
+
+    // quick work is not reported, and each stalled work item is only
+    // reported once, however long it runs for
+    for (unsigned int i = 0; i < 4; ++i)
+        sched.post(boost::bind(&resize_scheduler_F::keepBusy, this, 0));
+    sched.post(boost::bind(&resize_scheduler_F::keepBusy, this, 300));
+    waitForWork(5);
+    BOOST_CHECK_EQUAL(sched.get_num_stalls(), 1U);
+
+    scheduler::stats snapshot(sched.get_stats());
+    BOOST_CHECK_EQUAL(snapshot.m_num_stalls, 1U);
+    boost::uint64_t num_stalls = 0;
+    for (std::vector<scheduler::thread_usage>::const_iterator i = snapshot.m_threads.begin();
+         i != snapshot.m_threads.end(); ++i)
+    {
+        num_stalls += i->m_num_stalls;
+    }
+    BOOST_CHECK_EQUAL(num_stalls, 1U);
+
+    // stopping the watchdog stops the reports
+    sched.set_stall_threshold(0);
+    sched.post(boost::bind(&resize_scheduler_F::keepBusy, this, 100));
+    waitForWork(6);
+    BOOST_CHECK_EQUAL(sched.get_num_stalls(), 1U);
+    sched.remove_active_user();
+    sched.shutdown();
+}
+
+BOOST_AUTO_TEST_CASE(checkBusyPollingFindsWorkWithoutBlocking) {
+    one_to_one_scheduler sched;
+    sched.set_num_threads(1);
+    sched.set_busy_poll(20000);
+    sched.add_active_user();
+
+    // work that arrives within the budget is found while polling...
+    for (unsigned int i = 0; i < 4; ++i) {
+        sched.post(boost::bind(&resize_scheduler_F::keepBusy, this, 0));
+        boost::this_thread::sleep(boost::posix_time::milliseconds(2));
+    }
+    waitForWork(4);
+    // ...and the thread blocks once the budget runs out
+    boost::this_thread::sleep(boost::posix_time::milliseconds(50));
+    sched.post(boost::bind(&resize_scheduler_F::keepBusy, this, 0));
+    waitForWork(5);
+    {
+        boost::mutex::scoped_lock work_lock(m_mutex);
+        BOOST_CHECK_EQUAL(m_num_done, 5U);
+    }
+
+    scheduler::stats snapshot(sched.get_stats());
+    BOOST_CHECK_EQUAL(snapshot.m_busy_poll_usec, 20000U);
+    BOOST_REQUIRE_EQUAL(snapshot.m_threads.size(), 1U);
+    BOOST_CHECK(snapshot.m_threads[0].m_num_spin_hits > 0);
+    BOOST_CHECK(snapshot.m_threads[0].m_num_spin_misses > 0);
+    BOOST_CHECK(snapshot.m_threads[0].m_spin_usec >= 20000U);
+    sched.remove_active_user();
+    sched.shutdown();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+
+BOOST_AUTO_TEST_CASE(checkParseCpuList) {
+    multi_thread_scheduler::cpu_list_type cpus(multi_thread_scheduler::parse_cpu_list("0-3,8,10-11"));
+    BOOST_REQUIRE_EQUAL(cpus.size(), 7U);
+    BOOST_CHECK_EQUAL(cpus[0], 0U);
+    BOOST_CHECK_EQUAL(cpus[3], 3U);
+    BOOST_CHECK_EQUAL(cpus[4], 8U);
+    BOOST_CHECK_EQUAL(cpus[6], 11U);
+
+    BOOST_CHECK_THROW(multi_thread_scheduler::parse_cpu_list(""), error::bad_arg);
+    BOOST_CHECK_THROW(multi_thread_scheduler::parse_cpu_list("3-1"), error::bad_arg);
+    BOOST_CHECK_THROW(multi_thread_scheduler::parse_cpu_list("0,x"), error::bad_arg);
+    BOOST_CHECK_THROW(multi_thread_scheduler::parse_cpu_list("node"), error::bad_arg);
+    BOOST_CHECK_THROW(multi_thread_scheduler::parse_cpu_list("0-4000000000"), error::bad_arg);
+    BOOST_CHECK_THROW(multi_thread_scheduler::parse_cpu_list("4294967295"), error::bad_arg);
+}
+
+#if defined(__linux__)
+
+///
+/// pinned_scheduler_F: fixture that records the CPUs used by a pinned one_to_one_scheduler
+///
+class pinned_scheduler_F {
+public:
+    pinned_scheduler_F() : m_num_done(0), m_num_moved(0) {
+        // pin all of the threads to the CPU that the test is running on,
+        // which is one that the process is allowed to use
+        m_cpu = sched_getcpu();
+        m_scheduler.set_num_threads(2);
+        m_scheduler.set_cpu_affinity(multi_thread_scheduler::cpu_list_type(1, static_cast<boost::uint32_t>(m_cpu)));
+    }
+    ~pinned_scheduler_F() {
+        m_scheduler.shutdown();
+    }
+
+    /// work item that checks which CPU it is running on
+    void checkCpu(void) {
+        const int cpu = sched_getcpu();
+        boost::mutex::scoped_lock work_lock(m_mutex);
+        if (cpu != m_cpu)
+            ++m_num_moved;
+        ++m_num_done;
+        m_work_done.notify_all();
+    }
+
+    one_to_one_scheduler    m_scheduler;
+    boost::mutex            m_mutex;
+    boost::condition        m_work_done;
+    unsigned int            m_num_done;
+    unsigned int            m_num_moved;
+    int                     m_cpu;
+};
+
+BOOST_FIXTURE_TEST_SUITE(pinned_scheduler_S, pinned_scheduler_F)
+
+BOOST_AUTO_TEST_CASE(checkWorkRunsOnPinnedCpu) {
+    m_scheduler.add_active_user();
+    for (boost::uint32_t n = 0; n < m_scheduler.get_num_services(); ++n) {
+        for (unsigned int i = 0; i < 10; ++i)
+            m_scheduler.get_io_service(n).post(boost::bind(&pinned_scheduler_F::checkCpu, this));
+    }
+    {
+        boost::mutex::scoped_lock work_lock(m_mutex);
+        const boost::system_time deadline(boost::get_system_time() + boost::posix_time::seconds(5));
+        while (m_num_done < 20 && m_work_done.timed_wait(work_lock, deadline)) {}
+        BOOST_CHECK_EQUAL(m_num_done, 20U);
+        BOOST_CHECK_EQUAL(m_num_moved, 0U);
+    }
+    m_scheduler.remove_active_user();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+#endif
@@ -8,10 +8,13 @@
 //
 
 #include <pion/config.hpp>
+#include <pion/error.hpp>
 #include <pion/scheduler.hpp>
+#include <pion/uring_engine.hpp>
 #include <pion/tcp/server.hpp>
 #include <boost/asio.hpp>
 #include <boost/bind.hpp>
+#include <boost/filesystem/operations.hpp>
 #include <boost/function/function1.hpp>
 #include <boost/thread/thread.hpp>
 #include <boost/test/unit_test.hpp>
@@ -38,6 +41,14 @@ public:
      */
     HelloServer(const unsigned int tcp_port = 0) : pion::tcp::server(tcp_port) {}
     
+    /**
+     * creates a Hello server
+     *
+     * @param sched the scheduler that will be used to manage worker threads
+     * @param tcp_port port number used to listen for new connections (IPv4)
+     */
+    HelloServer(scheduler& sched, const unsigned int tcp_port = 0) : pion::tcp::server(sched, tcp_port) {}
+    
     /**
      * handles a new TCP connection
      * 
@@ -227,8 +238,392 @@ BOOST_AUTO_TEST_CASE(checkServerExceptionsGetCaught) {
     tcp_stream_a.close();
 }
 
+BOOST_AUTO_TEST_CASE(checkConnectionObjectsAreReused) {
+    boost::asio::ip::tcp::endpoint localhost(boost::asio::ip::address::from_string("127.0.0.1"), getServerPtr()->get_port());
+
+    // open and close connections one at a time
+    static const int NUM_CONNECTIONS = 10;
+    std::string str;
+    for (int n = 0; n < NUM_CONNECTIONS; ++n) {
+        boost::asio::ip::tcp::iostream tcp_stream(localhost);
+        std::getline(tcp_stream, str);
+        BOOST_CHECK(str == "Hello there!");
+        tcp_stream << "Hi!\n";
+        tcp_stream.flush();
+        std::getline(tcp_stream, str);
+        BOOST_CHECK(str == "Goodbye!");
+        tcp_stream.close();
+        checkNumConnectionsForUpToOneSecond(static_cast<std::size_t>(0));
+    }
+
+    // finished connections should have been recycled instead of reallocated
+    BOOST_CHECK(getServerPtr()->get_total_connections() > static_cast<boost::uint64_t>(NUM_CONNECTIONS));
+    BOOST_CHECK(getServerPtr()->get_connection_allocations() < static_cast<boost::uint64_t>(NUM_CONNECTIONS));
+}
+
+BOOST_AUTO_TEST_CASE(checkConnectionReturnsTcpEndpoints) {
+    boost::asio::io_service io_service;
+    tcp::connection tcp_conn(io_service);
+    boost::system::error_code ec = tcp_conn.connect(boost::asio::ip::address::from_string("127.0.0.1"),
+                                                    getServerPtr()->get_port());
+    BOOST_REQUIRE(! ec);
+    BOOST_CHECK(! tcp_conn.is_local());
+    BOOST_CHECK_EQUAL(tcp_conn.get_remote_endpoint(), boost::asio::ip::tcp::endpoint(
+        boost::asio::ip::address::from_string("127.0.0.1"), getServerPtr()->get_port()));
+    BOOST_CHECK_EQUAL(tcp_conn.get_local_endpoint().address().to_string(), "127.0.0.1");
+    BOOST_CHECK(tcp_conn.get_local_endpoint().port() != 0);
+    tcp_conn.close();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+///
+/// ReusePortHelloServerTests_F: fixture used for running (Hello) server tests
+/// with one SO_REUSEPORT acceptor per I/O service
+/// 
+class ReusePortHelloServerTests_F {
+public:
+    ReusePortHelloServerTests_F()
+        : m_flag(false), m_scheduler(), hello_server_ptr()
+    {
+        m_scheduler.set_num_threads(4);
+        hello_server_ptr.reset(new HelloServer(m_scheduler));
+        hello_server_ptr->set_reuse_port(true);
+        hello_server_ptr->start();
+    }
+    ~ReusePortHelloServerTests_F() {
+        hello_server_ptr->stop();
+    }
+    inline tcp::server_ptr& getServerPtr(void) { return hello_server_ptr; }
+    inline one_to_one_scheduler& getScheduler(void) { return m_scheduler; }
+
+    /**
+     * check at 0.1 second intervals for up to one second to see if the number
+     * of connections is as expected
+     *
+     * @param expectedNumberOfConnections expected number of connections
+     */
+    void checkNumConnectionsForUpToOneSecond(std::size_t expectedNumberOfConnections)
+    {
+        for (int i = 0; i < 10; ++i) {
+            if (getServerPtr()->get_connections() == expectedNumberOfConnections) break;
+            scheduler::sleep(0, 100000000); // 0.1 seconds
+        }
+        BOOST_CHECK_EQUAL(getServerPtr()->get_connections(), expectedNumberOfConnections);
+    }
+
+    /// work item used to check whether a service still has a thread
+    void setFlag(void) { m_flag = true; }
+
+    bool                    m_flag;
+
+private:
+    one_to_one_scheduler    m_scheduler;
+    tcp::server_ptr         hello_server_ptr;
+};
+
+BOOST_FIXTURE_TEST_SUITE(ReusePortHelloServerTests_S, ReusePortHelloServerTests_F)
+
+BOOST_AUTO_TEST_CASE(checkReusePortServerIsListening) {
+    BOOST_CHECK(getServerPtr()->is_listening());
+    BOOST_CHECK(getServerPtr()->get_reuse_port());
+    BOOST_CHECK(getServerPtr()->get_port() != 0);
+}
+
+BOOST_AUTO_TEST_CASE(checkNumberOfActiveReusePortServerConnections) {
+    checkNumConnectionsForUpToOneSecond(static_cast<std::size_t>(0));
+
+    // open several connections, which may be spread across all of the I/O services
+    boost::asio::ip::tcp::endpoint localhost(boost::asio::ip::address::from_string("127.0.0.1"), getServerPtr()->get_port());
+    static const std::size_t NUM_CONNECTIONS = 6;
+    std::vector<boost::shared_ptr<boost::asio::ip::tcp::iostream> > streams;
+    for (std::size_t n = 1; n <= NUM_CONNECTIONS; ++n) {
+        streams.push_back(boost::shared_ptr<boost::asio::ip::tcp::iostream>(new boost::asio::ip::tcp::iostream(localhost)));
+        checkNumConnectionsForUpToOneSecond(n);
+    }
+
+    // close them in a different order than they were opened
+    for (std::size_t n = 0; n < NUM_CONNECTIONS; n += 2)
+        streams[n]->close();
+    checkNumConnectionsForUpToOneSecond(NUM_CONNECTIONS / 2);
+    for (std::size_t n = 1; n < NUM_CONNECTIONS; n += 2)
+        streams[n]->close();
+    checkNumConnectionsForUpToOneSecond(static_cast<std::size_t>(0));
+}
+
+BOOST_AUTO_TEST_CASE(checkReusePortServerConnectionBehavior) {
+    boost::asio::ip::tcp::endpoint localhost(boost::asio::ip::address::from_string("127.0.0.1"), getServerPtr()->get_port());
+
+    // open enough connections that more than one acceptor is likely to be used
+    static const int NUM_CONNECTIONS = 8;
+    std::string str;
+    for (int n = 0; n < NUM_CONNECTIONS; ++n) {
+        boost::asio::ip::tcp::iostream tcp_stream(localhost);
+        std::getline(tcp_stream, str);
+        BOOST_CHECK(str == "Hello there!");
+        tcp_stream << "Hi!\n";
+        tcp_stream.flush();
+        std::getline(tcp_stream, str);
+        BOOST_CHECK(str == "Goodbye!");
+        tcp_stream.close();
+    }
+}
+
+BOOST_AUTO_TEST_CASE(checkReusePortAcceptorsFollowSchedulerResizing) {
+    // connections waiting to be accepted do not count towards the load
+    for (boost::uint32_t n = 0; n < getScheduler().get_num_services(); ++n)
+        BOOST_CHECK_EQUAL(getScheduler().get_service_load(n), 0);
+
+    // so the retired services' threads finish once their acceptors are closed
+    boost::asio::io_service& last_service(getScheduler().get_io_service(3));
+    getScheduler().set_num_threads(2);
+    boost::this_thread::sleep(boost::posix_time::milliseconds(500));
+    last_service.post(boost::bind(&ReusePortHelloServerTests_F::setFlag, this));
+    boost::this_thread::sleep(boost::posix_time::milliseconds(100));
+    BOOST_CHECK(! m_flag);
+
+    // and new connections only go to the services that are left
+    boost::asio::ip::tcp::endpoint localhost(boost::asio::ip::address::from_string("127.0.0.1"), getServerPtr()->get_port());
+    std::string str;
+    for (int n = 0; n < 8; ++n) {
+        boost::asio::ip::tcp::iostream tcp_stream(localhost);
+        std::getline(tcp_stream, str);
+        BOOST_CHECK(str == "Hello there!");
+    }
+
+    // services that are added again get new acceptors
+    getScheduler().set_num_threads(4);
+    boost::this_thread::sleep(boost::posix_time::milliseconds(100));
+    static const std::size_t NUM_CONNECTIONS = 40;
+    std::vector<boost::shared_ptr<boost::asio::ip::tcp::iostream> > streams;
+    for (std::size_t n = 0; n < NUM_CONNECTIONS; ++n) {
+        streams.push_back(boost::shared_ptr<boost::asio::ip::tcp::iostream>(new boost::asio::ip::tcp::iostream(localhost)));
+        std::getline(*streams.back(), str);
+        BOOST_CHECK(str == "Hello there!");
+    }
+    BOOST_CHECK(getScheduler().get_service_load(2) + getScheduler().get_service_load(3) > 0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+
+///
+/// TunedHelloServerTests_F: fixture used for running (Hello) server tests
+/// with socket options and batch accepts configured
+/// 
+class TunedHelloServerTests_F {
+public:
+    TunedHelloServerTests_F()
+        : m_scheduler(), hello_server_ptr(new HelloServer(m_scheduler))
+    {
+        hello_server_ptr->set_option("backlog", "64");
+        hello_server_ptr->set_option("no_delay", "true");
+        hello_server_ptr->set_option("defer_accept", "1");
+        hello_server_ptr->set_option("fast_open", "16");
+        hello_server_ptr->set_option("receive_buffer_size", "65536");
+        hello_server_ptr->set_option("send_buffer_size", "65536");
+        hello_server_ptr->set_option("accept_batch_size", "8");
+        hello_server_ptr->start();
+    }
+    ~TunedHelloServerTests_F() {
+        hello_server_ptr->stop();
+    }
+    inline tcp::server_ptr& getServerPtr(void) { return hello_server_ptr; }
+
+private:
+    single_service_scheduler    m_scheduler;
+    tcp::server_ptr             hello_server_ptr;
+};
+
+BOOST_FIXTURE_TEST_SUITE(TunedHelloServerTests_S, TunedHelloServerTests_F)
+
+BOOST_AUTO_TEST_CASE(checkTunedServerIsListening) {
+    BOOST_CHECK(getServerPtr()->is_listening());
+    BOOST_CHECK_EQUAL(getServerPtr()->get_listen_backlog(), 64);
+    BOOST_CHECK(getServerPtr()->get_no_delay());
+    BOOST_CHECK_EQUAL(getServerPtr()->get_defer_accept(), 1);
+    BOOST_CHECK_EQUAL(getServerPtr()->get_fast_open(), 16);
+    BOOST_CHECK_EQUAL(getServerPtr()->get_receive_buffer_size(), 65536);
+    BOOST_CHECK_EQUAL(getServerPtr()->get_send_buffer_size(), 65536);
+    BOOST_CHECK_EQUAL(getServerPtr()->get_accept_batch_size(), 8U);
+}
+
+BOOST_AUTO_TEST_CASE(checkInvalidServerOptionsAreRejected) {
+    BOOST_CHECK_THROW(getServerPtr()->set_option("no_such_option", "1"), error::bad_arg);
+    BOOST_CHECK_THROW(getServerPtr()->set_option("backlog", "many"), error::bad_arg);
+    BOOST_CHECK_THROW(getServerPtr()->set_option("no_delay", "maybe"), error::bad_arg);
+}
+
+BOOST_AUTO_TEST_CASE(checkTunedServerAcceptsBurstOfConnections) {
+    boost::asio::ip::tcp::endpoint localhost(boost::asio::ip::address::from_string("127.0.0.1"), getServerPtr()->get_port());
+
+    // open more connections than the batch size before reading from any of them
+    static const std::size_t NUM_CONNECTIONS = 20;
+    std::vector<boost::shared_ptr<boost::asio::ip::tcp::iostream> > streams;
+    for (std::size_t n = 0; n < NUM_CONNECTIONS; ++n)
+        streams.push_back(boost::shared_ptr<boost::asio::ip::tcp::iostream>(new boost::asio::ip::tcp::iostream(localhost)));
+
+    // TCP_DEFER_ACCEPT holds connections until data arrives, so send first
+    std::string str;
+    for (std::size_t n = 0; n < NUM_CONNECTIONS; ++n) {
+        *streams[n] << "Hi!\n";
+        streams[n]->flush();
+    }
+    for (std::size_t n = 0; n < NUM_CONNECTIONS; ++n) {
+        std::getline(*streams[n], str);
+        BOOST_CHECK(str == "Hello there!");
+        std::getline(*streams[n], str);
+        BOOST_CHECK(str == "Goodbye!");
+        streams[n]->close();
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+
+///
+/// UringHelloServerTests_F: fixture used for running (Hello) server tests
+/// with the uring_engine performing socket I/O, if the kernel supports it
+/// 
+class UringHelloServerTests_F {
+public:
+    UringHelloServerTests_F()
+        : m_is_running(uring_engine::get_instance().start()),
+        hello_server_ptr(new HelloServer)
+    {
+        hello_server_ptr->start();
+    }
+    ~UringHelloServerTests_F() {
+        hello_server_ptr->stop();
+        uring_engine::get_instance().shutdown();
+    }
+    inline tcp::server_ptr& getServerPtr(void) { return hello_server_ptr; }
+    inline bool hasSocketIO(void) const {
+        return m_is_running && uring_engine::get_instance().has_socket_io();
+    }
+
+private:
+    const bool                  m_is_running;
+    tcp::server_ptr             hello_server_ptr;
+};
+
+BOOST_FIXTURE_TEST_SUITE(UringHelloServerTests_S, UringHelloServerTests_F)
+
+BOOST_AUTO_TEST_CASE(checkUringServerConnectionBehavior) {
+    if (! hasSocketIO())
+        BOOST_TEST_MESSAGE("io_uring socket I/O is not supported; checking the asio fallback");
+    const boost::uint64_t num_socket_ops = uring_engine::get_instance().get_num_socket_ops();
+    boost::asio::ip::tcp::endpoint localhost(boost::asio::ip::address::from_string("127.0.0.1"), getServerPtr()->get_port());
+    boost::asio::ip::tcp::iostream tcp_stream(localhost);
+
+    std::string str;
+    std::getline(tcp_stream, str);
+    BOOST_CHECK(str == "Hello there!");
+    tcp_stream << "Hi!\n";
+    tcp_stream.flush();
+    std::getline(tcp_stream, str);
+    BOOST_CHECK(str == "Goodbye!");
+    tcp_stream.close();
+
+    // the greeting, the read and the goodbye
+    if (hasSocketIO())
+        BOOST_CHECK_EQUAL(uring_engine::get_instance().get_num_socket_ops(), num_socket_ops + 3);
+}
+
+BOOST_AUTO_TEST_CASE(checkUringServerDetectsClosedConnections) {
+    boost::asio::ip::tcp::endpoint localhost(boost::asio::ip::address::from_string("127.0.0.1"), getServerPtr()->get_port());
+    boost::asio::ip::tcp::iostream tcp_stream(localhost);
+    std::string str;
+    std::getline(tcp_stream, str);
+    BOOST_CHECK(str == "Hello there!");
+
+    // the server's read finishes (with eof) once the client has gone away
+    tcp_stream.close();
+    for (int i = 0; i < 10 && getServerPtr()->get_connections() != 0; ++i)
+        scheduler::sleep(0, 100000000); // 0.1 seconds
+    BOOST_CHECK_EQUAL(getServerPtr()->get_connections(), 0U);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+
+
+#ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+
+///
+/// LocalHelloServerTests_F: fixture used for running (Hello) server tests
+/// over a Unix domain socket
+///
+class LocalHelloServerTests_F {
+public:
+    LocalHelloServerTests_F()
+        : m_scheduler(), hello_server_ptr(new HelloServer(m_scheduler)),
+        m_local_path("pion_tcp_server_tests.sock")
+    {
+        hello_server_ptr->set_local_path(m_local_path);
+        hello_server_ptr->start();
+    }
+    ~LocalHelloServerTests_F() {
+        hello_server_ptr->stop();
+    }
+    inline tcp::server_ptr& getServerPtr(void) { return hello_server_ptr; }
+    inline const std::string& getLocalPath(void) const { return m_local_path; }
+
+private:
+    single_service_scheduler    m_scheduler;
+    tcp::server_ptr             hello_server_ptr;
+    const std::string           m_local_path;
+};
+
+BOOST_FIXTURE_TEST_SUITE(LocalHelloServerTests_S, LocalHelloServerTests_F)
+
+BOOST_AUTO_TEST_CASE(checkLocalServerIsListening) {
+    BOOST_CHECK(getServerPtr()->is_listening());
+    BOOST_CHECK(getServerPtr()->is_local());
+    BOOST_CHECK_EQUAL(getServerPtr()->get_local_path(), getLocalPath());
+}
+
+BOOST_AUTO_TEST_CASE(checkLocalServerConnectionBehavior) {
+    boost::asio::local::stream_protocol::endpoint local_endpoint(getLocalPath());
+    std::string str;
+    for (int n = 0; n < 3; ++n) {
+        boost::asio::local::stream_protocol::iostream local_stream(local_endpoint);
+        std::getline(local_stream, str);
+        BOOST_CHECK(str == "Hello there!");
+        local_stream << "Hi!\n";
+        local_stream.flush();
+        std::getline(local_stream, str);
+        BOOST_CHECK(str == "Goodbye!");
+        local_stream.close();
+    }
+}
+
+BOOST_AUTO_TEST_CASE(checkLocalSocketIsRemovedWhenStopped) {
+    BOOST_CHECK(boost::filesystem::exists(getLocalPath()));
+    getServerPtr()->stop();
+    BOOST_CHECK(! boost::filesystem::exists(getLocalPath()));
+}
+
+BOOST_AUTO_TEST_CASE(checkConnectionCanConnectToLocalServer) {
+    boost::asio::io_service io_service;
+    tcp::connection tcp_conn(io_service);
+    boost::system::error_code ec = tcp_conn.connect(boost::asio::local::stream_protocol::endpoint(getLocalPath()));
+    BOOST_REQUIRE(! ec);
+    BOOST_CHECK(tcp_conn.is_local());
+    BOOST_CHECK(tcp_conn.get_remote_ip().is_unspecified());
+    BOOST_CHECK(tcp_conn.get_local_endpoint().address().is_unspecified());
+
+    // read the greeting using the connection's read buffer
+    std::size_t bytes_read = tcp_conn.read_some(ec);
+    BOOST_REQUIRE(! ec);
+    BOOST_CHECK_EQUAL(std::string(tcp_conn.get_read_buffer().data(), bytes_read), "Hello there!\n");
+    tcp_conn.close();
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 
+#endif
+
+
 ///
 /// MockSyncServer: simple TCP server that synchronously receives HTTP requests using http::message::receive(),
 /// and checks that the received request object has some expected properties.
@@ -447,6 +842,33 @@ BOOST_AUTO_TEST_CASE(checkReceivedRequestUsingRequestObject) {
     BOOST_CHECK(strncmp(tcp_conn.get_read_buffer().data(), "Goodbye!", strlen("Goodbye!")) == 0);
 }
 
+BOOST_AUTO_TEST_CASE(checkReceivedLargeRequestUsingRequestObject) {
+    // open a connection
+    pion::tcp::connection tcp_conn(get_io_service());
+    boost::system::error_code error_code;
+    error_code = tcp_conn.connect(boost::asio::ip::address::from_string("127.0.0.1"), getServerPtr()->get_port());
+    BOOST_REQUIRE(!error_code);
+
+    // large enough for the server's read buffer to grow while receiving it
+    const std::string content(300000, 'z');
+    std::map<std::string, std::string> expectedHeaders;
+    expectedHeaders[http::types::HEADER_CONTENT_LENGTH] = "300000";
+    getServerPtr()->setExpectations(expectedHeaders, content);
+
+    // send request to the server
+    http::request http_request;
+    http_request.set_content_length(content.size());
+    http_request.create_content_buffer();
+    memcpy(http_request.get_content(), content.c_str(), content.size());
+    http_request.send(tcp_conn, error_code);
+    BOOST_REQUIRE(!error_code);
+
+    // receive the response from the server
+    tcp_conn.read_some(error_code);
+    BOOST_CHECK(!error_code);
+    BOOST_CHECK(strncmp(tcp_conn.get_read_buffer().data(), "Goodbye!", strlen("Goodbye!")) == 0);
+}
+
 bool queryKeyXHasValueY(http::request& http_request) {
     return http_request.get_query("x") == "y";
 }
@@ -529,3 +951,81 @@ BOOST_AUTO_TEST_CASE(checkCharsetOfReceivedRequest) {
 */
 
 BOOST_AUTO_TEST_SUITE_END()
+
+
+///
+/// ReadBufferTests_F: fixture used for testing the growth of connection read buffers
+/// 
+class ReadBufferTests_F {
+public:
+    ReadBufferTests_F() : m_tcp_conn(m_io_service) {
+        getBuffer().set_size(4096, 16384);
+    }
+    ~ReadBufferTests_F() {}
+    inline pion::tcp::connection::read_buffer_type& getBuffer(void) { return m_tcp_conn.get_read_buffer(); }
+
+private:
+    boost::asio::io_service     m_io_service;
+    pion::tcp::connection       m_tcp_conn;
+};
+
+BOOST_FIXTURE_TEST_SUITE(ReadBufferTests_S, ReadBufferTests_F)
+
+BOOST_AUTO_TEST_CASE(checkReadBufferSizesAreRounded) {
+    getBuffer().set_size(3000, 100);
+    BOOST_CHECK_EQUAL(getBuffer().get_min_size(), 4096U);
+    BOOST_CHECK_EQUAL(getBuffer().get_max_size(), 4096U);
+    BOOST_CHECK_EQUAL(boost::asio::buffer_size(getBuffer().prepare()), 4096U);
+}
+
+BOOST_AUTO_TEST_CASE(checkReadBufferGrowsAfterFullReads) {
+    BOOST_CHECK_EQUAL(boost::asio::buffer_size(getBuffer().prepare()), 4096U);
+
+    // a single full read is not enough to grow the buffer
+    getBuffer().update_size(4096);
+    BOOST_CHECK_EQUAL(boost::asio::buffer_size(getBuffer().prepare()), 4096U);
+    getBuffer().update_size(4096);
+    BOOST_CHECK_EQUAL(boost::asio::buffer_size(getBuffer().prepare()), 8192U);
+    getBuffer().update_size(8192);
+    getBuffer().update_size(8192);
+    BOOST_CHECK_EQUAL(boost::asio::buffer_size(getBuffer().prepare()), 16384U);
+
+    // the buffer does not grow beyond its maximum size
+    getBuffer().update_size(16384);
+    getBuffer().update_size(16384);
+    BOOST_CHECK_EQUAL(boost::asio::buffer_size(getBuffer().prepare()), 16384U);
+}
+
+BOOST_AUTO_TEST_CASE(checkReadBufferShrinksAfterShortReads) {
+    for (int n = 0; n < 4; ++n)
+        getBuffer().update_size(getBuffer().size());
+    BOOST_CHECK_EQUAL(boost::asio::buffer_size(getBuffer().prepare()), 16384U);
+
+    // reads that fill more than a quarter of the buffer do not shrink it
+    for (int n = 0; n < 8; ++n)
+        getBuffer().update_size(8192);
+    BOOST_CHECK_EQUAL(boost::asio::buffer_size(getBuffer().prepare()), 16384U);
+
+    for (int n = 0; n < 4; ++n)
+        getBuffer().update_size(100);
+    BOOST_CHECK_EQUAL(boost::asio::buffer_size(getBuffer().prepare()), 8192U);
+
+    // the buffer does not shrink below its initial size
+    for (int n = 0; n < 16; ++n)
+        getBuffer().update_size(100);
+    BOOST_CHECK_EQUAL(boost::asio::buffer_size(getBuffer().prepare()), 4096U);
+}
+
+BOOST_AUTO_TEST_CASE(checkReleasedReadBufferShrinksToInitialSize) {
+    for (int n = 0; n < 2; ++n)
+        getBuffer().update_size(getBuffer().size());
+    BOOST_CHECK_EQUAL(boost::asio::buffer_size(getBuffer().prepare()), 8192U);
+    BOOST_CHECK(getBuffer().is_allocated());
+
+    getBuffer().release();
+    getBuffer().reset_size();
+    BOOST_CHECK(! getBuffer().is_allocated());
+    BOOST_CHECK_EQUAL(getBuffer().size(), 4096U);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
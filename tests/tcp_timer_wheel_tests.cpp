@@ -0,0 +1,146 @@
+// ---------------------------------------------------------------------
+// pion:  a Boost C++ framework for building lightweight HTTP interfaces
+// ---------------------------------------------------------------------
+// Copyright (C) 2007-2014 Splunk Inc.  (https://github.com/splunk/pion)
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See http://www.boost.org/LICENSE_1_0.txt
+//
+
+#include <boost/asio.hpp>
+#include <boost/bind.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/test/unit_test.hpp>
+#include <pion/config.hpp>
+#include <pion/tcp/connection.hpp>
+#include <pion/tcp/timer_wheel.hpp>
+
+using namespace std;
+using namespace pion;
+
+
+///
+/// timer_wheel_tests_F: fixture that connects a tcp::connection to a local socket
+///
+class timer_wheel_tests_F {
+public:
+    timer_wheel_tests_F()
+        : m_acceptor(m_io_service), m_peer(m_io_service), m_write_timer(m_io_service),
+        m_conn_ptr(new tcp::connection(m_io_service)), m_read_done(false)
+    {
+        boost::asio::ip::tcp::endpoint localhost(boost::asio::ip::address::from_string("127.0.0.1"), 0);
+        m_acceptor.open(localhost.protocol());
+        m_acceptor.bind(localhost);
+        m_acceptor.listen();
+        boost::asio::ip::tcp::endpoint server_endpoint(m_acceptor.local_endpoint());
+        BOOST_REQUIRE(! m_conn_ptr->connect(server_endpoint));
+        m_acceptor.accept(m_peer);
+    }
+    ~timer_wheel_tests_F() {}
+
+    /// returns the timer_wheel used by the connection
+    inline tcp::timer_wheel& getWheel(void) {
+        return boost::asio::use_service<tcp::timer_wheel>(m_io_service);
+    }
+
+    /// starts reading from the connection
+    void startRead(void) {
+        m_conn_ptr->async_read_some(boost::bind(&timer_wheel_tests_F::handleRead, this,
+                                                boost::asio::placeholders::error));
+    }
+
+    /// called when the read operation completes (cancels the deadline like http::reader)
+    void handleRead(const boost::system::error_code& ec) {
+        m_conn_ptr->cancel_deadline();
+        m_read_error = ec;
+        m_read_done = true;
+    }
+
+    /// writes some data from the peer after a number of seconds
+    void writeFromPeerAfter(long seconds) {
+        m_write_timer.expires_from_now(boost::posix_time::seconds(seconds));
+        m_write_timer.async_wait(boost::bind(&timer_wheel_tests_F::writeFromPeer, this));
+    }
+
+    /// writes some data from the peer
+    void writeFromPeer(void) {
+        boost::asio::write(m_peer, boost::asio::buffer("x", 1));
+    }
+
+    boost::asio::io_service             m_io_service;
+    boost::asio::ip::tcp::acceptor      m_acceptor;
+    boost::asio::ip::tcp::socket        m_peer;
+    boost::asio::deadline_timer         m_write_timer;
+    tcp::connection_ptr                 m_conn_ptr;
+    boost::system::error_code           m_read_error;
+    bool                                m_read_done;
+};
+
+
+BOOST_FIXTURE_TEST_SUITE(timer_wheel_tests_S, timer_wheel_tests_F)
+
+BOOST_AUTO_TEST_CASE(checkDeadlineCancelsPendingRead) {
+    startRead();
+    m_conn_ptr->set_deadline(1);
+    BOOST_CHECK_EQUAL(getWheel().get_size(), 1U);
+
+    boost::posix_time::ptime start_time(boost::posix_time::microsec_clock::universal_time());
+    m_io_service.run();
+    boost::posix_time::time_duration elapsed(boost::posix_time::microsec_clock::universal_time() - start_time);
+
+    BOOST_REQUIRE(m_read_done);
+    BOOST_CHECK(m_read_error == boost::asio::error::operation_aborted);
+    BOOST_CHECK(elapsed >= boost::posix_time::seconds(1));
+    BOOST_CHECK(elapsed < boost::posix_time::seconds(3));
+    BOOST_CHECK_EQUAL(getWheel().get_size(), 0U);
+    BOOST_CHECK_EQUAL(getWheel().get_expired(), 1U);
+}
+
+BOOST_AUTO_TEST_CASE(checkCancelledDeadlineDoesNotExpire) {
+    startRead();
+    m_conn_ptr->set_deadline(1);
+    m_conn_ptr->cancel_deadline();
+    BOOST_CHECK_EQUAL(getWheel().get_size(), 0U);
+
+    // the read should complete normally after the deadline would have expired
+    writeFromPeerAfter(3);
+    m_io_service.run();
+
+    BOOST_REQUIRE(m_read_done);
+    BOOST_CHECK(! m_read_error);
+    BOOST_CHECK_EQUAL(getWheel().get_expired(), 0U);
+}
+
+BOOST_AUTO_TEST_CASE(checkDeadlineCanBeExtended) {
+    startRead();
+    m_conn_ptr->set_deadline(1);
+    m_conn_ptr->set_deadline(5);
+    BOOST_CHECK_EQUAL(getWheel().get_size(), 1U);
+
+    // the read should complete before the extended deadline expires
+    writeFromPeerAfter(3);
+    m_io_service.run();
+
+    BOOST_REQUIRE(m_read_done);
+    BOOST_CHECK(! m_read_error);
+    BOOST_CHECK_EQUAL(getWheel().get_expired(), 0U);
+}
+
+BOOST_AUTO_TEST_CASE(checkLongDeadlinesAreTracked) {
+    // deadlines that span several levels of the wheel
+    tcp::connection conn_a(m_io_service), conn_b(m_io_service), conn_c(m_io_service);
+    conn_a.set_deadline(100);
+    conn_b.set_deadline(10000);
+    conn_c.set_deadline(20000000);
+    BOOST_CHECK_EQUAL(getWheel().get_size(), 3U);
+
+    conn_b.cancel_deadline();
+    BOOST_CHECK_EQUAL(getWheel().get_size(), 2U);
+
+    // closing a connection also cancels its deadline
+    conn_a.close();
+    conn_c.close();
+    BOOST_CHECK_EQUAL(getWheel().get_size(), 0U);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,222 @@
+// ---------------------------------------------------------------------
+// pion:  a Boost C++ framework for building lightweight HTTP interfaces
+// ---------------------------------------------------------------------
+// Copyright (C) 2007-2014 Splunk Inc.  (https://github.com/splunk/pion)
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See http://www.boost.org/LICENSE_1_0.txt
+//
+
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <boost/asio.hpp>
+#include <boost/bind.hpp>
+#include <boost/test/unit_test.hpp>
+#include <pion/config.hpp>
+#include <pion/uring_engine.hpp>
+
+#ifdef PION_HAVE_IO_URING
+    #include <fcntl.h>
+    #include <unistd.h>
+    #include <sys/socket.h>
+#endif
+
+using namespace std;
+using namespace pion;
+
+
+///
+/// uring_engine_F: fixture that starts a uring_engine and creates a file to read
+///
+class uring_engine_F {
+public:
+    uring_engine_F() : m_work(m_io_service), m_fd(-1), m_num_done(0), m_bytes_read(0) {
+        m_sockets[0] = m_sockets[1] = -1;
+        for (unsigned int n = 0; n < FILE_SIZE; ++n)
+            m_file_content.push_back(static_cast<char>('a' + n % 26));
+        std::ofstream file_stream(FILE_NAME, std::ios::out | std::ios::binary);
+        file_stream.write(m_file_content.data(), m_file_content.size());
+        file_stream.close();
+        m_is_running = m_engine.start(8, 2, BUFFER_SIZE);
+#ifdef PION_HAVE_IO_URING
+        m_fd = ::open(FILE_NAME, O_RDONLY);
+        if (::socketpair(AF_UNIX, SOCK_STREAM, 0, m_sockets) != 0)
+            m_sockets[0] = m_sockets[1] = -1;
+#endif
+        if (! m_is_running)
+            BOOST_TEST_MESSAGE("io_uring is not supported; skipping uring_engine tests");
+    }
+    ~uring_engine_F() {
+        m_engine.shutdown();
+#ifdef PION_HAVE_IO_URING
+        if (m_fd >= 0)
+            ::close(m_fd);
+        for (int n = 0; n < 2; ++n) {
+            if (m_sockets[n] >= 0)
+                ::close(m_sockets[n]);
+        }
+#endif
+        std::remove(FILE_NAME);
+    }
+
+    /// handler that counts finished reads
+    void handleRead(const boost::system::error_code& ec, std::size_t bytes_read) {
+        BOOST_CHECK(! ec);
+        m_bytes_read += bytes_read;
+        ++m_num_done;
+    }
+
+    /// handler that records the result of a socket operation
+    void handleSocketOp(const boost::system::error_code& ec, std::size_t bytes) {
+        m_socket_ec = ec;
+        m_bytes_read += bytes;
+        ++m_num_done;
+    }
+
+    /// returns true if the engine may be used for sockets in this environment
+    bool hasSocketIO(void) const {
+        return m_is_running && m_engine.has_socket_io() && m_sockets[0] >= 0;
+    }
+
+    /// queues reads of each block of the file from within the IO service
+    void queueReads(char *buf, unsigned int num_blocks) {
+        for (unsigned int n = 0; n < num_blocks; ++n) {
+            BOOST_CHECK(m_engine.async_read(m_fd, n * BLOCK_SIZE, buf + n * BLOCK_SIZE, BLOCK_SIZE,
+                                            m_io_service, boost::bind(&uring_engine_F::handleRead, this, _1, _2)));
+        }
+    }
+
+    static const char *         FILE_NAME;
+    static const unsigned int   FILE_SIZE = 4000;
+    static const unsigned int   BLOCK_SIZE = 500;
+    static const std::size_t    BUFFER_SIZE = 4096;
+
+    uring_engine                m_engine;
+    boost::asio::io_service     m_io_service;
+    boost::asio::io_service::work   m_work;     // keeps run_one() waiting for reads
+    std::string                 m_file_content;
+    int                         m_fd;
+    int                         m_sockets[2];
+    bool                        m_is_running;
+    unsigned int                m_num_done;
+    std::size_t                 m_bytes_read;
+    boost::system::error_code   m_socket_ec;
+};
+
+const char *uring_engine_F::FILE_NAME = "uring_engine_tests.tmp";
+
+
+BOOST_FIXTURE_TEST_SUITE(uring_engine_S, uring_engine_F)
+
+BOOST_AUTO_TEST_CASE(checkEngineFallsBackWhenStopped) {
+    char buf[BLOCK_SIZE];
+    m_engine.shutdown();
+    BOOST_CHECK(! m_engine.is_running());
+    BOOST_CHECK(! m_engine.async_read(m_fd, 0, buf, sizeof(buf), m_io_service,
+                                      boost::bind(&uring_engine_F::handleRead, this, _1, _2)));
+}
+
+BOOST_AUTO_TEST_CASE(checkReadIntoRegisteredBuffer) {
+    if (! m_is_running)
+        return;
+    char *buf = m_engine.acquire_buffer();
+    BOOST_REQUIRE(buf != NULL);
+    BOOST_CHECK_EQUAL(m_engine.get_buffer_size(), static_cast<std::size_t>(BUFFER_SIZE));
+    BOOST_REQUIRE(m_engine.async_read(m_fd, 0, buf, BUFFER_SIZE, m_io_service,
+                                      boost::bind(&uring_engine_F::handleRead, this, _1, _2)));
+    while (m_num_done < 1)
+        m_io_service.run_one();
+
+    // reading past the end of the file returns only the bytes that remain
+    BOOST_CHECK_EQUAL(m_bytes_read, static_cast<std::size_t>(FILE_SIZE));
+    BOOST_CHECK(std::string(buf, FILE_SIZE) == m_file_content);
+    BOOST_CHECK_EQUAL(m_engine.get_num_reads(), 1U);
+    m_engine.release_buffer(buf);
+}
+
+BOOST_AUTO_TEST_CASE(checkReadIntoPrivateBuffer) {
+    if (! m_is_running)
+        return;
+    std::vector<char> buf(BLOCK_SIZE);
+    BOOST_REQUIRE(m_engine.async_read(m_fd, BLOCK_SIZE, &buf[0], BLOCK_SIZE, m_io_service,
+                                      boost::bind(&uring_engine_F::handleRead, this, _1, _2)));
+    while (m_num_done < 1)
+        m_io_service.run_one();
+    BOOST_CHECK_EQUAL(m_bytes_read, static_cast<std::size_t>(BLOCK_SIZE));
+    BOOST_CHECK(std::string(&buf[0], BLOCK_SIZE) == m_file_content.substr(BLOCK_SIZE, BLOCK_SIZE));
+    BOOST_CHECK_EQUAL(m_engine.get_num_fixed_reads(), 0U);
+}
+
+BOOST_AUTO_TEST_CASE(checkReadsQueuedTogetherAreBatched) {
+    if (! m_is_running)
+        return;
+    const unsigned int num_blocks = FILE_SIZE / BLOCK_SIZE;
+    char *buf = m_engine.acquire_buffer();
+    BOOST_REQUIRE(buf != NULL);
+    m_io_service.post(boost::bind(&uring_engine_F::queueReads, this, buf, num_blocks));
+    while (m_num_done < num_blocks)
+        m_io_service.run_one();
+    BOOST_CHECK_EQUAL(m_bytes_read, static_cast<std::size_t>(FILE_SIZE));
+    BOOST_CHECK(std::string(buf, FILE_SIZE) == m_file_content);
+    BOOST_CHECK_EQUAL(m_engine.get_num_reads(), num_blocks);
+    BOOST_CHECK_EQUAL(m_engine.get_num_fixed_reads(), num_blocks);
+    BOOST_CHECK_EQUAL(m_engine.get_num_batches(), 1U);
+    m_engine.release_buffer(buf);
+}
+
+BOOST_AUTO_TEST_CASE(checkSocketSendAndRecv) {
+    if (! hasSocketIO())
+        return;
+    const std::string message("hello, world");
+    std::vector<boost::asio::const_buffer> buffers;
+    buffers.push_back(boost::asio::buffer(message.data(), 5));
+    buffers.push_back(boost::asio::buffer(message.data() + 5, message.size() - 5));
+    BOOST_REQUIRE(m_engine.async_send(m_sockets[0], buffers, m_io_service,
+                                      boost::bind(&uring_engine_F::handleSocketOp, this, _1, _2)));
+    while (m_num_done < 1)
+        m_io_service.run_one();
+    BOOST_CHECK(! m_socket_ec);
+    BOOST_CHECK_EQUAL(m_bytes_read, message.size());
+
+    char buf[64];
+    m_bytes_read = 0;
+    BOOST_REQUIRE(m_engine.async_recv(m_sockets[1], buf, sizeof(buf), m_io_service,
+                                      boost::bind(&uring_engine_F::handleSocketOp, this, _1, _2)));
+    while (m_num_done < 2)
+        m_io_service.run_one();
+    BOOST_CHECK(! m_socket_ec);
+    BOOST_CHECK_EQUAL(std::string(buf, m_bytes_read), message);
+    BOOST_CHECK_EQUAL(m_engine.get_num_socket_ops(), 2U);
+}
+
+BOOST_AUTO_TEST_CASE(checkCancelAbortsSocketRecv) {
+    if (! hasSocketIO())
+        return;
+    char buf[64];
+    BOOST_REQUIRE(m_engine.async_recv(m_sockets[1], buf, sizeof(buf), m_io_service,
+                                      boost::bind(&uring_engine_F::handleSocketOp, this, _1, _2)));
+    m_io_service.poll();    // submits the read, which waits for data
+    BOOST_CHECK_EQUAL(m_num_done, 0U);
+    m_engine.cancel(m_sockets[1]);
+    while (m_num_done < 1)
+        m_io_service.run_one();
+    BOOST_CHECK(m_socket_ec == boost::asio::error::operation_aborted);
+}
+
+BOOST_AUTO_TEST_CASE(checkShutdownFinishesSocketRecv) {
+    if (! hasSocketIO())
+        return;
+    char buf[64];
+    BOOST_REQUIRE(m_engine.async_recv(m_sockets[1], buf, sizeof(buf), m_io_service,
+                                      boost::bind(&uring_engine_F::handleSocketOp, this, _1, _2)));
+    // the read has not been submitted yet; shutting down must not wait for data
+    m_engine.shutdown();
+    BOOST_CHECK(! m_engine.is_running());
+    while (m_num_done < 1)
+        m_io_service.run_one();
+    BOOST_CHECK(m_socket_ec == boost::asio::error::operation_aborted);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,662 @@
+// ---------------------------------------------------------------------
+// pion:  a Boost C++ framework for building lightweight HTTP interfaces
+// ---------------------------------------------------------------------
+// Copyright (C) 2007-2014 Splunk Inc.  (https://github.com/splunk/pion)
+//
+// Distributed under the Boost Software License, Version 1.0.
+// See http://www.boost.org/LICENSE_1_0.txt
+//
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#include <algorithm>
+#include <string>
+#include <iostream>
+#include <boost/asio.hpp>
+#include <boost/bind.hpp>
+#include <boost/lexical_cast.hpp>
+#include <boost/date_time/posix_time/posix_time.hpp>
+#include <boost/thread/condition.hpp>
+#include <boost/thread/mutex.hpp>
+#include <pion/error.hpp>
+#include <pion/scheduler.hpp>
+#include <pion/tcp/buffer_pool.hpp>
+#include <pion/tcp/connection.hpp>
+#include <pion/tcp/server.hpp>
+#include <pion/http/parser.hpp>
+#include <pion/http/request.hpp>
+#include <pion/http/response.hpp>
+#include <pion/http/response_writer.hpp>
+#include <pion/http/server.hpp>
+
+using namespace std;
+using namespace pion;
+
+
+/// TCP server that closes every connection as soon as it has been accepted
+class CloseServer : public tcp::server {
+public:
+    CloseServer(scheduler& sched) : tcp::server(sched, 0) {}
+    virtual ~CloseServer() {}
+    virtual void handle_connection(const tcp::connection_ptr& tcp_conn)
+    {
+        tcp_conn->set_lifecycle(pion::tcp::connection::LIFECYCLE_CLOSE);
+        tcp_conn->finish();
+    }
+};
+
+/// TCP server that keeps every connection open until the client closes it
+class IdleServer : public tcp::server {
+public:
+    IdleServer(scheduler& sched) : tcp::server(sched, 0) {}
+    virtual ~IdleServer() {}
+    virtual void handle_connection(const tcp::connection_ptr& tcp_conn)
+    {
+        tcp_conn->async_read_some(boost::bind(&IdleServer::handle_read, this, tcp_conn,
+                                              boost::asio::placeholders::error));
+    }
+    void handle_read(const tcp::connection_ptr& tcp_conn, const boost::system::error_code& read_error)
+    {
+        if (read_error) {
+            tcp_conn->set_lifecycle(pion::tcp::connection::LIFECYCLE_CLOSE);
+            tcp_conn->finish();
+        } else {
+            handle_connection(tcp_conn);
+        }
+    }
+};
+
+/// HTTP request handler that responds with a short message
+static void bench_hello_handler(const http::request_ptr& http_request_ptr,
+                                const tcp::connection_ptr& tcp_conn)
+{
+    static const std::string HELLO_HTML = "<html><body>Hello World!</body></html>";
+    http::response_writer_ptr writer(http::response_writer::create(tcp_conn, *http_request_ptr,
+                                                                   boost::bind(&tcp::connection::finish, tcp_conn)));
+    writer->write_no_copy(HELLO_HTML);
+    writer->send();
+}
+
+
+/// returns the current time (used to time benchmarks)
+static inline boost::posix_time::ptime bench_now(void)
+{
+    return boost::posix_time::microsec_clock::universal_time();
+}
+
+/// returns the number of nanoseconds that have passed since start_time
+static inline double bench_elapsed_nsec(const boost::posix_time::ptime& start_time)
+{
+    return static_cast<double>((bench_now() - start_time).total_microseconds()) * 1000.0;
+}
+
+/// returns the resident set size of the process in bytes (0 if unknown)
+static std::size_t bench_resident_bytes(void)
+{
+    std::size_t rss_pages = 0;
+#ifdef __linux__
+    FILE *statm = fopen("/proc/self/statm", "r");
+    if (statm != NULL) {
+        unsigned long total_pages = 0, resident_pages = 0;
+        if (fscanf(statm, "%lu %lu", &total_pages, &resident_pages) == 2)
+            rss_pages = resident_pages;
+        fclose(statm);
+    }
+#endif
+    return rss_pages * 4096;
+}
+
+/// prints one benchmark result
+static void bench_report(const char *name, double value, const char *units)
+{
+    printf("%-32s %14.3f %s\n", name, value, units);
+}
+
+
+/// measures construction cost and memory footprint of plain TCP connections
+static void bench_connection(unsigned int iterations)
+{
+    boost::asio::io_service io_service;
+#ifdef PION_HAVE_SSL
+    tcp::connection::ssl_context_type ssl_context(boost::asio::ssl::context::sslv23);
+#else
+    tcp::connection::ssl_context_type ssl_context = 0;
+#endif
+
+    // time creating and destroying connections one at a time
+    boost::posix_time::ptime start_time(bench_now());
+    for (unsigned int n = 0; n < iterations; ++n) {
+        tcp::connection_ptr conn_ptr(tcp::connection::create(io_service, ssl_context, false,
+                                                             tcp::connection::connection_handler()));
+    }
+    bench_report("connection.create", bench_elapsed_nsec(start_time) / iterations, "ns/conn");
+
+    // hold all of the connections at once to estimate their memory footprint
+    std::vector<tcp::connection_ptr> conn_pool;
+    conn_pool.reserve(iterations);
+    const std::size_t rss_before = bench_resident_bytes();
+    for (unsigned int n = 0; n < iterations; ++n) {
+        conn_pool.push_back(tcp::connection::create(io_service, ssl_context, false,
+                                                    tcp::connection::connection_handler()));
+    }
+    const std::size_t rss_after = bench_resident_bytes();
+    bench_report("connection.sizeof", sizeof(tcp::connection), "bytes");
+    if (rss_after > rss_before)
+        bench_report("connection.resident", double(rss_after - rss_before) / iterations, "bytes/conn");
+}
+
+/// measures the time for a client to connect to a server and see it close
+static void bench_accept(unsigned int iterations)
+{
+    single_service_scheduler sched;
+    sched.set_num_threads(1);
+    CloseServer server(sched);
+    server.start();
+
+    boost::asio::io_service io_service;
+    boost::asio::ip::tcp::endpoint localhost(boost::asio::ip::address::from_string("127.0.0.1"),
+                                             server.get_port());
+    char buf[16];
+    boost::posix_time::ptime start_time(bench_now());
+    for (unsigned int n = 0; n < iterations; ++n) {
+        boost::asio::ip::tcp::socket sock(io_service);
+        boost::system::error_code ec;
+        sock.connect(localhost, ec);
+        if (ec) break;
+        // wait for the server to close the connection
+        sock.read_some(boost::asio::buffer(buf), ec);
+    }
+    bench_report("accept.latency", bench_elapsed_nsec(start_time) / iterations, "ns/conn");
+    if (server.get_total_connections() > 0)
+        bench_report("accept.allocations", double(server.get_connection_allocations())
+                     / server.get_total_connections(), "allocs/conn");
+
+    server.stop();
+}
+
+/// measures the time to accept and close a connection while many others stay open
+static void bench_accept_idle(unsigned int iterations)
+{
+    // each idle connection uses two file descriptors in this process
+    static const unsigned int NUM_IDLE_CONNECTIONS = 400;
+    single_service_scheduler sched;
+    sched.set_num_threads(1);
+    IdleServer server(sched);
+    server.start();
+
+    boost::asio::io_service io_service;
+    boost::asio::ip::tcp::endpoint localhost(boost::asio::ip::address::from_string("127.0.0.1"),
+                                             server.get_port());
+    std::vector<boost::shared_ptr<boost::asio::ip::tcp::socket> > idle_pool;
+    for (unsigned int n = 0; n < NUM_IDLE_CONNECTIONS; ++n) {
+        boost::shared_ptr<boost::asio::ip::tcp::socket> sock_ptr(new boost::asio::ip::tcp::socket(io_service));
+        boost::system::error_code ec;
+        sock_ptr->connect(localhost, ec);
+        if (ec) break;
+        idle_pool.push_back(sock_ptr);
+    }
+
+    char buf[16];
+    boost::posix_time::ptime start_time(bench_now());
+    for (unsigned int n = 0; n < iterations; ++n) {
+        boost::asio::ip::tcp::socket sock(io_service);
+        boost::system::error_code ec;
+        sock.connect(localhost, ec);
+        if (ec) break;
+        // close our end and wait for the server to close its end
+        sock.shutdown(boost::asio::ip::tcp::socket::shutdown_send, ec);
+        sock.read_some(boost::asio::buffer(buf), ec);
+    }
+    bench_report("accept_idle.latency", bench_elapsed_nsec(start_time) / iterations, "ns/conn");
+    bench_report("accept_idle.open", idle_pool.size(), "conns");
+
+    idle_pool.clear();
+    server.stop();
+}
+
+/// measures the memory used by kept-alive HTTP connections while they are idle
+static void bench_keepalive_idle(unsigned int iterations)
+{
+    static const std::string REQUEST = "GET / HTTP/1.1\r\nHost: localhost\r\n\r\n";
+    for (int release_buffers = 0; release_buffers < 2; ++release_buffers) {
+        single_service_scheduler sched;
+        sched.set_num_threads(1);
+        http::server server(sched);
+        server.add_resource("/", bench_hello_handler);
+        server.set_release_idle_buffers(release_buffers != 0);
+        server.start();
+
+        boost::asio::io_service io_service;
+        boost::asio::ip::tcp::endpoint localhost(boost::asio::ip::address::from_string("127.0.0.1"),
+                                                 server.get_port());
+        const long bytes_before = tcp::buffer_pool::get_bytes_in_use();
+        const std::size_t rss_before = bench_resident_bytes();
+
+        // send one request on each connection, then leave it open and idle
+        std::vector<boost::shared_ptr<boost::asio::ip::tcp::socket> > idle_pool;
+        char buf[1024];
+        for (unsigned int n = 0; n < iterations; ++n) {
+            boost::shared_ptr<boost::asio::ip::tcp::socket> sock_ptr(new boost::asio::ip::tcp::socket(io_service));
+            boost::system::error_code ec;
+            sock_ptr->connect(localhost, ec);
+            if (ec) break;
+            boost::asio::write(*sock_ptr, boost::asio::buffer(REQUEST), ec);
+            if (! ec)
+                sock_ptr->read_some(boost::asio::buffer(buf), ec);
+            if (ec) break;
+            idle_pool.push_back(sock_ptr);
+        }
+
+        // give the server a chance to start waiting for the next requests
+        scheduler::sleep(0, 100000000);
+        const std::size_t rss_after = bench_resident_bytes();
+        const long bytes_after = tcp::buffer_pool::get_bytes_in_use();
+
+        const std::string prefix(release_buffers ? "keepalive_idle.released" : "keepalive_idle.pinned");
+        if (! idle_pool.empty()) {
+            bench_report((prefix + ".buffers").c_str(),
+                         double(bytes_after - bytes_before) / idle_pool.size(), "bytes/conn");
+            if (rss_after > rss_before)
+                bench_report((prefix + ".resident").c_str(),
+                             double(rss_after - rss_before) / idle_pool.size(), "bytes/conn");
+        }
+
+        idle_pool.clear();
+        server.stop();
+    }
+}
+
+/// measures the throughput of large uploads with fixed and adaptive read buffers
+static void bench_upload(unsigned int iterations)
+{
+    static const std::size_t CONTENT_LENGTH = 512 * 1024;
+    const std::string content(CONTENT_LENGTH, 'x');
+    std::string request("POST / HTTP/1.1\r\nHost: localhost\r\nContent-Length: ");
+    request += boost::lexical_cast<std::string>(CONTENT_LENGTH);
+    request += "\r\n\r\n";
+    request += content;
+
+    for (int adaptive = 0; adaptive < 2; ++adaptive) {
+        single_service_scheduler sched;
+        sched.set_num_threads(1);
+        http::server server(sched);
+        server.add_resource("/", bench_hello_handler);
+        if (adaptive)
+            server.set_read_buffer_size(tcp::connection::READ_BUFFER_SIZE);
+        else
+            server.set_read_buffer_size(tcp::connection::READ_BUFFER_SIZE, tcp::connection::READ_BUFFER_SIZE);
+        server.start();
+
+        boost::asio::io_service io_service;
+        boost::asio::ip::tcp::endpoint localhost(boost::asio::ip::address::from_string("127.0.0.1"),
+                                                 server.get_port());
+        boost::asio::ip::tcp::socket sock(io_service);
+        boost::system::error_code ec;
+        sock.connect(localhost, ec);
+
+        // send every request on the same kept-alive connection
+        char buf[1024];
+        unsigned int num_uploads = 0;
+        boost::posix_time::ptime start_time(bench_now());
+        while (! ec && num_uploads < iterations) {
+            boost::asio::write(sock, boost::asio::buffer(request), ec);
+            if (! ec)
+                sock.read_some(boost::asio::buffer(buf), ec);
+            if (! ec)
+                ++num_uploads;
+        }
+        const double elapsed_nsec = bench_elapsed_nsec(start_time);
+
+        if (num_uploads > 0)
+            bench_report(adaptive ? "upload.adaptive" : "upload.fixed",
+                         double(CONTENT_LENGTH) * num_uploads * 1000.0 / elapsed_nsec, "MB/s");
+
+        sock.close(ec);
+        server.stop();
+    }
+}
+
+/// sends requests on a kept-alive connection, returning the number answered
+template <typename SocketType>
+static unsigned int bench_send_requests(SocketType& sock, const std::string& request,
+                                        unsigned int iterations)
+{
+    char buf[1024];
+    unsigned int num_requests = 0;
+    boost::system::error_code ec;
+    while (! ec && num_requests < iterations) {
+        boost::asio::write(sock, boost::asio::buffer(request), ec);
+        if (! ec)
+            sock.read_some(boost::asio::buffer(buf), ec);
+        if (! ec)
+            ++num_requests;
+    }
+    return num_requests;
+}
+
+/// measures the HTTP request rate over loopback TCP and over a Unix domain socket
+static void bench_hello(unsigned int iterations)
+{
+    static const std::string REQUEST = "GET / HTTP/1.1\r\nHost: localhost\r\n\r\n";
+    for (int local = 0; local < 2; ++local) {
+#ifndef BOOST_ASIO_HAS_LOCAL_SOCKETS
+        if (local) break;
+#endif
+        single_service_scheduler sched;
+        sched.set_num_threads(1);
+        http::server server(sched);
+        server.add_resource("/", bench_hello_handler);
+        if (local)
+            server.set_local_path("pionbench.sock");
+        server.start();
+
+        boost::asio::io_service io_service;
+        boost::system::error_code ec;
+        unsigned int num_requests = 0;
+        boost::posix_time::ptime start_time(bench_now());
+#ifdef BOOST_ASIO_HAS_LOCAL_SOCKETS
+        if (local) {
+            boost::asio::local::stream_protocol::socket sock(io_service);
+            sock.connect(boost::asio::local::stream_protocol::endpoint(server.get_local_path()), ec);
+            if (! ec)
+                num_requests = bench_send_requests(sock, REQUEST, iterations);
+        } else
+#endif
+        {
+            boost::asio::ip::tcp::socket sock(io_service);
+            sock.connect(boost::asio::ip::tcp::endpoint(boost::asio::ip::address::from_string("127.0.0.1"),
+                                                        server.get_port()), ec);
+            if (! ec)
+                num_requests = bench_send_requests(sock, REQUEST, iterations);
+        }
+        const double elapsed_nsec = bench_elapsed_nsec(start_time);
+
+        if (num_requests > 0)
+            bench_report(local ? "hello.local" : "hello.tcp",
+                         num_requests * 1000000000.0 / elapsed_nsec, "req/s");
+
+        server.stop();
+    }
+}
+
+/// parses a request repeatedly and reports the rate at which its headers were read;
+/// if use_cookies is true, a cookie is looked up in each request that is parsed
+static void bench_parse_request(const char *name, const std::string& request, unsigned int iterations,
+                                bool header_views = false, bool lazy_params = true,
+                                bool use_cookies = false)
+{
+    http::parser request_parser(true);
+    request_parser.set_parse_header_views(header_views);
+    request_parser.set_lazy_params(lazy_params);
+    boost::system::error_code ec;
+    unsigned int num_parsed = 0;
+    boost::posix_time::ptime start_time(bench_now());
+    for (unsigned int n = 0; n < iterations; ++n) {
+        http::request http_request;
+        request_parser.reset();
+        request_parser.set_read_buffer(request.data(), request.size());
+        if (request_parser.parse(http_request, ec) == true
+            && (! use_cookies || http_request.has_cookie("session")))
+            ++num_parsed;
+    }
+    const double elapsed_nsec = bench_elapsed_nsec(start_time);
+    if (num_parsed > 0)
+        bench_report(name, double(request.size()) * num_parsed * 1000.0 / elapsed_nsec, "MB/s");
+}
+
+/// measures the rate at which the HTTP parser reads request headers
+static void bench_parse_headers(unsigned int iterations)
+{
+    // headers sent by a typical browser
+    static const std::string BROWSER_REQUEST =
+        "GET /search/results?q=pion+http+parser&lang=en HTTP/1.1\r\n"
+        "Host: www.example.com\r\n"
+        "User-Agent: Mozilla/5.0 (X11; Linux x86_64) AppleWebKit/537.36 (KHTML, like Gecko) "
+            "Chrome/120.0.0.0 Safari/537.36\r\n"
+        "Accept: text/html,application/xhtml+xml,application/xml;q=0.9,image/avif,image/webp,*/*;q=0.8\r\n"
+        "Accept-Language: en-US,en;q=0.9\r\n"
+        "Accept-Encoding: gzip, deflate, br\r\n"
+        "Referer: https://www.example.com/search?q=pion&source=homepage\r\n"
+        "Cookie: session=3f2a9c1e7b8d4a6f0e5d; theme=dark; tracking_id=GA1.2.1234567890.1234567890\r\n"
+        "Connection: keep-alive\r\n"
+        "Cache-Control: max-age=0\r\n"
+        "Upgrade-Insecure-Requests: 1\r\n"
+        "\r\n";
+    bench_parse_request("parse_headers.browser", BROWSER_REQUEST, iterations);
+    bench_parse_request("parse_headers.browser_views", BROWSER_REQUEST, iterations, true);
+
+    // a long resource and a few long header values, such as tokens and traces
+    const std::string long_text(2048, 'x');
+    const std::string long_request("GET /assets/" + long_text + ".js HTTP/1.1\r\n"
+                                   "Host: www.example.com\r\n"
+                                   "Authorization: Bearer " + long_text + "\r\n"
+                                   "X-Trace-Context: " + long_text + "\r\n"
+                                   "\r\n");
+    bench_parse_request("parse_headers.long_lines", long_request, iterations);
+
+    // a site with many analytics and preference cookies
+    std::string cookie_request("GET /account/overview?tab=orders&page=2 HTTP/1.1\r\n"
+                               "Host: www.example.com\r\n"
+                               "Cookie: session=3f2a9c1e7b8d4a6f0e5d");
+    for (unsigned int n = 0; n < 40; ++n)
+        cookie_request += "; pref_" + boost::lexical_cast<std::string>(n) + "=GA1.2.1234567890.1234567890";
+    cookie_request += "\r\n\r\n";
+    bench_parse_request("parse_headers.cookies", cookie_request, iterations);
+    bench_parse_request("parse_headers.cookies_used", cookie_request, iterations, false, true, true);
+    bench_parse_request("parse_headers.cookies_eager", cookie_request, iterations, false, false);
+}
+
+/// measures the rate at which the HTTP parser reads payload content
+static void bench_parse_content(unsigned int iterations)
+{
+    static const std::size_t CONTENT_SIZE = 64 * 1024;
+    static const std::size_t CHUNK_SIZE = 4096;
+    const std::string content(CONTENT_SIZE, 'x');
+
+    // an upload with a Content-Length header
+    const std::string length_request("POST /upload HTTP/1.1\r\n"
+                                     "Content-Length: " + boost::lexical_cast<std::string>(CONTENT_SIZE) + "\r\n"
+                                     "\r\n" + content);
+    bench_parse_request("parse_content.length", length_request, iterations);
+
+    // the same upload sent in chunks
+    std::string chunked_request("POST /upload HTTP/1.1\r\n"
+                                "Transfer-Encoding: chunked\r\n"
+                                "\r\n");
+    for (std::size_t pos = 0; pos < CONTENT_SIZE; pos += CHUNK_SIZE)
+        chunked_request += "1000\r\n" + content.substr(pos, CHUNK_SIZE) + "\r\n";
+    chunked_request += "0\r\n\r\n";
+    bench_parse_request("parse_content.chunked", chunked_request, iterations);
+
+    // a response with no length, which is read until the connection closes
+    const std::string no_length_response("HTTP/1.0 200 OK\r\n"
+                                         "\r\n" + content);
+    http::parser response_parser(false);
+    boost::system::error_code ec;
+    unsigned int num_parsed = 0;
+    boost::posix_time::ptime start_time(bench_now());
+    for (unsigned int n = 0; n < iterations; ++n) {
+        http::response http_response;
+        response_parser.reset();
+        response_parser.set_read_buffer(no_length_response.data(), no_length_response.size());
+        if (boost::indeterminate(response_parser.parse(http_response, ec))) {
+            response_parser.finish(http_response);
+            ++num_parsed;
+        }
+    }
+    const double elapsed_nsec = bench_elapsed_nsec(start_time);
+    if (num_parsed > 0)
+        bench_report("parse_content.no_length", double(no_length_response.size()) * num_parsed * 1000.0 / elapsed_nsec, "MB/s");
+}
+
+/// counts finished work items for the scheduler benchmarks
+class BenchWorkCounter {
+public:
+    BenchWorkCounter(void) : m_num_done(0) {}
+
+    /// work item that spins for a number of microseconds
+    void run(long usec) {
+        boost::posix_time::ptime start_time(bench_now());
+        while ((bench_now() - start_time).total_microseconds() < usec) {}
+        boost::mutex::scoped_lock counter_lock(m_mutex);
+        ++m_num_done;
+        m_work_done.notify_all();
+    }
+
+    /// waits until a number of work items have finished
+    void wait(unsigned int num_items) {
+        boost::mutex::scoped_lock counter_lock(m_mutex);
+        while (m_num_done < num_items)
+            m_work_done.wait(counter_lock);
+    }
+
+private:
+    boost::mutex        m_mutex;
+    boost::condition    m_work_done;
+    unsigned int        m_num_done;
+};
+
+/// posts work where one item in a hundred costs 1000 times more than the others
+static void bench_skewed_work(scheduler& sched, const char *name, unsigned int iterations)
+{
+    sched.set_num_threads(4);
+    sched.add_active_user();
+    BenchWorkCounter counter;
+    boost::posix_time::ptime start_time(bench_now());
+    for (unsigned int n = 0; n < iterations; ++n)
+        sched.post(boost::bind(&BenchWorkCounter::run, &counter, (n % 100 == 0) ? 10000L : 10L));
+    counter.wait(iterations);
+    bench_report(name, bench_elapsed_nsec(start_time) / iterations, "ns/item");
+    sched.remove_active_user();
+    sched.shutdown();
+}
+
+/// measures the time to finish work with skewed costs using each scheduler
+static void bench_skewed(unsigned int iterations)
+{
+    {
+        single_service_scheduler sched;
+        bench_skewed_work(sched, "skewed.single_service", iterations);
+    }
+    {
+        one_to_one_scheduler sched;
+        bench_skewed_work(sched, "skewed.one_to_one", iterations);
+    }
+    {
+        work_stealing_scheduler sched;
+        bench_skewed_work(sched, "skewed.work_stealing", iterations);
+        bench_report("skewed.work_stealing.stolen", double(sched.get_stolen_work()), "items");
+    }
+}
+
+/// measures the throughput of post() with and without instrumentation
+static void bench_post(unsigned int iterations)
+{
+    double elapsed_nsec[2];
+    for (int instrumented = 0; instrumented < 2; ++instrumented) {
+        one_to_one_scheduler sched;
+        sched.set_num_threads(4);
+        sched.set_instrumentation(instrumented != 0);
+        sched.add_active_user();
+        BenchWorkCounter counter;
+        boost::posix_time::ptime start_time(bench_now());
+        for (unsigned int n = 0; n < iterations; ++n)
+            sched.post(boost::bind(&BenchWorkCounter::run, &counter, 0L));
+        counter.wait(iterations);
+        elapsed_nsec[instrumented] = bench_elapsed_nsec(start_time);
+        bench_report(instrumented ? "post.instrumented" : "post.uninstrumented",
+                     elapsed_nsec[instrumented] / iterations, "ns/item");
+        sched.remove_active_user();
+        sched.shutdown();
+    }
+    bench_report("post.overhead", (elapsed_nsec[1] - elapsed_nsec[0]) * 100 / elapsed_nsec[0], "%");
+}
+
+/// data type for a benchmark function
+typedef void (*bench_func_t)(unsigned int);
+
+/// table of available benchmarks
+static const struct {
+    const char *    name;
+    bench_func_t    func;
+    unsigned int    iterations;
+} BENCHMARKS[] = {
+    { "connection", bench_connection, 100000 },
+    { "accept", bench_accept, 5000 },
+    { "accept_idle", bench_accept_idle, 5000 },
+    { "keepalive_idle", bench_keepalive_idle, 400 },
+    { "upload", bench_upload, 2000 },
+    { "hello", bench_hello, 20000 },
+    { "parse_headers", bench_parse_headers, 200000 },
+    { "parse_content", bench_parse_content, 5000 },
+    { "skewed", bench_skewed, 20000 },
+    { "post", bench_post, 200000 }
+};
+
+/// number of available benchmarks
+static const std::size_t NUM_BENCHMARKS = sizeof(BENCHMARKS) / sizeof(BENCHMARKS[0]);
+
+
+/// displays an error message if the arguments are invalid
+void argument_error(void)
+{
+    std::cerr << "usage:   pionbench [-n ITERATIONS] [BENCHMARK...]" << std::endl
+              << "benchmarks:";
+    for (std::size_t i = 0; i < NUM_BENCHMARKS; ++i)
+        std::cerr << ' ' << BENCHMARKS[i].name;
+    std::cerr << std::endl;
+}
+
+
+/// main control function
+int main (int argc, char *argv[])
+{
+    unsigned int iterations = 0;
+    std::vector<std::string> selected;
+
+    for (int argnum=1; argnum < argc; ++argnum) {
+        if (argv[argnum][0] == '-') {
+            if (argv[argnum][1] == 'n' && argv[argnum][2] == '\0' && argnum+1 < argc) {
+                iterations = strtoul(argv[++argnum], 0, 10);
+            } else {
+                argument_error();
+                return 1;
+            }
+        } else {
+            selected.push_back(argv[argnum]);
+        }
+    }
+
+    // keep library log output from interfering with the results
+    logger pion_log(PION_GET_LOGGER("pion"));
+    PION_LOG_SETLEVEL_ERROR(pion_log);
+    PION_LOG_CONFIG_BASIC;
+
+    // make sure that all of the selected benchmarks exist
+    for (std::vector<std::string>::const_iterator j = selected.begin(); j != selected.end(); ++j) {
+        std::size_t i = 0;
+        while (i < NUM_BENCHMARKS && *j != BENCHMARKS[i].name)
+            ++i;
+        if (i == NUM_BENCHMARKS) {
+            argument_error();
+            return 1;
+        }
+    }
+
+    try {
+        for (std::size_t i = 0; i < NUM_BENCHMARKS; ++i) {
+            if (selected.empty() || std::find(selected.begin(), selected.end(),
+                                              std::string(BENCHMARKS[i].name)) != selected.end())
+            {
+                BENCHMARKS[i].func(iterations > 0 ? iterations : BENCHMARKS[i].iterations);
+            }
+        }
+    } catch (std::exception& e) {
+        std::cerr << "pionbench: " << pion::diagnostic_information(e) << std::endl;
+        return 1;
+    }
+
+    return 0;
+}
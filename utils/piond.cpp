@@ -10,9 +10,12 @@
 #include <vector>
 #include <iostream>
 #include <boost/asio.hpp>
+#include <boost/lexical_cast.hpp>
 #include <pion/error.hpp>
 #include <pion/plugin.hpp>
 #include <pion/process.hpp>
+#include <pion/scheduler.hpp>
+#include <pion/uring_engine.hpp>
 #include <pion/http/plugin_server.hpp>
 
 // these are used only when linking to static web service libraries
@@ -22,6 +25,7 @@ PION_DECLARE_PLUGIN(FileService)
 PION_DECLARE_PLUGIN(HelloService)
 PION_DECLARE_PLUGIN(LogService)
 PION_DECLARE_PLUGIN(CookieService)
+PION_DECLARE_PLUGIN(SchedulerService)
 
 using namespace std;
 using namespace pion;
@@ -32,7 +36,21 @@ void argument_error(void)
 {
     std::cerr << "usage:   piond [OPTIONS] RESOURCE WEBSERVICE" << std::endl
               << "         piond [OPTIONS] -c SERVICE_CONFIG_FILE" << std::endl
-              << "options: [-ssl PEM_FILE] [-i IP] [-p PORT] [-d PLUGINS_DIR] [-o OPTION=VALUE] [-v]" << std::endl;
+              << "options: [-ssl PEM_FILE] [-i IP] [-p PORT] [-u SOCKET_PATH] [-d PLUGINS_DIR]" << std::endl
+              << "         [-o OPTION=VALUE] [-t TUNABLE=VALUE] [-a CPU_LIST] [-n THREADS]" << std::endl
+              << "         [-w STALL_MSEC] [-b SPIN_USEC] [-e IO_ENGINE] [-m] [-v]" << std::endl
+              << "tunables: backlog, no_delay, defer_accept, fast_open, receive_buffer_size," << std::endl
+              << "         send_buffer_size, accept_batch_size, busy_poll, reuse_port," << std::endl
+              << "         read_buffer_size, max_read_buffer_size, max_cached_connections" << std::endl
+              << "cpu list: CPU numbers and ranges (e.g. 0-3,8) or a NUMA node (e.g. node1);" << std::endl
+              << "         runs one thread pinned to each CPU" << std::endl
+              << "threads: a number of server threads, or a range (e.g. 2-16) to resize" << std::endl
+              << "         the thread pool automatically as the load changes" << std::endl
+              << "stall msec: logs handlers that hold up a server thread for longer than this" << std::endl
+              << "spin usec: server threads busy poll for events this long before blocking" << std::endl
+              << "-m: measures the work run by server threads (reported by SchedulerService)" << std::endl
+              << "io engine: blocking (default) reads files on a thread pool; uring reads" << std::endl
+              << "         them (and performs socket I/O) using io_uring, if the kernel supports it" << std::endl;
 }
 
 
@@ -44,6 +62,7 @@ int main (int argc, char *argv[])
     // used to keep track of web service name=value options
     typedef std::vector<std::pair<std::string, std::string> >   ServiceOptionsType;
     ServiceOptionsType service_options;
+    ServiceOptionsType server_options;
     
     // parse command line: determine port number, RESOURCE and WEBSERVICE
     boost::asio::ip::tcp::endpoint cfg_endpoint(boost::asio::ip::tcp::v4(), DEFAULT_PORT);
@@ -51,7 +70,14 @@ int main (int argc, char *argv[])
     std::string resource_name;
     std::string service_name;
     std::string ssl_pem_file;
+    std::string local_path;
+    std::string cpu_list;
+    std::string num_threads;
+    boost::uint32_t stall_threshold = 0;
+    boost::uint32_t busy_poll = 0;
+    std::string io_engine("blocking");
     bool ssl_flag = false;
+    bool measure_flag = false;
     bool verbose_flag = false;
     
     for (int argnum=1; argnum < argc; ++argnum) {
@@ -64,6 +90,28 @@ int main (int argc, char *argv[])
             } else if (argv[argnum][1] == 'i' && argv[argnum][2] == '\0' && argnum+1 < argc) {
                 // set ip address
                 cfg_endpoint.address(boost::asio::ip::address::from_string(argv[++argnum]));
+            } else if (argv[argnum][1] == 'u' && argv[argnum][2] == '\0' && argnum+1 < argc) {
+                // listen on a Unix domain socket
+                local_path = argv[++argnum];
+            } else if (argv[argnum][1] == 'a' && argv[argnum][2] == '\0' && argnum+1 < argc) {
+                // pin the server's threads to a set of CPUs
+                cpu_list = argv[++argnum];
+            } else if (argv[argnum][1] == 'n' && argv[argnum][2] == '\0' && argnum+1 < argc) {
+                // set the number of threads, or the range used for autoscaling
+                num_threads = argv[++argnum];
+            } else if (argv[argnum][1] == 'w' && argv[argnum][2] == '\0' && argnum+1 < argc) {
+                // set the stall watchdog's threshold
+                stall_threshold = strtoul(argv[++argnum], 0, 10);
+            } else if (argv[argnum][1] == 'b' && argv[argnum][2] == '\0' && argnum+1 < argc) {
+                // set the budget for busy polling
+                busy_poll = strtoul(argv[++argnum], 0, 10);
+            } else if (argv[argnum][1] == 'e' && argv[argnum][2] == '\0' && argnum+1 < argc) {
+                // choose the engine used to read files
+                io_engine = argv[++argnum];
+                if (io_engine != "blocking" && io_engine != "uring") {
+                    argument_error();
+                    return 1;
+                }
             } else if (argv[argnum][1] == 'c' && argv[argnum][2] == '\0' && argnum+1 < argc) {
                 service_config_file = argv[++argnum];
             } else if (argv[argnum][1] == 'd' && argv[argnum][2] == '\0' && argnum+1 < argc) {
@@ -84,10 +132,23 @@ int main (int argc, char *argv[])
                 std::string option_value(option_name, pos + 1);
                 option_name.resize(pos);
                 service_options.push_back( std::make_pair(option_name, option_value) );
+            } else if (argv[argnum][1] == 't' && argv[argnum][2] == '\0' && argnum+1 < argc) {
+                // set a server tunable
+                std::string option_name(argv[++argnum]);
+                std::string::size_type pos = option_name.find('=');
+                if (pos == std::string::npos) {
+                    argument_error();
+                    return 1;
+                }
+                std::string option_value(option_name, pos + 1);
+                option_name.resize(pos);
+                server_options.push_back( std::make_pair(option_name, option_value) );
             } else if (argv[argnum][1] == 's' && argv[argnum][2] == 's' &&
                        argv[argnum][3] == 'l' && argv[argnum][4] == '\0' && argnum+1 < argc) {
                 ssl_flag = true;
                 ssl_pem_file = argv[++argnum];
+            } else if (argv[argnum][1] == 'm' && argv[argnum][2] == '\0') {
+                measure_flag = true;
             } else if (argv[argnum][1] == 'v' && argv[argnum][2] == '\0') {
                 verbose_flag = true;
             } else {
@@ -141,8 +202,51 @@ int main (int argc, char *argv[])
                 << boost::filesystem::path(argv[0]).branch_path());
         }
 
+        // threads pinned to CPUs each use their own IO service, so that
+        // connections stay on the NUMA node of the thread that accepted them
+        single_service_scheduler shared_scheduler;
+        one_to_one_scheduler pinned_scheduler;
+        if (! cpu_list.empty()) {
+            pinned_scheduler.set_cpu_affinity(multi_thread_scheduler::parse_cpu_list(cpu_list));
+            pinned_scheduler.set_num_threads(static_cast<boost::uint32_t>(pinned_scheduler.get_cpu_affinity().size()));
+            PION_LOG_INFO(main_log, "Pinning " << pinned_scheduler.get_num_threads()
+                << " server threads to CPUs: " << cpu_list);
+        }
+        multi_thread_scheduler& web_scheduler = (cpu_list.empty() ? static_cast<multi_thread_scheduler&>(shared_scheduler)
+            : static_cast<multi_thread_scheduler&>(pinned_scheduler));
+
+        if (! num_threads.empty()) {
+            const std::string::size_type pos = num_threads.find('-');
+            const boost::uint32_t min_threads = boost::lexical_cast<boost::uint32_t>(num_threads.substr(0, pos));
+            if (pos == std::string::npos) {
+                web_scheduler.set_num_threads(min_threads);
+            } else {
+                // start with the fewest threads and add more as needed
+                web_scheduler.set_thread_limits(min_threads, boost::lexical_cast<boost::uint32_t>(num_threads.substr(pos + 1)));
+                web_scheduler.set_num_threads(min_threads);
+                web_scheduler.set_autoscaling(true);
+            }
+        }
+
+        if (stall_threshold > 0)
+            web_scheduler.set_stall_threshold(stall_threshold);
+        web_scheduler.set_busy_poll(busy_poll);
+        web_scheduler.set_instrumentation(measure_flag);
+
+        if (io_engine == "uring") {
+            if (! uring_engine::get_instance().start()) {
+                PION_LOG_WARN(main_log, "io_uring is not available; reading files on the blocking pool");
+            } else if (uring_engine::get_instance().has_socket_io()) {
+                PION_LOG_INFO(main_log, "Reading files and performing socket I/O using io_uring");
+            } else {
+                PION_LOG_INFO(main_log, "Reading files using io_uring");
+            }
+        }
+
         // create a server for HTTP & add the Hello Service
-        http::plugin_server  web_server(cfg_endpoint);
+        http::plugin_server  web_server(web_scheduler, cfg_endpoint);
+        if (! local_path.empty())
+            web_server.set_local_path(local_path);
 
         if (ssl_flag) {
 #ifdef PION_HAVE_SSL
@@ -169,6 +273,14 @@ int main (int argc, char *argv[])
             web_server.load_service_config(service_config_file);
         }
 
+        // set server tunables if any are defined
+        for (ServiceOptionsType::iterator i = server_options.begin();
+             i != server_options.end(); ++i)
+        {
+            web_server.set_option(i->first, i->second);
+            PION_LOG_INFO(main_log, "Set server option: " << i->first << '=' << i->second);
+        }
+
         // startup the server
         web_server.start();
         process::wait_for_shutdown();